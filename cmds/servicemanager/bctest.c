@@ -54,6 +54,36 @@ int svcmgr_publish(struct binder_state *bs, uint32_t target, const char *name, v
     return status;
 }
 
+int svcmgr_stats(struct binder_state *bs, uint32_t target)
+{
+    unsigned iodata[512/4];
+    struct binder_io msg, reply;
+
+    bio_init(&msg, iodata, sizeof(iodata), 4);
+    bio_put_uint32(&msg, 0);  // strict mode header
+    bio_put_string16_x(&msg, SVC_MGR_NAME);
+
+    if (binder_call(bs, &msg, &reply, target, SVC_MGR_DUMP_STATS))
+        return -1;
+
+    uint32_t services = bio_get_uint32(&reply);
+    uint32_t buckets = bio_get_uint32(&reply);
+    uint32_t lookups = bio_get_uint32(&reply);
+    uint32_t misses = bio_get_uint32(&reply);
+    uint32_t find_avg = bio_get_uint32(&reply);
+    uint32_t find_max = bio_get_uint32(&reply);
+    uint32_t total_avg = bio_get_uint32(&reply);
+    uint32_t total_max = bio_get_uint32(&reply);
+
+    binder_done(bs, &msg, &reply);
+
+    fprintf(stderr,"services: %u in %u buckets\n", services, buckets);
+    fprintf(stderr,"lookups: %u (%u misses)\n", lookups, misses);
+    fprintf(stderr,"table lookup: avg %u ns, max %u ns\n", find_avg, find_max);
+    fprintf(stderr,"with permission checks: avg %u ns, max %u ns\n", total_avg, total_max);
+    return 0;
+}
+
 unsigned token;
 
 int main(int argc, char **argv)
@@ -96,6 +126,8 @@ int main(int argc, char **argv)
             svcmgr_publish(bs, svcmgr, argv[1], &token);
             argc--;
             argv++;
+        } else if (!strcmp(argv[0],"stats")) {
+            svcmgr_stats(bs, svcmgr);
         } else {
             fprintf(stderr,"unknown command %s\n", argv[0]);
             return -1;
@@ -39,6 +39,8 @@ enum {
     SVC_MGR_CHECK_SERVICE,
     SVC_MGR_ADD_SERVICE,
     SVC_MGR_LIST_SERVICES,
+    /* servicemanager only: lookup statistics, see svcmgr_stats() in bctest */
+    SVC_MGR_DUMP_STATS,
 };
 
 typedef int (*binder_handler)(struct binder_state *bs,
@@ -7,6 +7,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 #include <cutils/multiuser.h>
 
@@ -145,7 +146,8 @@ static int svc_can_find(const uint16_t *name, size_t name_len, pid_t spid, uid_t
 
 struct svcinfo
 {
-    struct svcinfo *next;
+    struct svcinfo *next;   /* next in the same hash bucket */
+    uint32_t hash;
     uint32_t handle;
     struct binder_death death;
     int allow_isolated;
@@ -153,14 +155,78 @@ struct svcinfo
     uint16_t name[0];
 };
 
-struct svcinfo *svclist = NULL;
+/*
+ * Services are kept in a hash table keyed on their UTF-16 name, which
+ * grows to keep at most one service per bucket on average. A side index
+ * sorted by name serves list_services, which walks the services by
+ * position. Services are never removed, so neither needs deletion.
+ */
+#define SVC_INITIAL_BUCKETS 64
+
+static struct svcinfo **svc_buckets;
+static size_t svc_bucket_count;
+static struct svcinfo **svc_index;
+static size_t svc_index_capacity;
+static size_t svc_count;
+
+struct svc_lookup_stats
+{
+    uint64_t lookups;
+    uint64_t misses;
+    uint64_t find_ns;       /* time spent in the table */
+    uint64_t find_max_ns;
+    uint64_t total_ns;      /* including the permission checks */
+    uint64_t total_max_ns;
+};
+
+static struct svc_lookup_stats lookup_stats;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + (uint64_t) ts.tv_nsec;
+}
+
+static uint32_t svc_hash(const uint16_t *s16, size_t len)
+{
+    /* FNV-1a over the UTF-16 code units */
+    uint32_t hash = 2166136261U;
+    size_t i;
+
+    for (i = 0; i < len; i++) {
+        hash ^= s16[i];
+        hash *= 16777619U;
+    }
+    return hash;
+}
+
+static int svc_name_cmp(const uint16_t *a, size_t a_len, const uint16_t *b, size_t b_len)
+{
+    size_t len = a_len < b_len ? a_len : b_len;
+    size_t i;
+
+    for (i = 0; i < len; i++) {
+        if (a[i] != b[i])
+            return a[i] < b[i] ? -1 : 1;
+    }
+    if (a_len == b_len)
+        return 0;
+    return a_len < b_len ? -1 : 1;
+}
 
 struct svcinfo *find_svc(const uint16_t *s16, size_t len)
 {
     struct svcinfo *si;
+    uint32_t hash;
 
-    for (si = svclist; si; si = si->next) {
-        if ((len == si->len) &&
+    if (!svc_buckets) {
+        return NULL;
+    }
+
+    hash = svc_hash(s16, len);
+    for (si = svc_buckets[hash & (svc_bucket_count - 1)]; si; si = si->next) {
+        if ((hash == si->hash) && (len == si->len) &&
             !memcmp(s16, si->name, len * sizeof(uint16_t))) {
             return si;
         }
@@ -168,6 +234,73 @@ struct svcinfo *find_svc(const uint16_t *s16, size_t len)
     return NULL;
 }
 
+static void svc_rehash(size_t bucket_count)
+{
+    struct svcinfo **buckets;
+    struct svcinfo *si, *next;
+    size_t i;
+
+    buckets = calloc(bucket_count, sizeof(*buckets));
+    if (!buckets) {
+        /* keep the current table; it only gets slower */
+        return;
+    }
+
+    for (i = 0; i < svc_bucket_count; i++) {
+        for (si = svc_buckets[i]; si; si = next) {
+            next = si->next;
+            si->next = buckets[si->hash & (bucket_count - 1)];
+            buckets[si->hash & (bucket_count - 1)] = si;
+        }
+    }
+    free(svc_buckets);
+    svc_buckets = buckets;
+    svc_bucket_count = bucket_count;
+}
+
+static int svc_insert(struct svcinfo *si)
+{
+    size_t lo, hi;
+
+    if (!svc_buckets) {
+        svc_rehash(SVC_INITIAL_BUCKETS);
+        if (!svc_buckets)
+            return -1;
+    }
+
+    if (svc_count == svc_index_capacity) {
+        size_t capacity = svc_index_capacity ? svc_index_capacity * 2 : SVC_INITIAL_BUCKETS;
+        struct svcinfo **index = realloc(svc_index, capacity * sizeof(*index));
+        if (!index)
+            return -1;
+        svc_index = index;
+        svc_index_capacity = capacity;
+    }
+
+    if (svc_count >= svc_bucket_count) {
+        svc_rehash(svc_bucket_count * 2);
+    }
+
+    si->hash = svc_hash(si->name, si->len);
+    si->next = svc_buckets[si->hash & (svc_bucket_count - 1)];
+    svc_buckets[si->hash & (svc_bucket_count - 1)] = si;
+
+    /* binary search for the insertion point in the sorted index */
+    lo = 0;
+    hi = svc_count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (svc_name_cmp(svc_index[mid]->name, svc_index[mid]->len, si->name, si->len) < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    memmove(&svc_index[lo + 1], &svc_index[lo], (svc_count - lo) * sizeof(*svc_index));
+    svc_index[lo] = si;
+    svc_count++;
+    return 0;
+}
+
 void svcinfo_death(struct binder_state *bs, void *ptr)
 {
     struct svcinfo *si = (struct svcinfo* ) ptr;
@@ -185,10 +318,25 @@ uint16_t svcmgr_id[] = {
 };
 
 
-uint32_t do_find_service(const uint16_t *s, size_t len, uid_t uid, pid_t spid)
+static void record_lookup(uint64_t start_ns, uint64_t found_ns, uint32_t handle)
 {
-    struct svcinfo *si = find_svc(s, len);
+    uint64_t find_ns = found_ns - start_ns;
+    uint64_t total_ns = now_ns() - start_ns;
+
+    lookup_stats.lookups++;
+    if (!handle)
+        lookup_stats.misses++;
+    lookup_stats.find_ns += find_ns;
+    lookup_stats.total_ns += total_ns;
+    if (find_ns > lookup_stats.find_max_ns)
+        lookup_stats.find_max_ns = find_ns;
+    if (total_ns > lookup_stats.total_max_ns)
+        lookup_stats.total_max_ns = total_ns;
+}
 
+static uint32_t check_find_service(struct svcinfo *si, const uint16_t *s, size_t len,
+                                   uid_t uid, pid_t spid)
+{
     if (!si || !si->handle) {
         return 0;
     }
@@ -209,6 +357,34 @@ uint32_t do_find_service(const uint16_t *s, size_t len, uid_t uid, pid_t spid)
     return si->handle;
 }
 
+uint32_t do_find_service(const uint16_t *s, size_t len, uid_t uid, pid_t spid)
+{
+    uint64_t start_ns = now_ns();
+    struct svcinfo *si = find_svc(s, len);
+    uint64_t found_ns = now_ns();
+    uint32_t handle = check_find_service(si, s, len, uid, spid);
+
+    record_lookup(start_ns, found_ns, handle);
+    return handle;
+}
+
+static uint32_t avg_ns(uint64_t total_ns, uint64_t count)
+{
+    return count ? (uint32_t) (total_ns / count) : 0;
+}
+
+static void put_stats(struct binder_io *reply)
+{
+    bio_put_uint32(reply, (uint32_t) svc_count);
+    bio_put_uint32(reply, (uint32_t) svc_bucket_count);
+    bio_put_uint32(reply, (uint32_t) lookup_stats.lookups);
+    bio_put_uint32(reply, (uint32_t) lookup_stats.misses);
+    bio_put_uint32(reply, avg_ns(lookup_stats.find_ns, lookup_stats.lookups));
+    bio_put_uint32(reply, (uint32_t) lookup_stats.find_max_ns);
+    bio_put_uint32(reply, avg_ns(lookup_stats.total_ns, lookup_stats.lookups));
+    bio_put_uint32(reply, (uint32_t) lookup_stats.total_max_ns);
+}
+
 int do_add_service(struct binder_state *bs,
                    const uint16_t *s, size_t len,
                    uint32_t handle, uid_t uid, int allow_isolated,
@@ -250,8 +426,12 @@ int do_add_service(struct binder_state *bs,
         si->death.func = (void*) svcinfo_death;
         si->death.ptr = si;
         si->allow_isolated = allow_isolated;
-        si->next = svclist;
-        svclist = si;
+        if (svc_insert(si)) {
+            ALOGE("add_service('%s',%x) uid=%d - OUT OF MEMORY\n",
+                 str8(s, len), handle, uid);
+            free(si);
+            return -1;
+        }
     }
 
     binder_acquire(bs, handle);
@@ -264,7 +444,6 @@ int svcmgr_handler(struct binder_state *bs,
                    struct binder_io *msg,
                    struct binder_io *reply)
 {
-    struct svcinfo *si;
     uint16_t *s;
     size_t len;
     uint32_t handle;
@@ -337,15 +516,22 @@ int svcmgr_handler(struct binder_state *bs,
                     txn->sender_euid);
             return -1;
         }
-        si = svclist;
-        while ((n-- > 0) && si)
-            si = si->next;
-        if (si) {
-            bio_put_string16(reply, si->name);
+        if (n < svc_count) {
+            bio_put_string16(reply, svc_index[n]->name);
             return 0;
         }
         return -1;
     }
+
+    case SVC_MGR_DUMP_STATS:
+        if (!svc_can_list(txn->sender_pid, txn->sender_euid)) {
+            ALOGE("dump_stats() uid=%d - PERMISSION DENIED\n",
+                    txn->sender_euid);
+            return -1;
+        }
+        put_stats(reply);
+        return 0;
+
     default:
         ALOGE("unknown code %d\n", txn->code);
         return -1;
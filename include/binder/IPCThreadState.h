@@ -29,6 +29,8 @@ typedef  int  uid_t;
 // ---------------------------------------------------------------------------
 namespace android {
 
+class TransactionStats;
+
 class IPCThreadState
 {
 public:
@@ -88,6 +90,28 @@ public:
             // the maximum number of binder threads threads allowed for this process.
             void                blockUntilThreadAvailable();
 
+    // While a BatchScope exists, oneway transactions made by the calling
+    // thread are queued (with a copy of their data) instead of each being
+    // sent with its own BINDER_WRITE_READ, and are all sent at once when
+    // the outermost scope ends or is flushed. A two-way transaction, or a
+    // full queue, flushes the batch first. Errors of the queued
+    // transactions are returned by flush(), and by the transaction that
+    // filled the queue; otherwise they're left in the thread's last error
+    // (see clearLastError()).
+    class BatchScope {
+    public:
+                                BatchScope();
+                                ~BatchScope();
+
+            status_t            flush();
+
+    private:
+                                BatchScope(const BatchScope&);
+            BatchScope&         operator=(const BatchScope&);
+
+            IPCThreadState*     mState;
+    };
+
 private:
                                 IPCThreadState();
                                 ~IPCThreadState();
@@ -105,9 +129,23 @@ private:
             status_t            getAndExecuteCommand();
             status_t            executeCommand(int32_t command);
             void                processPendingDerefs();
+            status_t            queueBatchedTransaction(int32_t handle,
+                                                        uint32_t code,
+                                                        const Parcel& data,
+                                                        uint32_t flags);
+            status_t            flushBatch();
 
             void                clearCaller();
 
+            // A oneway transaction queued by a BatchScope, with its own copy
+            // of the data.
+            struct BatchedTransaction {
+                int32_t         handle;
+                uint32_t        code;
+                uint32_t        flags;
+                Parcel*         data;
+            };
+
     static  void                threadDestructor(void *st);
     static  void                freeBuffer(Parcel* parcel,
                                            const uint8_t* data, size_t dataSize,
@@ -126,6 +164,17 @@ private:
             uid_t               mCallingUid;
             int32_t             mStrictModePolicy;
             int32_t             mLastTransactionBinderFlags;
+            // Slot in ProcessState's thread pool statistics, -1 if this
+            // thread isn't in the pool.
+            ssize_t             mPoolStatsIndex;
+            bool                mLeavePool;
+            nsecs_t             mLastReadTime;
+            int32_t             mBatchDepth;
+            Vector<BatchedTransaction> mBatchedTransactions;
+            size_t              mBatchedSize;
+            // Bytes of mOut the driver has consumed so far.
+            size_t              mOutConsumed;
+            TransactionStats*   mTransactionStats;
 };
 
 }; // namespace android
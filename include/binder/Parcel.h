@@ -99,6 +99,11 @@ public:
     void                setError(status_t err);
     
     status_t            write(const void* data, size_t len);
+    // Like write(), but large buffers are only referenced: the bytes are
+    // copied in once, when the parcel is sent or otherwise accessed through
+    // anything but another write. The caller must keep 'data' valid and
+    // unchanged until then.
+    status_t            writeExternal(const void* data, size_t len);
     void*               writeInplace(size_t len);
     status_t            writeUnpadded(const void* data, size_t len);
     status_t            writeInt32(int32_t val);
@@ -128,6 +133,10 @@ public:
     status_t            writeByteVector(const std::vector<int8_t>& val);
     status_t            writeByteVector(const std::unique_ptr<std::vector<uint8_t>>& val);
     status_t            writeByteVector(const std::vector<uint8_t>& val);
+    // Same wire format as writeByteVector(), but the contents are written
+    // with writeExternal().
+    status_t            writeByteVectorExternal(const std::vector<int8_t>& val);
+    status_t            writeByteVectorExternal(const std::vector<uint8_t>& val);
     status_t            writeInt32Vector(const std::unique_ptr<std::vector<int32_t>>& val);
     status_t            writeInt32Vector(const std::vector<int32_t>& val);
     status_t            writeInt64Vector(const std::unique_ptr<std::vector<int64_t>>& val);
@@ -342,6 +351,13 @@ public:
     static size_t       getGlobalAllocSize();
     static size_t       getGlobalAllocCount();
 
+    // Debugging: get metrics on the per-thread pools of small data buffers.
+    // A hit is an allocation served from a pool, a miss one of pool size
+    // that had to go to the heap.
+    static size_t       getGlobalPoolHitCount();
+    static size_t       getGlobalPoolMissCount();
+    static size_t       getGlobalPooledSize();
+
 private:
     typedef void        (*release_func)(Parcel* parcel,
                                         const uint8_t* data, size_t dataSize,
@@ -374,6 +390,9 @@ private:
     uintptr_t           readPointer() const;
     void                freeDataNoInit();
     void                initState();
+    status_t            flattenExternal() const;
+    status_t            flattenExternalSegments();
+    void                clearExternal();
     void                scanForFds() const;
                         
     template<class T>
@@ -429,6 +448,16 @@ private:
     release_func        mOwner;
     void*               mOwnerCookie;
 
+    // Caller-owned data appended by writeExternal(), to be copied in at
+    // 'offset' in mData by flattenExternal().
+    struct ExternalSegment {
+        size_t          offset;
+        const void*     data;
+        size_t          size;
+    };
+    std::vector<ExternalSegment> mExternalSegments;
+    size_t              mExternalSize;  // sum of padded segment sizes
+
     class Blob {
     public:
         Blob();
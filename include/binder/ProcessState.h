@@ -21,11 +21,15 @@
 #include <utils/KeyedVector.h>
 #include <utils/String8.h>
 #include <utils/String16.h>
+#include <utils/Timers.h>
+#include <utils/Vector.h>
 
 #include <utils/threads.h>
 
 #include <pthread.h>
 
+#include <atomic>
+
 // ---------------------------------------------------------------------------
 namespace android {
 
@@ -64,6 +68,24 @@ public:
             status_t            setThreadPoolMaxThreadCount(size_t maxThreads);
             void                giveThreadPoolName();
 
+            // Lets the driver start only 'minThreads' pooled threads at first
+            // and raises its limit, up to 'maxThreads', whenever a
+            // transaction had to wait for a free thread for too long. Once a
+            // 'window' passes without such waits, pooled threads beyond what
+            // that window needed leave the pool as they finish a command.
+            status_t            setThreadPoolAdaptive(size_t minThreads,
+                                                      size_t maxThreads,
+                                                      nsecs_t window = s2ns(10));
+
+            // Appends per-thread busy/idle statistics of the thread pool.
+            void                dumpThreadPool(String8& result);
+
+            // Appends latency histograms of the transactions made and served
+            // by this process, per interface descriptor and code. Recording
+            // is off unless debug.binder.stats is set or it is enabled here.
+            void                setTransactionStatsEnabled(bool enabled);
+            void                dumpTransactionStats(String8& result);
+
 private:
     friend class IPCThreadState;
     
@@ -74,12 +96,53 @@ private:
             ProcessState&       operator=(const ProcessState& o);
             String8             makeBinderThreadName();
 
-            struct handle_entry {
-                IBinder* binder;
-                RefBase::weakref_type* refs;
+            // Proxies by handle. Lookups of existing proxies don't take mLock:
+            // readers announce themselves in mHandleReaders while they look
+            // at the table, and anything that could free what they see (a
+            // table being replaced by a larger one, a BpBinder being
+            // destroyed) first waits for the readers to leave.
+            struct handle_table {
+                size_t capacity;
+                std::atomic<IBinder*>* entries;
             };
 
-            handle_entry*       lookupHandleLocked(int32_t handle);
+            struct handle_reader_slot {
+                std::atomic<int32_t> count;
+                char padding[64 - sizeof(std::atomic<int32_t>)];
+            };
+
+            static const size_t kHandleReaderSlots = 16;
+
+            std::atomic<IBinder*>* lookupHandleLocked(int32_t handle);
+            IBinder*            attemptIncWeakProxy(int32_t handle);
+            void                waitForHandleReaders();
+
+            struct pool_thread_stats {
+                pid_t tid;
+                bool active;
+                bool isMain;
+                // Set once the thread has been told to leave the pool; it
+                // no longer counts towards mPoolThreads from then on.
+                bool leaving;
+                uint64_t commands;
+                uint64_t transactions;
+                nsecs_t busyTime;
+                nsecs_t idleTime;
+                nsecs_t totalQueueDelay;
+                nsecs_t maxQueueDelay;
+                // Set on the first thread to free up after every looper was
+                // busy: the driver may have queued work for it since then.
+                nsecs_t queuedSince;
+            };
+
+            // Called by pool threads with mThreadCountLock held.
+            ssize_t             registerPoolThreadLocked(pid_t tid, bool isMain);
+            void                unregisterPoolThreadLocked(ssize_t index);
+            void                poolCommandStartedLocked(ssize_t index, bool isTransaction,
+                                                         nsecs_t waitStart,
+                                                         nsecs_t readTime,
+                                                         nsecs_t start);
+            bool                poolCommandFinishedLocked(ssize_t index, nsecs_t busyTime);
 
             int                 mDriverFD;
             void*               mVMStart;
@@ -93,11 +156,32 @@ private:
             size_t              mMaxThreads;
             // Time when thread pool was emptied
             int64_t             mStarvationStartTimeMs;
+            // Adaptive pool state, see setThreadPoolAdaptive().
+            bool                mAdaptivePool;
+            size_t              mAdaptiveMinThreads;
+            nsecs_t             mAdaptiveWindow;
+            // Threads in joinThreadPool(), the pooled (non-main) ones among
+            // them, and pooled threads ever registered with the driver. The
+            // driver's limit applies to the latter.
+            size_t              mLooperThreads;
+            size_t              mPoolThreads;
+            size_t              mRegisteredPoolThreads;
+            size_t              mDriverMaxThreads;
+            // When every looper became busy, 0 while some are waiting.
+            nsecs_t             mSaturatedSince;
+            // Most threads busy at once, and longest a transaction waited for
+            // one, in the current observation window.
+            size_t              mWindowPeakThreads;
+            nsecs_t             mWindowMaxQueueDelay;
+            nsecs_t             mWindowStartTime;
+            size_t              mTargetPoolThreads;
+            Vector<pool_thread_stats> mPoolThreadStats;
+
+            handle_reader_slot  mHandleReaders[kHandleReaderSlots];
+            std::atomic<handle_table*> mHandleTable;
 
     mutable Mutex               mLock;  // protects everything below.
 
-            Vector<handle_entry>mHandleToObject;
-
             bool                mManagesContexts;
             context_check_func  mBinderContextCheckFunc;
             void*               mBinderContextUserData;
@@ -131,6 +131,24 @@ class BufferItem : public Flattenable<BufferItem> {
     // Indicates that this BufferItem contains a stale buffer which has already
     // been released by the BufferQueue.
     bool mIsStale;
+
+    // mDequeueTime and mQueueTime are the times (systemTime) at which the
+    // producer dequeued and queued this buffer, or 0 if the buffer was never
+    // dequeued, e.g. because it was attached instead.
+    union {
+        int64_t mDequeueTime;
+        struct {
+            uint32_t mDequeueTimeLo;
+            uint32_t mDequeueTimeHi;
+        };
+    };
+    union {
+        int64_t mQueueTime;
+        struct {
+            uint32_t mQueueTimeLo;
+            uint32_t mQueueTimeHi;
+        };
+    };
 };
 
 } // namespace android
@@ -0,0 +1,136 @@
+/*
+ * Copyright 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_GUI_BUFFERITEMFIFO_H
+#define ANDROID_GUI_BUFFERITEMFIFO_H
+
+#include <gui/BufferItem.h>
+
+#include <atomic>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace android {
+
+// BufferItemFifo is the queue of BufferItems between the producer and the
+// consumer of a BufferQueue. It's a ring, so removing the front item (what
+// acquireBuffer does) doesn't shift the remaining ones, and it only allocates
+// when it grows past its largest size so far.
+//
+// It's used like the Vector it replaces: all modifications must be made under
+// BufferQueueCore::mMutex. The head and tail positions are atomic so that
+// empty() and size() may also be read without holding the lock, e.g. by a
+// consumer polling for a new buffer.
+class BufferItemFifo {
+public:
+    template <typename Fifo, typename Item>
+    class Iterator {
+    public:
+        Iterator() : mFifo(NULL), mPosition(0) {}
+
+        Item& operator*() const { return mFifo->itemAtPosition(mPosition); }
+        Item* operator->() const { return &mFifo->itemAtPosition(mPosition); }
+
+        Iterator& operator++() {
+            ++mPosition;
+            return *this;
+        }
+
+        bool operator==(const Iterator& rhs) const {
+            return mPosition == rhs.mPosition;
+        }
+        bool operator!=(const Iterator& rhs) const {
+            return mPosition != rhs.mPosition;
+        }
+
+    private:
+        friend class BufferItemFifo;
+        Iterator(Fifo* fifo, uint32_t position)
+          : mFifo(fifo), mPosition(position) {}
+
+        Fifo* mFifo;
+        uint32_t mPosition;
+    };
+
+    typedef Iterator<BufferItemFifo, BufferItem> iterator;
+    typedef Iterator<const BufferItemFifo, const BufferItem> const_iterator;
+
+    BufferItemFifo();
+    ~BufferItemFifo();
+
+    bool empty() const {
+        return mHead.load(std::memory_order_acquire) ==
+                mTail.load(std::memory_order_acquire);
+    }
+
+    size_t size() const {
+        // Head first: it never passes a tail loaded after it.
+        const uint32_t headPosition = mHead.load(std::memory_order_acquire);
+        return mTail.load(std::memory_order_acquire) - headPosition;
+    }
+
+    iterator begin() { return iterator(this, head()); }
+    iterator end() { return iterator(this, tail()); }
+    const_iterator begin() const { return const_iterator(this, head()); }
+    const_iterator end() const { return const_iterator(this, tail()); }
+
+    const BufferItem& operator[](size_t index) const { return itemAt(index); }
+    BufferItem& operator[](size_t index) { return editItemAt(index); }
+
+    const BufferItem& itemAt(size_t index) const {
+        return itemAtPosition(head() + static_cast<uint32_t>(index));
+    }
+    BufferItem& editItemAt(size_t index) {
+        return itemAtPosition(head() + static_cast<uint32_t>(index));
+    }
+
+    void push_back(const BufferItem& item);
+
+    // Removes the item at 'position' and returns an iterator to the item
+    // that followed it. Removing the front item is O(1); erasing end() does
+    // nothing.
+    iterator erase(const iterator& position);
+
+    void clear();
+
+private:
+    BufferItemFifo(const BufferItemFifo&);
+    BufferItemFifo& operator=(const BufferItemFifo&);
+
+    // Positions only ever increase (modulo 2^32); the item at position p is
+    // stored at mItems[p & (mCapacity - 1)].
+    uint32_t head() const { return mHead.load(std::memory_order_relaxed); }
+    uint32_t tail() const { return mTail.load(std::memory_order_relaxed); }
+
+    BufferItem& itemAtPosition(uint32_t position) {
+        return mItems[position & (mCapacity - 1)];
+    }
+    const BufferItem& itemAtPosition(uint32_t position) const {
+        return mItems[position & (mCapacity - 1)];
+    }
+
+    void grow();
+
+    BufferItem* mItems;
+    uint32_t mCapacity; // always a power of two
+    std::atomic<uint32_t> mHead;
+    std::atomic<uint32_t> mTail;
+};
+
+} // namespace android
+
+#endif
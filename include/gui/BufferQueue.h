@@ -77,9 +77,15 @@ public:
     // BufferQueue manages a pool of gralloc memory slots to be used by
     // producers and consumers. allocator is used to allocate all the
     // needed gralloc buffers.
+    //
+    // singleProducerConsumer may be set when a single thread of this process
+    // produces and a single thread consumes; the consumer can then poll an
+    // empty queue without taking the lock. Handing a buffer over still takes
+    // the lock on both sides: this isn't a lock-free queue.
     static void createBufferQueue(sp<IGraphicBufferProducer>* outProducer,
             sp<IGraphicBufferConsumer>* outConsumer,
-            const sp<IGraphicBufferAlloc>& allocator = NULL);
+            const sp<IGraphicBufferAlloc>& allocator = NULL,
+            bool singleProducerConsumer = false);
 
 private:
     BufferQueue(); // Create through createBufferQueue
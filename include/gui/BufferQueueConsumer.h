@@ -143,6 +143,9 @@ public:
     // See IGraphicBufferConsumer::discardFreeBuffers
     virtual status_t discardFreeBuffers() override;
 
+    // See IGraphicBufferConsumer::setAdaptiveQueueDepth
+    virtual status_t setAdaptiveQueueDepth(bool enabled) override;
+
     // dump our state in a String
     virtual void dumpState(String8& result, const char* prefix) const;
 
@@ -18,8 +18,11 @@
 #define ANDROID_GUI_BUFFERQUEUECORE_H
 
 #include <gui/BufferItem.h>
+#include <gui/BufferItemFifo.h>
 #include <gui/BufferQueueDefs.h>
 #include <gui/BufferSlot.h>
+#include <gui/BufferSlotSet.h>
+#include <gui/LatencyHistogram.h>
 #include <gui/OccupancyTracker.h>
 
 #include <utils/Condition.h>
@@ -31,8 +34,8 @@
 #include <utils/Trace.h>
 #include <utils/Vector.h>
 
-#include <list>
-#include <set>
+#include <atomic>
+#include <thread>
 
 #define BQ_LOGV(x, ...) ALOGV("[%s] " x, mConsumerName.string(), ##__VA_ARGS__)
 #define BQ_LOGD(x, ...) ALOGD("[%s] " x, mConsumerName.string(), ##__VA_ARGS__)
@@ -76,12 +79,14 @@ public:
         NO_CONNECTED_API        = 0,
     };
 
-    typedef Vector<BufferItem> Fifo;
+    typedef BufferItemFifo Fifo;
 
     // BufferQueueCore manages a pool of gralloc memory slots to be used by
     // producers and consumers. allocator is used to allocate all the needed
-    // gralloc buffers.
-    BufferQueueCore(const sp<IGraphicBufferAlloc>& allocator = NULL);
+    // gralloc buffers. singleProducerConsumer promises that a single thread
+    // produces and a single thread consumes; see mSingleProducerConsumer.
+    BufferQueueCore(const sp<IGraphicBufferAlloc>& allocator = NULL,
+            bool singleProducerConsumer = false);
     virtual ~BufferQueueCore();
 
 private:
@@ -121,6 +126,20 @@ private:
     // given slot.
     void clearBufferSlotLocked(int slot);
 
+    // recycleBufferLocked offers the buffer of a free slot to the
+    // GraphicBufferPool, before the slot is cleared because the buffer is no
+    // longer needed.
+    void recycleBufferLocked(int slot);
+
+    // createGraphicBuffer takes a buffer from the GraphicBufferPool if it
+    // holds one recycled for owner (see mLastProducerUid, -1 to bypass the
+    // pool), and otherwise allocates one. *outFence must be waited on before
+    // writing to the buffer. It must be called without mMutex held.
+    sp<GraphicBuffer> createGraphicBuffer(int32_t owner, uint32_t width,
+            uint32_t height, PixelFormat format, uint32_t usage,
+            const String8& requestorName, sp<Fence>* outFence,
+            status_t* outError);
+
     // freeAllBuffersLocked frees the GraphicBuffer and sync resources for
     // all slots, even if they're currently dequeued, queued, or acquired.
     void freeAllBuffersLocked();
@@ -137,6 +156,69 @@ private:
     // waitWhileAllocatingLocked blocks until mIsAllocating is false.
     void waitWhileAllocatingLocked() const;
 
+    // recordDequeueLocked remembers the attributes a dequeueBuffer call asked
+    // for (before defaults and consumer usage bits were applied), from which
+    // the attributes of the next buffers are predicted.
+    void recordDequeueLocked(uint32_t width, uint32_t height,
+            PixelFormat format, uint32_t usage);
+
+    // schedulePreallocationLocked wakes the preallocation worker, starting it
+    // the first time, if free buffers don't match the predicted attributes.
+    // It's called whenever the attributes may have changed or a buffer became
+    // free.
+    void schedulePreallocationLocked();
+
+    // stopPreallocation makes the preallocation worker exit and joins it.
+    void stopPreallocation();
+
+    // preallocationLoop is run by the preallocation worker. It calls
+    // preallocateBuffers whenever schedulePreallocationLocked asks for it.
+    void preallocationLoop();
+
+    // getPredictedAttributesLocked returns the attributes the next dequeued
+    // buffers are expected to have, or false if there's no prediction or
+    // preallocation isn't possible.
+    bool getPredictedAttributesLocked(uint32_t* outWidth, uint32_t* outHeight,
+            PixelFormat* outFormat, uint32_t* outUsage) const;
+
+    // getPreallocationTargetLocked computes the predicted buffer attributes
+    // and returns how many free buffers should be replaced with buffers
+    // having them.
+    size_t getPreallocationTargetLocked(uint32_t* outWidth,
+            uint32_t* outHeight, PixelFormat* outFormat,
+            uint32_t* outUsage) const;
+
+    // preallocateBuffers replaces mismatching free buffers, least recently
+    // used first, until getPreallocationTargetLocked returns 0. Like
+    // BufferQueueProducer::allocateBuffers, it sets mIsAllocating while
+    // allocating.
+    void preallocateBuffers();
+
+    // updateAdaptiveDepthLocked counts a queued frame and, at the end of each
+    // window, lowers or raises mMaxDequeuedBufferCount if adaptive queue depth
+    // is enabled (see mAdaptiveDepth). It returns true if buffers were freed,
+    // in which case the consumer must be notified with onBuffersReleased.
+    bool updateAdaptiveDepthLocked();
+
+    // resetAdaptiveDepthLocked sets mMaxDequeuedBufferCount back to what the
+    // producer asked for, if the available slots allow it, and starts a new
+    // window. It returns true if buffers were freed.
+    bool resetAdaptiveDepthLocked();
+
+    // setAdaptiveMaxDequeuedLocked changes mMaxDequeuedBufferCount for
+    // adaptive queue depth and records the decision. It fails if the slots
+    // can't be added or removed.
+    bool setAdaptiveMaxDequeuedLocked(int maxDequeued, int reason);
+
+    // waitForDequeueConditionLocked waits on mDequeueCondition, forever if
+    // timeout is negative, and keeps mDequeueWaiters up to date.
+    status_t waitForDequeueConditionLocked(nsecs_t timeout);
+
+    // wakeDequeueWaitersLocked replaces broadcasting mDequeueCondition: it
+    // makes no futex call at all when no producer is waiting, and wakes a
+    // single thread when only one is.
+    void wakeDequeueWaitersLocked();
+
 #if DEBUG_ONLY_CODE
     // validateConsistencyLocked ensures that the free lists are in sync with
     // the information stored in mSlots
@@ -184,6 +266,10 @@ private:
     int mConnectedApi;
     // PID of the process which last successfully called connect(...)
     pid_t mConnectedPid;
+    // UID of the producer which last successfully called connect(...), or -1.
+    // Unlike mConnectedPid, it's kept after disconnecting: the buffers freed
+    // then are recycled for that producer only.
+    int32_t mLastProducerUid;
 
     // mLinkedToDeath is used to set a binder death notification on
     // the producer.
@@ -205,23 +291,26 @@ private:
 
     // mFreeSlots contains all of the slots which are FREE and do not currently
     // have a buffer attached.
-    std::set<int> mFreeSlots;
+    BufferSlotSet mFreeSlots;
 
     // mFreeBuffers contains all of the slots which are FREE and currently have
-    // a buffer attached.
-    std::list<int> mFreeBuffers;
+    // a buffer attached, least recently freed first.
+    BufferSlotList mFreeBuffers;
 
     // mUnusedSlots contains all slots that are currently unused. They should be
     // free and not have a buffer attached.
-    std::list<int> mUnusedSlots;
+    BufferSlotList mUnusedSlots;
 
     // mActiveBuffers contains all slots which have a non-FREE buffer attached.
-    std::set<int> mActiveBuffers;
+    BufferSlotSet mActiveBuffers;
 
     // mDequeueCondition is a condition variable used for dequeueBuffer in
     // synchronous mode.
     mutable Condition mDequeueCondition;
 
+    // mDequeueWaiters is the number of threads waiting on mDequeueCondition.
+    int mDequeueWaiters;
+
     // mDequeueBufferCannotBlock indicates whether dequeueBuffer is allowed to
     // block. This flag is set during connect when both the producer and
     // consumer are controlled by the application.
@@ -336,8 +425,163 @@ private:
 
     OccupancyTracker mOccupancyTracker;
 
+    // These histograms are always on, for dumpState. mDequeueWaitHistogram
+    // holds how long dequeueBuffer took to find a slot, including the time
+    // it blocked. mFenceWaitHistogram holds how long producers waited on
+    // fences inside BufferQueue: the EGL sync of a released buffer in
+    // dequeueBuffer and the EGL throttle in queueBuffer. The fence that
+    // dequeueBuffer returns is waited on by the producer itself, so it isn't
+    // included. mAllocationHistogram holds how long gralloc allocations took.
+    LatencyHistogram mDequeueWaitHistogram;
+    LatencyHistogram mFenceWaitHistogram;
+    LatencyHistogram mAllocationHistogram;
+
     const uint64_t mUniqueId;
 
+    // mSingleProducerConsumer is set when the BufferQueue was created for
+    // one producer thread and one consumer thread in the same process (e.g.
+    // camera to encoder). The consumer can then poll for buffers without
+    // taking mMutex; everything else behaves as usual.
+    const bool mSingleProducerConsumer;
+
+    // mConsumerCanPollWithoutLock is true in single producer/consumer mode
+    // unless shared buffer mode is enabled, in which case acquireBuffer may
+    // return a buffer while mQueue is empty.
+    std::atomic<bool> mConsumerCanPollWithoutLock;
+
+    // mPreallocation holds the state of predictive preallocation. When the
+    // buffer attributes change (the consumer sets a new default size, format
+    // or usage, or the producer dequeues with new ones), the free buffers
+    // that no longer match are replaced by a worker thread, so that the next
+    // dequeueBuffer calls don't have to allocate synchronously.
+    struct Preallocation {
+        Preallocation()
+          : thread(),
+            condition(),
+            pending(false),
+            exiting(false),
+            generation(0),
+            hasHistory(false),
+            width(0),
+            height(0),
+            format(PIXEL_FORMAT_UNKNOWN),
+            usage(0),
+            slots(),
+            syncAllocations(0),
+            preallocated(0),
+            used(0) {}
+
+        // the worker, started by the first schedulePreallocationLocked call,
+        // and the condition it waits on for pending or exiting to be set
+        std::thread thread;
+        Condition condition;
+        bool pending;
+        bool exiting;
+
+        // incremented by freeAllBuffersLocked, so that a buffer allocated
+        // before is dropped
+        uint32_t generation;
+
+        // attributes requested by the last dequeueBuffer call; 0 means the
+        // default size or format
+        bool hasHistory;
+        uint32_t width;
+        uint32_t height;
+        PixelFormat format;
+        uint32_t usage;
+
+        // free slots holding a preallocated buffer not yet dequeued
+        BufferSlotSet slots;
+
+        // dequeues that had to allocate, buffers preallocated, and
+        // preallocated buffers that were dequeued
+        uint64_t syncAllocations;
+        uint64_t preallocated;
+        uint64_t used;
+    } mPreallocation;
+
+    // mAdaptiveDepth holds the state of adaptive queue depth, which the
+    // consumer may enable with setAdaptiveQueueDepth to trade memory and
+    // latency automatically. At the end of every window of WINDOW_FRAMES
+    // queued frames, mMaxDequeuedBufferCount is
+    //  - raised by one, up to one more than the producer asked for, if the
+    //    producer blocked in dequeueBuffer while nothing was queued (the
+    //    consumer held all the other buffers) in at least 1 of every
+    //    STALL_RATIO frames
+    //  - lowered by one, down to 1, if the producer never blocked that way,
+    //    the queue held more than one buffer on average (so frames waited an
+    //    extra refresh to be consumed), and the producer never had as many
+    //    buffers dequeued at once as the current limit allows
+    // It's restored to what the producer asked for as soon as the producer
+    // tries to dequeue more buffers than a lowered limit allows, when the
+    // producer disconnects, and when adaptive queue depth is disabled.
+    struct AdaptiveDepth {
+        enum {
+            WINDOW_FRAMES = 60,
+            STALL_RATIO = 4,
+            // Windows to wait after raising before lowering again
+            LOWER_COOLDOWN_WINDOWS = 5,
+            HISTORY_SIZE = 8,
+        };
+
+        enum { RAISED, LOWERED, RESTORED };
+
+        struct Decision {
+            Decision()
+              : time(0),
+                reason(RESTORED),
+                from(0),
+                to(0),
+                stalls(0),
+                frames(0),
+                occupancy(0.0f) {}
+
+            nsecs_t time;
+            int reason;
+            int from;
+            int to;
+            // measurements of the window that led to the decision
+            size_t stalls;
+            size_t frames;
+            float occupancy;
+        };
+
+        AdaptiveDepth()
+          : enabled(false),
+            requestedMaxDequeued(1),
+            frames(0),
+            stalls(0),
+            stallTime(0),
+            maxDequeued(0),
+            startTotalTime(0),
+            startOccupancyTime(0),
+            windowsSinceRaise(LOWER_COOLDOWN_WINDOWS),
+            decisionCount(0) {}
+
+        bool enabled;
+
+        // mMaxDequeuedBufferCount as last set by the producer
+        int requestedMaxDequeued;
+
+        // measurements of the current window: queued frames, dequeueBuffer
+        // calls that blocked while nothing was queued and how long they
+        // blocked, and the most buffers dequeued at once
+        size_t frames;
+        size_t stalls;
+        nsecs_t stallTime;
+        int maxDequeued;
+
+        // mOccupancyTracker totals when the window started
+        nsecs_t startTotalTime;
+        nsecs_t startOccupancyTime;
+
+        size_t windowsSinceRaise;
+
+        // the last HISTORY_SIZE decisions, for dumpState
+        Decision history[HISTORY_SIZE];
+        uint64_t decisionCount;
+    } mAdaptiveDepth;
+
 }; // class BufferQueueCore
 
 } // namespace android
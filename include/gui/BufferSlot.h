@@ -182,7 +182,9 @@ struct BufferSlot {
       mEglFence(EGL_NO_SYNC_KHR),
       mFence(Fence::NO_FENCE),
       mAcquireCalled(false),
-      mNeedsReallocation(false) {
+      mNeedsReallocation(false),
+      mDequeueTime(0),
+      mStateTime(0) {
     }
 
     // mGraphicBuffer points to the buffer allocated for this slot or is NULL
@@ -230,6 +232,14 @@ struct BufferSlot {
     // producer. If so, it needs to set the BUFFER_NEEDS_REALLOCATION flag when
     // dequeued to prevent the producer from using a stale cached buffer.
     bool mNeedsReallocation;
+
+    // mDequeueTime is the time at which the buffer was last dequeued, or 0 if
+    // it was attached by the producer instead.
+    nsecs_t mDequeueTime;
+
+    // mStateTime is the time at which mBufferState last changed, so that
+    // dumpState can show for how long each buffer has been held.
+    nsecs_t mStateTime;
 };
 
 } // namespace android
@@ -0,0 +1,204 @@
+/*
+ * Copyright 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_GUI_BUFFERSLOTSET_H
+#define ANDROID_GUI_BUFFERSLOTSET_H
+
+#include <gui/BufferQueueDefs.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace android {
+
+// BufferQueueCore keeps every slot in exactly one of four collections (free
+// slots, free buffers, active buffers and unused slots). Since there are at
+// most 64 slots, these are kept as bitmasks rather than as std::set and
+// std::list: nothing is allocated when a slot moves from one to another.
+
+static_assert(BufferQueueDefs::NUM_BUFFER_SLOTS <= 64,
+        "slot collections hold at most 64 slots");
+
+// An unordered set of slots, iterated in increasing slot order like the
+// std::set<int> it replaces.
+class BufferSlotSet {
+public:
+    class const_iterator {
+    public:
+        int operator*() const { return __builtin_ctzll(mRemaining); }
+
+        const_iterator& operator++() {
+            mRemaining &= mRemaining - 1;
+            return *this;
+        }
+
+        bool operator==(const const_iterator& rhs) const {
+            return mRemaining == rhs.mRemaining;
+        }
+        bool operator!=(const const_iterator& rhs) const {
+            return mRemaining != rhs.mRemaining;
+        }
+
+    private:
+        friend class BufferSlotSet;
+        explicit const_iterator(uint64_t remaining) : mRemaining(remaining) {}
+
+        uint64_t mRemaining;
+    };
+
+    BufferSlotSet() : mMask(0) {}
+
+    bool empty() const { return mMask == 0; }
+    size_t size() const {
+        return static_cast<size_t>(__builtin_popcountll(mMask));
+    }
+    size_t count(int slot) const { return (mMask & bit(slot)) != 0 ? 1 : 0; }
+
+    void insert(int slot) { mMask |= bit(slot); }
+    void erase(int slot) { mMask &= ~bit(slot); }
+    void erase(const const_iterator& position) { erase(*position); }
+    void clear() { mMask = 0; }
+
+    const_iterator begin() const { return const_iterator(mMask); }
+    const_iterator end() const { return const_iterator(0); }
+
+private:
+    static uint64_t bit(int slot) {
+        return 1ULL << static_cast<unsigned int>(slot);
+    }
+
+    uint64_t mMask;
+};
+
+// An ordered list of slots, used where the order matters (e.g. free buffers
+// are reused least recently released first). Each slot is in the list at most
+// once, so pushing a slot that's already there moves it; the links are kept
+// in fixed arrays indexed by slot.
+class BufferSlotList {
+public:
+    class const_iterator {
+    public:
+        int operator*() const { return mSlot; }
+
+        const_iterator& operator++() {
+            mSlot = mList->mNext[mSlot];
+            return *this;
+        }
+
+        bool operator==(const const_iterator& rhs) const {
+            return mSlot == rhs.mSlot;
+        }
+        bool operator!=(const const_iterator& rhs) const {
+            return mSlot != rhs.mSlot;
+        }
+
+    private:
+        friend class BufferSlotList;
+        const_iterator(const BufferSlotList* list, int slot)
+          : mList(list), mSlot(slot) {}
+
+        const BufferSlotList* mList;
+        int mSlot;
+    };
+
+    BufferSlotList() : mMask(0), mHead(NONE), mTail(NONE) {}
+
+    bool empty() const { return mMask == 0; }
+    size_t size() const {
+        return static_cast<size_t>(__builtin_popcountll(mMask));
+    }
+    size_t count(int slot) const { return (mMask & bit(slot)) != 0 ? 1 : 0; }
+
+    int front() const { return mHead; }
+    int back() const { return mTail; }
+
+    void push_front(int slot) {
+        remove(slot);
+        mPrev[slot] = static_cast<int8_t>(NONE);
+        mNext[slot] = static_cast<int8_t>(mHead);
+        if (mHead != NONE) {
+            mPrev[mHead] = static_cast<int8_t>(slot);
+        } else {
+            mTail = slot;
+        }
+        mHead = slot;
+        mMask |= bit(slot);
+    }
+
+    void push_back(int slot) {
+        remove(slot);
+        mNext[slot] = static_cast<int8_t>(NONE);
+        mPrev[slot] = static_cast<int8_t>(mTail);
+        if (mTail != NONE) {
+            mNext[mTail] = static_cast<int8_t>(slot);
+        } else {
+            mHead = slot;
+        }
+        mTail = slot;
+        mMask |= bit(slot);
+    }
+
+    void pop_front() { remove(mHead); }
+    void pop_back() { remove(mTail); }
+
+    // Removes the slot if it's in the list.
+    void remove(int slot) {
+        if ((mMask & bit(slot)) == 0) {
+            return;
+        }
+        const int prev = mPrev[slot];
+        const int next = mNext[slot];
+        if (prev != NONE) {
+            mNext[prev] = static_cast<int8_t>(next);
+        } else {
+            mHead = next;
+        }
+        if (next != NONE) {
+            mPrev[next] = static_cast<int8_t>(prev);
+        } else {
+            mTail = prev;
+        }
+        mMask &= ~bit(slot);
+    }
+
+    void clear() {
+        mMask = 0;
+        mHead = NONE;
+        mTail = NONE;
+    }
+
+    const_iterator begin() const { return const_iterator(this, mHead); }
+    const_iterator end() const { return const_iterator(this, NONE); }
+    const_iterator cbegin() const { return begin(); }
+    const_iterator cend() const { return end(); }
+
+private:
+    enum { NONE = -1 };
+
+    static uint64_t bit(int slot) {
+        return 1ULL << static_cast<unsigned int>(slot);
+    }
+
+    uint64_t mMask;
+    int mHead;
+    int mTail;
+    int8_t mPrev[BufferQueueDefs::NUM_BUFFER_SLOTS];
+    int8_t mNext[BufferQueueDefs::NUM_BUFFER_SLOTS];
+};
+
+} // namespace android
+
+#endif
@@ -92,6 +92,9 @@ public:
     // See IGraphicBufferConsumer::discardFreeBuffers
     status_t discardFreeBuffers();
 
+    // See IGraphicBufferConsumer::setAdaptiveQueueDepth
+    status_t setAdaptiveQueueDepth(bool enabled);
+
 private:
     ConsumerBase(const ConsumerBase&);
     void operator=(const ConsumerBase&);
@@ -108,6 +108,8 @@ class CpuConsumer : public ConsumerBase
     // construction-time maxLockedBuffers parameter. If INVALID_OPERATION is
     // returned by lockNextBuffer, then old buffers must be returned to the queue
     // by calling unlockBuffer before more buffers can be acquired.
+    //
+    // PixelConverter can convert the locked buffer to RGBA or BGRA.
     status_t lockNextBuffer(LockedBuffer *nativeBuffer);
 
     // Returns a locked buffer to the queue, allowing it to be reused. Since
@@ -0,0 +1,137 @@
+/*
+ * Copyright 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_GUI_GRAPHICBUFFERPOOL_H
+#define ANDROID_GUI_GRAPHICBUFFERPOOL_H
+
+#include <ui/Fence.h>
+#include <ui/GraphicBuffer.h>
+#include <ui/PixelFormat.h>
+
+#include <utils/Condition.h>
+#include <utils/Mutex.h>
+#include <utils/Singleton.h>
+#include <utils/String8.h>
+#include <utils/StrongPointer.h>
+#include <utils/Timers.h>
+
+#include <thread>
+#include <vector>
+
+#include <stdint.h>
+
+namespace android {
+
+// GraphicBufferPool keeps the buffers that BufferQueues of this process no
+// longer need (because the queue was torn down, discarded its free buffers
+// or was resized) for a little while, so that another queue asking for the
+// same width, height, format and usage can reuse one instead of allocating.
+//
+// Buffers are only handed out to queues whose producer has the same uid as
+// the one that used the buffer before, since that producer may still have
+// the buffer mapped. A buffer is handed out only once the pool holds the
+// last reference to it in this process (e.g. once the consumer dropped it
+// from its slot cache), together with the release fence of its last use.
+//
+// The pool is disabled (setMaxBytes(0)) unless the process enables it, which
+// SurfaceFlinger does when ro.sf.buffer_pool_size_kb is set.
+//
+// Buffers are never freed with the pool's lock held. Buffers dropped by
+// recycle, whose caller holds its BufferQueue's lock, and expired buffers are
+// freed on the pool's expiry thread.
+class GraphicBufferPool : public Singleton<GraphicBufferPool> {
+public:
+    // Buffers not reused within this time are freed.
+    static const nsecs_t MAX_IDLE_TIME = 5000000000LL; // 5s
+
+    // setMaxBytes sets how many bytes of buffers the pool may hold, dropping
+    // the least recently recycled buffers if it holds more. 0 disables it.
+    void setMaxBytes(size_t maxBytes);
+    size_t getMaxBytes() const;
+
+    // take returns a buffer with exactly these attributes previously recycled
+    // for the same owner, or NULL. *outFence is the fence to wait on before
+    // writing to it.
+    sp<GraphicBuffer> take(int32_t owner, uint32_t width, uint32_t height,
+            PixelFormat format, uint32_t usage, sp<Fence>* outFence);
+
+    // recycle offers a buffer its BufferQueue is about to drop. The pool keeps
+    // it if it's enabled and the buffer fits, dropping the least recently
+    // recycled buffers to make room.
+    void recycle(int32_t owner, const sp<GraphicBuffer>& buffer,
+            const sp<Fence>& fence);
+
+    // trim drops the least recently recycled buffers until the pool holds at
+    // most maxBytes, e.g. trim(0) when an allocation fails.
+    void trim(size_t maxBytes);
+
+    void dump(String8& result, const char* prefix) const;
+
+private:
+    friend class Singleton<GraphicBufferPool>;
+    GraphicBufferPool();
+    ~GraphicBufferPool();
+
+    struct Entry {
+        int32_t owner;
+        sp<GraphicBuffer> buffer;
+        sp<Fence> fence;
+        size_t size;
+        nsecs_t recycleTime;
+    };
+
+    // getAllocationSize estimates the memory used by a buffer
+    static size_t getAllocationSize(const sp<GraphicBuffer>& buffer);
+
+    // removeLocked removes mEntries[index] from the pool and returns it
+    Entry removeLocked(size_t index);
+
+    // trimLocked removes the oldest entries until at most maxBytes are held,
+    // appends them to outDropped and returns how many it removed.
+    size_t trimLocked(size_t maxBytes, std::vector<Entry>* outDropped);
+
+    // expiryLoop runs on mExpiryThread, started by the first recycle, until
+    // the pool is destroyed. It frees the buffers in mDropped and expires
+    // buffers once they have been idle for MAX_IDLE_TIME.
+    void expiryLoop();
+
+    mutable Mutex mMutex;
+    Condition mExpiryCondition;
+    std::thread mExpiryThread;
+    bool mExiting;
+
+    // removed from the pool, to be freed by the expiry thread
+    std::vector<Entry> mDropped;
+
+    // oldest first
+    std::vector<Entry> mEntries;
+    size_t mMaxBytes;
+    size_t mBytes;
+    size_t mPeakBytes;
+
+    // statistics
+    uint64_t mRequests;
+    uint64_t mHits;
+    uint64_t mRecycled;
+    uint64_t mRejected;
+    uint64_t mEvicted;
+    uint64_t mExpired;
+    uint64_t mTrimmed;
+};
+
+} // namespace android
+
+#endif
@@ -277,6 +277,15 @@ public:
     // possible without discarding data.
     virtual status_t discardFreeBuffers() = 0;
 
+    // setAdaptiveQueueDepth enables or disables adaptive queue depth. While
+    // it's enabled, the BufferQueue lowers the number of buffers the producer
+    // may dequeue when frames consistently wait in the queue, which saves
+    // memory and latency, and raises it by one when the producer keeps
+    // blocking on the consumer. The producer may always dequeue as many
+    // buffers as it set with setMaxDequeuedBufferCount; the count is restored
+    // as soon as it tries to. Disabling adaptive queue depth restores it too.
+    virtual status_t setAdaptiveQueueDepth(bool enabled) = 0;
+
     // dump state into a string
     virtual void dumpState(String8& result, const char* prefix) const = 0;
 
@@ -0,0 +1,60 @@
+/*
+ * Copyright 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_GUI_LATENCYHISTOGRAM_H
+#define ANDROID_GUI_LATENCYHISTOGRAM_H
+
+#include <utils/Timers.h>
+
+#include <atomic>
+
+namespace android {
+
+class String8;
+
+// LatencyHistogram counts durations in power-of-two microsecond buckets:
+// bucket 0 holds durations under 1us, bucket i durations in [2^(i-1), 2^i) us,
+// and the last bucket everything longer. Recording is lock-free and cheap
+// enough to be always on, and may happen concurrently with dump.
+class LatencyHistogram
+{
+public:
+    enum { NUM_BUCKETS = 20 };
+
+    LatencyHistogram();
+
+    void add(nsecs_t duration);
+
+    uint64_t getCount() const;
+
+    // Returns the upper bound, in microseconds, of the bucket holding the
+    // given fraction of the samples, or 0 if there are none.
+    uint64_t getPercentileUs(double fraction) const;
+
+    // Appends one line with the sample count, average, maximum and
+    // percentiles, and one line with the non-empty buckets.
+    void dump(String8& result, const char* prefix, const char* name) const;
+
+private:
+    std::atomic<uint64_t> mBuckets[NUM_BUCKETS];
+    std::atomic<uint64_t> mCount;
+    std::atomic<int64_t> mTotal;
+    std::atomic<int64_t> mMax;
+};
+
+} // namespace android
+
+#endif
@@ -36,7 +36,9 @@ public:
       : mPendingSegment(),
         mSegmentHistory(),
         mLastOccupancy(0),
-        mLastOccupancyChangeTime(0) {}
+        mLastOccupancyChangeTime(0),
+        mTotalTime(0),
+        mTotalOccupancyTime(0) {}
 
     struct Segment : public Parcelable {
         Segment()
@@ -72,6 +74,17 @@ public:
     void registerOccupancyChange(size_t occupancy);
     std::vector<Segment> getSegmentHistory(bool forceFlush);
 
+    // Returns the highest occupancy seen in the current and the most
+    // recently recorded segment.
+    size_t getRecentMaxOccupancy() const;
+
+    // Returns the time tracked so far and the integral of the occupancy over
+    // it (occupancy * nanoseconds), leaving out idle periods like segments
+    // do. The average occupancy over an interval is the ratio of the
+    // differences between two calls; unlike getSegmentHistory this works
+    // while frames are produced continuously and doesn't consume anything.
+    void getTotals(nsecs_t* outTotalTime, nsecs_t* outOccupancyTime) const;
+
 private:
     static constexpr size_t MAX_HISTORY_SIZE = 10;
     static constexpr nsecs_t NEW_SEGMENT_DELAY = ms2ns(100);
@@ -97,6 +110,9 @@ private:
     size_t mLastOccupancy;
     nsecs_t mLastOccupancyChangeTime;
 
+    nsecs_t mTotalTime;
+    nsecs_t mTotalOccupancyTime;
+
 }; // class OccupancyTracker
 
 } // namespace android
@@ -0,0 +1,66 @@
+/*
+ * Copyright 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_GUI_PIXELCONVERTER_H
+#define ANDROID_GUI_PIXELCONVERTER_H
+
+#include <gui/CpuConsumer.h>
+
+#include <ui/PixelFormat.h>
+
+#include <utils/Errors.h>
+
+#include <stdint.h>
+
+namespace android {
+
+// PixelConverter converts the buffers CpuConsumer::lockNextBuffer hands out
+// to 32-bit RGBA or BGRA, optionally downscaling them, so that clients don't
+// each need their own conversion loops. Rows are converted with NEON or SSE2
+// where available, and with equivalent scalar code otherwise; both produce
+// exactly the same result.
+//
+// Supported sources are RGBA_8888, RGBX_8888, BGRA_8888 and RGB_565, and YUV
+// 4:2:0 buffers locked as flexible YUV (which includes YV12 and NV21) or, if
+// gralloc can't lock them that way, YV12 and NV21 buffers in their standard
+// layout. YUV is treated as BT.601 limited range.
+//
+// Any CPU-mapped image can be converted by describing it with a LockedBuffer.
+class PixelConverter {
+public:
+    // isSupportedSource returns whether convert() can read src
+    static bool isSupportedSource(const CpuConsumer::LockedBuffer& src);
+
+    // isSupportedDestination returns whether convert() can write format
+    static bool isSupportedDestination(PixelFormat format);
+
+    // convert writes the crop region of src (or all of it if the crop is
+    // empty) to dst, which holds dstHeight rows of dstStride pixels in
+    // dstFormat (RGBA_8888, RGBX_8888 or BGRA_8888). If dstWidth or dstHeight
+    // is smaller than the source, it's downscaled by sampling the source pixel
+    // nearest to the center of each destination pixel; upscaling isn't
+    // supported. Alpha is 0xff unless both formats have an alpha channel.
+    static status_t convert(const CpuConsumer::LockedBuffer& src,
+            uint8_t* dst, uint32_t dstWidth, uint32_t dstHeight,
+            uint32_t dstStride, PixelFormat dstFormat);
+
+private:
+    PixelConverter();
+};
+
+} // namespace android
+
+#endif // ANDROID_GUI_PIXELCONVERTER_H
@@ -23,7 +23,9 @@
 #include <utils/Condition.h>
 #include <utils/KeyedVector.h>
 #include <utils/Mutex.h>
+#include <utils/String8.h>
 #include <utils/StrongPointer.h>
+#include <utils/Timers.h>
 
 namespace android {
 
@@ -57,23 +59,37 @@ public:
     // output is abandoned by its consumer, the splitter will abandon its input
     // queue (see onAbandoned).
     //
+    // By default (maxQueueDepth == 0) an output receives every buffer, and if
+    // it's slow, it slows down the input and thus all of the other outputs
+    // (see onFrameAvailable). If maxQueueDepth is positive, the output may
+    // hold at most that many buffers (queued or acquired by its consumer) at
+    // once, and skips the buffers queued to the input while it's full instead.
+    // This is meant for consumers that may fall behind without holding up the
+    // others, e.g. an encoder next to a preview.
+    //
     // A return value other than NO_ERROR means that an error has occurred and
     // outputQueue has not been added to the splitter. BAD_VALUE is returned if
     // outputQueue is NULL. See IGraphicBufferProducer::connect for explanations
     // of other error codes.
-    status_t addOutput(const sp<IGraphicBufferProducer>& outputQueue);
+    status_t addOutput(const sp<IGraphicBufferProducer>& outputQueue,
+            size_t maxQueueDepth = 0);
 
     // setName sets the consumer name of the input queue
     void setName(const String8& name);
 
+    // dump appends, for each output, how many buffers it received and
+    // skipped, how many it holds and how long it held them, and how long the
+    // input was stalled by outputs that don't skip buffers.
+    void dump(String8& result, const char* prefix) const;
+
 private:
     // From IConsumerListener
     //
     // During this callback, we store some tracking information, detach the
-    // buffer from the input, and attach it to each of the outputs. This call
-    // can block if there are too many outstanding buffers. If it blocks, it
-    // will resume when onBufferReleasedByOutput releases a buffer back to the
-    // input.
+    // buffer from the input, and attach it to each of the outputs that isn't
+    // full. This call can block if too many buffers are held by outputs
+    // without a queue depth limit. If it blocks, it will resume when
+    // onBufferReleasedByOutput releases such a buffer.
     virtual void onFrameAvailable(const BufferItem& item);
 
     // From IConsumerListener
@@ -88,14 +104,15 @@ private:
 
     // This is the implementation of the onBufferReleased callback from
     // IProducerListener. It gets called from an OutputListener (see below), and
-    // 'from' is which producer interface from which the callback was received.
+    // 'outputIndex' is the index in mOutputs of the output from which the
+    // callback was received.
     //
     // During this callback, we detach the buffer from the output queue that
     // generated the callback, update our state tracking to see if this is the
     // last output releasing the buffer, and if so, release it to the input.
-    // If we release the buffer to the input, we allow a blocked
-    // onFrameAvailable call to proceed.
-    void onBufferReleasedByOutput(const sp<IGraphicBufferProducer>& from);
+    // If this was the last output without a queue depth limit holding the
+    // buffer, we allow a blocked onFrameAvailable call to proceed.
+    void onBufferReleasedByOutput(size_t outputIndex);
 
     // When this is called, the splitter disconnects from (i.e., abandons) its
     // input queue and signals any waiting onFrameAvailable calls to wake up.
@@ -106,13 +123,12 @@ private:
 
     // This is a thin wrapper class that lets us determine which BufferQueue
     // the IProducerListener::onBufferReleased callback is associated with. We
-    // create one of these per output BufferQueue, and then pass the producer
+    // create one of these per output BufferQueue, and then pass its index
     // into onBufferReleasedByOutput above.
     class OutputListener : public BnProducerListener,
                            public IBinder::DeathRecipient {
     public:
-        OutputListener(const sp<StreamSplitter>& splitter,
-                const sp<IGraphicBufferProducer>& output);
+        OutputListener(const sp<StreamSplitter>& splitter, size_t outputIndex);
         virtual ~OutputListener();
 
         // From IProducerListener
@@ -123,7 +139,25 @@ private:
 
     private:
         sp<StreamSplitter> mSplitter;
-        sp<IGraphicBufferProducer> mOutput;
+        size_t mOutputIndex;
+    };
+
+    struct Output {
+        explicit Output(const sp<IGraphicBufferProducer>& _queue = NULL,
+                size_t _maxQueueDepth = 0);
+
+        sp<IGraphicBufferProducer> queue;
+        // 0 if the output never skips buffers
+        size_t maxQueueDepth;
+        // buffers queued to the output and not yet released by it
+        size_t held;
+
+        // statistics
+        uint64_t queuedCount;
+        uint64_t skippedCount;
+        uint64_t releasedCount;
+        nsecs_t totalHoldTime;
+        nsecs_t maxHoldTime;
     };
 
     class BufferTracker : public LightRefBase<BufferTracker> {
@@ -135,9 +169,25 @@ private:
 
         void mergeFence(const sp<Fence>& with);
 
-        // Returns the new value
+        // when the buffer was queued to the outputs
+        nsecs_t getQueueTime() const { return mQueueTime; }
+
+        // Counts an output the buffer has been queued to; blocking is true if
+        // the output has no queue depth limit.
         // Only called while mMutex is held
-        size_t incrementReleaseCountLocked() { return ++mReleaseCount; }
+        void addHolderLocked(bool blocking);
+
+        // Counts a release by such an output and returns how many outputs
+        // still hold the buffer.
+        // Only called while mMutex is held
+        size_t removeHolderLocked(bool blocking);
+
+        // Returns how many outputs (only those without a queue depth limit if
+        // blocking is true) hold the buffer.
+        // Only called while mMutex is held
+        size_t getHolderCountLocked(bool blocking) const {
+            return blocking ? mBlockingHolders : mHolders;
+        }
 
     private:
         // Only destroy through LightRefBase
@@ -150,15 +200,22 @@ private:
 
         sp<GraphicBuffer> mBuffer; // One instance that holds this native handle
         sp<Fence> mMergedFence;
-        size_t mReleaseCount;
+        nsecs_t mQueueTime;
+        size_t mHolders;
+        size_t mBlockingHolders;
     };
 
+    // releaseToInputLocked returns a buffer no output holds anymore to the
+    // input.
+    void releaseToInputLocked(const sp<BufferTracker>& tracker);
+
     // Only called from createSplitter
     StreamSplitter(const sp<IGraphicBufferConsumer>& inputQueue);
 
     // Must be accessed through RefBase
     virtual ~StreamSplitter();
 
+    // Maximum number of buffers held by outputs without a queue depth limit
     static const int MAX_OUTSTANDING_BUFFERS = 2;
 
     // mIsAbandoned is set to true when an output dies. Once the StreamSplitter
@@ -167,16 +224,24 @@ private:
     // communicate with it further.
     bool mIsAbandoned;
 
-    Mutex mMutex;
+    mutable Mutex mMutex;
     Condition mReleaseCondition;
     int mOutstandingBuffers;
     sp<IGraphicBufferConsumer> mInput;
-    Vector<sp<IGraphicBufferProducer> > mOutputs;
+    Vector<Output> mOutputs;
 
     // Map of GraphicBuffer IDs (GraphicBuffer::getId()) to buffer tracking
-    // objects (which are mostly for counting how many outputs have released the
+    // objects (which are mostly for counting how many outputs still hold the
     // buffer, but also contain merged release fences).
     KeyedVector<uint64_t, sp<BufferTracker> > mBuffers;
+
+    // statistics
+    uint64_t mFrameCount;
+    // buffers no output had room for, released to the input right away
+    uint64_t mSkippedFrameCount;
+    // onFrameAvailable calls that had to wait, and for how long in total
+    uint64_t mStallCount;
+    nsecs_t mTotalStallTime;
 };
 
 } // namespace android
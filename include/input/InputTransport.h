@@ -116,6 +116,10 @@ struct InputMessage {
         struct Finished {
             uint32_t seq;
             bool handled;
+            // If non-zero, the message finishes every message the consumer was sent from
+            // the one with this sequence number through the one with seq, all with the
+            // same handled result.
+            uint32_t firstSeq;
 
             inline size_t size() const {
                 return sizeof(Finished);
@@ -127,12 +131,21 @@ struct InputMessage {
     size_t size() const;
 };
 
+struct InputChannelRing;
+
 /*
  * An input channel consists of a local unix domain socket used to send and receive
  * input messages across processes.  Each channel has a descriptive name for debugging purposes.
  *
  * Each endpoint has its own InputChannel object that specifies its file descriptor.
  *
+ * A channel pair may optionally exchange its messages through a pair of ring buffers in
+ * shared memory instead.  The socket then only carries wakeups, which are sent when a ring
+ * goes from empty to non-empty, so the fd is still readable whenever messages are pending
+ * and a receiver that keeps up with a burst drains it without a syscall per message.  The
+ * shared memory is handed to the client end through the socket itself, so the client's fd
+ * can be passed to another process exactly like the fd of a socket-only channel.
+ *
  * The input channel is closed when all references to it are released.
  */
 class InputChannel : public RefBase {
@@ -140,7 +153,12 @@ protected:
     virtual ~InputChannel();
 
 public:
-    InputChannel(const String8& name, int fd);
+    /* Creates a channel from one end of a channel pair.  sharedMemoryClient must be true
+     * for the client end of a pair opened by openSharedMemoryInputChannelPair, and only
+     * then: it is the only kind of channel that accepts a shared memory region from its
+     * peer, as the first message it receives.
+     */
+    InputChannel(const String8& name, int fd, bool sharedMemoryClient = false);
 
     /* Creates a pair of input channels.
      *
@@ -149,6 +167,15 @@ public:
     static status_t openInputChannelPair(const String8& name,
             sp<InputChannel>& outServerChannel, sp<InputChannel>& outClientChannel);
 
+    /* Creates a pair of input channels that exchange messages through shared memory.
+     *
+     * The client channel switches to shared memory when it receives its first message.
+     *
+     * Returns OK on success.
+     */
+    static status_t openSharedMemoryInputChannelPair(const String8& name,
+            sp<InputChannel>& outServerChannel, sp<InputChannel>& outClientChannel);
+
     inline String8 getName() const { return mName; }
     inline int getFd() const { return mFd; }
 
@@ -160,7 +187,8 @@ public:
      *
      * Returns OK on success.
      * Returns WOULD_BLOCK if the channel is full.
-     * Returns DEAD_OBJECT if the channel's peer has been closed.
+     * Returns DEAD_OBJECT if the channel's peer has been closed.  When using shared memory,
+     * this is only detected when a wakeup has to be sent.
      * Other errors probably indicate that the channel is broken.
      */
     status_t sendMessage(const InputMessage* msg);
@@ -180,9 +208,36 @@ public:
     /* Returns a new object that has a duplicate of this channel's fd. */
     sp<InputChannel> dup() const;
 
+    /* Returns true if messages are exchanged through shared memory. */
+    bool isSharedMemory() const;
+
+    /* Returns true if this is the client end of a shared memory channel pair that has not
+     * received its shared memory region yet.  Code that passes the channel to another
+     * process must pass this along to the InputChannel constructor there.
+     */
+    inline bool isSharedMemoryClient() const { return mAwaitingSharedMemory; }
+
 private:
+    class SharedMemory;
+
     String8 mName;
     int mFd;
+
+    // True until the client end of a shared memory channel pair receives its first message.
+    bool mAwaitingSharedMemory;
+
+    // The shared memory mapping and the rings within it, or NULL if messages are
+    // exchanged through the socket.
+    sp<SharedMemory> mSharedMemory;
+    InputChannelRing* mSendRing;
+    InputChannelRing* mReceiveRing;
+
+    status_t attachSharedMemory(int fd, uint32_t sendRingIndex);
+    status_t sendRingMessage(const InputMessage* msg);
+    status_t receiveRingMessage(InputMessage* msg);
+    status_t receiveSocketMessage(InputMessage* msg);
+    status_t receiveSharedMemory(InputMessage* msg);
+    status_t receiveAfterRingEmpty(InputMessage* msg);
 };
 
 /*
@@ -253,6 +308,7 @@ public:
      * and whether the consumer handled the message.
      *
      * The returned sequence number is never 0 unless the operation failed.
+     * For a cumulative signal, only the last sequence number is returned.
      *
      * Returns OK on success.
      * Returns WOULD_BLOCK if there is no signal present.
@@ -261,6 +317,16 @@ public:
      */
     status_t receiveFinishedSignal(uint32_t* outSeq, bool* outHandled);
 
+    /* Receives a finished signal that may cover several messages.
+     *
+     * A cumulative signal finishes every message published from the one with sequence
+     * number outFirstSeq through the one with outSeq, in publishing order.  For a signal
+     * that finishes a single message, outFirstSeq is equal to outSeq.
+     *
+     * Returns the same values as receiveFinishedSignal above.
+     */
+    status_t receiveFinishedSignal(uint32_t* outFirstSeq, uint32_t* outSeq, bool* outHandled);
+
 private:
     sp<InputChannel> mChannel;
 };
@@ -309,6 +375,9 @@ public:
      * with the specified sequence number has finished being process and whether
      * the message was handled by the consumer.
      *
+     * When the message is a batch whose samples were received back to back, a single
+     * cumulative signal finishes all of them.
+     *
      * Returns OK on success.
      * Returns BAD_VALUE if seq is 0.
      * Other errors probably indicate that the channel is broken.
@@ -423,6 +492,11 @@ private:
     };
     Vector<SeqChain> mSeqChains;
 
+    // Sequence numbers of the messages received but not yet finished, in the order they
+    // were received.  A cumulative finished signal may only cover a run of these that
+    // is being finished as a whole.
+    Vector<uint32_t> mUnfinishedSeqs;
+
     status_t consumeBatch(InputEventFactoryInterface* factory,
             nsecs_t frameTime, uint32_t* outSeq, InputEvent** outEvent);
     status_t consumeSamples(InputEventFactoryInterface* factory,
@@ -437,6 +511,10 @@ private:
     ssize_t findTouchState(int32_t deviceId, int32_t source) const;
 
     status_t sendUnchainedFinishedSignal(uint32_t seq, bool handled);
+    status_t sendCumulativeFinishedSignal(uint32_t firstSeq, uint32_t seq, size_t count,
+            bool handled);
+    bool isUnfinishedRun(const uint32_t* seqs, size_t count) const;
+    void removeUnfinishedSeqs(uint32_t firstSeq, size_t count);
 
     static void initializeKeyEvent(KeyEvent* event, const InputMessage* msg);
     static void initializeMotionEvent(MotionEvent* event, const InputMessage* msg);
@@ -39,4 +39,10 @@ extern Mutex gDefaultServiceManagerLock;
 extern sp<IServiceManager> gDefaultServiceManager;
 extern sp<IPermissionController> gPermissionController;
 
+// For TransactionStats.cpp
+class TransactionStats;
+extern Mutex gTransactionStatsLock;
+extern Vector<TransactionStats*> gTransactionStats;
+extern TransactionStats* gExitedTransactionStats;
+
 }   // namespace android
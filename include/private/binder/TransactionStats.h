@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_PRIVATE_BINDER_TRANSACTION_STATS_H
+#define ANDROID_PRIVATE_BINDER_TRANSACTION_STATS_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <atomic>
+
+#include <utils/String8.h>
+#include <utils/String16.h>
+#include <utils/Timers.h>
+
+namespace android {
+
+class Parcel;
+
+// Latency histograms of the binder transactions made and served by one
+// thread, keyed by direction, target (handle or local binder), transaction
+// code and the length of the interface token at the start of the parcel.
+// The descriptor in the token is only read to label new entries; dump()
+// merges the entries per descriptor.
+//
+// Only the owning thread writes to its histograms, so recording takes no
+// lock; dump() reads them all under a registry lock that is otherwise only
+// taken when threads come and go.
+//
+// Recording is off unless debug.binder.stats is set or setEnabled() turns it
+// on; a disabled Recorder only checks the flags.
+class TransactionStats {
+    struct Entry;
+
+public:
+    enum Direction {
+        OUTGOING = 0,
+        INCOMING = 1,
+    };
+
+    // Bucket i holds latencies in [2^i, 2^(i+1)) us; the first one also
+    // holds everything below 1us and the last one everything above.
+    static const size_t kBucketCount = 22;
+
+                        TransactionStats();
+                        ~TransactionStats();
+
+    // Times one transaction from construction to destruction, and wraps it
+    // in an atrace async slice when debug.binder.trace is set. 'target' is
+    // the handle of an outgoing transaction, or the binder an incoming one
+    // is for.
+    class Recorder {
+    public:
+                        Recorder(TransactionStats* stats, Direction direction,
+                                 uintptr_t target, const Parcel& data, uint32_t code);
+                        ~Recorder();
+    private:
+                        Recorder(const Recorder&);
+        Recorder&       operator=(const Recorder&);
+
+        Entry*          mEntry;
+        nsecs_t         mStart;
+        int32_t         mTraceCookie;
+        char            mTraceName[128];
+    };
+
+    static bool         isEnabled();
+    static void         setEnabled(bool enabled);
+
+    // Appends the histograms of all threads, including those that have
+    // exited, merged per descriptor, code and direction.
+    static void         dump(String8& result);
+
+private:
+                        TransactionStats(const TransactionStats&);
+    TransactionStats&   operator=(const TransactionStats&);
+
+    // Holds the histograms of exited threads; not registered.
+    explicit            TransactionStats(bool unregistered);
+
+    // Returns the entry for the key, or NULL if the table is full. A new
+    // entry has its key set but isn't published until it is labelled.
+    Entry*              findEntry(Direction direction, uintptr_t target, uint32_t code,
+                                  uint32_t tokenLength, bool* outCreated);
+    Entry*              getEntry(Direction direction, uintptr_t target, uint32_t code,
+                                 const Parcel& data);
+
+    static const size_t kEntryCount = 64;
+
+    Entry*              mEntries;
+    // transactions that didn't fit in the table
+    std::atomic<uint32_t> mDropped;
+};
+
+}; // namespace android
+
+#endif // ANDROID_PRIVATE_BINDER_TRANSACTION_STATS_H
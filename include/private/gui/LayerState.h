@@ -75,6 +75,8 @@ struct layer_state_t {
         matrix.dsdy = matrix.dtdx = 0.0f;
     }
 
+    // Only the fields flagged in 'what' are written and read; read leaves
+    // the other ones untouched.
     status_t    write(Parcel& output) const;
     status_t    read(const Parcel& input);
 
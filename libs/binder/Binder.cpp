@@ -21,9 +21,12 @@
 #include <binder/BpBinder.h>
 #include <binder/IInterface.h>
 #include <binder/IResultReceiver.h>
+#include <binder/IServiceManager.h>
 #include <binder/Parcel.h>
+#include <binder/ProcessState.h>
 
 #include <stdio.h>
+#include <unistd.h>
 
 namespace android {
 
@@ -220,6 +223,22 @@ status_t BBinder::onTransact(
             for (int i = 0; i < argc && data.dataAvail() > 0; i++) {
                args.add(data.readString16());
             }
+            if (args.size() == 1 && args[0] == String16("--binder-stats")) {
+                // Available from every service, whatever its own dump() does,
+                // but gated like the service dumps themselves.
+                String8 result;
+                int32_t pid, uid;
+                if (!checkCallingPermission(String16("android.permission.DUMP"),
+                        &pid, &uid)) {
+                    result.appendFormat("Permission Denial: "
+                            "can't dump binder stats from pid=%d, uid=%d\n", pid, uid);
+                } else {
+                    ProcessState::self()->dumpThreadPool(result);
+                    ProcessState::self()->dumpTransactionStats(result);
+                }
+                write(fd, result.string(), result.size());
+                return NO_ERROR;
+            }
             return dump(fd, args);
         }
 
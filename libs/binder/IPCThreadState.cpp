@@ -29,6 +29,7 @@
 
 #include <private/binder/binder_module.h>
 #include <private/binder/Static.h>
+#include <private/binder/TransactionStats.h>
 
 #include <errno.h>
 #include <inttypes.h>
@@ -425,6 +426,7 @@ status_t IPCThreadState::getAndExecuteCommand()
     status_t result;
     int32_t cmd;
 
+    const nsecs_t waitStart = systemTime();
     result = talkWithDriver();
     if (result >= NO_ERROR) {
         size_t IN = mIn.dataAvail();
@@ -435,17 +437,23 @@ status_t IPCThreadState::getAndExecuteCommand()
                  << getReturnString(cmd) << endl;
         }
 
+        const nsecs_t start = systemTime();
         pthread_mutex_lock(&mProcess->mThreadCountLock);
         mProcess->mExecutingThreadsCount++;
         if (mProcess->mExecutingThreadsCount >= mProcess->mMaxThreads &&
                 mProcess->mStarvationStartTimeMs == 0) {
             mProcess->mStarvationStartTimeMs = uptimeMillis();
         }
+        mProcess->poolCommandStartedLocked(mPoolStatsIndex, cmd == BR_TRANSACTION,
+                waitStart, mLastReadTime, start);
         pthread_mutex_unlock(&mProcess->mThreadCountLock);
 
         result = executeCommand(cmd);
 
         pthread_mutex_lock(&mProcess->mThreadCountLock);
+        if (mProcess->poolCommandFinishedLocked(mPoolStatsIndex, systemTime() - start)) {
+            mLeavePool = true;
+        }
         mProcess->mExecutingThreadsCount--;
         if (mProcess->mExecutingThreadsCount < mProcess->mMaxThreads &&
                 mProcess->mStarvationStartTimeMs != 0) {
@@ -507,6 +515,11 @@ void IPCThreadState::joinThreadPool(bool isMain)
     // one to avoid performing an initial transaction in the background.
     set_sched_policy(mMyThreadId, SP_FOREGROUND);
         
+    pthread_mutex_lock(&mProcess->mThreadCountLock);
+    mPoolStatsIndex = mProcess->registerPoolThreadLocked(mMyThreadId, isMain);
+    mLeavePool = false;
+    pthread_mutex_unlock(&mProcess->mThreadCountLock);
+
     status_t result;
     do {
         processPendingDerefs();
@@ -524,8 +537,18 @@ void IPCThreadState::joinThreadPool(bool isMain)
         if(result == TIMED_OUT && !isMain) {
             break;
         }
+
+        // ...or if the adaptive pool has more threads than it needs.
+        if (mLeavePool && !isMain) {
+            break;
+        }
     } while (result != -ECONNREFUSED && result != -EBADF);
 
+    pthread_mutex_lock(&mProcess->mThreadCountLock);
+    mProcess->unregisterPoolThreadLocked(mPoolStatsIndex);
+    mPoolStatsIndex = -1;
+    pthread_mutex_unlock(&mProcess->mThreadCountLock);
+
     LOG_THREADPOOL("**** THREAD %p (PID %d) IS LEAVING THE THREAD POOL err=%p\n",
         (void*)pthread_self(), getpid(), (void*)result);
     
@@ -582,6 +605,18 @@ status_t IPCThreadState::transact(int32_t handle,
             << indent << data << dedent << endl;
     }
     
+    TransactionStats::Recorder recorder(mTransactionStats,
+            TransactionStats::OUTGOING, (uintptr_t)handle, data, code);
+
+    if (err == NO_ERROR && mBatchDepth > 0) {
+        if ((flags & TF_ONE_WAY) != 0) {
+            return queueBatchedTransaction(handle, code, data, flags);
+        }
+        // The reply would otherwise arrive behind the completions of the
+        // batched transactions. A failed batch is left in mLastError.
+        flushBatch();
+    }
+
     if (err == NO_ERROR) {
         LOG_ONEWAY(">>>> SEND from pid %d uid %d %s", getpid(), getuid(),
             (flags & TF_ONE_WAY) == 0 ? "READ REPLY" : "ONE WAY");
@@ -629,6 +664,127 @@ status_t IPCThreadState::transact(int32_t handle,
     return err;
 }
 
+// Flush a batch once it holds this many transactions or bytes of data, so
+// that it doesn't exhaust the target's buffer space for oneway calls.
+static const size_t kMaxBatchedTransactions = 32;
+static const size_t kMaxBatchedSize = 64 * 1024;
+
+status_t IPCThreadState::queueBatchedTransaction(int32_t handle,
+    uint32_t code, const Parcel& data, uint32_t flags)
+{
+    // The transaction is written out when the batch is flushed, by which
+    // time the caller's parcel is long gone.
+    BatchedTransaction transaction;
+    transaction.handle = handle;
+    transaction.code = code;
+    transaction.flags = flags;
+    transaction.data = new Parcel;
+    const status_t err = transaction.data->appendFrom(&data, 0, data.dataSize());
+    if (err != NO_ERROR) {
+        delete transaction.data;
+        return (mLastError = err);
+    }
+    LOG_ONEWAY(">>>> QUEUE from pid %d uid %d ONE WAY", getpid(), getuid());
+
+    mBatchedTransactions.push(transaction);
+    mBatchedSize += transaction.data->dataSize();
+    if (mBatchedTransactions.size() >= kMaxBatchedTransactions
+            || mBatchedSize >= kMaxBatchedSize) {
+        return flushBatch();
+    }
+    return NO_ERROR;
+}
+
+status_t IPCThreadState::flushBatch()
+{
+    const size_t N = mBatchedTransactions.size();
+    if (N == 0) {
+        return NO_ERROR;
+    }
+
+    // Take the batch out of the thread state. An incoming transaction
+    // executed while waiting for the completions below sends its own oneway
+    // calls right away, instead of adding them to the batch being flushed.
+    const Vector<BatchedTransaction> batch(mBatchedTransactions);
+    mBatchedTransactions.clear();
+    mBatchedSize = 0;
+    const int32_t batchDepth = mBatchDepth;
+    mBatchDepth = 0;
+
+    // The commands queued since the batch started (reference counts, freed
+    // buffers) stay ahead of it, so the batch can be cut out of mOut on its
+    // own if it can't be sent.
+    const size_t batchStart = mOut.dataSize();
+    status_t result = NO_ERROR;
+    for (size_t i = 0; i < N && result == NO_ERROR; i++) {
+        const BatchedTransaction& transaction(batch.itemAt(i));
+        result = writeTransactionData(BC_TRANSACTION, transaction.flags,
+                transaction.handle, transaction.code, *transaction.data, NULL);
+    }
+    const size_t batchEnd = mOut.dataSize();
+    const size_t consumedBefore = mOutConsumed;
+    bool sendFailed = result != NO_ERROR;
+
+    // The first talkWithDriver() sends all the queued transactions; then
+    // collect one BR_TRANSACTION_COMPLETE (or failure) for each of them.
+    for (size_t i = 0; i < N && !sendFailed; i++) {
+        const status_t err = waitForResponse(NULL, NULL);
+        if (err == NO_ERROR) {
+            continue;
+        }
+        if (result == NO_ERROR) {
+            result = err;
+        }
+        // Anything else isn't the outcome of a single transaction; give up.
+        sendFailed = err != DEAD_OBJECT && err != FAILED_TRANSACTION;
+    }
+
+    // The driver consumes all of mOut or none of it. If the batch wasn't
+    // sent, it must not be sent later: it points into the parcels deleted
+    // below. Commands written after it by executeCommand() are kept.
+    if (sendFailed && mOutConsumed == consumedBefore) {
+        ALOGW("Dropping %zu unsent batched transactions after error %d\n",
+                N, result);
+        const size_t tailSize = mOut.dataSize() - batchEnd;
+        Parcel tail;
+        if (tailSize > 0) {
+            tail.write(mOut.data() + batchEnd, tailSize);
+        }
+        mOut.setDataSize(batchStart);
+        mOut.setDataPosition(batchStart);
+        if (tailSize > 0) {
+            mOut.write(tail.data(), tailSize);
+        }
+    }
+
+    for (size_t i = 0; i < N; i++) {
+        delete batch.itemAt(i).data;
+    }
+    mBatchDepth = batchDepth;
+    if (result != NO_ERROR) {
+        mLastError = result;
+    }
+    return result;
+}
+
+IPCThreadState::BatchScope::BatchScope()
+    : mState(IPCThreadState::self())
+{
+    mState->mBatchDepth++;
+}
+
+IPCThreadState::BatchScope::~BatchScope()
+{
+    if (--mState->mBatchDepth == 0) {
+        mState->flushBatch();
+    }
+}
+
+status_t IPCThreadState::BatchScope::flush()
+{
+    return mState->flushBatch();
+}
+
 void IPCThreadState::incStrongHandle(int32_t handle)
 {
     LOG_REMOTEREFS("IPCThreadState::incStrongHandle(%d)\n", handle);
@@ -709,7 +865,14 @@ IPCThreadState::IPCThreadState()
     : mProcess(ProcessState::self()),
       mMyThreadId(gettid()),
       mStrictModePolicy(0),
-      mLastTransactionBinderFlags(0)
+      mLastTransactionBinderFlags(0),
+      mPoolStatsIndex(-1),
+      mLeavePool(false),
+      mLastReadTime(0),
+      mBatchDepth(0),
+      mBatchedSize(0),
+      mOutConsumed(0),
+      mTransactionStats(new TransactionStats())
 {
     pthread_setspecific(gTLS, this);
     clearCaller();
@@ -719,6 +882,7 @@ IPCThreadState::IPCThreadState()
 
 IPCThreadState::~IPCThreadState()
 {
+    delete mTransactionStats;
 }
 
 status_t IPCThreadState::sendReply(const Parcel& reply, uint32_t flags)
@@ -898,6 +1062,7 @@ status_t IPCThreadState::talkWithDriver(bool doReceive)
 
     if (err >= NO_ERROR) {
         if (bwr.write_consumed > 0) {
+            mOutConsumed += bwr.write_consumed;
             if (bwr.write_consumed < mOut.dataSize())
                 mOut.remove(0, bwr.write_consumed);
             else
@@ -906,6 +1071,7 @@ status_t IPCThreadState::talkWithDriver(bool doReceive)
         if (bwr.read_consumed > 0) {
             mIn.setDataSize(bwr.read_consumed);
             mIn.setDataPosition(0);
+            mLastReadTime = systemTime();
         }
         IF_LOG_COMMANDS() {
             TextOutput::Bundle _b(alog);
@@ -936,7 +1102,11 @@ status_t IPCThreadState::writeTransactionData(int32_t cmd, uint32_t binderFlags,
     tr.sender_pid = 0;
     tr.sender_euid = 0;
     
-    const status_t err = data.errorCheck();
+    // Copy in any external segments; the driver needs one contiguous buffer.
+    status_t err = data.errorCheck();
+    if (err == NO_ERROR) {
+        err = data.flattenExternal();
+    }
     if (err == NO_ERROR) {
         tr.data_size = data.ipcDataSize();
         tr.data.ptr.buffer = data.ipcData();
@@ -1104,20 +1274,25 @@ status_t IPCThreadState::executeCommand(int32_t cmd)
                     << ", offsets addr="
                     << reinterpret_cast<const size_t*>(tr.data.ptr.offsets) << endl;
             }
-            if (tr.target.ptr) {
-                // We only have a weak reference on the target object, so we must first try to
-                // safely acquire a strong reference before doing anything else with it.
-                if (reinterpret_cast<RefBase::weakref_type*>(
-                        tr.target.ptr)->attemptIncStrong(this)) {
-                    error = reinterpret_cast<BBinder*>(tr.cookie)->transact(tr.code, buffer,
-                            &reply, tr.flags);
-                    reinterpret_cast<BBinder*>(tr.cookie)->decStrong(this);
+            {
+                TransactionStats::Recorder recorder(mTransactionStats,
+                        TransactionStats::INCOMING, (uintptr_t)tr.target.ptr, buffer,
+                        tr.code);
+                if (tr.target.ptr) {
+                    // We only have a weak reference on the target object, so we must first try to
+                    // safely acquire a strong reference before doing anything else with it.
+                    if (reinterpret_cast<RefBase::weakref_type*>(
+                            tr.target.ptr)->attemptIncStrong(this)) {
+                        error = reinterpret_cast<BBinder*>(tr.cookie)->transact(tr.code, buffer,
+                                &reply, tr.flags);
+                        reinterpret_cast<BBinder*>(tr.cookie)->decStrong(this);
+                    } else {
+                        error = UNKNOWN_TRANSACTION;
+                    }
+
                 } else {
-                    error = UNKNOWN_TRANSACTION;
+                    error = the_context_object->transact(tr.code, buffer, &reply, tr.flags);
                 }
-
-            } else {
-                error = the_context_object->transact(tr.code, buffer, &reply, tr.flags);
             }
 
             //ALOGI("<<<< TRANSACT from pid %d restore pid %d uid %d\n",
@@ -30,6 +30,8 @@
 #include <sys/resource.h>
 #include <unistd.h>
 
+#include <atomic>
+
 #include <binder/Binder.h>
 #include <binder/BpBinder.h>
 #include <binder/IPCThreadState.h>
@@ -94,6 +96,31 @@ static size_t gMaxFds = 0;
 // Maximum size of a blob to transfer in-place.
 static const size_t BLOB_INPLACE_LIMIT = 16 * 1024;
 
+// Writes up to this size are copied right away by writeExternal(); keeping a
+// reference to them isn't worth the bookkeeping.
+static const size_t EXTERNAL_COPY_LIMIT = 4 * 1024;
+
+// Data buffers of up to POOL_MAX_CAPACITY bytes are allocated in power of two
+// size classes and, when freed, kept in a small per-thread pool rather than
+// handed back to the heap, so that steady binder traffic doesn't hit malloc.
+static const size_t POOL_MIN_CAPACITY = 128;
+static const size_t POOL_MAX_CAPACITY = 4 * 1024;
+static const size_t POOL_CLASS_COUNT = 6;
+static const size_t POOL_BUFFERS_PER_CLASS = 4;
+
+struct ParcelBufferPool {
+    void* buffers[POOL_CLASS_COUNT][POOL_BUFFERS_PER_CLASS];
+    size_t counts[POOL_CLASS_COUNT];
+};
+
+static pthread_once_t gParcelPoolKeyOnce = PTHREAD_ONCE_INIT;
+static pthread_key_t gParcelPoolKey;
+static bool gHaveParcelPoolKey = false;
+
+static std::atomic<size_t> gParcelPoolHitCount(0);
+static std::atomic<size_t> gParcelPoolMissCount(0);
+static std::atomic<size_t> gParcelPooledSize(0);
+
 enum {
     BLOB_INPLACE = 0,
     BLOB_ASHMEM_IMMUTABLE = 1,
@@ -377,6 +404,123 @@ status_t unflatten_binder(const sp<ProcessState>& proc,
 
 // ---------------------------------------------------------------------------
 
+static inline size_t poolClassCapacity(size_t index)
+{
+    return POOL_MIN_CAPACITY << index;
+}
+
+// Returns the pool class holding buffers of exactly 'capacity' bytes, or -1.
+static ssize_t poolClassIndex(size_t capacity)
+{
+    for (size_t i = 0; i < POOL_CLASS_COUNT; i++) {
+        if (poolClassCapacity(i) == capacity) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void destroyParcelBufferPool(void* p)
+{
+    ParcelBufferPool* pool = static_cast<ParcelBufferPool*>(p);
+    for (size_t i = 0; i < POOL_CLASS_COUNT; i++) {
+        for (size_t j = 0; j < pool->counts[i]; j++) {
+            free(pool->buffers[i][j]);
+        }
+        gParcelPooledSize.fetch_sub(pool->counts[i] * poolClassCapacity(i),
+                std::memory_order_relaxed);
+    }
+    free(pool);
+}
+
+static void createParcelBufferPoolKey()
+{
+    gHaveParcelPoolKey =
+            pthread_key_create(&gParcelPoolKey, destroyParcelBufferPool) == 0;
+}
+
+// Buffers are only ever returned to an existing pool, so that parcels freed
+// by other TLS destructors at thread exit don't bring the pool back.
+static ParcelBufferPool* getParcelBufferPool(bool create)
+{
+    pthread_once(&gParcelPoolKeyOnce, createParcelBufferPoolKey);
+    if (!gHaveParcelPoolKey) {
+        return NULL;
+    }
+    ParcelBufferPool* pool =
+            static_cast<ParcelBufferPool*>(pthread_getspecific(gParcelPoolKey));
+    if (!pool && create) {
+        pool = static_cast<ParcelBufferPool*>(calloc(1, sizeof(ParcelBufferPool)));
+        if (pool && pthread_setspecific(gParcelPoolKey, pool) != 0) {
+            free(pool);
+            pool = NULL;
+        }
+    }
+    return pool;
+}
+
+// Returns the capacity to allocate for a buffer of at least 'size' bytes.
+static size_t parcelDataCapacity(size_t size)
+{
+    if (size == 0 || size > POOL_MAX_CAPACITY) {
+        return size;
+    }
+    size_t capacity = POOL_MIN_CAPACITY;
+    while (capacity < size) {
+        capacity <<= 1;
+    }
+    return capacity;
+}
+
+static uint8_t* allocParcelData(size_t capacity)
+{
+    const ssize_t index = poolClassIndex(capacity);
+    if (index >= 0) {
+        ParcelBufferPool* pool = getParcelBufferPool(true);
+        if (pool && pool->counts[index] > 0) {
+            gParcelPoolHitCount.fetch_add(1, std::memory_order_relaxed);
+            gParcelPooledSize.fetch_sub(capacity, std::memory_order_relaxed);
+            return static_cast<uint8_t*>(pool->buffers[index][--pool->counts[index]]);
+        }
+        gParcelPoolMissCount.fetch_add(1, std::memory_order_relaxed);
+    }
+    return static_cast<uint8_t*>(malloc(capacity));
+}
+
+static void freeParcelData(uint8_t* data, size_t capacity)
+{
+    const ssize_t index = poolClassIndex(capacity);
+    if (index >= 0) {
+        ParcelBufferPool* pool = getParcelBufferPool(false);
+        if (pool && pool->counts[index] < POOL_BUFFERS_PER_CLASS) {
+            pool->buffers[index][pool->counts[index]++] = data;
+            gParcelPooledSize.fetch_add(capacity, std::memory_order_relaxed);
+            return;
+        }
+    }
+    free(data);
+}
+
+// Like realloc(), but buffers moving into a pool size class are swapped for a
+// pooled one.
+static uint8_t* reallocParcelData(uint8_t* data, size_t oldCapacity, size_t capacity)
+{
+    if (data && oldCapacity == capacity) {
+        return data;
+    }
+    if (poolClassIndex(capacity) < 0) {
+        return static_cast<uint8_t*>(realloc(data, capacity));
+    }
+    uint8_t* newData = allocParcelData(capacity);
+    if (newData && data) {
+        memcpy(newData, data, oldCapacity < capacity ? oldCapacity : capacity);
+        freeParcelData(data, oldCapacity);
+    }
+    return newData;
+}
+
+// ---------------------------------------------------------------------------
+
 Parcel::Parcel()
 {
     LOG_ALLOC("Parcel %p: constructing", this);
@@ -403,18 +547,34 @@ size_t Parcel::getGlobalAllocCount() {
     return count;
 }
 
+size_t Parcel::getGlobalPoolHitCount() {
+    return gParcelPoolHitCount.load(std::memory_order_relaxed);
+}
+
+size_t Parcel::getGlobalPoolMissCount() {
+    return gParcelPoolMissCount.load(std::memory_order_relaxed);
+}
+
+size_t Parcel::getGlobalPooledSize() {
+    return gParcelPooledSize.load(std::memory_order_relaxed);
+}
+
 const uint8_t* Parcel::data() const
 {
+    flattenExternal();
     return mData;
 }
 
 size_t Parcel::dataSize() const
 {
-    return (mDataSize > mDataPos ? mDataSize : mDataPos);
+    return (mDataSize > mDataPos ? mDataSize : mDataPos) + mExternalSize;
 }
 
 size_t Parcel::dataAvail() const
 {
+    // Reads go through mData, so count what is left there once the segments
+    // are in place.
+    flattenExternal();
     size_t result = dataSize() - dataPosition();
     if (result > INT32_MAX) {
         abort();
@@ -424,12 +584,12 @@ size_t Parcel::dataAvail() const
 
 size_t Parcel::dataPosition() const
 {
-    return mDataPos;
+    return mDataPos + mExternalSize;
 }
 
 size_t Parcel::dataCapacity() const
 {
-    return mDataCapacity;
+    return mDataCapacity + mExternalSize;
 }
 
 status_t Parcel::setDataSize(size_t size)
@@ -440,8 +600,10 @@ status_t Parcel::setDataSize(size_t size)
         return BAD_VALUE;
     }
 
-    status_t err;
-    err = continueWrite(size);
+    status_t err = flattenExternal();
+    if (err == NO_ERROR) {
+        err = continueWrite(size);
+    }
     if (err == NO_ERROR) {
         mDataSize = size;
         ALOGV("setDataSize Setting data size of %p to %zu", this, mDataSize);
@@ -457,6 +619,7 @@ void Parcel::setDataPosition(size_t pos) const
         abort();
     }
 
+    flattenExternal();
     mDataPos = pos;
     mNextObjectHint = 0;
 }
@@ -469,6 +632,8 @@ status_t Parcel::setDataCapacity(size_t size)
         return BAD_VALUE;
     }
 
+    status_t err = flattenExternal();
+    if (err != NO_ERROR) return err;
     if (size > mDataCapacity) return continueWrite(size);
     return NO_ERROR;
 }
@@ -493,7 +658,10 @@ status_t Parcel::setData(const uint8_t* buffer, size_t len)
 status_t Parcel::appendFrom(const Parcel *parcel, size_t offset, size_t len)
 {
     const sp<ProcessState> proc(ProcessState::self());
-    status_t err;
+    status_t err = parcel->flattenExternal();
+    if (err != NO_ERROR) {
+        return err;
+    }
     const uint8_t *data = parcel->mData;
     const binder_size_t *objects = parcel->mObjects;
     size_t size = parcel->mObjectsSize;
@@ -660,6 +828,7 @@ bool Parcel::enforceInterface(const String16& interface,
 
 const binder_size_t* Parcel::objects() const
 {
+    flattenExternal();
     return mObjects;
 }
 
@@ -738,6 +907,34 @@ status_t Parcel::write(const void* data, size_t len)
     return mError;
 }
 
+status_t Parcel::writeExternal(const void* data, size_t len)
+{
+    if (len > INT32_MAX) {
+        // don't accept size_t values which may have come from an
+        // inadvertent conversion from a negative int.
+        return BAD_VALUE;
+    }
+
+    // Segments can only be appended; anything written over existing data
+    // (or too small to matter) is copied now.
+    if (len <= EXTERNAL_COPY_LIMIT || mDataPos < mDataSize) {
+        return write(data, len);
+    }
+
+    const size_t padded = pad_size(len);
+    if (dataSize() + padded > INT32_MAX) {
+        return BAD_VALUE;
+    }
+
+    ExternalSegment segment;
+    segment.offset = mDataPos;
+    segment.data = data;
+    segment.size = len;
+    mExternalSegments.push_back(segment);
+    mExternalSize += padded;
+    return NO_ERROR;
+}
+
 void* Parcel::writeInplace(size_t len)
 {
     if (len > INT32_MAX) {
@@ -841,6 +1038,21 @@ status_t writeByteVectorInternal(Parcel* parcel, const std::vector<T>& val)
     return status;
 }
 
+template<typename T>
+status_t writeByteVectorExternalInternal(Parcel* parcel, const std::vector<T>& val)
+{
+    if (val.size() > std::numeric_limits<int32_t>::max()) {
+        return BAD_VALUE;
+    }
+
+    status_t status = parcel->writeInt32(val.size());
+    if (status != OK) {
+        return status;
+    }
+
+    return parcel->writeExternal(val.data(), val.size());
+}
+
 template<typename T>
 status_t writeByteVectorInternalPtr(Parcel* parcel,
                                     const std::unique_ptr<std::vector<T>>& val)
@@ -872,6 +1084,14 @@ status_t Parcel::writeByteVector(const std::unique_ptr<std::vector<uint8_t>>& va
     return writeByteVectorInternalPtr(this, val);
 }
 
+status_t Parcel::writeByteVectorExternal(const std::vector<int8_t>& val) {
+    return writeByteVectorExternalInternal(this, val);
+}
+
+status_t Parcel::writeByteVectorExternal(const std::vector<uint8_t>& val) {
+    return writeByteVectorExternalInternal(this, val);
+}
+
 status_t Parcel::writeInt32Vector(const std::vector<int32_t>& val)
 {
     return writeTypedVector(val, &Parcel::writeInt32);
@@ -2299,6 +2519,7 @@ void Parcel::freeData()
 
 void Parcel::freeDataNoInit()
 {
+    clearExternal();
     if (mOwner) {
         LOG_ALLOC("Parcel %p: freeing other owner data", this);
         //ALOGI("Freeing data ref of %p (pid=%d)", this, getpid());
@@ -2318,12 +2539,78 @@ void Parcel::freeDataNoInit()
               gParcelGlobalAllocCount--;
             }
             pthread_mutex_unlock(&gParcelGlobalAllocSizeLock);
-            free(mData);
+            freeParcelData(mData, mDataCapacity);
         }
         if (mObjects) free(mObjects);
     }
 }
 
+status_t Parcel::flattenExternal() const
+{
+    if (mExternalSegments.empty()) {
+        return NO_ERROR;
+    }
+    return const_cast<Parcel*>(this)->flattenExternalSegments();
+}
+
+status_t Parcel::flattenExternalSegments()
+{
+    // All segments were appended at or before mDataPos, which is still the
+    // end of the inline data.
+    const size_t inlineSize = (mDataSize > mDataPos ? mDataSize : mDataPos);
+    const size_t desired = inlineSize + mExternalSize;
+    if (desired > mDataCapacity) {
+        const status_t err = continueWrite(desired);
+        if (err != NO_ERROR) {
+            clearExternal();
+            mError = err;
+            return err;
+        }
+    }
+
+    // Shift every object offset by the size of the segments in front of it.
+    const size_t N = mExternalSegments.size();
+    for (size_t i = 0; i < mObjectsSize; i++) {
+        binder_size_t shift = 0;
+        for (size_t j = 0; j < N && mExternalSegments[j].offset <= mObjects[i]; j++) {
+            shift += pad_size(mExternalSegments[j].size);
+        }
+        mObjects[i] += shift;
+    }
+
+    // Open up the gaps from the back so that each inline byte moves once,
+    // and copy every segment into its gap.
+    size_t shift = mExternalSize;
+    size_t chunkEnd = inlineSize;
+    for (size_t i = N; i-- > 0; ) {
+        const ExternalSegment& segment(mExternalSegments[i]);
+        const size_t padded = pad_size(segment.size);
+        if (chunkEnd > segment.offset) {
+            memmove(mData + segment.offset + shift, mData + segment.offset,
+                    chunkEnd - segment.offset);
+        }
+        shift -= padded;
+        uint8_t* const dest = mData + segment.offset + shift;
+        memcpy(dest, segment.data, segment.size);
+        if (padded > segment.size) {
+            memset(dest + segment.size, 0, padded - segment.size);
+        }
+        chunkEnd = segment.offset;
+    }
+
+    mDataSize = desired;
+    mDataPos += mExternalSize;
+    ALOGV("flattenExternal Setting data size of %p to %zu", this, mDataSize);
+    clearExternal();
+    return NO_ERROR;
+}
+
+void Parcel::clearExternal()
+{
+    mExternalSegments.clear();
+    mExternalSize = 0;
+}
+
 status_t Parcel::growData(size_t len)
 {
     if (len > INT32_MAX) {
@@ -2351,25 +2638,27 @@ status_t Parcel::restartWrite(size_t desired)
         return continueWrite(desired);
     }
 
-    uint8_t* data = (uint8_t*)realloc(mData, desired);
-    if (!data && desired > mDataCapacity) {
+    const size_t capacity = parcelDataCapacity(desired);
+    uint8_t* data = reallocParcelData(mData, mDataCapacity, capacity);
+    if (!data && capacity > mDataCapacity) {
         mError = NO_MEMORY;
         return NO_MEMORY;
     }
 
     releaseObjects();
+    clearExternal();
 
     if (data) {
-        LOG_ALLOC("Parcel %p: restart from %zu to %zu capacity", this, mDataCapacity, desired);
+        LOG_ALLOC("Parcel %p: restart from %zu to %zu capacity", this, mDataCapacity, capacity);
         pthread_mutex_lock(&gParcelGlobalAllocSizeLock);
-        gParcelGlobalAllocSize += desired;
+        gParcelGlobalAllocSize += capacity;
         gParcelGlobalAllocSize -= mDataCapacity;
         if (!mData) {
             gParcelGlobalAllocCount++;
         }
         pthread_mutex_unlock(&gParcelGlobalAllocSizeLock);
         mData = data;
-        mDataCapacity = desired;
+        mDataCapacity = capacity;
     }
 
     mDataSize = mDataPos = 0;
@@ -2419,7 +2708,8 @@ status_t Parcel::continueWrite(size_t desired)
 
         // If there is a different owner, we need to take
         // posession.
-        uint8_t* data = (uint8_t*)malloc(desired);
+        const size_t capacity = parcelDataCapacity(desired);
+        uint8_t* data = allocParcelData(capacity);
         if (!data) {
             mError = NO_MEMORY;
             return NO_MEMORY;
@@ -2429,7 +2719,7 @@ status_t Parcel::continueWrite(size_t desired)
         if (objectsSize) {
             objects = (binder_size_t*)calloc(objectsSize, sizeof(binder_size_t));
             if (!objects) {
-                free(data);
+                freeParcelData(data, capacity);
 
                 mError = NO_MEMORY;
                 return NO_MEMORY;
@@ -2453,9 +2743,9 @@ status_t Parcel::continueWrite(size_t desired)
         mOwner(this, mData, mDataSize, mObjects, mObjectsSize, mOwnerCookie);
         mOwner = NULL;
 
-        LOG_ALLOC("Parcel %p: taking ownership of %zu capacity", this, desired);
+        LOG_ALLOC("Parcel %p: taking ownership of %zu capacity", this, capacity);
         pthread_mutex_lock(&gParcelGlobalAllocSizeLock);
-        gParcelGlobalAllocSize += desired;
+        gParcelGlobalAllocSize += capacity;
         gParcelGlobalAllocCount++;
         pthread_mutex_unlock(&gParcelGlobalAllocSizeLock);
 
@@ -2463,7 +2753,7 @@ status_t Parcel::continueWrite(size_t desired)
         mObjects = objects;
         mDataSize = (mDataSize < desired) ? mDataSize : desired;
         ALOGV("continueWrite Setting data size of %p to %zu", this, mDataSize);
-        mDataCapacity = desired;
+        mDataCapacity = capacity;
         mObjectsSize = mObjectsCapacity = objectsSize;
         mNextObjectHint = 0;
 
@@ -2495,16 +2785,17 @@ status_t Parcel::continueWrite(size_t desired)
 
         // We own the data, so we can just do a realloc().
         if (desired > mDataCapacity) {
-            uint8_t* data = (uint8_t*)realloc(mData, desired);
+            const size_t capacity = parcelDataCapacity(desired);
+            uint8_t* data = reallocParcelData(mData, mDataCapacity, capacity);
             if (data) {
                 LOG_ALLOC("Parcel %p: continue from %zu to %zu capacity", this, mDataCapacity,
-                        desired);
+                        capacity);
                 pthread_mutex_lock(&gParcelGlobalAllocSizeLock);
-                gParcelGlobalAllocSize += desired;
+                gParcelGlobalAllocSize += capacity;
                 gParcelGlobalAllocSize -= mDataCapacity;
                 pthread_mutex_unlock(&gParcelGlobalAllocSizeLock);
                 mData = data;
-                mDataCapacity = desired;
+                mDataCapacity = capacity;
             } else if (desired > mDataCapacity) {
                 mError = NO_MEMORY;
                 return NO_MEMORY;
@@ -2522,7 +2813,8 @@ status_t Parcel::continueWrite(size_t desired)
 
     } else {
         // This is the first data.  Easy!
-        uint8_t* data = (uint8_t*)malloc(desired);
+        const size_t capacity = parcelDataCapacity(desired);
+        uint8_t* data = allocParcelData(capacity);
         if (!data) {
             mError = NO_MEMORY;
             return NO_MEMORY;
@@ -2533,9 +2825,9 @@ status_t Parcel::continueWrite(size_t desired)
             ALOGE("continueWrite: %zu/%p/%zu/%zu", mDataCapacity, mObjects, mObjectsCapacity, desired);
         }
 
-        LOG_ALLOC("Parcel %p: allocating with %zu capacity", this, desired);
+        LOG_ALLOC("Parcel %p: allocating with %zu capacity", this, capacity);
         pthread_mutex_lock(&gParcelGlobalAllocSizeLock);
-        gParcelGlobalAllocSize += desired;
+        gParcelGlobalAllocSize += capacity;
         gParcelGlobalAllocCount++;
         pthread_mutex_unlock(&gParcelGlobalAllocSizeLock);
 
@@ -2543,7 +2835,7 @@ status_t Parcel::continueWrite(size_t desired)
         mDataSize = mDataPos = 0;
         ALOGV("continueWrite Setting data size of %p to %zu", this, mDataSize);
         ALOGV("continueWrite Setting data pos of %p to %zu", this, mDataPos);
-        mDataCapacity = desired;
+        mDataCapacity = capacity;
     }
 
     return NO_ERROR;
@@ -2567,6 +2859,7 @@ void Parcel::initState()
     mFdsKnown = true;
     mAllowFds = true;
     mOwner = NULL;
+    clearExternal();
 #ifndef DISABLE_ASHMEM_TRACKING
     mOpenAshmemSize = 0;
 #endif
@@ -2586,6 +2879,8 @@ void Parcel::initState()
 
 void Parcel::scanForFds() const
 {
+    // The object offsets only match mData once the segments are in place.
+    flattenExternal();
     bool hasFds = false;
     for (size_t i=0; i<mObjectsSize; i++) {
         const flat_binder_object* flat
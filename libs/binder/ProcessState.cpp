@@ -31,11 +31,15 @@
 
 #include <private/binder/binder_module.h>
 #include <private/binder/Static.h>
+#include <private/binder/TransactionStats.h>
 
 #include <errno.h>
 #include <fcntl.h>
+#include <inttypes.h>
+#include <sched.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include <sys/ioctl.h>
 #include <sys/mman.h>
@@ -45,6 +49,13 @@
 #define BINDER_VM_SIZE ((1*1024*1024) - (4096 *2))
 #define DEFAULT_MAX_BINDER_THREADS 15
 
+// A transaction that waited this long for a free thread makes the adaptive
+// pool grow.
+static const nsecs_t kAdaptivePoolGrowDelay = ms2ns(5);
+
+// A read that returns a transaction this quickly found it already queued.
+static const nsecs_t kQueuedReadTime = us2ns(500);
+
 // -------------------------------------------------------------------------
 
 namespace android {
@@ -163,33 +174,101 @@ bool ProcessState::becomeContextManager(context_check_func checkFunc, void* user
     return mManagesContexts;
 }
 
-ProcessState::handle_entry* ProcessState::lookupHandleLocked(int32_t handle)
+// Spreads threads over the reader slots so that lookups on different threads
+// don't all bounce the same cache line.
+static size_t handleReaderId()
+{
+    return reinterpret_cast<uintptr_t>(pthread_self()) >> 6;
+}
+
+std::atomic<IBinder*>* ProcessState::lookupHandleLocked(int32_t handle)
+{
+    if (handle < 0) return NULL;
+
+    handle_table* table = mHandleTable.load(std::memory_order_relaxed);
+    const size_t capacity = table ? table->capacity : 0;
+    if (capacity <= (size_t)handle) {
+        size_t newCapacity = capacity ? capacity : 64;
+        while (newCapacity <= (size_t)handle) newCapacity *= 2;
+
+        handle_table* newTable = new handle_table;
+        newTable->capacity = newCapacity;
+        newTable->entries = new std::atomic<IBinder*>[newCapacity];
+        for (size_t i = 0; i < newCapacity; i++) {
+            IBinder* b = i < capacity
+                    ? table->entries[i].load(std::memory_order_relaxed) : NULL;
+            newTable->entries[i].store(b, std::memory_order_relaxed);
+        }
+        mHandleTable.store(newTable);
+
+        if (table) {
+            // Readers may still be looking at the old table.
+            waitForHandleReaders();
+            delete[] table->entries;
+            delete table;
+        }
+        table = newTable;
+    }
+    return &table->entries[handle];
+}
+
+IBinder* ProcessState::attemptIncWeakProxy(int32_t handle)
 {
-    const size_t N=mHandleToObject.size();
-    if (N <= (size_t)handle) {
-        handle_entry e;
-        e.binder = NULL;
-        e.refs = NULL;
-        status_t err = mHandleToObject.insertAt(e, N, handle+1-N);
-        if (err < NO_ERROR) return NULL;
-    }
-    return &mHandleToObject.editItemAt(handle);
+    std::atomic<int32_t>& readers =
+            mHandleReaders[handleReaderId() % kHandleReaderSlots].count;
+    // Sequentially consistent, so that a writer either sees us in the slot
+    // or we see its update to the table.
+    readers.fetch_add(1);
+
+    IBinder* b = NULL;
+    handle_table* table = mHandleTable.load();
+    if (table && handle >= 0 && (size_t)handle < table->capacity) {
+        b = table->entries[handle].load();
+        // The BpBinder can't be freed before we leave: its destructor calls
+        // expungeHandle(), which waits for us. attemptIncWeak() fails if it
+        // is already on its way out.
+        if (b != NULL && !b->getWeakRefs()->attemptIncWeak(this)) {
+            b = NULL;
+        }
+    }
+
+    readers.fetch_sub(1, std::memory_order_release);
+    return b;
+}
+
+void ProcessState::waitForHandleReaders()
+{
+    for (size_t i = 0; i < kHandleReaderSlots; i++) {
+        while (mHandleReaders[i].count.load() != 0) {
+            sched_yield();
+        }
+    }
 }
 
 sp<IBinder> ProcessState::getStrongProxyForHandle(int32_t handle)
 {
     sp<IBinder> result;
 
+    IBinder* b = attemptIncWeakProxy(handle);
+    if (b != NULL) {
+        // This little bit of nastyness is to allow us to add a primary
+        // reference to the remote proxy when this team doesn't have one
+        // but another team is sending the handle to us.
+        result.force_set(b);
+        b->getWeakRefs()->decWeak(this);
+        return result;
+    }
+
     AutoMutex _l(mLock);
 
-    handle_entry* e = lookupHandleLocked(handle);
+    std::atomic<IBinder*>* e = lookupHandleLocked(handle);
 
     if (e != NULL) {
         // We need to create a new BpBinder if there isn't currently one, OR we
         // are unable to acquire a weak reference on this current one.  See comment
         // in getWeakProxyForHandle() for more info about this.
-        IBinder* b = e->binder;
-        if (b == NULL || !e->refs->attemptIncWeak(this)) {
+        b = e->load(std::memory_order_relaxed);
+        if (b == NULL || !b->getWeakRefs()->attemptIncWeak(this)) {
             if (handle == 0) {
                 // Special case for context manager...
                 // The context manager is the only object for which we create
@@ -218,15 +297,12 @@ sp<IBinder> ProcessState::getStrongProxyForHandle(int32_t handle)
             }
 
             b = new BpBinder(handle); 
-            e->binder = b;
-            if (b) e->refs = b->getWeakRefs();
+            e->store(b);
             result = b;
         } else {
-            // This little bit of nastyness is to allow us to add a primary
-            // reference to the remote proxy when this team doesn't have one
-            // but another team is sending the handle to us.
+            // Someone else created it while we were waiting for the lock.
             result.force_set(b);
-            e->refs->decWeak(this);
+            b->getWeakRefs()->decWeak(this);
         }
     }
 
@@ -237,9 +313,16 @@ wp<IBinder> ProcessState::getWeakProxyForHandle(int32_t handle)
 {
     wp<IBinder> result;
 
+    IBinder* b = attemptIncWeakProxy(handle);
+    if (b != NULL) {
+        result = b;
+        b->getWeakRefs()->decWeak(this);
+        return result;
+    }
+
     AutoMutex _l(mLock);
 
-    handle_entry* e = lookupHandleLocked(handle);
+    std::atomic<IBinder*>* e = lookupHandleLocked(handle);
 
     if (e != NULL) {        
         // We need to create a new BpBinder if there isn't currently one, OR we
@@ -249,15 +332,14 @@ wp<IBinder> ProcessState::getWeakProxyForHandle(int32_t handle)
         // We need to do this because there is a race condition between someone
         // releasing a reference on this BpBinder, and a new reference on its handle
         // arriving from the driver.
-        IBinder* b = e->binder;
-        if (b == NULL || !e->refs->attemptIncWeak(this)) {
+        b = e->load(std::memory_order_relaxed);
+        if (b == NULL || !b->getWeakRefs()->attemptIncWeak(this)) {
             b = new BpBinder(handle);
             result = b;
-            e->binder = b;
-            if (b) e->refs = b->getWeakRefs();
+            e->store(b);
         } else {
             result = b;
-            e->refs->decWeak(this);
+            b->getWeakRefs()->decWeak(this);
         }
     }
 
@@ -268,12 +350,18 @@ void ProcessState::expungeHandle(int32_t handle, IBinder* binder)
 {
     AutoMutex _l(mLock);
     
-    handle_entry* e = lookupHandleLocked(handle);
+    std::atomic<IBinder*>* e = lookupHandleLocked(handle);
 
     // This handle may have already been replaced with a new BpBinder
     // (if someone failed the AttemptIncWeak() above); we don't want
     // to overwrite it.
-    if (e && e->binder == binder) e->binder = NULL;
+    if (e && e->load(std::memory_order_relaxed) == binder) {
+        e->store(NULL);
+    }
+
+    // Lock-free readers may have picked up 'binder' before it was cleared
+    // or replaced; it must stay valid until they are done with it.
+    waitForHandleReaders();
 }
 
 String8 ProcessState::makeBinderThreadName() {
@@ -297,14 +385,228 @@ void ProcessState::spawnPooledThread(bool isMain)
 status_t ProcessState::setThreadPoolMaxThreadCount(size_t maxThreads) {
     status_t result = NO_ERROR;
     if (ioctl(mDriverFD, BINDER_SET_MAX_THREADS, &maxThreads) != -1) {
+        pthread_mutex_lock(&mThreadCountLock);
+        mMaxThreads = maxThreads;
+        mDriverMaxThreads = maxThreads;
+        mAdaptivePool = false;
+        pthread_mutex_unlock(&mThreadCountLock);
+    } else {
+        result = -errno;
+        ALOGE("Binder ioctl to set max threads failed: %s", strerror(-result));
+    }
+    return result;
+}
+
+status_t ProcessState::setThreadPoolAdaptive(size_t minThreads, size_t maxThreads,
+        nsecs_t window) {
+    if (minThreads > maxThreads || window <= 0) {
+        return BAD_VALUE;
+    }
+
+    pthread_mutex_lock(&mThreadCountLock);
+    // The driver counts every pooled thread it ever asked for against its
+    // limit, including those that have left the pool since.
+    size_t driverMax = mRegisteredPoolThreads - mPoolThreads + minThreads;
+    status_t result = NO_ERROR;
+    if (ioctl(mDriverFD, BINDER_SET_MAX_THREADS, &driverMax) != -1) {
         mMaxThreads = maxThreads;
+        mDriverMaxThreads = driverMax;
+        mAdaptivePool = true;
+        mAdaptiveMinThreads = minThreads;
+        mAdaptiveWindow = window;
+        mTargetPoolThreads = maxThreads;
+        mWindowPeakThreads = 0;
+        mWindowMaxQueueDelay = 0;
+        mWindowStartTime = systemTime();
     } else {
         result = -errno;
         ALOGE("Binder ioctl to set max threads failed: %s", strerror(-result));
     }
+    pthread_mutex_unlock(&mThreadCountLock);
     return result;
 }
 
+ssize_t ProcessState::registerPoolThreadLocked(pid_t tid, bool isMain)
+{
+    mLooperThreads++;
+    if (!isMain) {
+        mPoolThreads++;
+        mRegisteredPoolThreads++;
+    }
+
+    pool_thread_stats stats;
+    memset(&stats, 0, sizeof(stats));
+    stats.tid = tid;
+    stats.active = true;
+    stats.isMain = isMain;
+
+    // Reuse the slot of a thread that has left the pool.
+    for (size_t i = 0; i < mPoolThreadStats.size(); i++) {
+        if (!mPoolThreadStats[i].active) {
+            mPoolThreadStats.editItemAt(i) = stats;
+            return i;
+        }
+    }
+    return mPoolThreadStats.add(stats);
+}
+
+void ProcessState::unregisterPoolThreadLocked(ssize_t index)
+{
+    if (index < 0 || (size_t)index >= mPoolThreadStats.size()) return;
+    pool_thread_stats& stats(mPoolThreadStats.editItemAt(index));
+    mLooperThreads--;
+    if (!stats.isMain && !stats.leaving) {
+        mPoolThreads--;
+    }
+    stats.active = false;
+}
+
+void ProcessState::poolCommandStartedLocked(ssize_t index, bool isTransaction,
+        nsecs_t waitStart, nsecs_t readTime, nsecs_t start)
+{
+    // The driver doesn't say when a transaction arrived. One that came in
+    // while the thread was blocked in the read waited only since the read;
+    // one the driver had to queue because every looper was busy waited at
+    // most since the pool became saturated.
+    nsecs_t queuedSince = readTime;
+    if (index >= 0 && (size_t)index < mPoolThreadStats.size()) {
+        pool_thread_stats& stats(mPoolThreadStats.editItemAt(index));
+        if (stats.queuedSince != 0 && readTime >= waitStart
+                && readTime - waitStart < kQueuedReadTime) {
+            queuedSince = stats.queuedSince;
+        }
+        stats.queuedSince = 0;
+        stats.commands++;
+        stats.idleTime += start - waitStart;
+        if (isTransaction) {
+            const nsecs_t queueDelay = start - queuedSince;
+            stats.transactions++;
+            stats.totalQueueDelay += queueDelay;
+            if (queueDelay > stats.maxQueueDelay) {
+                stats.maxQueueDelay = queueDelay;
+            }
+        }
+    }
+
+    if (mExecutingThreadsCount >= mLooperThreads && mSaturatedSince == 0) {
+        mSaturatedSince = start;
+    }
+
+    if (!mAdaptivePool) return;
+
+    if (mExecutingThreadsCount > mWindowPeakThreads) {
+        mWindowPeakThreads = mExecutingThreadsCount;
+    }
+    if (!isTransaction) return;
+
+    const nsecs_t queueDelay = start - queuedSince;
+    if (queueDelay > mWindowMaxQueueDelay) {
+        mWindowMaxQueueDelay = queueDelay;
+    }
+
+    // The transaction waited too long for a thread: let the driver spawn
+    // another one the next time it runs out of ready threads, and keep it
+    // until a window passes without such waits.
+    if (queueDelay >= kAdaptivePoolGrowDelay && mPoolThreads < mMaxThreads
+            && mDriverMaxThreads < mRegisteredPoolThreads + 1) {
+        size_t driverMax = mRegisteredPoolThreads + 1;
+        if (ioctl(mDriverFD, BINDER_SET_MAX_THREADS, &driverMax) != -1) {
+            mDriverMaxThreads = driverMax;
+            if (mTargetPoolThreads < mPoolThreads + 1) {
+                mTargetPoolThreads = mPoolThreads + 1;
+            }
+        }
+    }
+}
+
+bool ProcessState::poolCommandFinishedLocked(ssize_t index, nsecs_t busyTime)
+{
+    const bool valid = index >= 0 && (size_t)index < mPoolThreadStats.size();
+
+    // This thread is the first to free up since every looper became busy,
+    // so the driver hands it whatever it queued meanwhile.
+    if (mSaturatedSince != 0) {
+        if (valid) {
+            mPoolThreadStats.editItemAt(index).queuedSince = mSaturatedSince;
+        }
+        mSaturatedSince = 0;
+    }
+
+    if (!valid) return false;
+    pool_thread_stats& stats(mPoolThreadStats.editItemAt(index));
+    stats.busyTime += busyTime;
+
+    if (!mAdaptivePool) return false;
+
+    const nsecs_t now = systemTime();
+    if (now - mWindowStartTime >= mAdaptiveWindow) {
+        // Keep one spare thread above the peak load of the last window,
+        // unless transactions still had to wait for a thread in it.
+        if (mWindowMaxQueueDelay < kAdaptivePoolGrowDelay) {
+            mTargetPoolThreads = mWindowPeakThreads + 1;
+            if (mTargetPoolThreads < mAdaptiveMinThreads) {
+                mTargetPoolThreads = mAdaptiveMinThreads;
+            }
+        }
+        mWindowPeakThreads = mExecutingThreadsCount;
+        mWindowMaxQueueDelay = 0;
+        mWindowStartTime = now;
+    }
+
+    // The main thread never leaves; it isn't counted in mPoolThreads.
+    if (stats.isMain || stats.leaving || mPoolThreads <= mTargetPoolThreads) {
+        return stats.leaving;
+    }
+
+    // Take the thread out of the count now, while the lock is held, so that
+    // other threads finishing a command meanwhile don't all leave at once.
+    stats.leaving = true;
+    mPoolThreads--;
+    return true;
+}
+
+void ProcessState::dumpThreadPool(String8& result)
+{
+    pthread_mutex_lock(&mThreadCountLock);
+    result.appendFormat("Binder thread pool: %zu pooled threads (%zu registered), "
+            "%zu executing, max %zu%s\n",
+            mPoolThreads, mRegisteredPoolThreads, mExecutingThreadsCount, mMaxThreads,
+            mAdaptivePool ? " (adaptive)" : "");
+    if (mAdaptivePool) {
+        result.appendFormat("  min %zu, target %zu, driver limit %zu, "
+                "peak busy in window %zu, max queue delay in window %" PRId64 " us\n",
+                mAdaptiveMinThreads, mTargetPoolThreads, mDriverMaxThreads,
+                mWindowPeakThreads, ns2us(mWindowMaxQueueDelay));
+    }
+    for (size_t i = 0; i < mPoolThreadStats.size(); i++) {
+        const pool_thread_stats& stats(mPoolThreadStats[i]);
+        const nsecs_t total = stats.busyTime + stats.idleTime;
+        result.appendFormat("  tid %d%s%s: %" PRIu64 " commands, %" PRIu64
+                " transactions, busy %" PRId64 " ms (%d%%), idle %" PRId64 " ms, "
+                "queue delay avg %" PRId64 " us max %" PRId64 " us\n",
+                stats.tid, stats.isMain ? " (main)" : "",
+                stats.active ? "" : " (exited)",
+                stats.commands, stats.transactions,
+                ns2ms(stats.busyTime),
+                total > 0 ? int(stats.busyTime * 100 / total) : 0,
+                ns2ms(stats.idleTime),
+                stats.transactions
+                        ? ns2us(stats.totalQueueDelay / int64_t(stats.transactions)) : 0,
+                ns2us(stats.maxQueueDelay));
+    }
+    pthread_mutex_unlock(&mThreadCountLock);
+}
+
+void ProcessState::setTransactionStatsEnabled(bool enabled)
+{
+    TransactionStats::setEnabled(enabled);
+}
+
+void ProcessState::dumpTransactionStats(String8& result)
+{
+    TransactionStats::dump(result);
+}
+
 void ProcessState::giveThreadPoolName() {
     androidSetThreadName( makeBinderThreadName().string() );
 }
@@ -344,6 +646,19 @@ ProcessState::ProcessState()
     , mExecutingThreadsCount(0)
     , mMaxThreads(DEFAULT_MAX_BINDER_THREADS)
     , mStarvationStartTimeMs(0)
+    , mAdaptivePool(false)
+    , mAdaptiveMinThreads(0)
+    , mAdaptiveWindow(s2ns(10))
+    , mLooperThreads(0)
+    , mPoolThreads(0)
+    , mRegisteredPoolThreads(0)
+    , mDriverMaxThreads(DEFAULT_MAX_BINDER_THREADS)
+    , mSaturatedSince(0)
+    , mWindowPeakThreads(0)
+    , mWindowMaxQueueDelay(0)
+    , mWindowStartTime(0)
+    , mTargetPoolThreads(DEFAULT_MAX_BINDER_THREADS)
+    , mHandleTable(NULL)
     , mManagesContexts(false)
     , mBinderContextCheckFunc(NULL)
     , mBinderContextUserData(NULL)
@@ -361,6 +676,10 @@ ProcessState::ProcessState()
         }
     }
 
+    for (size_t i = 0; i < kHandleReaderSlots; i++) {
+        mHandleReaders[i].count.store(0);
+    }
+
     LOG_ALWAYS_FATAL_IF(mDriverFD < 0, "Binder driver could not be opened.  Terminating.");
 }
 
@@ -373,6 +692,12 @@ ProcessState::~ProcessState()
         close(mDriverFD);
     }
     mDriverFD = -1;
+
+    handle_table* table = mHandleTable.load();
+    if (table) {
+        delete[] table->entries;
+        delete table;
+    }
 }
         
 }; // namespace android
@@ -96,4 +96,10 @@ Mutex gDefaultServiceManagerLock;
 sp<IServiceManager> gDefaultServiceManager;
 sp<IPermissionController> gPermissionController;
 
+// ------------ TransactionStats.cpp
+
+Mutex gTransactionStatsLock;
+Vector<TransactionStats*> gTransactionStats;
+TransactionStats* gExitedTransactionStats = NULL;
+
 }   // namespace android
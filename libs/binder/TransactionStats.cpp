@@ -0,0 +1,405 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "TransactionStats"
+#define ATRACE_TAG ATRACE_TAG_ALWAYS
+
+#include <private/binder/TransactionStats.h>
+
+#include <binder/Parcel.h>
+#include <cutils/properties.h>
+#include <cutils/trace.h>
+#include <utils/Log.h>
+
+#include <private/binder/Static.h>
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <map>
+
+namespace android {
+
+// ---------------------------------------------------------------------------
+
+struct TransactionStats::Entry {
+    // set (with release semantics) once the key and label below are valid
+    std::atomic<uint32_t> used;
+    uint32_t hash;
+    uintptr_t target;
+    uint32_t code;
+    uint32_t tokenLength;
+    Direction direction;
+    String16 descriptor;
+
+    std::atomic<uint32_t> count;
+    std::atomic<uint64_t> totalNs;
+    std::atomic<uint64_t> maxNs;
+    std::atomic<uint32_t> buckets[kBucketCount];
+};
+
+// Only the owning thread writes to an entry, so there's no need for an
+// atomic read-modify-write.
+template <typename T, typename U>
+static inline void add(std::atomic<T>& counter, U value)
+{
+    counter.store(counter.load(std::memory_order_relaxed) + value,
+            std::memory_order_relaxed);
+}
+
+static size_t bucketFor(nsecs_t duration)
+{
+    const uint64_t us = duration > 0 ? uint64_t(duration) / 1000 : 0;
+    if (us < 2) {
+        return 0;
+    }
+    size_t bucket = 63 - __builtin_clzll(us);
+    return bucket < TransactionStats::kBucketCount
+            ? bucket : TransactionStats::kBucketCount - 1;
+}
+
+// Returns the length of the interface descriptor written by
+// Parcel::writeInterfaceToken() (the strict mode policy, then a String16),
+// or 0 for parcels that don't start with one (pings, dumps, raw
+// transactions). Doesn't look at the characters.
+static uint32_t tokenLength(const Parcel& data)
+{
+    const size_t size = data.dataSize();
+    if (size < 2 * sizeof(int32_t)) {
+        return 0;
+    }
+    const uint8_t* bytes = data.data();
+    int32_t len;
+    memcpy(&len, bytes + sizeof(int32_t), sizeof(len));
+    if (len <= 0 || len > 255 ||
+            2 * sizeof(int32_t) + (size_t(len) + 1) * sizeof(char16_t) > size) {
+        return 0;
+    }
+    char16_t terminator;
+    memcpy(&terminator, bytes + 2 * sizeof(int32_t) + len * sizeof(char16_t),
+            sizeof(terminator));
+    return terminator == 0 ? len : 0;
+}
+
+// Finds the interface descriptor at the start of the parcel, if it is one.
+static bool findInterfaceToken(const Parcel& data, const char16_t** descriptor,
+        size_t* length)
+{
+    const uint32_t len = tokenLength(data);
+    if (len == 0) {
+        return false;
+    }
+    const char16_t* chars =
+            reinterpret_cast<const char16_t*>(data.data() + 2 * sizeof(int32_t));
+    for (uint32_t i = 0; i < len; i++) {
+        if (chars[i] < 0x20 || chars[i] > 0x7e) {
+            return false;
+        }
+    }
+    *descriptor = chars;
+    *length = len;
+    return true;
+}
+
+static uint32_t hashKey(TransactionStats::Direction direction, uintptr_t target,
+        uint32_t code, uint32_t tokenLength)
+{
+    uint64_t key = uint64_t(target) ^ (uint64_t(code) << 32) ^
+            (uint64_t(tokenLength) << 1) ^ uint64_t(direction);
+    key *= 0x9e3779b97f4a7c15ULL;
+    return uint32_t(key >> 32);
+}
+
+static pthread_once_t gEnabledOnce = PTHREAD_ONCE_INIT;
+static std::atomic<bool> gEnabled(false);
+
+static void readEnabledProperty()
+{
+    char value[PROPERTY_VALUE_MAX];
+    property_get("debug.binder.stats", value, "0");
+    if (atoi(value) != 0) {
+        gEnabled.store(true, std::memory_order_relaxed);
+    }
+}
+
+static bool gTraceChecked = false;
+static bool gTraceEnabled = false;
+static std::atomic<int32_t> gTraceCookie(0);
+
+static bool isTraceEnabled()
+{
+    if (!gTraceChecked) {
+        char value[PROPERTY_VALUE_MAX];
+        property_get("debug.binder.trace", value, "0");
+        gTraceEnabled = atoi(value) != 0;
+        gTraceChecked = true;
+    }
+    return gTraceEnabled;
+}
+
+// ---------------------------------------------------------------------------
+
+TransactionStats::TransactionStats()
+    : mEntries(new Entry[kEntryCount]()),
+      mDropped(0)
+{
+    pthread_once(&gEnabledOnce, readEnabledProperty);
+    AutoMutex _l(gTransactionStatsLock);
+    gTransactionStats.add(this);
+}
+
+TransactionStats::~TransactionStats()
+{
+    AutoMutex _l(gTransactionStatsLock);
+    for (size_t i = 0; i < gTransactionStats.size(); i++) {
+        if (gTransactionStats[i] == this) {
+            gTransactionStats.removeAt(i);
+            break;
+        }
+    }
+
+    // Keep what this thread recorded.
+    if (gExitedTransactionStats == NULL) {
+        gExitedTransactionStats = new TransactionStats(true);
+    }
+    TransactionStats* exited = gExitedTransactionStats;
+    for (size_t i = 0; i < kEntryCount; i++) {
+        const Entry& entry(mEntries[i]);
+        if (!entry.used.load(std::memory_order_acquire)) continue;
+        bool created;
+        Entry* e = exited->findEntry(entry.direction, entry.target, entry.code,
+                entry.tokenLength, &created);
+        if (e == NULL) {
+            add(exited->mDropped, entry.count.load());
+            continue;
+        }
+        if (created) {
+            e->descriptor = entry.descriptor;
+            e->used.store(1, std::memory_order_release);
+        }
+        add(e->count, entry.count.load());
+        add(e->totalNs, entry.totalNs.load());
+        if (entry.maxNs.load() > e->maxNs.load()) {
+            e->maxNs.store(entry.maxNs.load());
+        }
+        for (size_t b = 0; b < kBucketCount; b++) {
+            add(e->buckets[b], entry.buckets[b].load());
+        }
+    }
+    add(exited->mDropped, mDropped.load());
+
+    delete[] mEntries;
+}
+
+TransactionStats::TransactionStats(bool /*unregistered*/)
+    : mEntries(new Entry[kEntryCount]()),
+      mDropped(0)
+{
+}
+
+bool TransactionStats::isEnabled()
+{
+    return gEnabled.load(std::memory_order_relaxed);
+}
+
+void TransactionStats::setEnabled(bool enabled)
+{
+    pthread_once(&gEnabledOnce, readEnabledProperty);
+    gEnabled.store(enabled, std::memory_order_relaxed);
+}
+
+TransactionStats::Entry* TransactionStats::findEntry(Direction direction,
+        uintptr_t target, uint32_t code, uint32_t tokenLength, bool* outCreated)
+{
+    const uint32_t hash = hashKey(direction, target, code, tokenLength);
+    for (size_t probe = 0; probe < kEntryCount; probe++) {
+        Entry& entry(mEntries[(hash + probe) % kEntryCount]);
+        if (!entry.used.load(std::memory_order_relaxed)) {
+            entry.hash = hash;
+            entry.target = target;
+            entry.code = code;
+            entry.tokenLength = tokenLength;
+            entry.direction = direction;
+            *outCreated = true;
+            return &entry;
+        }
+        if (entry.hash == hash && entry.target == target && entry.code == code &&
+                entry.tokenLength == tokenLength && entry.direction == direction) {
+            *outCreated = false;
+            return &entry;
+        }
+    }
+    return NULL;
+}
+
+TransactionStats::Entry* TransactionStats::getEntry(Direction direction,
+        uintptr_t target, uint32_t code, const Parcel& data)
+{
+    bool created;
+    Entry* entry = findEntry(direction, target, code, tokenLength(data), &created);
+    if (entry != NULL && created) {
+        const char16_t* descriptor;
+        size_t length;
+        if (findInterfaceToken(data, &descriptor, &length)) {
+            entry->descriptor.setTo(descriptor, length);
+        }
+        entry->used.store(1, std::memory_order_release);
+    }
+    return entry;
+}
+
+// ---------------------------------------------------------------------------
+
+TransactionStats::Recorder::Recorder(TransactionStats* stats, Direction direction,
+        uintptr_t target, const Parcel& data, uint32_t code)
+    : mEntry(NULL),
+      mStart(0),
+      mTraceCookie(0)
+{
+    const bool enabled = stats != NULL && isEnabled();
+    if (!enabled && !isTraceEnabled()) {
+        return;
+    }
+    mStart = systemTime();
+
+    if (enabled) {
+        mEntry = stats->getEntry(direction, target, code, data);
+        if (mEntry == NULL) {
+            add(stats->mDropped, 1);
+        }
+    }
+
+    if (isTraceEnabled()) {
+        const char16_t* descriptor;
+        size_t length = 0;
+        findInterfaceToken(data, &descriptor, &length);
+        snprintf(mTraceName, sizeof(mTraceName), "binder %s %s#%u",
+                direction == OUTGOING ? "call" : "serve",
+                length ? String8(descriptor, length).string() : "?", code);
+        mTraceCookie = ++gTraceCookie;
+        atrace_async_begin(ATRACE_TAG, mTraceName, mTraceCookie);
+    }
+}
+
+TransactionStats::Recorder::~Recorder()
+{
+    if (mStart == 0) {
+        return;
+    }
+    const nsecs_t duration = systemTime() - mStart;
+    if (mTraceCookie != 0) {
+        atrace_async_end(ATRACE_TAG, mTraceName, mTraceCookie);
+    }
+    if (mEntry == NULL) {
+        return;
+    }
+    add(mEntry->count, 1);
+    add(mEntry->totalNs, duration);
+    if (uint64_t(duration) > mEntry->maxNs.load(std::memory_order_relaxed)) {
+        mEntry->maxNs.store(duration, std::memory_order_relaxed);
+    }
+    add(mEntry->buckets[bucketFor(duration)], 1);
+}
+
+// ---------------------------------------------------------------------------
+
+namespace {
+
+struct Key {
+    String16 descriptor;
+    uint32_t code;
+    int direction;
+
+    bool operator<(const Key& rhs) const {
+        if (direction != rhs.direction) return direction < rhs.direction;
+        if (descriptor != rhs.descriptor) return descriptor < rhs.descriptor;
+        return code < rhs.code;
+    }
+};
+
+struct Histogram {
+    uint64_t count;
+    uint64_t totalNs;
+    uint64_t maxNs;
+    uint64_t buckets[TransactionStats::kBucketCount];
+
+    // upper bound, in us, of the bucket holding the given fraction
+    uint64_t percentileUs(double fraction) const {
+        const uint64_t target = uint64_t(fraction * count);
+        uint64_t seen = 0;
+        for (size_t i = 0; i < TransactionStats::kBucketCount; i++) {
+            seen += buckets[i];
+            if (seen > target) return uint64_t(2) << i;
+        }
+        return uint64_t(2) << (TransactionStats::kBucketCount - 1);
+    }
+};
+
+} // namespace
+
+void TransactionStats::dump(String8& result)
+{
+    std::map<Key, Histogram> merged;
+    uint64_t dropped = 0;
+
+    AutoMutex _l(gTransactionStatsLock);
+    const size_t N = gTransactionStats.size();
+    for (size_t t = 0; t <= N; t++) {
+        const TransactionStats* stats = t < N ? gTransactionStats[t] : gExitedTransactionStats;
+        if (stats == NULL) continue;
+        dropped += stats->mDropped.load(std::memory_order_relaxed);
+        for (size_t i = 0; i < kEntryCount; i++) {
+            const Entry& entry(stats->mEntries[i]);
+            if (!entry.used.load(std::memory_order_acquire)) continue;
+            Key key = { entry.descriptor, entry.code, entry.direction };
+            std::map<Key, Histogram>::iterator it = merged.find(key);
+            if (it == merged.end()) {
+                Histogram empty;
+                memset(&empty, 0, sizeof(empty));
+                it = merged.insert(std::make_pair(key, empty)).first;
+            }
+            Histogram& h(it->second);
+            h.count += entry.count.load(std::memory_order_relaxed);
+            h.totalNs += entry.totalNs.load(std::memory_order_relaxed);
+            const uint64_t maxNs = entry.maxNs.load(std::memory_order_relaxed);
+            if (maxNs > h.maxNs) h.maxNs = maxNs;
+            for (size_t b = 0; b < kBucketCount; b++) {
+                h.buckets[b] += entry.buckets[b].load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    result.appendFormat("Binder transactions (%zu threads, %" PRIu64 " not tracked%s), "
+            "latencies in us:\n", N, dropped,
+            isEnabled() ? "" : ", recording off");
+    for (std::map<Key, Histogram>::const_iterator it = merged.begin();
+            it != merged.end(); ++it) {
+        const Key& key(it->first);
+        const Histogram& h(it->second);
+        if (h.count == 0) continue;
+        result.appendFormat("  %s %s #%u: count=%" PRIu64 " avg=%" PRIu64
+                " max=%" PRIu64 " p50<%" PRIu64 " p90<%" PRIu64 " p99<%" PRIu64 "\n",
+                key.direction == OUTGOING ? "out" : "in ",
+                key.descriptor.size() ? String8(key.descriptor).string() : "(no token)",
+                key.code, h.count, h.totalNs / h.count / 1000, h.maxNs / 1000,
+                h.percentileUs(0.5), h.percentileUs(0.9), h.percentileUs(0.99));
+    }
+}
+
+}; // namespace android
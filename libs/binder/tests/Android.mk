@@ -33,6 +33,14 @@ LOCAL_SRC_FILES := binderLibTest.cpp
 LOCAL_SHARED_LIBRARIES := libbinder libutils
 include $(BUILD_NATIVE_TEST)
 
+include $(CLEAR_VARS)
+LOCAL_MODULE := binderParcelTest
+LOCAL_SRC_FILES := binderParcelTest.cpp
+LOCAL_SHARED_LIBRARIES := libbinder libutils
+LOCAL_CLANG := true
+LOCAL_CFLAGS += -g -Wall -Werror -std=c++11
+include $(BUILD_NATIVE_TEST)
+
 include $(CLEAR_VARS)
 LOCAL_MODULE := binderThroughputTest
 LOCAL_SRC_FILES := binderThroughputTest.cpp
@@ -40,3 +48,11 @@ LOCAL_SHARED_LIBRARIES := libbinder libutils
 LOCAL_CLANG := true
 LOCAL_CFLAGS += -g -Wall -Werror -std=c++11 -Wno-missing-field-initializers -Wno-sign-compare -O3
 include $(BUILD_NATIVE_TEST)
+
+include $(CLEAR_VARS)
+LOCAL_MODULE := binderHandleLookupBenchmark
+LOCAL_SRC_FILES := binderHandleLookupBenchmark.cpp
+LOCAL_SHARED_LIBRARIES := libbinder libutils
+LOCAL_CLANG := true
+LOCAL_CFLAGS += -g -Wall -Werror -std=c++11 -O3
+include $(BUILD_NATIVE_TEST)
@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Measures how ProcessState::getStrongProxyForHandle() scales when many
+// threads look up existing proxies at once, the way binder threads do when
+// unflattening the binders of incoming transactions.
+
+#include <binder/BpBinder.h>
+#include <binder/IBinder.h>
+#include <binder/IServiceManager.h>
+#include <binder/ProcessState.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace android;
+
+static void lookup_fx(const vector<int32_t>& handles, int iterations)
+{
+    sp<ProcessState> proc(ProcessState::self());
+    for (int i = 0; i < iterations; i++) {
+        sp<IBinder> b = proc->getStrongProxyForHandle(handles[i % handles.size()]);
+        if (b == NULL) {
+            cout << "lookup of handle " << handles[i % handles.size()] << " failed" << endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    int max_threads = 16;
+    int iterations = 1000000;
+
+    // Parse arguments.
+    for (int i = 1; i < argc; i++) {
+        if (string(argv[i]) == "-t") {
+            max_threads = atoi(argv[i+1]);
+            i++;
+            continue;
+        }
+        if (string(argv[i]) == "-i") {
+            iterations = atoi(argv[i+1]);
+            i++;
+            continue;
+        }
+    }
+
+    // Hold on to a proxy for every registered service, so that lookups
+    // always find an existing one.
+    sp<IServiceManager> sm = defaultServiceManager();
+    vector<sp<IBinder> > services;
+    vector<int32_t> handles;
+    Vector<String16> names = sm->listServices();
+    for (size_t i = 0; i < names.size(); i++) {
+        sp<IBinder> service = sm->checkService(names[i]);
+        if (service != NULL && service->remoteBinder() != NULL) {
+            services.push_back(service);
+            handles.push_back(service->remoteBinder()->handle());
+        }
+    }
+    if (handles.empty()) {
+        handles.push_back(0);
+    }
+    cout << "looking up " << handles.size() << " handles" << endl;
+
+    for (int threads = 1; threads <= max_threads; threads *= 2) {
+        chrono::time_point<chrono::high_resolution_clock> start, end;
+        start = chrono::high_resolution_clock::now();
+        vector<thread> workers;
+        for (int t = 0; t < threads; t++) {
+            workers.push_back(thread(lookup_fx, cref(handles), iterations));
+        }
+        for (auto& w : workers) {
+            w.join();
+        }
+        end = chrono::high_resolution_clock::now();
+
+        double ns = chrono::duration_cast<chrono::nanoseconds>(end - start).count();
+        double lookups = double(iterations) * threads;
+        cout << "threads: " << threads
+             << " lookups per sec: " << lookups / (ns / 1.0E9)
+             << " ns per lookup per thread: " << ns / iterations << endl;
+    }
+    return 0;
+}
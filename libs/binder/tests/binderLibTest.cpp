@@ -16,10 +16,12 @@
 
 #include <errno.h>
 #include <fcntl.h>
+#include <inttypes.h>
 #include <poll.h>
 #include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <gtest/gtest.h>
 
@@ -27,6 +29,7 @@
 #include <binder/IBinder.h>
 #include <binder/IPCThreadState.h>
 #include <binder/IServiceManager.h>
+#include <binder/ProcessState.h>
 
 #define ARRAY_SIZE(array) (sizeof array / sizeof array[0])
 
@@ -55,6 +58,11 @@ enum BinderLibTestTranscationCode {
     BINDER_LIB_TEST_EXIT_TRANSACTION,
     BINDER_LIB_TEST_DELAYED_EXIT_TRANSACTION,
     BINDER_LIB_TEST_GET_PTR_SIZE_TRANSACTION,
+    BINDER_LIB_TEST_ECHO_BINDERS_AND_BYTES_TRANSACTION,
+    BINDER_LIB_TEST_SET_ADAPTIVE_POOL_TRANSACTION,
+    BINDER_LIB_TEST_SLEEP_TRANSACTION,
+    BINDER_LIB_TEST_DUMP_THREAD_POOL_TRANSACTION,
+    BINDER_LIB_TEST_TRANSACTION_STATS_TRANSACTION,
 };
 
 pid_t start_server_process(int arg2)
@@ -672,6 +680,302 @@ TEST_F(BinderLibTest, PromoteRemote) {
     EXPECT_GE(ret, 0);
 }
 
+// Large enough that writeByteVectorExternal() keeps it as a segment.
+static const size_t EXTERNAL_PAYLOAD_SIZE = 16 * 1024 + 3;
+
+static std::vector<uint8_t> makeExternalPayload()
+{
+    std::vector<uint8_t> payload(EXTERNAL_PAYLOAD_SIZE);
+    for (size_t i = 0; i < payload.size(); i++) {
+        payload[i] = (uint8_t)(i * 7);
+    }
+    return payload;
+}
+
+TEST_F(BinderLibTest, ExternalSegmentShiftsObjectOffsets) {
+    sp<IBinder> before = new BBinder();
+    sp<IBinder> after = new BBinder();
+    std::vector<uint8_t> payload = makeExternalPayload();
+    std::vector<uint8_t> readPayload;
+    Parcel data;
+
+    EXPECT_EQ(NO_ERROR, data.writeStrongBinder(before));
+    EXPECT_EQ(NO_ERROR, data.writeByteVectorExternal(payload));
+    const size_t afterOffset = data.dataPosition();
+    EXPECT_EQ(NO_ERROR, data.writeStrongBinder(after));
+    EXPECT_EQ(NO_ERROR, data.writeInt32(0x7e57));
+
+    // objects() copies the segment in and moves the second binder past it.
+    ASSERT_EQ(2u, data.objectsCount());
+    EXPECT_EQ(0u, data.objects()[0]);
+    EXPECT_EQ(afterOffset, data.objects()[1]);
+
+    data.setDataPosition(0);
+    EXPECT_EQ(before, data.readStrongBinder());
+    EXPECT_EQ(NO_ERROR, data.readByteVector(&readPayload));
+    EXPECT_TRUE(payload == readPayload);
+    EXPECT_EQ(after, data.readStrongBinder());
+    EXPECT_EQ(0x7e57, data.readInt32());
+}
+
+TEST_F(BinderLibTest, ExternalSegmentBetweenBinders) {
+    status_t ret;
+    sp<IBinder> before = new BBinder();
+    sp<IBinder> after = new BBinder();
+    std::vector<uint8_t> payload = makeExternalPayload();
+    std::vector<uint8_t> readPayload;
+    Parcel data, reply;
+
+    // The segment is only copied in when the transaction is sent; the driver
+    // rejects the transaction if the offset of the second binder is wrong.
+    EXPECT_EQ(NO_ERROR, data.writeStrongBinder(before));
+    EXPECT_EQ(NO_ERROR, data.writeByteVectorExternal(payload));
+    EXPECT_EQ(NO_ERROR, data.writeStrongBinder(after));
+    ret = m_server->transact(BINDER_LIB_TEST_ECHO_BINDERS_AND_BYTES_TRANSACTION, data, &reply);
+    ASSERT_EQ(NO_ERROR, ret);
+
+    EXPECT_EQ(before, reply.readStrongBinder());
+    EXPECT_EQ(NO_ERROR, reply.readByteVector(&readPayload));
+    EXPECT_TRUE(payload == readPayload);
+    EXPECT_EQ(after, reply.readStrongBinder());
+}
+
+TEST_F(BinderLibTest, ExternalSegmentDataAvail) {
+    std::vector<uint8_t> payload = makeExternalPayload();
+    std::vector<uint8_t> readPayload;
+    Parcel data, copy;
+
+    EXPECT_EQ(NO_ERROR, data.writeInt32(1));
+    EXPECT_EQ(NO_ERROR, data.writeByteVectorExternal(payload));
+    EXPECT_EQ(NO_ERROR, data.writeInt32(2));
+    EXPECT_EQ(0u, data.dataAvail());
+    EXPECT_EQ(data.dataSize(), data.dataPosition());
+
+    data.setDataPosition(sizeof(int32_t));
+    EXPECT_EQ(data.dataSize() - sizeof(int32_t), data.dataAvail());
+    EXPECT_EQ(NO_ERROR, data.readByteVector(&readPayload));
+    EXPECT_TRUE(payload == readPayload);
+    EXPECT_EQ(2, data.readInt32());
+    EXPECT_EQ(0u, data.dataAvail());
+
+    // Appending behind a segment that hasn't been copied in yet.
+    EXPECT_EQ(NO_ERROR, copy.writeByteVectorExternal(payload));
+    EXPECT_EQ(NO_ERROR, copy.appendFrom(&data, 0, data.dataSize()));
+    copy.setDataPosition(0);
+    EXPECT_EQ(copy.dataSize(), copy.dataAvail());
+    EXPECT_EQ(NO_ERROR, copy.readByteVector(&readPayload));
+    EXPECT_TRUE(payload == readPayload);
+    EXPECT_EQ(1, copy.readInt32());
+    EXPECT_EQ(NO_ERROR, copy.readByteVector(&readPayload));
+    EXPECT_TRUE(payload == readPayload);
+    EXPECT_EQ(2, copy.readInt32());
+    EXPECT_EQ(0u, copy.dataAvail());
+}
+
+TEST_F(BinderLibTest, ExternalSegmentFileDescriptors) {
+    std::vector<uint8_t> payload = makeExternalPayload();
+    std::vector<uint8_t> readPayload;
+    int pipefd[2];
+    Parcel data, noFds, withFds;
+
+    ASSERT_EQ(0, pipe(pipefd));
+    EXPECT_EQ(NO_ERROR, data.writeByteVectorExternal(payload));
+    const size_t fdOffset = data.dataPosition();
+    EXPECT_EQ(NO_ERROR, data.writeDupFileDescriptor(pipefd[0]));
+    EXPECT_EQ(NO_ERROR, data.writeInt32(0x7e57));
+    EXPECT_TRUE(data.hasFileDescriptors());
+    ASSERT_EQ(1u, data.objectsCount());
+    EXPECT_EQ(fdOffset, data.objects()[0]);
+
+    // Only a range past the segment holds the descriptor. The parcels it is
+    // appended to have segments of their own that aren't copied in yet.
+    EXPECT_EQ(NO_ERROR, noFds.writeByteVectorExternal(payload));
+    EXPECT_EQ(NO_ERROR, noFds.appendFrom(&data, 0, fdOffset));
+    EXPECT_FALSE(noFds.hasFileDescriptors());
+    EXPECT_EQ(NO_ERROR, withFds.writeByteVectorExternal(payload));
+    EXPECT_EQ(NO_ERROR, withFds.appendFrom(&data, fdOffset, data.dataSize() - fdOffset));
+    EXPECT_TRUE(withFds.hasFileDescriptors());
+    ASSERT_EQ(1u, withFds.objectsCount());
+    EXPECT_EQ(fdOffset, withFds.objects()[0]);
+    withFds.setDataPosition(fdOffset);
+    EXPECT_GE(withFds.readFileDescriptor(), 0);
+    EXPECT_EQ(0x7e57, withFds.readInt32());
+
+    data.setDataPosition(0);
+    EXPECT_EQ(NO_ERROR, data.readByteVector(&readPayload));
+    EXPECT_TRUE(payload == readPayload);
+    EXPECT_GE(data.readFileDescriptor(), 0);
+    EXPECT_EQ(0x7e57, data.readInt32());
+
+    close(pipefd[0]);
+    close(pipefd[1]);
+}
+
+struct BinderLibTestPoolCalls {
+    sp<IBinder> server;
+    uint32_t code;
+    int32_t arg;
+    int count;
+};
+
+static void *poolCallsThread(void *arg)
+{
+    BinderLibTestPoolCalls *calls = static_cast<BinderLibTestPoolCalls *>(arg);
+    for (int i = 0; i < calls->count; i++) {
+        Parcel data, reply;
+        data.writeInt32(calls->arg);
+        EXPECT_EQ(NO_ERROR, calls->server->transact(calls->code, data, &reply));
+    }
+    return NULL;
+}
+
+// Makes 'count' calls from each of 'threads' threads at once.
+static void callConcurrently(const sp<IBinder>& server, uint32_t code, int32_t arg,
+                             int count, size_t threads)
+{
+    BinderLibTestPoolCalls calls = { server, code, arg, count };
+    std::vector<pthread_t> ids(threads);
+    for (size_t i = 0; i < threads; i++) {
+        ASSERT_EQ(0, pthread_create(&ids[i], NULL, poolCallsThread, &calls));
+    }
+    for (size_t i = 0; i < threads; i++) {
+        pthread_join(ids[i], NULL);
+    }
+}
+
+static void getPoolThreads(const sp<IBinder>& server, size_t *pooled, size_t *registered)
+{
+    Parcel data, reply;
+    ASSERT_EQ(NO_ERROR, server->transact(BINDER_LIB_TEST_DUMP_THREAD_POOL_TRANSACTION,
+                                         data, &reply));
+    String8 dump = reply.readString8();
+    ASSERT_EQ(2, sscanf(dump.string(), "Binder thread pool: %zu pooled threads (%zu registered)",
+                        pooled, registered)) << dump.string();
+}
+
+TEST_F(BinderLibTest, AdaptiveThreadPoolGrowsAndShrinks) {
+    const int32_t windowMs = 1000;
+    size_t pooled = 0;
+    size_t registered = 0;
+    Parcel data, reply;
+    sp<IBinder> server = addServer();
+    ASSERT_TRUE(server != NULL);
+
+    data.writeInt32(1);
+    data.writeInt32(4);
+    data.writeInt32(windowMs);
+    ASSERT_EQ(NO_ERROR, server->transact(BINDER_LIB_TEST_SET_ADAPTIVE_POOL_TRANSACTION,
+                                         data, &reply));
+
+    // Calls queue behind each other for far longer than the pool tolerates,
+    // so it grows past its minimum, but never past its maximum.
+    callConcurrently(server, BINDER_LIB_TEST_SLEEP_TRANSACTION, 100, 2, 8);
+    getPoolThreads(server, &pooled, &registered);
+    EXPECT_GT(pooled, 1u);
+    EXPECT_LE(pooled, 4u);
+    EXPECT_GE(registered, pooled);
+
+    // The window with the waits keeps the pool as it is. The quiet one
+    // after it sets the target to one thread above its peak load of one,
+    // and the surplus threads leave as they finish their next command.
+    for (int i = 0; i < 2; i++) {
+        usleep((windowMs + 100) * 1000);
+        EXPECT_EQ(NO_ERROR, server->transact(BINDER_LIB_TEST_NOP_TRANSACTION, data, &reply));
+    }
+    for (int i = 0; i < 20 && pooled > 2; i++) {
+        callConcurrently(server, BINDER_LIB_TEST_NOP_TRANSACTION, 0, 20, 4);
+        getPoolThreads(server, &pooled, &registered);
+    }
+    EXPECT_LE(pooled, 2u);
+}
+
+static const char binderLibTestStatsDescriptor[] = "test.binderLib.TransactionStats";
+
+static status_t nopWithToken(const sp<IBinder>& server, uint32_t flags = 0)
+{
+    Parcel data, reply;
+    data.writeInterfaceToken(String16(binderLibTestStatsDescriptor));
+    return server->transact(BINDER_LIB_TEST_NOP_TRANSACTION, data, &reply, flags);
+}
+
+// Returns the count on the line of a transaction stats dump for the test
+// descriptor's NOP transactions in the given direction, or 0 without one.
+static uint64_t nopStatsCount(const String8& dump, const char *direction)
+{
+    String8 prefix = String8::format("  %-3s %s #%u: count=", direction,
+                                     binderLibTestStatsDescriptor,
+                                     BINDER_LIB_TEST_NOP_TRANSACTION);
+    const char *line = strstr(dump.string(), prefix.string());
+    uint64_t count;
+    if (line == NULL || sscanf(line + prefix.size(), "%" SCNu64, &count) != 1) {
+        return 0;
+    }
+    // The rest of the line holds the latencies.
+    const char *end = strchr(line, '\n');
+    String8 rest(line, end ? end - line : strlen(line));
+    EXPECT_TRUE(strstr(rest.string(), " avg=") != NULL) << rest.string();
+    EXPECT_TRUE(strstr(rest.string(), " p99<") != NULL) << rest.string();
+    return count;
+}
+
+static uint64_t outgoingNopStatsCount()
+{
+    String8 dump;
+    ProcessState::self()->dumpTransactionStats(dump);
+    return nopStatsCount(dump, "out");
+}
+
+TEST_F(BinderLibTest, TransactionStatsCountOutgoing) {
+    String8 dump;
+
+    ProcessState::self()->setTransactionStatsEnabled(false);
+    ProcessState::self()->dumpTransactionStats(dump);
+    EXPECT_TRUE(strstr(dump.string(), "recording off") != NULL) << dump.string();
+    uint64_t count = outgoingNopStatsCount();
+    EXPECT_EQ(NO_ERROR, nopWithToken(m_server));
+    EXPECT_EQ(count, outgoingNopStatsCount());
+
+    ProcessState::self()->setTransactionStatsEnabled(true);
+    for (int i = 0; i < 5; i++) {
+        EXPECT_EQ(NO_ERROR, nopWithToken(m_server));
+    }
+    EXPECT_EQ(count + 5, outgoingNopStatsCount());
+
+    // Batched one-way calls are counted when they are queued.
+    {
+        IPCThreadState::BatchScope batch;
+        for (int i = 0; i < 3; i++) {
+            EXPECT_EQ(NO_ERROR, nopWithToken(m_server, TF_ONE_WAY));
+        }
+        EXPECT_EQ(count + 8, outgoingNopStatsCount());
+        EXPECT_EQ(NO_ERROR, batch.flush());
+    }
+    EXPECT_EQ(count + 8, outgoingNopStatsCount());
+
+    ProcessState::self()->setTransactionStatsEnabled(false);
+    EXPECT_EQ(NO_ERROR, nopWithToken(m_server));
+    EXPECT_EQ(count + 8, outgoingNopStatsCount());
+}
+
+TEST_F(BinderLibTest, TransactionStatsCountIncoming) {
+    Parcel data, reply;
+    sp<IBinder> server = addServer();
+    ASSERT_TRUE(server != NULL);
+
+    data.writeInt32(1);
+    ASSERT_EQ(NO_ERROR, server->transact(BINDER_LIB_TEST_TRANSACTION_STATS_TRANSACTION,
+                                         data, &reply));
+    EXPECT_EQ(0u, nopStatsCount(reply.readString8(), "in"));
+
+    for (int i = 0; i < 4; i++) {
+        EXPECT_EQ(NO_ERROR, nopWithToken(server));
+    }
+    reply.freeData();
+    ASSERT_EQ(NO_ERROR, server->transact(BINDER_LIB_TEST_TRANSACTION_STATS_TRANSACTION,
+                                         data, &reply));
+    EXPECT_EQ(4u, nopStatsCount(reply.readString8(), "in"));
+}
+
 class BinderLibTestService : public BBinder
 {
     public:
@@ -812,6 +1116,53 @@ class BinderLibTestService : public BBinder
                 return NO_ERROR;
             case BINDER_LIB_TEST_GET_STATUS_TRANSACTION:
                 return NO_ERROR;
+            case BINDER_LIB_TEST_ECHO_BINDERS_AND_BYTES_TRANSACTION: {
+                sp<IBinder> before;
+                sp<IBinder> after;
+                std::vector<uint8_t> bytes;
+
+                before = data.readStrongBinder();
+                if (before == NULL) {
+                    return BAD_VALUE;
+                }
+                if (data.readByteVector(&bytes) != NO_ERROR) {
+                    return BAD_VALUE;
+                }
+                after = data.readStrongBinder();
+                if (after == NULL) {
+                    return BAD_VALUE;
+                }
+                reply->writeStrongBinder(before);
+                reply->writeByteVector(bytes);
+                reply->writeStrongBinder(after);
+                return NO_ERROR;
+            }
+            case BINDER_LIB_TEST_SET_ADAPTIVE_POOL_TRANSACTION: {
+                int32_t minThreads = data.readInt32();
+                int32_t maxThreads = data.readInt32();
+                int32_t windowMs = data.readInt32();
+                if (minThreads < 0 || maxThreads < 0) {
+                    return BAD_VALUE;
+                }
+                return ProcessState::self()->setThreadPoolAdaptive(minThreads, maxThreads,
+                                                                   ms2ns(windowMs));
+            }
+            case BINDER_LIB_TEST_SLEEP_TRANSACTION:
+                usleep(data.readInt32() * 1000);
+                return NO_ERROR;
+            case BINDER_LIB_TEST_DUMP_THREAD_POOL_TRANSACTION: {
+                String8 dump;
+                ProcessState::self()->dumpThreadPool(dump);
+                reply->writeString8(dump);
+                return NO_ERROR;
+            }
+            case BINDER_LIB_TEST_TRANSACTION_STATS_TRANSACTION: {
+                String8 dump;
+                ProcessState::self()->setTransactionStatsEnabled(data.readInt32() != 0);
+                ProcessState::self()->dumpTransactionStats(dump);
+                reply->writeString8(dump);
+                return NO_ERROR;
+            }
             case BINDER_LIB_TEST_ADD_STRONG_REF_TRANSACTION:
                 m_strongRef = data.readStrongBinder();
                 return NO_ERROR;
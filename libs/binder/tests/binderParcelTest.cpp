@@ -0,0 +1,143 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Checks the per-thread pools Parcel keeps its small data buffers in. Each
+// test runs on threads of its own, which start out without a pool.
+
+#include <binder/Parcel.h>
+
+#include <gtest/gtest.h>
+
+#include <thread>
+
+using namespace android;
+
+// The pool size classes and how many buffers each keeps, as in Parcel.cpp.
+static const size_t kPoolClasses[] = { 128, 256, 512, 1024, 2048, 4096 };
+static const size_t kPoolBuffersPerClass = 4;
+
+static void allocAndFree(size_t capacity)
+{
+    Parcel parcel;
+    ASSERT_EQ(NO_ERROR, parcel.setDataCapacity(capacity));
+}
+
+TEST(ParcelBufferPool, HitsAndMissesPerSizeClass) {
+    std::thread([] {
+        for (size_t capacity : kPoolClasses) {
+            size_t hits = Parcel::getGlobalPoolHitCount();
+            size_t misses = Parcel::getGlobalPoolMissCount();
+            const size_t pooled = Parcel::getGlobalPooledSize();
+
+            // Buffers of the smaller classes pooled so far don't serve this
+            // one; the buffer is kept once freed.
+            allocAndFree(capacity);
+            EXPECT_EQ(hits, Parcel::getGlobalPoolHitCount());
+            EXPECT_EQ(misses + 1, Parcel::getGlobalPoolMissCount());
+            EXPECT_EQ(pooled + capacity, Parcel::getGlobalPooledSize());
+
+            // Any size rounding up to the class reuses it.
+            allocAndFree(capacity / 2 + 1);
+            EXPECT_EQ(hits + 1, Parcel::getGlobalPoolHitCount());
+            EXPECT_EQ(misses + 1, Parcel::getGlobalPoolMissCount());
+            EXPECT_EQ(pooled + capacity, Parcel::getGlobalPooledSize());
+        }
+    }).join();
+}
+
+TEST(ParcelBufferPool, KeepsBoundedBuffersPerClass) {
+    std::thread([] {
+        const size_t capacity = kPoolClasses[0];
+        const size_t pooled = Parcel::getGlobalPooledSize();
+        {
+            Parcel parcels[kPoolBuffersPerClass + 2];
+            for (Parcel& parcel : parcels) {
+                ASSERT_EQ(NO_ERROR, parcel.setDataCapacity(capacity));
+            }
+        }
+        EXPECT_EQ(pooled + kPoolBuffersPerClass * capacity, Parcel::getGlobalPooledSize());
+
+        const size_t hits = Parcel::getGlobalPoolHitCount();
+        const size_t misses = Parcel::getGlobalPoolMissCount();
+        {
+            Parcel parcels[kPoolBuffersPerClass + 1];
+            for (Parcel& parcel : parcels) {
+                ASSERT_EQ(NO_ERROR, parcel.setDataCapacity(capacity));
+            }
+        }
+        EXPECT_EQ(hits + kPoolBuffersPerClass, Parcel::getGlobalPoolHitCount());
+        EXPECT_EQ(misses + 1, Parcel::getGlobalPoolMissCount());
+    }).join();
+}
+
+TEST(ParcelBufferPool, OversizedBuffersBypassPool) {
+    std::thread([] {
+        const size_t capacity = kPoolClasses[sizeof(kPoolClasses) / sizeof(kPoolClasses[0]) - 1];
+        const size_t hits = Parcel::getGlobalPoolHitCount();
+        const size_t misses = Parcel::getGlobalPoolMissCount();
+        const size_t pooled = Parcel::getGlobalPooledSize();
+
+        allocAndFree(capacity + 1);
+        allocAndFree(capacity + 1);
+        allocAndFree(64 * 1024);
+        EXPECT_EQ(hits, Parcel::getGlobalPoolHitCount());
+        EXPECT_EQ(misses, Parcel::getGlobalPoolMissCount());
+        EXPECT_EQ(pooled, Parcel::getGlobalPooledSize());
+    }).join();
+}
+
+TEST(ParcelBufferPool, FreedOnAnotherThread) {
+    const size_t capacity = kPoolClasses[2];
+    const size_t pooled = Parcel::getGlobalPooledSize();
+
+    // A thread without a pool of its own hands the buffer back to the heap
+    // rather than creating a pool for it.
+    Parcel* parcel = NULL;
+    std::thread([&] {
+        parcel = new Parcel();
+        ASSERT_EQ(NO_ERROR, parcel->setDataCapacity(capacity));
+    }).join();
+    ASSERT_TRUE(parcel != NULL);
+    std::thread([&] {
+        delete parcel;
+        EXPECT_EQ(pooled, Parcel::getGlobalPooledSize());
+
+        // Allocating creates the pool, empty.
+        const size_t misses = Parcel::getGlobalPoolMissCount();
+        allocAndFree(capacity);
+        EXPECT_EQ(misses + 1, Parcel::getGlobalPoolMissCount());
+    }).join();
+    // The pool went away with its thread.
+    EXPECT_EQ(pooled, Parcel::getGlobalPooledSize());
+
+    // A thread with a pool keeps buffers other threads allocated, and serves
+    // its own allocations from them.
+    std::thread([&] {
+        parcel = new Parcel();
+        ASSERT_EQ(NO_ERROR, parcel->setDataCapacity(capacity));
+    }).join();
+    std::thread([&] {
+        allocAndFree(kPoolClasses[0]);
+        const size_t pooledHere = Parcel::getGlobalPooledSize();
+        delete parcel;
+        EXPECT_EQ(pooledHere + capacity, Parcel::getGlobalPooledSize());
+
+        const size_t hits = Parcel::getGlobalPoolHitCount();
+        allocAndFree(capacity);
+        EXPECT_EQ(hits + 1, Parcel::getGlobalPoolHitCount());
+    }).join();
+    EXPECT_EQ(pooled, Parcel::getGlobalPooledSize());
+}
@@ -6,6 +6,8 @@
 #include <cstring>
 #include <cstdlib>
 #include <cstdio>
+#include <cerrno>
+#include <cstdint>
 
 #include <iostream>
 #include <vector>
@@ -170,6 +172,9 @@ void worker_fx(
     int num,
     int worker_count,
     int iterations,
+    size_t payload_size,
+    bool external,
+    int batch,
     Pipe p)
 {
     // Create BinderWorkerService and for go.
@@ -194,12 +199,32 @@ void worker_fx(
 
     // Run the benchmark.
     ProcResults results;
+    vector<uint8_t> payload(payload_size, uint8_t(num));
     chrono::time_point<chrono::high_resolution_clock> start, end;
-    for (int i = 0; i < iterations; i++) {
+    for (int i = 0; i < iterations; i += max(batch, 1)) {
         int target = rand() % workers.size();
         Parcel data, reply;
         start = chrono::high_resolution_clock::now();
-        status_t ret = workers[target]->transact(BINDER_NOP, data, &reply);
+        if (payload_size) {
+            if (external) {
+                data.writeByteVectorExternal(payload);
+            } else {
+                data.writeByteVector(payload);
+            }
+        }
+        status_t ret;
+        if (batch == 0) {
+            ret = workers[target]->transact(BINDER_NOP, data, &reply);
+        } else if (batch == 1) {
+            ret = workers[target]->transact(BINDER_NOP, data, NULL, IBinder::FLAG_ONEWAY);
+        } else {
+            // Each sample is one batch of oneway transactions.
+            IPCThreadState::BatchScope scope;
+            for (int j = 0; j < batch; j++) {
+                workers[target]->transact(BINDER_NOP, data, NULL, IBinder::FLAG_ONEWAY);
+            }
+            ret = scope.flush();
+        }
         end = chrono::high_resolution_clock::now();
 
         uint64_t cur_time = uint64_t(chrono::duration_cast<chrono::nanoseconds>(end - start).count());
@@ -221,7 +246,8 @@ void worker_fx(
     exit(EXIT_SUCCESS);
 }
 
-Pipe make_worker(int num, int iterations, int worker_count)
+Pipe make_worker(int num, int iterations, int worker_count,
+                 size_t payload_size, bool external, int batch)
 {
     auto pipe_pair = Pipe::createPipePair();
     pid_t pid = fork();
@@ -230,7 +256,8 @@ Pipe make_worker(int num, int iterations, int worker_count)
         return move(get<0>(pipe_pair));
     } else {
         /* child */
-        worker_fx(num, worker_count, iterations, move(get<1>(pipe_pair)));
+        worker_fx(num, worker_count, iterations, payload_size, external, batch,
+                  move(get<1>(pipe_pair)));
         /* never get here */
         return move(get<0>(pipe_pair));
     }
@@ -255,6 +282,9 @@ int main(int argc, char *argv[])
 {
     int workers = 2;
     int iterations = 10000;
+    size_t payload_size = 0;
+    bool external = false;
+    int batch = 0;
     (void)argc;
     (void)argv;
     vector<Pipe> pipes;
@@ -271,11 +301,51 @@ int main(int argc, char *argv[])
             i++;
             continue;
         }
+        // Size in bytes of a byte vector sent with every transaction.
+        // Byte vectors are limited to INT32_MAX bytes.
+        if (string(argv[i]) == "-s") {
+            char *end = NULL;
+            unsigned long size = 0;
+            errno = 0;
+            if (i + 1 < argc) {
+                size = strtoul(argv[i+1], &end, 10);
+            }
+            if (end == NULL || end == argv[i+1] || *end != '\0' ||
+                    errno == ERANGE || size > INT32_MAX) {
+                cerr << "-s takes a payload size from 0 to " << INT32_MAX
+                     << " bytes" << endl;
+                return EXIT_FAILURE;
+            }
+            payload_size = size;
+            i++;
+            continue;
+        }
+        // Write the payload with Parcel::writeByteVectorExternal(), which
+        // copies it once when the transaction is sent, instead of
+        // writeByteVector(). Run with and without to compare.
+        if (string(argv[i]) == "-x") {
+            external = true;
+            continue;
+        }
+        // Send oneway transactions, grouped in IPCThreadState::BatchScopes
+        // of the given size (1: no batching).
+        if (string(argv[i]) == "-b") {
+            batch = max(atoi(argv[i+1]), 1);
+            i++;
+            continue;
+        }
+    }
+    if (batch) {
+        cout << "oneway, batches of " << batch << endl;
+    }
+    if (payload_size) {
+        cout << "payload: " << payload_size << " bytes, "
+             << (external ? "external" : "copied") << endl;
     }
 
     // Create all the workers and wait for them to spawn.
     for (int i = 0; i < workers; i++) {
-        pipes.push_back(make_worker(i, iterations, workers));
+        pipes.push_back(make_worker(i, iterations, workers, payload_size, external, batch));
     }
     wait_all(pipes);
 
@@ -43,6 +43,7 @@ LOCAL_SRC_FILES := \
 	IConsumerListener.cpp \
 	BitTube.cpp \
 	BufferItem.cpp \
+	BufferItemFifo.cpp \
 	BufferItemConsumer.cpp \
 	BufferQueue.cpp \
 	BufferQueueConsumer.cpp \
@@ -54,6 +55,7 @@ LOCAL_SRC_FILES := \
 	DisplayEventReceiver.cpp \
 	GLConsumer.cpp \
 	GraphicBufferAlloc.cpp \
+	GraphicBufferPool.cpp \
 	GraphicsEnv.cpp \
 	GuiConfig.cpp \
 	IDisplayEventConnection.cpp \
@@ -64,8 +66,10 @@ LOCAL_SRC_FILES := \
 	ISensorServer.cpp \
 	ISurfaceComposer.cpp \
 	ISurfaceComposerClient.cpp \
+	LatencyHistogram.cpp \
 	LayerState.cpp \
 	OccupancyTracker.cpp \
+	PixelConverter.cpp \
 	Sensor.cpp \
 	SensorEventQueue.cpp \
 	SensorManager.cpp \
@@ -40,7 +40,9 @@ BufferItem::BufferItem() :
     mSurfaceDamage(),
     mAutoRefresh(false),
     mQueuedBuffer(true),
-    mIsStale(false) {
+    mIsStale(false),
+    mDequeueTime(0),
+    mQueueTime(0) {
 }
 
 BufferItem::~BufferItem() {}
@@ -66,6 +68,10 @@ size_t BufferItem::getPodSize() const {
     addAligned(size, mIsDroppable);
     addAligned(size, mAcquireCalled);
     addAligned(size, mTransformToDisplayInverse);
+    addAligned(size, mDequeueTimeLo);
+    addAligned(size, mDequeueTimeHi);
+    addAligned(size, mQueueTimeLo);
+    addAligned(size, mQueueTimeHi);
     return size;
 }
 
@@ -151,6 +157,10 @@ status_t BufferItem::flatten(
     writeAligned(buffer, size, mIsDroppable);
     writeAligned(buffer, size, mAcquireCalled);
     writeAligned(buffer, size, mTransformToDisplayInverse);
+    writeAligned(buffer, size, mDequeueTimeLo);
+    writeAligned(buffer, size, mDequeueTimeHi);
+    writeAligned(buffer, size, mQueueTimeLo);
+    writeAligned(buffer, size, mQueueTimeHi);
 
     return NO_ERROR;
 }
@@ -207,6 +217,10 @@ status_t BufferItem::unflatten(
     readAligned(buffer, size, mIsDroppable);
     readAligned(buffer, size, mAcquireCalled);
     readAligned(buffer, size, mTransformToDisplayInverse);
+    readAligned(buffer, size, mDequeueTimeLo);
+    readAligned(buffer, size, mDequeueTimeHi);
+    readAligned(buffer, size, mQueueTimeLo);
+    readAligned(buffer, size, mQueueTimeHi);
 
     return NO_ERROR;
 }
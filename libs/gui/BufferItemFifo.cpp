@@ -0,0 +1,86 @@
+/*
+ * Copyright 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gui/BufferItemFifo.h>
+
+namespace android {
+
+// Enough for the usual double and triple buffering without growing.
+static const uint32_t INITIAL_CAPACITY = 4;
+
+BufferItemFifo::BufferItemFifo() :
+    mItems(new BufferItem[INITIAL_CAPACITY]),
+    mCapacity(INITIAL_CAPACITY),
+    mHead(0),
+    mTail(0) {}
+
+BufferItemFifo::~BufferItemFifo() {
+    delete[] mItems;
+}
+
+void BufferItemFifo::push_back(const BufferItem& item) {
+    const uint32_t tailPosition = tail();
+    if (tailPosition - head() == mCapacity) {
+        grow();
+    }
+    itemAtPosition(tailPosition) = item;
+    mTail.store(tailPosition + 1, std::memory_order_release);
+}
+
+BufferItemFifo::iterator BufferItemFifo::erase(const iterator& position) {
+    const uint32_t headPosition = head();
+    const uint32_t tailPosition = tail();
+    const uint32_t p = position.mPosition;
+    if (p == tailPosition) {
+        return end();
+    }
+    if (p == headPosition) {
+        // Drop the references held by the item now rather than when the
+        // storage is reused.
+        itemAtPosition(p) = BufferItem();
+        mHead.store(headPosition + 1, std::memory_order_release);
+        return iterator(this, headPosition + 1);
+    }
+    for (uint32_t i = p; i + 1 != tailPosition; ++i) {
+        itemAtPosition(i) = itemAtPosition(i + 1);
+    }
+    itemAtPosition(tailPosition - 1) = BufferItem();
+    mTail.store(tailPosition - 1, std::memory_order_release);
+    return iterator(this, p);
+}
+
+void BufferItemFifo::clear() {
+    const uint32_t tailPosition = tail();
+    for (uint32_t i = head(); i != tailPosition; ++i) {
+        itemAtPosition(i) = BufferItem();
+    }
+    mHead.store(tailPosition, std::memory_order_release);
+}
+
+void BufferItemFifo::grow() {
+    // Items keep their positions, so the head and tail (which may be read
+    // without the lock) don't change.
+    const uint32_t capacity = mCapacity * 2;
+    BufferItem* items = new BufferItem[capacity];
+    for (uint32_t i = head(); i != tail(); ++i) {
+        items[i & (capacity - 1)] = itemAtPosition(i);
+    }
+    delete[] mItems;
+    mItems = items;
+    mCapacity = capacity;
+}
+
+} // namespace android
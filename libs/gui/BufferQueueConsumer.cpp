@@ -49,6 +49,13 @@ status_t BufferQueueConsumer::acquireBuffer(BufferItem* outBuffer,
         nsecs_t expectedPresent, uint64_t maxFrameNumber) {
     ATRACE_CALL();
 
+    // A consumer polling an empty queue shouldn't hold up its producer. Note
+    // that this reports NO_BUFFER_AVAILABLE even if the acquired buffer count
+    // check below would have failed.
+    if (mCore->mConsumerCanPollWithoutLock && mCore->mQueue.empty()) {
+        return NO_BUFFER_AVAILABLE;
+    }
+
     int numDroppedBuffers = 0;
     sp<IProducerListener> listener;
     {
@@ -242,6 +249,7 @@ status_t BufferQueueConsumer::acquireBuffer(BufferItem* outBuffer,
             } else {
                 mSlots[slot].mBufferState.acquire();
             }
+            mSlots[slot].mStateTime = systemTime();
             mSlots[slot].mFence = Fence::NO_FENCE;
         }
 
@@ -257,7 +265,7 @@ status_t BufferQueueConsumer::acquireBuffer(BufferItem* outBuffer,
         // We might have freed a slot while dropping old buffers, or the producer
         // may be blocked waiting for the number of buffers in the queue to
         // decrease.
-        mCore->mDequeueCondition.broadcast();
+        mCore->wakeDequeueWaitersLocked();
 
         ATRACE_INT(mCore->mConsumerName.string(), mCore->mQueue.size());
         mCore->mOccupancyTracker.registerOccupancyChange(mCore->mQueue.size());
@@ -304,7 +312,7 @@ status_t BufferQueueConsumer::detachBuffer(int slot) {
     mCore->mActiveBuffers.erase(slot);
     mCore->mFreeSlots.insert(slot);
     mCore->clearBufferSlotLocked(slot);
-    mCore->mDequeueCondition.broadcast();
+    mCore->wakeDequeueWaitersLocked();
     VALIDATE_CONSISTENCY();
 
     return NO_ERROR;
@@ -373,6 +381,7 @@ status_t BufferQueueConsumer::attachBuffer(int* outSlot,
 
     mSlots[*outSlot].mGraphicBuffer = buffer;
     mSlots[*outSlot].mBufferState.attachConsumer();
+    mSlots[*outSlot].mStateTime = systemTime();
     mSlots[*outSlot].mNeedsReallocation = true;
     mSlots[*outSlot].mFence = Fence::NO_FENCE;
     mSlots[*outSlot].mFrameNumber = 0;
@@ -437,6 +446,7 @@ status_t BufferQueueConsumer::releaseBuffer(int slot, uint64_t frameNumber,
         mSlots[slot].mEglFence = eglFence;
         mSlots[slot].mFence = releaseFence;
         mSlots[slot].mBufferState.release();
+        mSlots[slot].mStateTime = systemTime();
 
         // After leaving shared buffer mode, the shared buffer will
         // still be around. Mark it as no longer shared if this
@@ -448,12 +458,13 @@ status_t BufferQueueConsumer::releaseBuffer(int slot, uint64_t frameNumber,
         if (!mSlots[slot].mBufferState.isShared()) {
             mCore->mActiveBuffers.erase(slot);
             mCore->mFreeBuffers.push_back(slot);
+            mCore->schedulePreallocationLocked();
         }
 
         listener = mCore->mConnectedProducerListener;
         BQ_LOGV("releaseBuffer: releasing slot %d", slot);
 
-        mCore->mDequeueCondition.broadcast();
+        mCore->wakeDequeueWaitersLocked();
         VALIDATE_CONSISTENCY();
     } // Autolock scope
 
@@ -507,7 +518,7 @@ status_t BufferQueueConsumer::disconnect() {
     mCore->mQueue.clear();
     mCore->freeAllBuffersLocked();
     mCore->mSharedBufferSlot = BufferQueueCore::INVALID_BUFFER_SLOT;
-    mCore->mDequeueCondition.broadcast();
+    mCore->wakeDequeueWaitersLocked();
     return NO_ERROR;
 }
 
@@ -564,6 +575,7 @@ status_t BufferQueueConsumer::setDefaultBufferSize(uint32_t width,
     Mutex::Autolock lock(mCore->mMutex);
     mCore->mDefaultWidth = width;
     mCore->mDefaultHeight = height;
+    mCore->schedulePreallocationLocked();
     return NO_ERROR;
 }
 
@@ -686,6 +698,7 @@ status_t BufferQueueConsumer::setDefaultBufferFormat(PixelFormat defaultFormat)
     BQ_LOGV("setDefaultBufferFormat: %u", defaultFormat);
     Mutex::Autolock lock(mCore->mMutex);
     mCore->mDefaultBufferFormat = defaultFormat;
+    mCore->schedulePreallocationLocked();
     return NO_ERROR;
 }
 
@@ -703,6 +716,7 @@ status_t BufferQueueConsumer::setConsumerUsageBits(uint32_t usage) {
     BQ_LOGV("setConsumerUsageBits: %#x", usage);
     Mutex::Autolock lock(mCore->mMutex);
     mCore->mConsumerUsageBits = usage;
+    mCore->schedulePreallocationLocked();
     return NO_ERROR;
 }
 
@@ -732,6 +746,40 @@ status_t BufferQueueConsumer::discardFreeBuffers() {
     return NO_ERROR;
 }
 
+status_t BufferQueueConsumer::setAdaptiveQueueDepth(bool enabled) {
+    ATRACE_CALL();
+    BQ_LOGV("setAdaptiveQueueDepth: %d", enabled);
+
+    sp<IConsumerListener> listener;
+    { // Autolock scope
+        Mutex::Autolock lock(mCore->mMutex);
+        mCore->waitWhileAllocatingLocked();
+
+        if (mCore->mIsAbandoned) {
+            BQ_LOGE("setAdaptiveQueueDepth: BufferQueue has been abandoned");
+            return NO_INIT;
+        }
+
+        if (enabled == mCore->mAdaptiveDepth.enabled) {
+            return NO_ERROR;
+        }
+
+        if (!enabled && mCore->resetAdaptiveDepthLocked()) {
+            listener = mCore->mConsumerListener;
+        }
+        mCore->mAdaptiveDepth.enabled = enabled;
+        if (enabled) {
+            mCore->resetAdaptiveDepthLocked();
+        }
+    } // Autolock scope
+
+    // Call back without lock held
+    if (listener != NULL) {
+        listener->onBuffersReleased();
+    }
+    return NO_ERROR;
+}
+
 void BufferQueueConsumer::dumpState(String8& result, const char* prefix) const {
     const IPCThreadState* ipc = IPCThreadState::self();
     const pid_t pid = ipc->getCallingPid();
@@ -30,12 +30,15 @@
 
 #include <gui/BufferItem.h>
 #include <gui/BufferQueueCore.h>
+#include <gui/GraphicBufferPool.h>
 #include <gui/IConsumerListener.h>
 #include <gui/IGraphicBufferAlloc.h>
 #include <gui/IProducerListener.h>
 #include <gui/ISurfaceComposer.h>
 #include <private/gui/ComposerService.h>
 
+#include <thread>
+
 namespace android {
 
 static String8 getUniqueName() {
@@ -50,7 +53,8 @@ static uint64_t getUniqueId() {
     return id | counter++;
 }
 
-BufferQueueCore::BufferQueueCore(const sp<IGraphicBufferAlloc>& allocator) :
+BufferQueueCore::BufferQueueCore(const sp<IGraphicBufferAlloc>& allocator,
+        bool singleProducerConsumer) :
     mAllocator(allocator),
     mMutex(),
     mIsAbandoned(false),
@@ -59,6 +63,7 @@ BufferQueueCore::BufferQueueCore(const sp<IGraphicBufferAlloc>& allocator) :
     mConsumerListener(),
     mConsumerUsageBits(0),
     mConnectedApi(NO_CONNECTED_API),
+    mLastProducerUid(-1),
     mLinkedToDeath(),
     mConnectedProducerListener(),
     mSlots(),
@@ -68,6 +73,7 @@ BufferQueueCore::BufferQueueCore(const sp<IGraphicBufferAlloc>& allocator) :
     mUnusedSlots(),
     mActiveBuffers(),
     mDequeueCondition(),
+    mDequeueWaiters(0),
     mDequeueBufferCannotBlock(false),
     mDefaultBufferFormat(PIXEL_FORMAT_RGBA_8888),
     mDefaultWidth(1),
@@ -91,7 +97,11 @@ BufferQueueCore::BufferQueueCore(const sp<IGraphicBufferAlloc>& allocator) :
     mSharedBufferCache(Rect::INVALID_RECT, 0, NATIVE_WINDOW_SCALING_MODE_FREEZE,
             HAL_DATASPACE_UNKNOWN),
     mLastQueuedSlot(INVALID_BUFFER_SLOT),
-    mUniqueId(getUniqueId())
+    mUniqueId(getUniqueId()),
+    mSingleProducerConsumer(singleProducerConsumer),
+    mConsumerCanPollWithoutLock(singleProducerConsumer),
+    mPreallocation(),
+    mAdaptiveDepth()
 {
     if (allocator == NULL) {
         sp<ISurfaceComposer> composer(ComposerService::getComposerService());
@@ -111,7 +121,12 @@ BufferQueueCore::BufferQueueCore(const sp<IGraphicBufferAlloc>& allocator) :
     }
 }
 
-BufferQueueCore::~BufferQueueCore() {}
+BufferQueueCore::~BufferQueueCore() {
+    stopPreallocation();
+    for (int s : mFreeBuffers) {
+        recycleBufferLocked(s);
+    }
+}
 
 void BufferQueueCore::dumpState(String8& result, const char* prefix) const {
     Mutex::Autolock lock(mMutex);
@@ -137,27 +152,87 @@ void BufferQueueCore::dumpState(String8& result, const char* prefix) const {
             mDefaultHeight, mDefaultBufferFormat, mTransformHint, mQueue.size(),
             fifo.string());
 
+    result.appendFormat("%s-BufferQueue synchronous allocations=%" PRIu64
+            ", preallocated=%" PRIu64 " (dequeued %" PRIu64 ")\n", prefix,
+            mPreallocation.syncAllocations, mPreallocation.preallocated,
+            mPreallocation.used);
+
+    if (mAdaptiveDepth.enabled) {
+        result.appendFormat("%s-BufferQueue adaptive depth: "
+                "maxDequeued=%d (requested %d), window %zu/%d frames, "
+                "%zu stalls (%.1f ms)\n", prefix, mMaxDequeuedBufferCount,
+                mAdaptiveDepth.requestedMaxDequeued, mAdaptiveDepth.frames,
+                static_cast<int>(AdaptiveDepth::WINDOW_FRAMES),
+                mAdaptiveDepth.stalls,
+                static_cast<double>(mAdaptiveDepth.stallTime) / 1e6);
+        const nsecs_t now = systemTime();
+        const uint64_t count = mAdaptiveDepth.decisionCount;
+        const uint64_t first = count > AdaptiveDepth::HISTORY_SIZE ?
+                count - AdaptiveDepth::HISTORY_SIZE : 0;
+        for (uint64_t i = first; i < count; ++i) {
+            const AdaptiveDepth::Decision& decision(mAdaptiveDepth.history[
+                    i % AdaptiveDepth::HISTORY_SIZE]);
+            const double age = static_cast<double>(now - decision.time) / 1e9;
+            if (decision.reason == AdaptiveDepth::RESTORED) {
+                result.appendFormat("%s  %.1fs ago: restored %d -> %d\n",
+                        prefix, age, decision.from, decision.to);
+                continue;
+            }
+            result.appendFormat("%s  %.1fs ago: %s %d -> %d (%zu/%zu frames "
+                    "stalled, occupancy %.2f)\n", prefix, age,
+                    decision.reason == AdaptiveDepth::RAISED ? "raised" :
+                    "lowered", decision.from, decision.to, decision.stalls,
+                    decision.frames, static_cast<double>(decision.occupancy));
+        }
+    }
+
+    // Who holds the slots, and for how long
+    int dequeuedCount = 0;
+    int acquiredCount = 0;
+    for (int s : mActiveBuffers) {
+        if (mSlots[s].mBufferState.isDequeued()) {
+            ++dequeuedCount;
+        }
+        if (mSlots[s].mBufferState.isAcquired()) {
+            ++acquiredCount;
+        }
+    }
+    result.appendFormat("%s-BufferQueue slots: %d dequeued by pid %d, %zu "
+            "queued, %d acquired by the consumer, %zu free buffers, %zu free "
+            "slots\n", prefix, dequeuedCount, mConnectedPid, mQueue.size(),
+            acquiredCount, mFreeBuffers.size(), mFreeSlots.size());
+    mDequeueWaitHistogram.dump(result, prefix, "-BufferQueue dequeue wait");
+    mFenceWaitHistogram.dump(result, prefix, "-BufferQueue fence wait");
+    mAllocationHistogram.dump(result, prefix, "-BufferQueue allocation");
+
+    const nsecs_t now = systemTime();
     for (int s : mActiveBuffers) {
         const sp<GraphicBuffer>& buffer(mSlots[s].mGraphicBuffer);
+        const double age = mSlots[s].mStateTime > 0 ?
+                static_cast<double>(now - mSlots[s].mStateTime) / 1e6 : 0.0;
         // A dequeued buffer might be null if it's still being allocated
         if (buffer.get()) {
             result.appendFormat("%s%s[%02d:%p] state=%-8s, %p "
-                    "[%4ux%4u:%4u,%3X]\n", prefix,
+                    "[%4ux%4u:%4u,%3X] for %.1f ms\n", prefix,
                     (mSlots[s].mBufferState.isAcquired()) ? ">" : " ", s,
                     buffer.get(), mSlots[s].mBufferState.string(),
                     buffer->handle, buffer->width, buffer->height,
-                    buffer->stride, buffer->format);
+                    buffer->stride, buffer->format, age);
         } else {
-            result.appendFormat("%s [%02d:%p] state=%-8s\n", prefix, s,
-                    buffer.get(), mSlots[s].mBufferState.string());
+            result.appendFormat("%s [%02d:%p] state=%-8s for %.1f ms\n",
+                    prefix, s, buffer.get(), mSlots[s].mBufferState.string(),
+                    age);
         }
     }
     for (int s : mFreeBuffers) {
         const sp<GraphicBuffer>& buffer(mSlots[s].mGraphicBuffer);
-        result.appendFormat("%s [%02d:%p] state=%-8s, %p [%4ux%4u:%4u,%3X]\n",
-                prefix, s, buffer.get(), mSlots[s].mBufferState.string(),
-                buffer->handle, buffer->width, buffer->height, buffer->stride,
-                buffer->format);
+        const double age = mSlots[s].mStateTime > 0 ?
+                static_cast<double>(now - mSlots[s].mStateTime) / 1e6 : 0.0;
+        result.appendFormat("%s [%02d:%p] state=%-8s, %p [%4ux%4u:%4u,%3X] "
+                "for %.1f ms\n", prefix, s, buffer.get(),
+                mSlots[s].mBufferState.string(), buffer->handle,
+                buffer->width, buffer->height, buffer->stride, buffer->format,
+                age);
     }
 
     for (int s : mFreeSlots) {
@@ -208,6 +283,8 @@ void BufferQueueCore::clearBufferSlotLocked(int slot) {
     mSlots[slot].mFrameNumber = 0;
     mSlots[slot].mAcquireCalled = false;
     mSlots[slot].mNeedsReallocation = true;
+    mSlots[slot].mStateTime = 0;
+    mPreallocation.slots.erase(slot);
 
     // Destroy fence as BufferQueue now takes ownership
     if (mSlots[slot].mEglFence != EGL_NO_SYNC_KHR) {
@@ -222,13 +299,56 @@ void BufferQueueCore::clearBufferSlotLocked(int slot) {
     }
 }
 
+void BufferQueueCore::recycleBufferLocked(int slot) {
+    const BufferSlot& bufferSlot(mSlots[slot]);
+    // A pending EGL fence can't be handed over; GL may still be reading
+    if (bufferSlot.mGraphicBuffer == NULL || mLastProducerUid < 0 ||
+            bufferSlot.mEglFence != EGL_NO_SYNC_KHR) {
+        return;
+    }
+    GraphicBufferPool::getInstance().recycle(mLastProducerUid,
+            bufferSlot.mGraphicBuffer, bufferSlot.mFence);
+}
+
+sp<GraphicBuffer> BufferQueueCore::createGraphicBuffer(int32_t owner,
+        uint32_t width, uint32_t height, PixelFormat format, uint32_t usage,
+        const String8& requestorName, sp<Fence>* outFence,
+        status_t* outError) {
+    if (owner >= 0) {
+        sp<GraphicBuffer> graphicBuffer(GraphicBufferPool::getInstance().take(
+                owner, width, height, format, usage, outFence));
+        if (graphicBuffer != NULL) {
+            BQ_LOGV("createGraphicBuffer: reusing a pooled buffer");
+            *outError = NO_ERROR;
+            return graphicBuffer;
+        }
+    }
+    *outFence = Fence::NO_FENCE;
+    const nsecs_t startTime = systemTime();
+    sp<GraphicBuffer> graphicBuffer(mAllocator->createGraphicBuffer(width,
+            height, format, usage,
+            {requestorName.string(), requestorName.size()}, outError));
+    mAllocationHistogram.add(systemTime() - startTime);
+    return graphicBuffer;
+}
+
 void BufferQueueCore::freeAllBuffersLocked() {
+    // Buffers being preallocated must not be installed after this, and an
+    // abandoned queue doesn't need the worker any more
+    ++mPreallocation.generation;
+    mPreallocation.pending = false;
+    if (mIsAbandoned) {
+        mPreallocation.exiting = true;
+        mPreallocation.condition.signal();
+    }
+
     for (int s : mFreeSlots) {
         clearBufferSlotLocked(s);
     }
 
     for (int s : mFreeBuffers) {
         mFreeSlots.insert(s);
+        recycleBufferLocked(s);
         clearBufferSlotLocked(s);
     }
     mFreeBuffers.clear();
@@ -249,6 +369,7 @@ void BufferQueueCore::freeAllBuffersLocked() {
 void BufferQueueCore::discardFreeBuffersLocked() {
     for (int s : mFreeBuffers) {
         mFreeSlots.insert(s);
+        recycleBufferLocked(s);
         clearBufferSlotLocked(s);
     }
     mFreeBuffers.clear();
@@ -285,6 +406,7 @@ bool BufferQueueCore::adjustAvailableSlotsLocked(int delta) {
                 mFreeSlots.erase(slot);
             } else if (!mFreeBuffers.empty()) {
                 int slot = mFreeBuffers.back();
+                recycleBufferLocked(slot);
                 clearBufferSlotLocked(slot);
                 mUnusedSlots.push_back(slot);
                 mFreeBuffers.pop_back();
@@ -304,19 +426,314 @@ void BufferQueueCore::waitWhileAllocatingLocked() const {
     }
 }
 
+void BufferQueueCore::recordDequeueLocked(uint32_t width, uint32_t height,
+        PixelFormat format, uint32_t usage) {
+    mPreallocation.hasHistory = true;
+    mPreallocation.width = width;
+    mPreallocation.height = height;
+    mPreallocation.format = format;
+    mPreallocation.usage = usage;
+}
+
+bool BufferQueueCore::getPredictedAttributesLocked(uint32_t* outWidth,
+        uint32_t* outHeight, PixelFormat* outFormat, uint32_t* outUsage) const {
+    if (!mPreallocation.hasHistory || mIsAbandoned || !mAllowAllocation ||
+            mSharedBufferMode || mAllocator == NULL ||
+            mConnectedApi == NO_CONNECTED_API) {
+        return false;
+    }
+    *outWidth = mPreallocation.width ? mPreallocation.width : mDefaultWidth;
+    *outHeight = mPreallocation.height ? mPreallocation.height : mDefaultHeight;
+    *outFormat = mPreallocation.format ?
+            mPreallocation.format : mDefaultBufferFormat;
+    *outUsage = mPreallocation.usage | mConsumerUsageBits;
+    return true;
+}
+
+size_t BufferQueueCore::getPreallocationTargetLocked(uint32_t* outWidth,
+        uint32_t* outHeight, PixelFormat* outFormat, uint32_t* outUsage) const {
+    if (!getPredictedAttributesLocked(outWidth, outHeight, outFormat,
+            outUsage)) {
+        return 0;
+    }
+
+    // Keep as many matching buffers ready as the producer recently had queued
+    // at once (at least one); the others are replaced when their turn comes.
+    size_t wanted = mOccupancyTracker.getRecentMaxOccupancy();
+    if (wanted < 1) {
+        wanted = 1;
+    }
+    size_t stale = 0;
+    for (int s : mFreeBuffers) {
+        if (mSlots[s].mGraphicBuffer->needsReallocation(*outWidth, *outHeight,
+                *outFormat, *outUsage)) {
+            ++stale;
+        } else if (wanted > 0) {
+            --wanted;
+        }
+    }
+    return stale < wanted ? stale : wanted;
+}
+
+void BufferQueueCore::schedulePreallocationLocked() {
+    uint32_t width, height, usage;
+    PixelFormat format;
+    if (mPreallocation.exiting ||
+            getPreallocationTargetLocked(&width, &height, &format, &usage) == 0) {
+        return;
+    }
+    mPreallocation.pending = true;
+    if (!mPreallocation.thread.joinable()) {
+        // The worker doesn't hold a reference; the destructor stops it
+        mPreallocation.thread = std::thread([this]() { preallocationLoop(); });
+    } else {
+        mPreallocation.condition.signal();
+    }
+}
+
+void BufferQueueCore::stopPreallocation() {
+    { // Autolock scope
+        Mutex::Autolock lock(mMutex);
+        mPreallocation.exiting = true;
+        mPreallocation.condition.signal();
+    } // Autolock scope
+    if (mPreallocation.thread.joinable()) {
+        mPreallocation.thread.join();
+    }
+}
+
+void BufferQueueCore::preallocationLoop() {
+    while (true) {
+        { // Autolock scope
+            Mutex::Autolock lock(mMutex);
+            while (!mPreallocation.pending && !mPreallocation.exiting) {
+                mPreallocation.condition.wait(mMutex);
+            }
+            if (mPreallocation.exiting) {
+                return;
+            }
+            mPreallocation.pending = false;
+        } // Autolock scope
+        preallocateBuffers();
+    }
+}
+
+void BufferQueueCore::preallocateBuffers() {
+    ATRACE_CALL();
+    while (true) {
+        uint32_t width = 0;
+        uint32_t height = 0;
+        PixelFormat format = PIXEL_FORMAT_UNKNOWN;
+        uint32_t usage = 0;
+        int32_t owner = -1;
+        uint32_t generation = 0;
+        String8 consumerName;
+        { // Autolock scope
+            Mutex::Autolock lock(mMutex);
+            waitWhileAllocatingLocked();
+            if (mPreallocation.exiting || getPreallocationTargetLocked(&width,
+                    &height, &format, &usage) == 0) {
+                return;
+            }
+            owner = mLastProducerUid;
+            generation = mPreallocation.generation;
+            consumerName = mConsumerName;
+
+            // Like allocateBuffers: nothing else touches the free slots and
+            // buffers while we allocate. dequeueBuffer waits for us, so only
+            // one buffer is allocated at a time.
+            mIsAllocating = true;
+        } // Autolock scope
+
+        status_t result = NO_ERROR;
+        sp<Fence> fence;
+        sp<GraphicBuffer> buffer(createGraphicBuffer(owner, width, height,
+                format, usage, consumerName, &fence, &result));
+
+        Mutex::Autolock lock(mMutex);
+        mIsAllocating = false;
+        mIsAllocatingCondition.broadcast();
+
+        if (result != NO_ERROR || buffer == NULL) {
+            BQ_LOGE("preallocateBuffers: failed to allocate buffer (%u x %u, "
+                    "format %d, usage %#x)", width, height, format, usage);
+            return;
+        }
+
+        // The attributes may have changed, or the buffers may have been freed,
+        // while the lock was released.
+        int found = INVALID_BUFFER_SLOT;
+        if (generation == mPreallocation.generation &&
+                getPredictedAttributesLocked(&width, &height, &format,
+                &usage) && !buffer->needsReallocation(width, height, format,
+                usage)) {
+            for (int s : mFreeBuffers) {
+                if (mSlots[s].mGraphicBuffer->needsReallocation(width, height,
+                        format, usage)) {
+                    found = s;
+                    break;
+                }
+            }
+        }
+        if (found == INVALID_BUFFER_SLOT) {
+            // Don't keep allocating if the prediction keeps changing (or the
+            // allocator doesn't give us what we ask for).
+            BQ_LOGV("preallocateBuffers: dropping unneeded buffer");
+            if (owner >= 0) {
+                GraphicBufferPool::getInstance().recycle(owner, buffer, fence);
+            }
+            return;
+        }
+
+        // The slot keeps its place in mFreeBuffers. The producer and consumer
+        // pick up the new buffer as they would after a reallocation:
+        // requestBuffer and a full BufferItem.
+        recycleBufferLocked(found);
+        clearBufferSlotLocked(found);
+        buffer->setGenerationNumber(mGenerationNumber);
+        mSlots[found].mGraphicBuffer = buffer;
+        mSlots[found].mFence = fence;
+        mPreallocation.slots.insert(found);
+        ++mPreallocation.preallocated;
+        BQ_LOGV("preallocateBuffers: replaced the buffer in slot %d", found);
+        VALIDATE_CONSISTENCY();
+    }
+}
+
+bool BufferQueueCore::updateAdaptiveDepthLocked() {
+    AdaptiveDepth& depth(mAdaptiveDepth);
+    if (!depth.enabled || mSharedBufferMode) {
+        return false;
+    }
+    if (++depth.frames < AdaptiveDepth::WINDOW_FRAMES) {
+        return false;
+    }
+
+    nsecs_t totalTime = 0;
+    nsecs_t occupancyTime = 0;
+    mOccupancyTracker.getTotals(&totalTime, &occupancyTime);
+    const nsecs_t windowTime = totalTime - depth.startTotalTime;
+    const float occupancy = windowTime > 0 ?
+            static_cast<float>(occupancyTime - depth.startOccupancyTime) /
+            static_cast<float>(windowTime) : 0.0f;
+    const size_t frames = depth.frames;
+    const size_t stalls = depth.stalls;
+    const int maxDequeued = depth.maxDequeued;
+    depth.frames = 0;
+    depth.stalls = 0;
+    depth.stallTime = 0;
+    depth.maxDequeued = 0;
+    depth.startTotalTime = totalTime;
+    depth.startOccupancyTime = occupancyTime;
+    ++depth.windowsSinceRaise;
+
+    // Slots must not be taken away while a producer is allocating
+    if (mIsAllocating) {
+        return false;
+    }
+
+    const int maxAllowed = mMaxBufferCount -
+            getMinUndequeuedBufferCountLocked();
+    const int ceiling = depth.requestedMaxDequeued + 1 < maxAllowed ?
+            depth.requestedMaxDequeued + 1 : maxAllowed;
+    if (stalls * AdaptiveDepth::STALL_RATIO >= frames &&
+            mMaxDequeuedBufferCount < ceiling) {
+        if (!setAdaptiveMaxDequeuedLocked(mMaxDequeuedBufferCount + 1,
+                AdaptiveDepth::RAISED)) {
+            return false;
+        }
+        depth.windowsSinceRaise = 0;
+    } else if (stalls == 0 && occupancy > 1.0f &&
+            mMaxDequeuedBufferCount > 1 &&
+            maxDequeued < mMaxDequeuedBufferCount &&
+            depth.windowsSinceRaise >= AdaptiveDepth::LOWER_COOLDOWN_WINDOWS) {
+        if (!setAdaptiveMaxDequeuedLocked(mMaxDequeuedBufferCount - 1,
+                AdaptiveDepth::LOWERED)) {
+            return false;
+        }
+    } else {
+        return false;
+    }
+
+    AdaptiveDepth::Decision& decision(depth.history[
+            (depth.decisionCount - 1) % AdaptiveDepth::HISTORY_SIZE]);
+    decision.stalls = stalls;
+    decision.frames = frames;
+    decision.occupancy = occupancy;
+    return decision.reason == AdaptiveDepth::LOWERED;
+}
+
+bool BufferQueueCore::resetAdaptiveDepthLocked() {
+    AdaptiveDepth& depth(mAdaptiveDepth);
+    const int delta = depth.requestedMaxDequeued - mMaxDequeuedBufferCount;
+    bool released = false;
+    if (delta != 0 && !mIsAllocating &&
+            setAdaptiveMaxDequeuedLocked(depth.requestedMaxDequeued,
+            AdaptiveDepth::RESTORED)) {
+        released = delta < 0;
+    }
+    depth.frames = 0;
+    depth.stalls = 0;
+    depth.stallTime = 0;
+    depth.maxDequeued = 0;
+    mOccupancyTracker.getTotals(&depth.startTotalTime,
+            &depth.startOccupancyTime);
+    return released;
+}
+
+bool BufferQueueCore::setAdaptiveMaxDequeuedLocked(int maxDequeued,
+        int reason) {
+    const int from = mMaxDequeuedBufferCount;
+    // The consumer may have taken more buffers since the count was lowered
+    if (maxDequeued + getMinUndequeuedBufferCountLocked() > mMaxBufferCount ||
+            !adjustAvailableSlotsLocked(maxDequeued - from)) {
+        BQ_LOGV("setAdaptiveMaxDequeuedLocked: can't change %d to %d", from,
+                maxDequeued);
+        return false;
+    }
+    mMaxDequeuedBufferCount = maxDequeued;
+    wakeDequeueWaitersLocked();
+    BQ_LOGV("adaptive depth: maxDequeued %d -> %d", from, maxDequeued);
+
+    AdaptiveDepth& depth(mAdaptiveDepth);
+    AdaptiveDepth::Decision& decision(depth.history[
+            depth.decisionCount % AdaptiveDepth::HISTORY_SIZE]);
+    decision = AdaptiveDepth::Decision();
+    decision.time = systemTime();
+    decision.reason = reason;
+    decision.from = from;
+    decision.to = maxDequeued;
+    ++depth.decisionCount;
+    return true;
+}
+
+status_t BufferQueueCore::waitForDequeueConditionLocked(nsecs_t timeout) {
+    ++mDequeueWaiters;
+    status_t result = timeout >= 0 ?
+            mDequeueCondition.waitRelative(mMutex, timeout) :
+            mDequeueCondition.wait(mMutex);
+    --mDequeueWaiters;
+    return result;
+}
+
+void BufferQueueCore::wakeDequeueWaitersLocked() {
+    // Waiters register under mMutex before waiting, so none can be missed.
+    if (mDequeueWaiters == 1) {
+        mDequeueCondition.signal();
+    } else if (mDequeueWaiters > 1) {
+        mDequeueCondition.broadcast();
+    }
+}
+
 #if DEBUG_ONLY_CODE
 void BufferQueueCore::validateConsistencyLocked() const {
     static const useconds_t PAUSE_TIME = 0;
     int allocatedSlots = 0;
     for (int slot = 0; slot < BufferQueueDefs::NUM_BUFFER_SLOTS; ++slot) {
         bool isInFreeSlots = mFreeSlots.count(slot) != 0;
-        bool isInFreeBuffers =
-                std::find(mFreeBuffers.cbegin(), mFreeBuffers.cend(), slot) !=
-                mFreeBuffers.cend();
+        bool isInFreeBuffers = mFreeBuffers.count(slot) != 0;
         bool isInActiveBuffers = mActiveBuffers.count(slot) != 0;
-        bool isInUnusedSlots =
-                std::find(mUnusedSlots.cbegin(), mUnusedSlots.cend(), slot) !=
-                mUnusedSlots.cend();
+        bool isInUnusedSlots = mUnusedSlots.count(slot) != 0;
 
         if (isInFreeSlots || isInFreeBuffers || isInActiveBuffers) {
             allocatedSlots++;
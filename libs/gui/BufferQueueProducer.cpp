@@ -104,6 +104,7 @@ status_t BufferQueueProducer::setMaxDequeuedBufferCount(
         }
 
         if (maxDequeuedBuffers == mCore->mMaxDequeuedBufferCount) {
+            mCore->mAdaptiveDepth.requestedMaxDequeued = maxDequeuedBuffers;
             return NO_ERROR;
         }
 
@@ -152,11 +153,13 @@ status_t BufferQueueProducer::setMaxDequeuedBufferCount(
             return BAD_VALUE;
         }
         mCore->mMaxDequeuedBufferCount = maxDequeuedBuffers;
+        mCore->mAdaptiveDepth.requestedMaxDequeued = maxDequeuedBuffers;
+        mCore->resetAdaptiveDepthLocked();
         VALIDATE_CONSISTENCY();
         if (delta < 0) {
             listener = mCore->mConsumerListener;
         }
-        mCore->mDequeueCondition.broadcast();
+        mCore->wakeDequeueWaitersLocked();
     } // Autolock scope
 
     // Call back without lock held
@@ -208,7 +211,7 @@ status_t BufferQueueProducer::setAsyncMode(bool async) {
         }
         mCore->mAsyncMode = async;
         VALIDATE_CONSISTENCY();
-        mCore->mDequeueCondition.broadcast();
+        mCore->wakeDequeueWaitersLocked();
         if (delta < 0) {
             listener = mCore->mConsumerListener;
         }
@@ -244,6 +247,7 @@ status_t BufferQueueProducer::waitForFreeSlotThenRelock(FreeSlotCaller caller,
     auto callerString = (caller == FreeSlotCaller::Dequeue) ?
             "dequeueBuffer" : "attachBuffer";
     bool tryAgain = true;
+    bool stalled = false;
     while (tryAgain) {
         if (mCore->mIsAbandoned) {
             BQ_LOGE("%s: BufferQueue has been abandoned", callerString);
@@ -261,6 +265,18 @@ status_t BufferQueueProducer::waitForFreeSlotThenRelock(FreeSlotCaller caller,
             }
         }
 
+        // If adaptive queue depth lowered mMaxDequeuedBufferCount, the
+        // producer may still dequeue as many buffers as it asked for
+        BufferQueueCore::AdaptiveDepth& adaptiveDepth(mCore->mAdaptiveDepth);
+        if (adaptiveDepth.enabled &&
+                dequeuedCount >= mCore->mMaxDequeuedBufferCount &&
+                dequeuedCount < adaptiveDepth.requestedMaxDequeued &&
+                !mCore->mIsAllocating) {
+            mCore->setAdaptiveMaxDequeuedLocked(
+                    adaptiveDepth.requestedMaxDequeued,
+                    BufferQueueCore::AdaptiveDepth::RESTORED);
+        }
+
         // Producers are not allowed to dequeue more than
         // mMaxDequeuedBufferCount buffers.
         // This check is only done if a buffer has already been queued
@@ -326,15 +342,26 @@ status_t BufferQueueProducer::waitForFreeSlotThenRelock(FreeSlotCaller caller,
                     (acquiredCount <= mCore->mMaxAcquiredBufferCount)) {
                 return WOULD_BLOCK;
             }
-            if (mDequeueTimeout >= 0) {
-                status_t result = mCore->mDequeueCondition.waitRelative(
-                        mCore->mMutex, mDequeueTimeout);
-                if (result == TIMED_OUT) {
-                    return result;
-                }
-            } else {
-                mCore->mDequeueCondition.wait(mCore->mMutex);
+
+            // Blocking while nothing is queued means the consumer holds all
+            // the other buffers, which a deeper queue would have avoided
+            const bool stall = caller == FreeSlotCaller::Dequeue &&
+                    !tooManyBuffers && mCore->mQueue.empty();
+            if (stall && !stalled) {
+                stalled = true;
+                ++adaptiveDepth.stalls;
+            }
+            const nsecs_t waitStart = stall ? systemTime() : 0;
+            status_t result = mCore->waitForDequeueConditionLocked(
+                    mDequeueTimeout);
+            if (stall) {
+                adaptiveDepth.stallTime += systemTime() - waitStart;
             }
+            if (result == TIMED_OUT) {
+                return result;
+            }
+        } else if (dequeuedCount + 1 > adaptiveDepth.maxDequeued) {
+            adaptiveDepth.maxDequeued = dequeuedCount + 1;
         }
     } // while (tryAgain)
 
@@ -372,10 +399,13 @@ status_t BufferQueueProducer::dequeueBuffer(int *outSlot,
     EGLDisplay eglDisplay = EGL_NO_DISPLAY;
     EGLSyncKHR eglFence = EGL_NO_SYNC_KHR;
     bool attachedByConsumer = false;
+    int32_t poolOwner = -1;
 
     { // Autolock scope
         Mutex::Autolock lock(mCore->mMutex);
+        const nsecs_t waitStart = systemTime();
         mCore->waitWhileAllocatingLocked();
+        mCore->recordDequeueLocked(width, height, format, usage);
 
         if (format == 0) {
             format = mCore->mDefaultBufferFormat;
@@ -395,6 +425,9 @@ status_t BufferQueueProducer::dequeueBuffer(int *outSlot,
             status_t status = waitForFreeSlotThenRelock(FreeSlotCaller::Dequeue,
                     &found);
             if (status != NO_ERROR) {
+                if (status == TIMED_OUT) {
+                    mCore->mDequeueWaitHistogram.add(systemTime() - waitStart);
+                }
                 return status;
             }
 
@@ -418,6 +451,7 @@ status_t BufferQueueProducer::dequeueBuffer(int *outSlot,
                         return BAD_VALUE;
                     }
                     mCore->mFreeSlots.insert(found);
+                    mCore->recycleBufferLocked(found);
                     mCore->clearBufferSlotLocked(found);
                     found = BufferItem::INVALID_BUFFER_SLOT;
                     continue;
@@ -425,6 +459,8 @@ status_t BufferQueueProducer::dequeueBuffer(int *outSlot,
             }
         }
 
+        mCore->mDequeueWaitHistogram.add(systemTime() - waitStart);
+
         const sp<GraphicBuffer>& buffer(mSlots[found].mGraphicBuffer);
         if (mCore->mSharedBufferSlot == found &&
                 buffer->needsReallocation(width,  height, format, usage)) {
@@ -444,10 +480,17 @@ status_t BufferQueueProducer::dequeueBuffer(int *outSlot,
         mSlots[found].mNeedsReallocation = false;
 
         mSlots[found].mBufferState.dequeue();
+        mSlots[found].mDequeueTime = systemTime();
+        mSlots[found].mStateTime = mSlots[found].mDequeueTime;
+
+        const bool preallocated = mCore->mPreallocation.slots.count(found) != 0;
+        mCore->mPreallocation.slots.erase(found);
 
         if ((buffer == NULL) ||
                 buffer->needsReallocation(width, height, format, usage))
         {
+            mCore->recycleBufferLocked(found);
+            poolOwner = mCore->mLastProducerUid;
             mSlots[found].mAcquireCalled = false;
             mSlots[found].mGraphicBuffer = NULL;
             mSlots[found].mRequestBufferCalled = false;
@@ -458,7 +501,11 @@ status_t BufferQueueProducer::dequeueBuffer(int *outSlot,
             mCore->mIsAllocating = true;
 
             returnFlags |= BUFFER_NEEDS_REALLOCATION;
+            ++mCore->mPreallocation.syncAllocations;
         } else {
+            if (preallocated) {
+                ++mCore->mPreallocation.used;
+            }
             // We add 1 because that will be the frame number when this buffer
             // is queued
             mCore->mBufferAge =
@@ -495,16 +542,19 @@ status_t BufferQueueProducer::dequeueBuffer(int *outSlot,
 
     if (returnFlags & BUFFER_NEEDS_REALLOCATION) {
         status_t error;
+        sp<Fence> poolFence;
         BQ_LOGV("dequeueBuffer: allocating a new buffer for slot %d", *outSlot);
-        sp<GraphicBuffer> graphicBuffer(mCore->mAllocator->createGraphicBuffer(
-                width, height, format, usage,
-                {mConsumerName.string(), mConsumerName.size()}, &error));
+        sp<GraphicBuffer> graphicBuffer(mCore->createGraphicBuffer(poolOwner,
+                width, height, format, usage, mConsumerName, &poolFence,
+                &error));
         { // Autolock scope
             Mutex::Autolock lock(mCore->mMutex);
 
             if (graphicBuffer != NULL && !mCore->mIsAbandoned) {
                 graphicBuffer->setGenerationNumber(mCore->mGenerationNumber);
                 mSlots[*outSlot].mGraphicBuffer = graphicBuffer;
+                // A recycled buffer may still be read by its last consumer
+                *outFence = poolFence;
             }
 
             mCore->mIsAllocating = false;
@@ -524,6 +574,10 @@ status_t BufferQueueProducer::dequeueBuffer(int *outSlot,
                 return NO_INIT;
             }
 
+            // The attributes probably changed; get the other free buffers
+            // replaced before they're dequeued.
+            mCore->schedulePreallocationLocked();
+
             VALIDATE_CONSISTENCY();
         } // Autolock scope
     }
@@ -533,8 +587,10 @@ status_t BufferQueueProducer::dequeueBuffer(int *outSlot,
     }
 
     if (eglFence != EGL_NO_SYNC_KHR) {
+        const nsecs_t waitStart = systemTime();
         EGLint result = eglClientWaitSyncKHR(eglDisplay, eglFence, 0,
                 1000000000);
+        mCore->mFenceWaitHistogram.add(systemTime() - waitStart);
         // If something goes wrong, log the error, but return the buffer without
         // synchronizing access to it. It's too late at this point to abort the
         // dequeue operation.
@@ -597,7 +653,7 @@ status_t BufferQueueProducer::detachBuffer(int slot) {
         mCore->mActiveBuffers.erase(slot);
         mCore->mFreeSlots.insert(slot);
         mCore->clearBufferSlotLocked(slot);
-        mCore->mDequeueCondition.broadcast();
+        mCore->wakeDequeueWaitersLocked();
         VALIDATE_CONSISTENCY();
         listener = mCore->mConsumerListener;
     }
@@ -717,6 +773,8 @@ status_t BufferQueueProducer::attachBuffer(int* outSlot,
 
     mSlots[*outSlot].mGraphicBuffer = buffer;
     mSlots[*outSlot].mBufferState.attachProducer();
+    mSlots[*outSlot].mDequeueTime = 0;
+    mSlots[*outSlot].mStateTime = systemTime();
     mSlots[*outSlot].mEglFence = EGL_NO_SYNC_KHR;
     mSlots[*outSlot].mFence = Fence::NO_FENCE;
     mSlots[*outSlot].mRequestBufferCalled = true;
@@ -762,6 +820,7 @@ status_t BufferQueueProducer::queueBuffer(int slot,
 
     sp<IConsumerListener> frameAvailableListener;
     sp<IConsumerListener> frameReplacedListener;
+    sp<IConsumerListener> buffersReleasedListener;
     int callbackTicket = 0;
     BufferItem item;
     { // Autolock scope
@@ -846,6 +905,9 @@ status_t BufferQueueProducer::queueBuffer(int slot,
         item.mSurfaceDamage = surfaceDamage;
         item.mQueuedBuffer = true;
         item.mAutoRefresh = mCore->mSharedBufferMode && mCore->mAutoRefresh;
+        item.mDequeueTime = mSlots[slot].mDequeueTime;
+        item.mQueueTime = systemTime();
+        mSlots[slot].mStateTime = item.mQueueTime;
 
         mStickyTransform = stickyTransform;
 
@@ -897,7 +959,7 @@ status_t BufferQueueProducer::queueBuffer(int slot,
         }
 
         mCore->mBufferHasBeenQueued = true;
-        mCore->mDequeueCondition.broadcast();
+        mCore->wakeDequeueWaitersLocked();
         mCore->mLastQueuedSlot = slot;
 
         output->inflate(mCore->mDefaultWidth, mCore->mDefaultHeight,
@@ -907,6 +969,9 @@ status_t BufferQueueProducer::queueBuffer(int slot,
 
         ATRACE_INT(mCore->mConsumerName.string(), mCore->mQueue.size());
         mCore->mOccupancyTracker.registerOccupancyChange(mCore->mQueue.size());
+        if (mCore->updateAdaptiveDepthLocked()) {
+            buffersReleasedListener = mCore->mConsumerListener;
+        }
 
         // Take a ticket for the callback functions
         callbackTicket = mNextCallbackTicket++;
@@ -937,12 +1002,18 @@ status_t BufferQueueProducer::queueBuffer(int slot,
         mCallbackCondition.broadcast();
     }
 
+    if (buffersReleasedListener != NULL) {
+        buffersReleasedListener->onBuffersReleased();
+    }
+
     // Wait without lock held
     if (mCore->mConnectedApi == NATIVE_WINDOW_API_EGL) {
         // Waiting here allows for two full buffers to be queued but not a
         // third. In the event that frames take varying time, this makes a
         // small trade-off in favor of latency rather than throughput.
+        const nsecs_t waitStart = systemTime();
         mLastQueueBufferFence->waitForever("Throttling EGL Production");
+        mCore->mFenceWaitHistogram.add(systemTime() - waitStart);
     }
     mLastQueueBufferFence = fence;
     mLastQueuedCrop = item.mCrop;
@@ -985,6 +1056,7 @@ status_t BufferQueueProducer::cancelBuffer(int slot, const sp<Fence>& fence) {
     }
 
     mSlots[slot].mBufferState.cancel();
+    mSlots[slot].mStateTime = systemTime();
 
     // After leaving shared buffer mode, the shared buffer will still be around.
     // Mark it as no longer shared if this operation causes it to be free.
@@ -999,7 +1071,7 @@ status_t BufferQueueProducer::cancelBuffer(int slot, const sp<Fence>& fence) {
     }
 
     mSlots[slot].mFence = fence;
-    mCore->mDequeueCondition.broadcast();
+    mCore->wakeDequeueWaitersLocked();
     VALIDATE_CONSISTENCY();
 
     return NO_ERROR;
@@ -1136,6 +1208,10 @@ status_t BufferQueueProducer::connect(const sp<IProducerListener>& listener,
             break;
     }
     mCore->mConnectedPid = IPCThreadState::self()->getCallingPid();
+    if (status == NO_ERROR) {
+        mCore->mLastProducerUid = static_cast<int32_t>(
+                IPCThreadState::self()->getCallingUid());
+    }
     mCore->mBufferHasBeenQueued = false;
     mCore->mDequeueBufferCannotBlock = false;
     if (mDequeueTimeout < 0) {
@@ -1188,6 +1264,7 @@ status_t BufferQueueProducer::disconnect(int api, DisconnectMode mode) {
             case NATIVE_WINDOW_API_CAMERA:
                 if (mCore->mConnectedApi == api) {
                     mCore->freeAllBuffersLocked();
+                    mCore->resetAdaptiveDepthLocked();
 
                     // Remove our death notification callback if we have one
                     if (mCore->mLinkedToDeath != NULL) {
@@ -1205,7 +1282,8 @@ status_t BufferQueueProducer::disconnect(int api, DisconnectMode mode) {
                     mCore->mConnectedApi = BufferQueueCore::NO_CONNECTED_API;
                     mCore->mConnectedPid = -1;
                     mCore->mSidebandStream.clear();
-                    mCore->mDequeueCondition.broadcast();
+                    mCore->mPreallocation.hasHistory = false;
+                    mCore->wakeDequeueWaitersLocked();
                     listener = mCore->mConsumerListener;
                 } else if (mCore->mConnectedApi != BufferQueueCore::NO_CONNECTED_API) {
                     BQ_LOGE("disconnect: still connected to another API "
@@ -1251,6 +1329,7 @@ void BufferQueueProducer::allocateBuffers(uint32_t width, uint32_t height,
         uint32_t allocHeight = 0;
         PixelFormat allocFormat = PIXEL_FORMAT_UNKNOWN;
         uint32_t allocUsage = 0;
+        int32_t poolOwner = -1;
         { // Autolock scope
             Mutex::Autolock lock(mCore->mMutex);
             mCore->waitWhileAllocatingLocked();
@@ -1270,16 +1349,19 @@ void BufferQueueProducer::allocateBuffers(uint32_t width, uint32_t height,
             allocHeight = height > 0 ? height : mCore->mDefaultHeight;
             allocFormat = format != 0 ? format : mCore->mDefaultBufferFormat;
             allocUsage = usage | mCore->mConsumerUsageBits;
+            poolOwner = mCore->mLastProducerUid;
 
             mCore->mIsAllocating = true;
         } // Autolock scope
 
         Vector<sp<GraphicBuffer>> buffers;
+        Vector<sp<Fence>> fences;
         for (size_t i = 0; i <  newBufferCount; ++i) {
             status_t result = NO_ERROR;
-            sp<GraphicBuffer> graphicBuffer(mCore->mAllocator->createGraphicBuffer(
-                    allocWidth, allocHeight, allocFormat, allocUsage,
-                    {mConsumerName.string(), mConsumerName.size()}, &result));
+            sp<Fence> fence;
+            sp<GraphicBuffer> graphicBuffer(mCore->createGraphicBuffer(
+                    poolOwner, allocWidth, allocHeight, allocFormat,
+                    allocUsage, mConsumerName, &fence, &result));
             if (result != NO_ERROR) {
                 BQ_LOGE("allocateBuffers: failed to allocate buffer (%u x %u, format"
                         " %u, usage %u)", width, height, format, usage);
@@ -1289,6 +1371,7 @@ void BufferQueueProducer::allocateBuffers(uint32_t width, uint32_t height,
                 return;
             }
             buffers.push_back(graphicBuffer);
+            fences.push_back(fence);
         }
 
         { // Autolock scope
@@ -1316,7 +1399,7 @@ void BufferQueueProducer::allocateBuffers(uint32_t width, uint32_t height,
                 auto slot = mCore->mFreeSlots.begin();
                 mCore->clearBufferSlotLocked(*slot); // Clean up the slot first
                 mSlots[*slot].mGraphicBuffer = buffers[i];
-                mSlots[*slot].mFence = Fence::NO_FENCE;
+                mSlots[*slot].mFence = fences[i];
 
                 // freeBufferLocked puts this slot on the free slots list. Since
                 // we then attached a buffer, move the slot to free buffer list.
@@ -1371,6 +1454,8 @@ status_t BufferQueueProducer::setSharedBufferMode(bool sharedBufferMode) {
         mCore->mSharedBufferSlot = BufferQueueCore::INVALID_BUFFER_SLOT;
     }
     mCore->mSharedBufferMode = sharedBufferMode;
+    mCore->mConsumerCanPollWithoutLock =
+            mCore->mSingleProducerConsumer && !sharedBufferMode;
     return NO_ERROR;
 }
 
@@ -254,6 +254,15 @@ status_t ConsumerBase::discardFreeBuffers() {
     return mConsumer->discardFreeBuffers();
 }
 
+status_t ConsumerBase::setAdaptiveQueueDepth(bool enabled) {
+    Mutex::Autolock _l(mMutex);
+    if (mAbandoned) {
+        CB_LOGE("setAdaptiveQueueDepth: ConsumerBase is abandoned!");
+        return NO_INIT;
+    }
+    return mConsumer->setAdaptiveQueueDepth(enabled);
+}
+
 void ConsumerBase::dumpState(String8& result) const {
     dumpState(result, "");
 }
@@ -20,6 +20,7 @@
 #include <ui/GraphicBuffer.h>
 
 #include <gui/GraphicBufferAlloc.h>
+#include <gui/GraphicBufferPool.h>
 
 // ----------------------------------------------------------------------------
 namespace android {
@@ -35,8 +36,15 @@ sp<GraphicBuffer> GraphicBufferAlloc::createGraphicBuffer(uint32_t width,
         uint32_t height, PixelFormat format, uint32_t usage,
         std::string requestorName, status_t* error) {
     sp<GraphicBuffer> graphicBuffer(new GraphicBuffer(
-            width, height, format, usage, std::move(requestorName)));
+            width, height, format, usage, requestorName));
     status_t err = graphicBuffer->initCheck();
+    if (err == NO_MEMORY) {
+        // Give back what the pool holds and try again
+        GraphicBufferPool::getInstance().trim(0);
+        graphicBuffer = new GraphicBuffer(
+                width, height, format, usage, std::move(requestorName));
+        err = graphicBuffer->initCheck();
+    }
     *error = err;
     if (err != 0 || graphicBuffer->handle == 0) {
         if (err == NO_MEMORY) {
@@ -0,0 +1,236 @@
+/*
+ * Copyright 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "GraphicBufferPool"
+#define ATRACE_TAG ATRACE_TAG_GRAPHICS
+//#define LOG_NDEBUG 0
+
+#include <inttypes.h>
+
+#include <gui/GraphicBufferPool.h>
+
+#include <utils/Log.h>
+#include <utils/Trace.h>
+
+namespace android {
+
+ANDROID_SINGLETON_STATIC_INSTANCE(GraphicBufferPool);
+
+GraphicBufferPool::GraphicBufferPool() : Singleton<GraphicBufferPool>(),
+        mMutex(),
+        mExpiryCondition(),
+        mExpiryThread(),
+        mExiting(false),
+        mDropped(),
+        mEntries(),
+        mMaxBytes(0),
+        mBytes(0),
+        mPeakBytes(0),
+        mRequests(0),
+        mHits(0),
+        mRecycled(0),
+        mRejected(0),
+        mEvicted(0),
+        mExpired(0),
+        mTrimmed(0) {
+}
+
+GraphicBufferPool::~GraphicBufferPool() {
+    { // Autolock scope
+        Mutex::Autolock lock(mMutex);
+        mExiting = true;
+        mExpiryCondition.signal();
+    } // Autolock scope
+    if (mExpiryThread.joinable()) {
+        mExpiryThread.join();
+    }
+}
+
+void GraphicBufferPool::setMaxBytes(size_t maxBytes) {
+    std::vector<Entry> dropped;
+    { // Autolock scope
+        Mutex::Autolock lock(mMutex);
+        mMaxBytes = maxBytes;
+        mEvicted += trimLocked(maxBytes, &dropped);
+    } // Autolock scope
+    // The dropped buffers are freed here, after unlocking
+}
+
+size_t GraphicBufferPool::getMaxBytes() const {
+    Mutex::Autolock lock(mMutex);
+    return mMaxBytes;
+}
+
+sp<GraphicBuffer> GraphicBufferPool::take(int32_t owner, uint32_t width,
+        uint32_t height, PixelFormat format, uint32_t usage,
+        sp<Fence>* outFence) {
+    ATRACE_CALL();
+    Mutex::Autolock lock(mMutex);
+    if (mMaxBytes == 0) {
+        return NULL;
+    }
+    ++mRequests;
+    for (size_t i = 0; i < mEntries.size(); ++i) {
+        const Entry& entry(mEntries[i]);
+        const sp<GraphicBuffer>& buffer(entry.buffer);
+        // Buffers still referenced elsewhere in this process (e.g. by the
+        // slot cache of their previous consumer) may still be read.
+        if (entry.owner != owner || buffer->getWidth() != width ||
+                buffer->getHeight() != height ||
+                buffer->getPixelFormat() != format ||
+                buffer->getUsage() != usage ||
+                buffer->getStrongCount() != 1) {
+            continue;
+        }
+        *outFence = entry.fence;
+        sp<GraphicBuffer> result(removeLocked(i).buffer);
+        ++mHits;
+        ALOGV("take: reusing %ux%u buffer for uid %d", width, height, owner);
+        return result;
+    }
+    return NULL;
+}
+
+void GraphicBufferPool::recycle(int32_t owner,
+        const sp<GraphicBuffer>& buffer, const sp<Fence>& fence) {
+    Mutex::Autolock lock(mMutex);
+    if (mMaxBytes == 0) {
+        return;
+    }
+    const size_t size = getAllocationSize(buffer);
+    if (size > mMaxBytes) {
+        ++mRejected;
+        return;
+    }
+    // The caller holds its BufferQueue's lock, so the evicted buffers are
+    // freed on the expiry thread.
+    mEvicted += trimLocked(mMaxBytes - size, &mDropped);
+
+    Entry entry;
+    entry.owner = owner;
+    entry.buffer = buffer;
+    entry.fence = fence != NULL ? fence : Fence::NO_FENCE;
+    entry.size = size;
+    entry.recycleTime = systemTime(SYSTEM_TIME_MONOTONIC);
+    mEntries.push_back(entry);
+    mBytes += size;
+    if (mBytes > mPeakBytes) {
+        mPeakBytes = mBytes;
+    }
+    ++mRecycled;
+
+    if (!mExpiryThread.joinable()) {
+        mExpiryThread = std::thread([this]() { expiryLoop(); });
+    } else {
+        mExpiryCondition.signal();
+    }
+}
+
+void GraphicBufferPool::trim(size_t maxBytes) {
+    std::vector<Entry> dropped;
+    { // Autolock scope
+        Mutex::Autolock lock(mMutex);
+        mTrimmed += trimLocked(maxBytes, &dropped);
+    } // Autolock scope
+    if (!dropped.empty()) {
+        ALOGI("trim: dropped %zu buffers", dropped.size());
+    }
+}
+
+size_t GraphicBufferPool::getAllocationSize(const sp<GraphicBuffer>& buffer) {
+    // YUV and implementation defined formats have no fixed bytes per pixel;
+    // counting them as 4 overestimates rather than underestimates.
+    uint32_t bpp = bytesPerPixel(buffer->getPixelFormat());
+    if (bpp == 0) {
+        bpp = 4;
+    }
+    return static_cast<size_t>(buffer->getStride()) * buffer->getHeight() *
+            bpp;
+}
+
+GraphicBufferPool::Entry GraphicBufferPool::removeLocked(size_t index) {
+    Entry entry(mEntries[index]);
+    mBytes -= entry.size;
+    mEntries.erase(mEntries.begin() + static_cast<ptrdiff_t>(index));
+    return entry;
+}
+
+size_t GraphicBufferPool::trimLocked(size_t maxBytes,
+        std::vector<Entry>* outDropped) {
+    size_t count = 0;
+    while (mBytes > maxBytes) {
+        outDropped->push_back(removeLocked(0));
+        ++count;
+    }
+    return count;
+}
+
+void GraphicBufferPool::expiryLoop() {
+    while (true) {
+        std::vector<Entry> dropped;
+        { // Autolock scope
+            Mutex::Autolock lock(mMutex);
+            while (!mExiting && mDropped.empty()) {
+                if (mEntries.empty()) {
+                    mExpiryCondition.wait(mMutex);
+                    continue;
+                }
+                const nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+                const nsecs_t deadline = mEntries[0].recycleTime +
+                        MAX_IDLE_TIME;
+                if (deadline > now) {
+                    mExpiryCondition.waitRelative(mMutex, deadline - now);
+                    continue;
+                }
+                mDropped.push_back(removeLocked(0));
+                ++mExpired;
+            }
+            if (mExiting) {
+                return;
+            }
+            dropped.swap(mDropped);
+        } // Autolock scope
+        ATRACE_NAME("GraphicBufferPool::freeBuffers");
+        dropped.clear();
+    }
+}
+
+void GraphicBufferPool::dump(String8& result, const char* prefix) const {
+    Mutex::Autolock lock(mMutex);
+    const double hitRate = mRequests > 0 ?
+            100.0 * static_cast<double>(mHits) /
+            static_cast<double>(mRequests) : 0.0;
+    result.appendFormat("%sGraphicBufferPool: %zu buffers, %zu KiB "
+            "(max %zu KiB, peak %zu KiB)\n", prefix, mEntries.size(),
+            mBytes / 1024, mMaxBytes / 1024, mPeakBytes / 1024);
+    result.appendFormat("%s  requests=%" PRIu64 ", hits=%" PRIu64
+            " (%.1f%%), recycled=%" PRIu64 ", rejected=%" PRIu64
+            ", evicted=%" PRIu64 ", expired=%" PRIu64 ", trimmed=%" PRIu64
+            "\n", prefix, mRequests, mHits, hitRate, mRecycled, mRejected,
+            mEvicted, mExpired, mTrimmed);
+    const nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+    for (const Entry& entry : mEntries) {
+        const sp<GraphicBuffer>& buffer(entry.buffer);
+        result.appendFormat("%s  uid %d: %ux%u format %d usage %#x, %zu KiB, "
+                "idle %.1fs%s\n", prefix, entry.owner, buffer->getWidth(),
+                buffer->getHeight(), buffer->getPixelFormat(),
+                buffer->getUsage(), entry.size / 1024,
+                static_cast<double>(now - entry.recycleTime) / 1e9,
+                buffer->getStrongCount() != 1 ? " (still referenced)" : "");
+    }
+}
+
+} // namespace android
@@ -53,6 +53,7 @@ enum {
     GET_SIDEBAND_STREAM,
     GET_OCCUPANCY_HISTORY,
     DISCARD_FREE_BUFFERS,
+    SET_ADAPTIVE_QUEUE_DEPTH,
     DUMP,
 };
 
@@ -302,6 +303,23 @@ public:
         return result;
     }
 
+    virtual status_t setAdaptiveQueueDepth(bool enabled) {
+        Parcel data, reply;
+        data.writeInterfaceToken(IGraphicBufferConsumer::getInterfaceDescriptor());
+        data.writeBool(enabled);
+        status_t error = remote()->transact(SET_ADAPTIVE_QUEUE_DEPTH, data,
+                &reply);
+        if (error != NO_ERROR) {
+            return error;
+        }
+        int32_t result = NO_ERROR;
+        error = reply.readInt32(&result);
+        if (error != NO_ERROR) {
+            return error;
+        }
+        return result;
+    }
+
     virtual void dumpState(String8& result, const char* prefix) const {
         Parcel data, reply;
         data.writeInterfaceToken(IGraphicBufferConsumer::getInterfaceDescriptor());
@@ -476,6 +494,17 @@ status_t BnGraphicBufferConsumer::onTransact(
             status_t error = reply->writeInt32(result);
             return error;
         }
+        case SET_ADAPTIVE_QUEUE_DEPTH: {
+            CHECK_INTERFACE(IGraphicBufferConsumer, data, reply);
+            bool enabled = false;
+            status_t error = data.readBool(&enabled);
+            if (error != NO_ERROR) {
+                return error;
+            }
+            status_t result = setAdaptiveQueueDepth(enabled);
+            error = reply->writeInt32(result);
+            return error;
+        }
         case DUMP: {
             CHECK_INTERFACE(IGraphicBufferConsumer, data, reply);
             String8 result = data.readString8();
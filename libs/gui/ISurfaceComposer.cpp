@@ -418,28 +418,26 @@ status_t BnSurfaceComposer::onTransact(
             if (count > data.dataSize()) {
                 return BAD_VALUE;
             }
-            ComposerState s;
+            // Read each state in place: the states only carry the fields
+            // that changed, the others keep their defaults.
             Vector<ComposerState> state;
-            state.setCapacity(count);
+            state.resize(count);
             for (size_t i = 0; i < count; i++) {
-                if (s.read(data) == BAD_VALUE) {
+                if (state.editItemAt(i).read(data) == BAD_VALUE) {
                     return BAD_VALUE;
                 }
-                state.add(s);
             }
 
             count = data.readUint32();
             if (count > data.dataSize()) {
                 return BAD_VALUE;
             }
-            DisplayState d;
             Vector<DisplayState> displays;
-            displays.setCapacity(count);
+            displays.resize(count);
             for (size_t i = 0; i < count; i++) {
-                if (d.read(data) == BAD_VALUE) {
+                if (displays.editItemAt(i).read(data) == BAD_VALUE) {
                     return BAD_VALUE;
                 }
-                displays.add(d);
             }
 
             uint32_t stateFlags = data.readUint32();
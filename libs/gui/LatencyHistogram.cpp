@@ -0,0 +1,133 @@
+/*
+ * Copyright 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gui/LatencyHistogram.h>
+
+#include <utils/String8.h>
+
+#include <inttypes.h>
+
+namespace android {
+
+static size_t bucketFor(nsecs_t duration) {
+    const int64_t us = duration / 1000;
+    if (us <= 0) {
+        return 0;
+    }
+    const size_t bucket = static_cast<size_t>(
+            64 - __builtin_clzll(static_cast<uint64_t>(us)));
+    return bucket < LatencyHistogram::NUM_BUCKETS ?
+            bucket : LatencyHistogram::NUM_BUCKETS - 1;
+}
+
+// The upper bound of the last bucket is unknown, so it reports its lower bound
+static uint64_t bucketBoundUs(size_t bucket) {
+    return bucket < LatencyHistogram::NUM_BUCKETS - 1 ?
+            1ull << bucket : 1ull << (bucket - 1);
+}
+
+static void appendBound(String8& result, size_t bucket) {
+    result.appendFormat(bucket < LatencyHistogram::NUM_BUCKETS - 1 ?
+            "<%" PRIu64 "us" : ">=%" PRIu64 "us", bucketBoundUs(bucket));
+}
+
+LatencyHistogram::LatencyHistogram()
+  : mCount(0),
+    mTotal(0),
+    mMax(0) {
+    for (size_t i = 0; i < NUM_BUCKETS; ++i) {
+        mBuckets[i] = 0;
+    }
+}
+
+void LatencyHistogram::add(nsecs_t duration) {
+    mBuckets[bucketFor(duration)].fetch_add(1, std::memory_order_relaxed);
+    mCount.fetch_add(1, std::memory_order_relaxed);
+    mTotal.fetch_add(duration, std::memory_order_relaxed);
+    int64_t max = mMax.load(std::memory_order_relaxed);
+    while (duration > max && !mMax.compare_exchange_weak(max, duration,
+            std::memory_order_relaxed)) {
+    }
+}
+
+uint64_t LatencyHistogram::getCount() const {
+    return mCount.load(std::memory_order_relaxed);
+}
+
+static size_t percentileBucket(const uint64_t* buckets, uint64_t count,
+        double fraction) {
+    const uint64_t target = static_cast<uint64_t>(
+            static_cast<double>(count) * fraction + 0.5);
+    uint64_t seen = 0;
+    for (size_t i = 0; i < LatencyHistogram::NUM_BUCKETS; ++i) {
+        seen += buckets[i];
+        if (seen >= target && seen > 0) {
+            return i;
+        }
+    }
+    return LatencyHistogram::NUM_BUCKETS - 1;
+}
+
+uint64_t LatencyHistogram::getPercentileUs(double fraction) const {
+    uint64_t buckets[NUM_BUCKETS];
+    uint64_t count = 0;
+    for (size_t i = 0; i < NUM_BUCKETS; ++i) {
+        buckets[i] = mBuckets[i].load(std::memory_order_relaxed);
+        count += buckets[i];
+    }
+    if (count == 0) {
+        return 0;
+    }
+    return bucketBoundUs(percentileBucket(buckets, count, fraction));
+}
+
+void LatencyHistogram::dump(String8& result, const char* prefix,
+        const char* name) const {
+    // Sum the buckets rather than reading mCount so the line is consistent
+    // with the buckets even if samples are being added
+    uint64_t buckets[NUM_BUCKETS];
+    uint64_t count = 0;
+    for (size_t i = 0; i < NUM_BUCKETS; ++i) {
+        buckets[i] = mBuckets[i].load(std::memory_order_relaxed);
+        count += buckets[i];
+    }
+    result.appendFormat("%s%s: %" PRIu64 " samples", prefix, name, count);
+    if (count == 0) {
+        result.append("\n");
+        return;
+    }
+    const int64_t total = mTotal.load(std::memory_order_relaxed);
+    result.appendFormat(", avg %.3f ms, max %.3f ms, p50 ",
+            static_cast<double>(total) / static_cast<double>(count) / 1e6,
+            static_cast<double>(mMax.load(std::memory_order_relaxed)) / 1e6);
+    appendBound(result, percentileBucket(buckets, count, 0.5));
+    result.append(", p90 ");
+    appendBound(result, percentileBucket(buckets, count, 0.9));
+    result.append(", p99 ");
+    appendBound(result, percentileBucket(buckets, count, 0.99));
+    result.appendFormat("\n%s ", prefix);
+    for (size_t i = 0; i < NUM_BUCKETS; ++i) {
+        if (buckets[i] == 0) {
+            continue;
+        }
+        result.append(" ");
+        appendBound(result, i);
+        result.appendFormat(":%" PRIu64, buckets[i]);
+    }
+    result.append("\n");
+}
+
+} // namespace android
@@ -22,32 +22,70 @@
 
 namespace android {
 
+// Only the fields flagged in 'what' are written, in the order of the bits
+// below; a transaction typically changes a couple of properties of each layer.
+
 status_t layer_state_t::write(Parcel& output) const
 {
     output.writeStrongBinder(surface);
     output.writeUint32(what);
-    output.writeFloat(x);
-    output.writeFloat(y);
-    output.writeUint32(z);
-    output.writeUint32(w);
-    output.writeUint32(h);
-    output.writeUint32(layerStack);
-    output.writeFloat(blur);
-    output.writeStrongBinder(blurMaskSurface);
-    output.writeUint32(blurMaskSampling);
-    output.writeFloat(blurMaskAlphaThreshold);
-    output.writeFloat(alpha);
-    output.writeUint32(flags);
-    output.writeUint32(mask);
-    *reinterpret_cast<layer_state_t::matrix22_t *>(
-            output.writeInplace(sizeof(layer_state_t::matrix22_t))) = matrix;
-    output.write(crop);
-    output.write(finalCrop);
-    output.writeStrongBinder(handle);
-    output.writeUint64(frameNumber);
-    output.writeInt32(overrideScalingMode);
-    output.writeUint32(color);
-    output.write(transparentRegion);
+    if (what & ePositionChanged) {
+        output.writeFloat(x);
+        output.writeFloat(y);
+    }
+    if (what & eLayerChanged) {
+        output.writeUint32(z);
+    }
+    if (what & eSizeChanged) {
+        output.writeUint32(w);
+        output.writeUint32(h);
+    }
+    if (what & eAlphaChanged) {
+        output.writeFloat(alpha);
+    }
+    if (what & eMatrixChanged) {
+        *reinterpret_cast<layer_state_t::matrix22_t *>(
+                output.writeInplace(sizeof(layer_state_t::matrix22_t))) = matrix;
+    }
+    if (what & eTransparentRegionChanged) {
+        output.write(transparentRegion);
+    }
+    if (what & eFlagsChanged) {
+        // both fit in one word
+        output.writeUint32(static_cast<uint32_t>(flags) |
+                (static_cast<uint32_t>(mask) << 8));
+    }
+    if (what & eLayerStackChanged) {
+        output.writeUint32(layerStack);
+    }
+    if (what & eCropChanged) {
+        output.write(crop);
+    }
+    if (what & eDeferTransaction) {
+        output.writeStrongBinder(handle);
+        output.writeUint64(frameNumber);
+    }
+    if (what & eFinalCropChanged) {
+        output.write(finalCrop);
+    }
+    if (what & eOverrideScalingModeChanged) {
+        output.writeInt32(overrideScalingMode);
+    }
+    if (what & eColorChanged) {
+        output.writeUint32(color);
+    }
+    if (what & eBlurChanged) {
+        output.writeFloat(blur);
+    }
+    if (what & eBlurMaskSurfaceChanged) {
+        output.writeStrongBinder(blurMaskSurface);
+    }
+    if (what & eBlurMaskSamplingChanged) {
+        output.writeUint32(blurMaskSampling);
+    }
+    if (what & eBlurMaskAlphaThresholdChanged) {
+        output.writeFloat(blurMaskAlphaThreshold);
+    }
     return NO_ERROR;
 }
 
@@ -55,32 +93,72 @@ status_t layer_state_t::read(const Parcel& input)
 {
     surface = input.readStrongBinder();
     what = input.readUint32();
-    x = input.readFloat();
-    y = input.readFloat();
-    z = input.readUint32();
-    w = input.readUint32();
-    h = input.readUint32();
-    layerStack = input.readUint32();
-    blur = input.readFloat();
-    blurMaskSurface = input.readStrongBinder();
-    blurMaskSampling = input.readUint32();
-    blurMaskAlphaThreshold = input.readFloat();
-    alpha = input.readFloat();
-    flags = static_cast<uint8_t>(input.readUint32());
-    mask = static_cast<uint8_t>(input.readUint32());
-    const void* matrix_data = input.readInplace(sizeof(layer_state_t::matrix22_t));
-    if (matrix_data) {
-        matrix = *reinterpret_cast<layer_state_t::matrix22_t const *>(matrix_data);
-    } else {
-        return BAD_VALUE;
-    }
-    input.read(crop);
-    input.read(finalCrop);
-    handle = input.readStrongBinder();
-    frameNumber = input.readUint64();
-    overrideScalingMode = input.readInt32();
-    color = input.readUint32();
-    input.read(transparentRegion);
+    if (what & ePositionChanged) {
+        x = input.readFloat();
+        y = input.readFloat();
+    }
+    if (what & eLayerChanged) {
+        z = input.readUint32();
+    }
+    if (what & eSizeChanged) {
+        w = input.readUint32();
+        h = input.readUint32();
+    }
+    if (what & eAlphaChanged) {
+        alpha = input.readFloat();
+    }
+    if (what & eMatrixChanged) {
+        const void* matrix_data =
+                input.readInplace(sizeof(layer_state_t::matrix22_t));
+        if (matrix_data) {
+            matrix = *reinterpret_cast<layer_state_t::matrix22_t const *>(
+                    matrix_data);
+        } else {
+            return BAD_VALUE;
+        }
+    }
+    if (what & eTransparentRegionChanged) {
+        status_t err = input.read(transparentRegion);
+        if (err != NO_ERROR) {
+            return BAD_VALUE;
+        }
+    }
+    if (what & eFlagsChanged) {
+        const uint32_t flagsAndMask = input.readUint32();
+        flags = static_cast<uint8_t>(flagsAndMask);
+        mask = static_cast<uint8_t>(flagsAndMask >> 8);
+    }
+    if (what & eLayerStackChanged) {
+        layerStack = input.readUint32();
+    }
+    if (what & eCropChanged) {
+        input.read(crop);
+    }
+    if (what & eDeferTransaction) {
+        handle = input.readStrongBinder();
+        frameNumber = input.readUint64();
+    }
+    if (what & eFinalCropChanged) {
+        input.read(finalCrop);
+    }
+    if (what & eOverrideScalingModeChanged) {
+        overrideScalingMode = input.readInt32();
+    }
+    if (what & eColorChanged) {
+        color = input.readUint32();
+    }
+    if (what & eBlurChanged) {
+        blur = input.readFloat();
+    }
+    if (what & eBlurMaskSurfaceChanged) {
+        blurMaskSurface = input.readStrongBinder();
+    }
+    if (what & eBlurMaskSamplingChanged) {
+        blurMaskSampling = input.readUint32();
+    }
+    if (what & eBlurMaskAlphaThresholdChanged) {
+        blurMaskAlphaThreshold = input.readFloat();
+    }
     return NO_ERROR;
 }
 
@@ -73,6 +73,8 @@ void OccupancyTracker::registerOccupancyChange(size_t occupancy) {
         } else {
             mPendingSegment.mOccupancyTimes[mLastOccupancy] = delta;
         }
+        mTotalTime += delta;
+        mTotalOccupancyTime += delta * static_cast<nsecs_t>(mLastOccupancy);
     }
     if (occupancy > mLastOccupancy) {
         ++mPendingSegment.numFrames;
@@ -92,6 +94,31 @@ std::vector<OccupancyTracker::Segment> OccupancyTracker::getSegmentHistory(
     return segments;
 }
 
+size_t OccupancyTracker::getRecentMaxOccupancy() const {
+    size_t maxOccupancy = mLastOccupancy;
+    for (const auto& timePair : mPendingSegment.mOccupancyTimes) {
+        if (timePair.first > maxOccupancy) {
+            maxOccupancy = timePair.first;
+        }
+    }
+    if (!mSegmentHistory.empty()) {
+        // Segments only record whether more than one buffer was queued.
+        const Segment& segment(mSegmentHistory.front());
+        size_t segmentOccupancy = segment.usedThirdBuffer ? 2 :
+                (segment.occupancyAverage > 0.0f ? 1 : 0);
+        if (segmentOccupancy > maxOccupancy) {
+            maxOccupancy = segmentOccupancy;
+        }
+    }
+    return maxOccupancy;
+}
+
+void OccupancyTracker::getTotals(nsecs_t* outTotalTime,
+        nsecs_t* outOccupancyTime) const {
+    *outTotalTime = mTotalTime;
+    *outOccupancyTime = mTotalOccupancyTime;
+}
+
 void OccupancyTracker::recordPendingSegment() {
     // Only record longer segments to get a better measurement of actual double-
     // vs. triple-buffered time
@@ -0,0 +1,499 @@
+/*
+ * Copyright 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "PixelConverter"
+#define ATRACE_TAG ATRACE_TAG_GRAPHICS
+//#define LOG_NDEBUG 0
+
+#include <gui/PixelConverter.h>
+
+#include <utils/Log.h>
+#include <utils/Trace.h>
+
+#include <vector>
+
+#include <string.h>
+
+#if defined(__ARM_NEON__) || defined(__aarch64__)
+#define PIXEL_CONVERTER_NEON 1
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#define PIXEL_CONVERTER_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace android {
+
+// Where the planes of a YUV 4:2:0 image are
+struct YuvPlanes {
+    const uint8_t* y;
+    const uint8_t* cb;
+    const uint8_t* cr;
+    size_t yStride;
+    size_t chromaStride;
+    size_t chromaStep;
+};
+
+static uint8_t clampToByte(int32_t value) {
+    return static_cast<uint8_t>(value < 0 ? 0 : (value > 255 ? 255 : value));
+}
+
+// BT.601 limited range, in 8.8 fixed point. The SIMD kernels compute exactly
+// this in 32 bits.
+static void yuvToRgb(uint8_t y, uint8_t cb, uint8_t cr, uint8_t* r, uint8_t* g,
+        uint8_t* b) {
+    const int32_t c = 298 * (static_cast<int32_t>(y) - 16);
+    const int32_t d = static_cast<int32_t>(cb) - 128;
+    const int32_t e = static_cast<int32_t>(cr) - 128;
+    *r = clampToByte((c + 409 * e + 128) >> 8);
+    *g = clampToByte((c - 100 * d - 208 * e + 128) >> 8);
+    *b = clampToByte((c + 516 * d + 128) >> 8);
+}
+
+// The row kernels below convert 'width' pixels starting at src to RGBA, or
+// BGRA if swapRB is set. The SIMD loops handle as many pixels as they can and
+// leave the rest to the scalar loop.
+
+static void convertRgbaRow(const uint8_t* src, uint8_t* dst, size_t width,
+        bool swapRB, bool opaque) {
+    if (!swapRB && !opaque) {
+        memcpy(dst, src, width * 4);
+        return;
+    }
+    size_t x = 0;
+#if defined(PIXEL_CONVERTER_NEON)
+    for (; x + 16 <= width; x += 16) {
+        uint8x16x4_t pixels = vld4q_u8(src + x * 4);
+        if (swapRB) {
+            const uint8x16_t red = pixels.val[0];
+            pixels.val[0] = pixels.val[2];
+            pixels.val[2] = red;
+        }
+        if (opaque) {
+            pixels.val[3] = vdupq_n_u8(0xff);
+        }
+        vst4q_u8(dst + x * 4, pixels);
+    }
+#elif defined(PIXEL_CONVERTER_SSE2)
+    const __m128i greenAlphaMask = _mm_set1_epi32(static_cast<int>(0xff00ff00));
+    const __m128i redBlueMask = _mm_set1_epi32(0x00ff00ff);
+    const __m128i alpha = _mm_set1_epi32(opaque ? static_cast<int>(0xff000000) : 0);
+    for (; x + 4 <= width; x += 4) {
+        __m128i pixels = _mm_loadu_si128(
+                static_cast<const __m128i*>(static_cast<const void*>(src + x * 4)));
+        if (swapRB) {
+            // Swapping the 16-bit halves of each pixel swaps red and blue
+            __m128i redBlue = _mm_and_si128(pixels, redBlueMask);
+            redBlue = _mm_shufflehi_epi16(_mm_shufflelo_epi16(redBlue, 0xb1), 0xb1);
+            pixels = _mm_or_si128(_mm_and_si128(pixels, greenAlphaMask), redBlue);
+        }
+        pixels = _mm_or_si128(pixels, alpha);
+        _mm_storeu_si128(static_cast<__m128i*>(static_cast<void*>(dst + x * 4)),
+                pixels);
+    }
+#endif
+    const size_t red = swapRB ? 2 : 0;
+    const size_t blue = swapRB ? 0 : 2;
+    for (; x < width; ++x) {
+        const uint8_t* in = src + x * 4;
+        uint8_t* out = dst + x * 4;
+        const uint8_t r = in[red];
+        const uint8_t b = in[blue];
+        out[0] = r;
+        out[1] = in[1];
+        out[2] = b;
+        out[3] = opaque ? 0xff : in[3];
+    }
+}
+
+static void convertRgb565Row(const uint8_t* src, uint8_t* dst, size_t width,
+        bool swapRB) {
+    size_t x = 0;
+#if defined(PIXEL_CONVERTER_NEON)
+    const uint16_t* src16 =
+            static_cast<const uint16_t*>(static_cast<const void*>(src));
+    for (; x + 8 <= width; x += 8) {
+        const uint16x8_t pixels = vld1q_u16(src16 + x);
+        uint8x8_t red = vand_u8(vshrn_n_u16(pixels, 8), vdup_n_u8(0xf8));
+        uint8x8_t green = vand_u8(vshrn_n_u16(pixels, 3), vdup_n_u8(0xfc));
+        uint8x8_t blue = vmovn_u16(vshlq_n_u16(pixels, 3));
+        red = vorr_u8(red, vshr_n_u8(red, 5));
+        green = vorr_u8(green, vshr_n_u8(green, 6));
+        blue = vorr_u8(blue, vshr_n_u8(blue, 5));
+        uint8x8x4_t out;
+        out.val[0] = swapRB ? blue : red;
+        out.val[1] = green;
+        out.val[2] = swapRB ? red : blue;
+        out.val[3] = vdup_n_u8(0xff);
+        vst4_u8(dst + x * 4, out);
+    }
+#elif defined(PIXEL_CONVERTER_SSE2)
+    const __m128i fiveBits = _mm_set1_epi16(0x1f);
+    const __m128i sixBits = _mm_set1_epi16(0x3f);
+    const __m128i alpha = _mm_set1_epi16(static_cast<short>(0xff00));
+    for (; x + 8 <= width; x += 8) {
+        const __m128i pixels = _mm_loadu_si128(
+                static_cast<const __m128i*>(static_cast<const void*>(src + x * 2)));
+        __m128i red = _mm_and_si128(_mm_srli_epi16(pixels, 11), fiveBits);
+        __m128i green = _mm_and_si128(_mm_srli_epi16(pixels, 5), sixBits);
+        __m128i blue = _mm_and_si128(pixels, fiveBits);
+        red = _mm_or_si128(_mm_slli_epi16(red, 3), _mm_srli_epi16(red, 2));
+        green = _mm_or_si128(_mm_slli_epi16(green, 2), _mm_srli_epi16(green, 4));
+        blue = _mm_or_si128(_mm_slli_epi16(blue, 3), _mm_srli_epi16(blue, 2));
+        // Each 16-bit lane now holds one channel; pack them into
+        // (first, green) and (third, alpha) pairs and interleave the pairs.
+        const __m128i firstGreen = _mm_or_si128(swapRB ? blue : red,
+                _mm_slli_epi16(green, 8));
+        const __m128i thirdAlpha = _mm_or_si128(swapRB ? red : blue, alpha);
+        _mm_storeu_si128(static_cast<__m128i*>(static_cast<void*>(dst + x * 4)),
+                _mm_unpacklo_epi16(firstGreen, thirdAlpha));
+        _mm_storeu_si128(static_cast<__m128i*>(static_cast<void*>(dst + x * 4 + 16)),
+                _mm_unpackhi_epi16(firstGreen, thirdAlpha));
+    }
+#endif
+    for (; x < width; ++x) {
+        const uint32_t pixel = static_cast<uint32_t>(src[x * 2]) |
+                (static_cast<uint32_t>(src[x * 2 + 1]) << 8);
+        const uint32_t red5 = pixel >> 11;
+        const uint32_t green6 = (pixel >> 5) & 0x3f;
+        const uint32_t blue5 = pixel & 0x1f;
+        const uint8_t r = static_cast<uint8_t>((red5 << 3) | (red5 >> 2));
+        const uint8_t g = static_cast<uint8_t>((green6 << 2) | (green6 >> 4));
+        const uint8_t b = static_cast<uint8_t>((blue5 << 3) | (blue5 >> 2));
+        uint8_t* out = dst + x * 4;
+        out[0] = swapRB ? b : r;
+        out[1] = g;
+        out[2] = swapRB ? r : b;
+        out[3] = 0xff;
+    }
+}
+
+#if defined(PIXEL_CONVERTER_SSE2)
+// Returns (lo, hi) repeated, for multiplying interleaved pairs with madd
+static __m128i coefficientPairs(int16_t lo, int16_t hi) {
+    return _mm_set_epi16(hi, lo, hi, lo, hi, lo, hi, lo);
+}
+
+// Computes (a * aCoefficient + b * bCoefficient + 128) >> 8 for 8 pixels
+static __m128i multiplyAddPairs(__m128i a, __m128i b, __m128i coefficients) {
+    const __m128i rounding = _mm_set1_epi32(128);
+    const __m128i lo = _mm_madd_epi16(_mm_unpacklo_epi16(a, b), coefficients);
+    const __m128i hi = _mm_madd_epi16(_mm_unpackhi_epi16(a, b), coefficients);
+    return _mm_packs_epi32(_mm_srai_epi32(_mm_add_epi32(lo, rounding), 8),
+            _mm_srai_epi32(_mm_add_epi32(hi, rounding), 8));
+}
+#endif
+
+// Converts a row of 4:2:0 YUV, where cb and cr hold a sample for every pair
+// of pixels (with no gaps in between).
+static void convertYuvRow(const uint8_t* y, const uint8_t* cb, const uint8_t* cr,
+        uint8_t* dst, size_t width, bool swapRB) {
+    size_t x = 0;
+#if defined(PIXEL_CONVERTER_NEON)
+    const uint8x8_t lumaOffset = vdup_n_u8(16);
+    const uint8x8_t chromaOffset = vdup_n_u8(128);
+    for (; x + 16 <= width; x += 16) {
+        const uint8x16_t luma = vld1q_u8(y + x);
+        const uint8x8x2_t blueDiff = vzip_u8(vld1_u8(cb + x / 2),
+                vld1_u8(cb + x / 2));
+        const uint8x8x2_t redDiff = vzip_u8(vld1_u8(cr + x / 2),
+                vld1_u8(cr + x / 2));
+        for (size_t half = 0; half < 2; ++half) {
+            const int16x8_t c = vreinterpretq_s16_u16(vsubl_u8(half == 0 ?
+                    vget_low_u8(luma) : vget_high_u8(luma), lumaOffset));
+            const int16x8_t d = vreinterpretq_s16_u16(
+                    vsubl_u8(blueDiff.val[half], chromaOffset));
+            const int16x8_t e = vreinterpretq_s16_u16(
+                    vsubl_u8(redDiff.val[half], chromaOffset));
+            const int32x4_t cLo = vmull_n_s16(vget_low_s16(c), 298);
+            const int32x4_t cHi = vmull_n_s16(vget_high_s16(c), 298);
+            const int32x4_t rLo = vmlal_n_s16(cLo, vget_low_s16(e), 409);
+            const int32x4_t rHi = vmlal_n_s16(cHi, vget_high_s16(e), 409);
+            const int32x4_t gLo = vmlsl_n_s16(vmlsl_n_s16(cLo,
+                    vget_low_s16(d), 100), vget_low_s16(e), 208);
+            const int32x4_t gHi = vmlsl_n_s16(vmlsl_n_s16(cHi,
+                    vget_high_s16(d), 100), vget_high_s16(e), 208);
+            const int32x4_t bLo = vmlal_n_s16(cLo, vget_low_s16(d), 516);
+            const int32x4_t bHi = vmlal_n_s16(cHi, vget_high_s16(d), 516);
+            // The rounding shift adds the 128 before shifting
+            const uint8x8_t red = vqmovun_s16(vcombine_s16(
+                    vrshrn_n_s32(rLo, 8), vrshrn_n_s32(rHi, 8)));
+            const uint8x8_t green = vqmovun_s16(vcombine_s16(
+                    vrshrn_n_s32(gLo, 8), vrshrn_n_s32(gHi, 8)));
+            const uint8x8_t blue = vqmovun_s16(vcombine_s16(
+                    vrshrn_n_s32(bLo, 8), vrshrn_n_s32(bHi, 8)));
+            uint8x8x4_t out;
+            out.val[0] = swapRB ? blue : red;
+            out.val[1] = green;
+            out.val[2] = swapRB ? red : blue;
+            out.val[3] = vdup_n_u8(0xff);
+            vst4_u8(dst + (x + half * 8) * 4, out);
+        }
+    }
+#elif defined(PIXEL_CONVERTER_SSE2)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i lumaOffset = _mm_set1_epi16(16);
+    const __m128i chromaOffset = _mm_set1_epi16(128);
+    const __m128i redCoefficients = coefficientPairs(298, 409);
+    const __m128i greenCoefficients = coefficientPairs(298, -100);
+    const __m128i greenRedCoefficients = coefficientPairs(-208, 0);
+    const __m128i blueCoefficients = coefficientPairs(298, 516);
+    const __m128i alpha = _mm_set1_epi8(static_cast<char>(0xff));
+    for (; x + 16 <= width; x += 16) {
+        const __m128i luma = _mm_loadu_si128(
+                static_cast<const __m128i*>(static_cast<const void*>(y + x)));
+        __m128i blueDiff = _mm_loadl_epi64(
+                static_cast<const __m128i*>(static_cast<const void*>(cb + x / 2)));
+        __m128i redDiff = _mm_loadl_epi64(
+                static_cast<const __m128i*>(static_cast<const void*>(cr + x / 2)));
+        blueDiff = _mm_unpacklo_epi8(blueDiff, blueDiff);
+        redDiff = _mm_unpacklo_epi8(redDiff, redDiff);
+
+        __m128i channels[3][2];
+        for (size_t half = 0; half < 2; ++half) {
+            const __m128i c = _mm_sub_epi16(half == 0 ?
+                    _mm_unpacklo_epi8(luma, zero) :
+                    _mm_unpackhi_epi8(luma, zero), lumaOffset);
+            const __m128i d = _mm_sub_epi16(half == 0 ?
+                    _mm_unpacklo_epi8(blueDiff, zero) :
+                    _mm_unpackhi_epi8(blueDiff, zero), chromaOffset);
+            const __m128i e = _mm_sub_epi16(half == 0 ?
+                    _mm_unpacklo_epi8(redDiff, zero) :
+                    _mm_unpackhi_epi8(redDiff, zero), chromaOffset);
+            channels[0][half] = multiplyAddPairs(c, e, redCoefficients);
+            // The rounding is added once, by the first product
+            const __m128i greenLo = _mm_add_epi32(
+                    _mm_madd_epi16(_mm_unpacklo_epi16(c, d), greenCoefficients),
+                    _mm_madd_epi16(_mm_unpacklo_epi16(e, zero),
+                            greenRedCoefficients));
+            const __m128i greenHi = _mm_add_epi32(
+                    _mm_madd_epi16(_mm_unpackhi_epi16(c, d), greenCoefficients),
+                    _mm_madd_epi16(_mm_unpackhi_epi16(e, zero),
+                            greenRedCoefficients));
+            const __m128i rounding = _mm_set1_epi32(128);
+            channels[1][half] = _mm_packs_epi32(
+                    _mm_srai_epi32(_mm_add_epi32(greenLo, rounding), 8),
+                    _mm_srai_epi32(_mm_add_epi32(greenHi, rounding), 8));
+            channels[2][half] = multiplyAddPairs(c, d, blueCoefficients);
+        }
+        const __m128i red = _mm_packus_epi16(channels[0][0], channels[0][1]);
+        const __m128i green = _mm_packus_epi16(channels[1][0], channels[1][1]);
+        const __m128i blue = _mm_packus_epi16(channels[2][0], channels[2][1]);
+        const __m128i first = swapRB ? blue : red;
+        const __m128i third = swapRB ? red : blue;
+        const __m128i firstGreenLo = _mm_unpacklo_epi8(first, green);
+        const __m128i firstGreenHi = _mm_unpackhi_epi8(first, green);
+        const __m128i thirdAlphaLo = _mm_unpacklo_epi8(third, alpha);
+        const __m128i thirdAlphaHi = _mm_unpackhi_epi8(third, alpha);
+        __m128i* out = static_cast<__m128i*>(static_cast<void*>(dst + x * 4));
+        _mm_storeu_si128(out, _mm_unpacklo_epi16(firstGreenLo, thirdAlphaLo));
+        _mm_storeu_si128(out + 1, _mm_unpackhi_epi16(firstGreenLo, thirdAlphaLo));
+        _mm_storeu_si128(out + 2, _mm_unpacklo_epi16(firstGreenHi, thirdAlphaHi));
+        _mm_storeu_si128(out + 3, _mm_unpackhi_epi16(firstGreenHi, thirdAlphaHi));
+    }
+#endif
+    for (; x < width; ++x) {
+        uint8_t r, g, b;
+        yuvToRgb(y[x], cb[x / 2], cr[x / 2], &r, &g, &b);
+        uint8_t* out = dst + x * 4;
+        out[0] = swapRB ? b : r;
+        out[1] = g;
+        out[2] = swapRB ? r : b;
+        out[3] = 0xff;
+    }
+}
+
+static bool getYuvPlanes(const CpuConsumer::LockedBuffer& src, YuvPlanes* planes) {
+    if (src.flexFormat == HAL_PIXEL_FORMAT_YCbCr_420_888) {
+        planes->y = src.data;
+        planes->cb = src.dataCb;
+        planes->cr = src.dataCr;
+        planes->yStride = src.stride;
+        planes->chromaStride = src.chromaStride;
+        planes->chromaStep = src.chromaStep;
+        return planes->cb != NULL && planes->cr != NULL &&
+                planes->chromaStep > 0;
+    }
+    // Buffers gralloc couldn't lock as flexible YUV; see the format
+    // definitions in system/graphics.h.
+    const size_t lumaSize = static_cast<size_t>(src.stride) * src.height;
+    switch (static_cast<int>(src.format)) {
+        case HAL_PIXEL_FORMAT_YV12:
+            planes->y = src.data;
+            planes->yStride = src.stride;
+            planes->chromaStride = (planes->yStride / 2 + 15) & ~size_t(15);
+            planes->cr = src.data + lumaSize;
+            planes->cb = planes->cr + planes->chromaStride * (src.height / 2);
+            planes->chromaStep = 1;
+            return true;
+        case HAL_PIXEL_FORMAT_YCrCb_420_SP:
+            planes->y = src.data;
+            planes->yStride = src.stride;
+            planes->chromaStride = src.stride;
+            planes->cr = src.data + lumaSize;
+            planes->cb = planes->cr + 1;
+            planes->chromaStep = 2;
+            return true;
+        default:
+            return false;
+    }
+}
+
+
+bool PixelConverter::isSupportedSource(const CpuConsumer::LockedBuffer& src) {
+    switch (static_cast<int>(src.format)) {
+        case HAL_PIXEL_FORMAT_RGBA_8888:
+        case HAL_PIXEL_FORMAT_RGBX_8888:
+        case HAL_PIXEL_FORMAT_BGRA_8888:
+        case HAL_PIXEL_FORMAT_RGB_565:
+            return true;
+        default: {
+            YuvPlanes planes;
+            return getYuvPlanes(src, &planes);
+        }
+    }
+}
+
+bool PixelConverter::isSupportedDestination(PixelFormat format) {
+    switch (format) {
+        case HAL_PIXEL_FORMAT_RGBA_8888:
+        case HAL_PIXEL_FORMAT_RGBX_8888:
+        case HAL_PIXEL_FORMAT_BGRA_8888:
+            return true;
+        default:
+            return false;
+    }
+}
+
+status_t PixelConverter::convert(const CpuConsumer::LockedBuffer& src,
+        uint8_t* dst, uint32_t dstWidth, uint32_t dstHeight,
+        uint32_t dstStride, PixelFormat dstFormat) {
+    ATRACE_CALL();
+    if (src.data == NULL || dst == NULL) {
+        ALOGE("convert: NULL buffer");
+        return BAD_VALUE;
+    }
+    if (!isSupportedSource(src) || !isSupportedDestination(dstFormat)) {
+        ALOGE("convert: unsupported conversion from %#x to %#x", src.format,
+                dstFormat);
+        return BAD_VALUE;
+    }
+
+    Rect crop(src.crop);
+    if (crop.isEmpty()) {
+        crop = Rect(src.width, src.height);
+    }
+    if (crop.left < 0 || crop.top < 0 ||
+            static_cast<uint32_t>(crop.right) > src.width ||
+            static_cast<uint32_t>(crop.bottom) > src.height) {
+        ALOGE("convert: crop [%d %d %d %d] is outside the %ux%u buffer",
+                crop.left, crop.top, crop.right, crop.bottom, src.width,
+                src.height);
+        return BAD_VALUE;
+    }
+    const size_t srcWidth = static_cast<size_t>(crop.getWidth());
+    const size_t srcHeight = static_cast<size_t>(crop.getHeight());
+    if (dstWidth == 0 || dstHeight == 0 || dstWidth > srcWidth ||
+            dstHeight > srcHeight || dstStride < dstWidth) {
+        ALOGE("convert: can't convert %zux%zu to %ux%u (stride %u)", srcWidth,
+                srcHeight, dstWidth, dstHeight, dstStride);
+        return BAD_VALUE;
+    }
+
+    const size_t left = static_cast<size_t>(crop.left);
+    const size_t top = static_cast<size_t>(crop.top);
+    const bool srcIsBgra = src.format == HAL_PIXEL_FORMAT_BGRA_8888;
+    const bool swapRB = srcIsBgra != (dstFormat == HAL_PIXEL_FORMAT_BGRA_8888);
+    const bool opaque = dstFormat == HAL_PIXEL_FORMAT_RGBX_8888 ||
+            src.format == HAL_PIXEL_FORMAT_RGBX_8888;
+    YuvPlanes planes;
+    const bool isYuv = src.format != HAL_PIXEL_FORMAT_RGBA_8888 &&
+            src.format != HAL_PIXEL_FORMAT_RGBX_8888 && !srcIsBgra &&
+            src.format != HAL_PIXEL_FORMAT_RGB_565 &&
+            getYuvPlanes(src, &planes);
+
+    // Without scaling, rows are converted straight into dst. Otherwise each
+    // sampled source row is converted into a scratch row first.
+    const bool scaling = dstWidth != srcWidth || dstHeight != srcHeight;
+    std::vector<uint8_t> scratchRow(scaling ? srcWidth * 4 : 0);
+    std::vector<size_t> sampledColumns(scaling ? dstWidth : 0);
+    for (size_t dx = 0; dx < sampledColumns.size(); ++dx) {
+        sampledColumns[dx] = (2 * dx + 1) * srcWidth / (2 * dstWidth);
+    }
+    // The chroma of a row is made contiguous first if it's interleaved, e.g.
+    // NV21. One extra sample covers crops starting at an odd column.
+    const size_t chromaWidth = srcWidth / 2 + 2;
+    const bool deinterleave = isYuv && planes.chromaStep != 1;
+    std::vector<uint8_t> chromaRows(deinterleave ? chromaWidth * 2 : 0);
+
+    for (size_t dy = 0; dy < dstHeight; ++dy) {
+        const size_t sy = top + (scaling ?
+                (2 * dy + 1) * srcHeight / (2 * dstHeight) : dy);
+        uint8_t* dstRow = dst + dy * dstStride * 4;
+        uint8_t* out = scaling ? scratchRow.data() : dstRow;
+
+        if (isYuv) {
+            const uint8_t* y = planes.y + sy * planes.yStride + left;
+            const size_t chromaOffset = (sy / 2) * planes.chromaStride +
+                    (left / 2) * planes.chromaStep;
+            const uint8_t* cb = planes.cb + chromaOffset;
+            const uint8_t* cr = planes.cr + chromaOffset;
+            if (deinterleave) {
+                const size_t count = (left % 2 + srcWidth + 1) / 2;
+                uint8_t* contiguousCb = chromaRows.data();
+                uint8_t* contiguousCr = chromaRows.data() + chromaWidth;
+                for (size_t i = 0; i < count; ++i) {
+                    contiguousCb[i] = cb[i * planes.chromaStep];
+                    contiguousCr[i] = cr[i * planes.chromaStep];
+                }
+                cb = contiguousCb;
+                cr = contiguousCr;
+            }
+            size_t width = srcWidth;
+            if (left % 2 != 0) {
+                // The first pixel shares its chroma with the one left of the
+                // crop; convert it on its own so the rest are paired.
+                uint8_t r, g, b;
+                yuvToRgb(*y, *cb, *cr, &r, &g, &b);
+                out[0] = swapRB ? b : r;
+                out[1] = g;
+                out[2] = swapRB ? r : b;
+                out[3] = 0xff;
+                ++y;
+                ++cb;
+                ++cr;
+                out += 4;
+                --width;
+            }
+            convertYuvRow(y, cb, cr, out, width, swapRB);
+        } else if (src.format == HAL_PIXEL_FORMAT_RGB_565) {
+            convertRgb565Row(src.data + (sy * src.stride + left) * 2, out,
+                    srcWidth, swapRB);
+        } else {
+            convertRgbaRow(src.data + (sy * src.stride + left) * 4, out,
+                    srcWidth, swapRB, opaque);
+        }
+
+        if (scaling) {
+            for (size_t dx = 0; dx < sampledColumns.size(); ++dx) {
+                memcpy(dstRow + dx * 4, &scratchRow[sampledColumns[dx] * 4], 4);
+            }
+        }
+    }
+    return NO_ERROR;
+}
+
+} // namespace android
@@ -56,13 +56,15 @@ status_t StreamSplitter::createSplitter(
 
 StreamSplitter::StreamSplitter(const sp<IGraphicBufferConsumer>& inputQueue)
       : mIsAbandoned(false), mMutex(), mReleaseCondition(),
-        mOutstandingBuffers(0), mInput(inputQueue), mOutputs(), mBuffers() {}
+        mOutstandingBuffers(0), mInput(inputQueue), mOutputs(), mBuffers(),
+        mFrameCount(0), mSkippedFrameCount(0), mStallCount(0),
+        mTotalStallTime(0) {}
 
 StreamSplitter::~StreamSplitter() {
     mInput->consumerDisconnect();
-    Vector<sp<IGraphicBufferProducer> >::iterator output = mOutputs.begin();
+    Vector<Output>::iterator output = mOutputs.begin();
     for (; output != mOutputs.end(); ++output) {
-        (*output)->disconnect(NATIVE_WINDOW_API_CPU);
+        output->queue->disconnect(NATIVE_WINDOW_API_CPU);
     }
 
     if (mBuffers.size() > 0) {
@@ -71,7 +73,7 @@ StreamSplitter::~StreamSplitter() {
 }
 
 status_t StreamSplitter::addOutput(
-        const sp<IGraphicBufferProducer>& outputQueue) {
+        const sp<IGraphicBufferProducer>& outputQueue, size_t maxQueueDepth) {
     if (outputQueue == NULL) {
         ALOGE("addOutput: outputQueue must not be NULL");
         return BAD_VALUE;
@@ -80,7 +82,7 @@ status_t StreamSplitter::addOutput(
     Mutex::Autolock lock(mMutex);
 
     IGraphicBufferProducer::QueueBufferOutput queueBufferOutput;
-    sp<OutputListener> listener(new OutputListener(this, outputQueue));
+    sp<OutputListener> listener(new OutputListener(this, mOutputs.size()));
     IInterface::asBinder(outputQueue)->linkToDeath(listener);
     status_t status = outputQueue->connect(listener, NATIVE_WINDOW_API_CPU,
             /* producerControlledByApp */ false, &queueBufferOutput);
@@ -89,7 +91,7 @@ status_t StreamSplitter::addOutput(
         return status;
     }
 
-    mOutputs.push_back(outputQueue);
+    mOutputs.push_back(Output(outputQueue, maxQueueDepth));
 
     return NO_ERROR;
 }
@@ -99,46 +101,105 @@ void StreamSplitter::setName(const String8 &name) {
     mInput->setConsumerName(name);
 }
 
+void StreamSplitter::dump(String8& result, const char* prefix) const {
+    Mutex::Autolock lock(mMutex);
+    result.appendFormat("%sStreamSplitter: %" PRIu64 " frames, %" PRIu64
+            " skipped by all outputs, %d outstanding, stalled %" PRIu64
+            " times for %.1f ms%s\n", prefix, mFrameCount, mSkippedFrameCount,
+            mOutstandingBuffers, mStallCount,
+            static_cast<double>(mTotalStallTime) / 1e6,
+            mIsAbandoned ? " (abandoned)" : "");
+    for (size_t i = 0; i < mOutputs.size(); ++i) {
+        const Output& output(mOutputs[i]);
+        const double averageHoldTime = output.releasedCount > 0 ?
+                static_cast<double>(output.totalHoldTime) /
+                static_cast<double>(output.releasedCount) / 1e6 : 0.0;
+        result.appendFormat("%s  output %zu (max depth ", prefix, i);
+        if (output.maxQueueDepth > 0) {
+            result.appendFormat("%zu", output.maxQueueDepth);
+        } else {
+            result.append("unlimited");
+        }
+        result.appendFormat("): queued %" PRIu64 ", skipped %" PRIu64
+                ", holding %zu, hold time avg %.2f ms max %.2f ms\n",
+                output.queuedCount, output.skippedCount, output.held,
+                averageHoldTime,
+                static_cast<double>(output.maxHoldTime) / 1e6);
+    }
+}
+
 void StreamSplitter::onFrameAvailable(const BufferItem& /* item */) {
     ATRACE_CALL();
     Mutex::Autolock lock(mMutex);
 
-    // The current policy is that if any one consumer is consuming buffers too
+    // If any output without a queue depth limit is consuming buffers too
     // slowly, the splitter will stall the rest of the outputs by not acquiring
     // any more buffers from the input. This will cause back pressure on the
-    // input queue, slowing down its producer.
-
-    // If there are too many outstanding buffers, we block until a buffer is
-    // released back to the input in onBufferReleased
-    while (mOutstandingBuffers >= MAX_OUTSTANDING_BUFFERS) {
-        mReleaseCondition.wait(mMutex);
-
-        // If the splitter is abandoned while we are waiting, the release
-        // condition variable will be broadcast, and we should just return
-        // without attempting to do anything more (since the input queue will
-        // also be abandoned).
-        if (mIsAbandoned) {
-            return;
+    // input queue, slowing down its producer. Outputs with a queue depth limit
+    // skip buffers instead, so they never stall the others.
+
+    // If too many buffers are held by such outputs, we block until one of them
+    // releases a buffer in onBufferReleasedByOutput
+    if (mOutstandingBuffers >= MAX_OUTSTANDING_BUFFERS) {
+        ATRACE_NAME("stalled");
+        const nsecs_t stallStart = systemTime(SYSTEM_TIME_MONOTONIC);
+        while (mOutstandingBuffers >= MAX_OUTSTANDING_BUFFERS) {
+            mReleaseCondition.wait(mMutex);
+
+            // If the splitter is abandoned while we are waiting, the release
+            // condition variable will be broadcast, and we should just return
+            // without attempting to do anything more (since the input queue
+            // will also be abandoned).
+            if (mIsAbandoned) {
+                return;
+            }
         }
+        ++mStallCount;
+        mTotalStallTime += systemTime(SYSTEM_TIME_MONOTONIC) - stallStart;
     }
-    ++mOutstandingBuffers;
 
-    // Acquire and detach the buffer from the input
+    // Acquire the buffer from the input
     BufferItem bufferItem;
     status_t status = mInput->acquireBuffer(&bufferItem, /* presentWhen */ 0);
     LOG_ALWAYS_FATAL_IF(status != NO_ERROR,
             "acquiring buffer from input failed (%d)", status);
+    ++mFrameCount;
 
     ALOGV("acquired buffer %#" PRIx64 " from input",
             bufferItem.mGraphicBuffer->getId());
 
+    // Pick the outputs that take this buffer
+    Vector<size_t> targets;
+    for (size_t i = 0; i < mOutputs.size(); ++i) {
+        Output& output(mOutputs.editItemAt(i));
+        if (output.maxQueueDepth > 0 && output.held >= output.maxQueueDepth) {
+            ALOGV("output %zu is full, skipping buffer %#" PRIx64, i,
+                    bufferItem.mGraphicBuffer->getId());
+            ++output.skippedCount;
+            continue;
+        }
+        targets.push_back(i);
+    }
+
+    if (targets.isEmpty()) {
+        // Nobody has room for it; give it back as is, without detaching it
+        ++mSkippedFrameCount;
+        status = mInput->releaseBuffer(bufferItem.mSlot,
+                bufferItem.mFrameNumber, EGL_NO_DISPLAY, EGL_NO_SYNC_KHR,
+                bufferItem.mFence);
+        LOG_ALWAYS_FATAL_IF(status != NO_ERROR,
+                "releasing buffer to input failed (%d)", status);
+        return;
+    }
+
+    // Detach the buffer from the input
     status = mInput->detachBuffer(bufferItem.mSlot);
     LOG_ALWAYS_FATAL_IF(status != NO_ERROR,
             "detaching buffer from input failed (%d)", status);
 
     // Initialize our reference count for this buffer
-    mBuffers.add(bufferItem.mGraphicBuffer->getId(),
-            new BufferTracker(bufferItem.mGraphicBuffer));
+    sp<BufferTracker> tracker(new BufferTracker(bufferItem.mGraphicBuffer));
+    mBuffers.add(bufferItem.mGraphicBuffer->getId(), tracker);
 
     IGraphicBufferProducer::QueueBufferInput queueInput(
             bufferItem.mTimestamp, bufferItem.mIsAutoTimestamp,
@@ -146,18 +207,16 @@ void StreamSplitter::onFrameAvailable(const BufferItem& /* item */) {
             static_cast<int32_t>(bufferItem.mScalingMode),
             bufferItem.mTransform, bufferItem.mFence);
 
-    // Attach and queue the buffer to each of the outputs
-    Vector<sp<IGraphicBufferProducer> >::iterator output = mOutputs.begin();
-    for (; output != mOutputs.end(); ++output) {
+    // Attach and queue the buffer to each of the chosen outputs
+    for (size_t i = 0; i < targets.size(); ++i) {
+        Output& output(mOutputs.editItemAt(targets[i]));
         int slot;
-        status = (*output)->attachBuffer(&slot, bufferItem.mGraphicBuffer);
+        status = output.queue->attachBuffer(&slot, bufferItem.mGraphicBuffer);
         if (status == NO_INIT) {
             // If we just discovered that this output has been abandoned, note
-            // that, increment the release count so that we still release this
-            // buffer eventually, and move on to the next output
+            // that, and move on to the next output without counting it as
+            // holding the buffer
             onAbandonedLocked();
-            mBuffers.editValueFor(bufferItem.mGraphicBuffer->getId())->
-                    incrementReleaseCountLocked();
             continue;
         } else {
             LOG_ALWAYS_FATAL_IF(status != NO_ERROR,
@@ -165,33 +224,42 @@ void StreamSplitter::onFrameAvailable(const BufferItem& /* item */) {
         }
 
         IGraphicBufferProducer::QueueBufferOutput queueOutput;
-        status = (*output)->queueBuffer(slot, queueInput, &queueOutput);
+        status = output.queue->queueBuffer(slot, queueInput, &queueOutput);
         if (status == NO_INIT) {
             // If we just discovered that this output has been abandoned, note
-            // that, increment the release count so that we still release this
-            // buffer eventually, and move on to the next output
+            // that, and move on to the next output without counting it as
+            // holding the buffer
             onAbandonedLocked();
-            mBuffers.editValueFor(bufferItem.mGraphicBuffer->getId())->
-                    incrementReleaseCountLocked();
             continue;
         } else {
             LOG_ALWAYS_FATAL_IF(status != NO_ERROR,
                     "queueing buffer to output failed (%d)", status);
         }
 
-        ALOGV("queued buffer %#" PRIx64 " to output %p",
-                bufferItem.mGraphicBuffer->getId(), output->get());
+        tracker->addHolderLocked(output.maxQueueDepth == 0);
+        ++output.held;
+        ++output.queuedCount;
+
+        ALOGV("queued buffer %#" PRIx64 " to output %zu",
+                bufferItem.mGraphicBuffer->getId(), targets[i]);
+    }
+
+    if (tracker->getHolderCountLocked(true) > 0) {
+        ++mOutstandingBuffers;
+    } else if (tracker->getHolderCountLocked(false) == 0) {
+        // Every output turned out to be abandoned
+        mBuffers.removeItem(bufferItem.mGraphicBuffer->getId());
     }
 }
 
-void StreamSplitter::onBufferReleasedByOutput(
-        const sp<IGraphicBufferProducer>& from) {
+void StreamSplitter::onBufferReleasedByOutput(size_t outputIndex) {
     ATRACE_CALL();
     Mutex::Autolock lock(mMutex);
 
+    Output& output(mOutputs.editItemAt(outputIndex));
     sp<GraphicBuffer> buffer;
     sp<Fence> fence;
-    status_t status = from->detachNextBuffer(&buffer, &fence);
+    status_t status = output.queue->detachNextBuffer(&buffer, &fence);
     if (status == NO_INIT) {
         // If we just discovered that this output has been abandoned, note that,
         // but we can't do anything else, since buffer is invalid
@@ -202,33 +270,56 @@ void StreamSplitter::onBufferReleasedByOutput(
                 "detaching buffer from output failed (%d)", status);
     }
 
-    ALOGV("detached buffer %#" PRIx64 " from output %p",
-          buffer->getId(), from.get());
+    ALOGV("detached buffer %#" PRIx64 " from output %zu",
+          buffer->getId(), outputIndex);
 
-    const sp<BufferTracker>& tracker = mBuffers.editValueFor(buffer->getId());
+    const sp<BufferTracker> tracker = mBuffers.valueFor(buffer->getId());
+
+    const nsecs_t holdTime =
+            systemTime(SYSTEM_TIME_MONOTONIC) - tracker->getQueueTime();
+    --output.held;
+    ++output.releasedCount;
+    output.totalHoldTime += holdTime;
+    if (holdTime > output.maxHoldTime) {
+        output.maxHoldTime = holdTime;
+    }
 
     // Merge the release fence of the incoming buffer so that the fence we send
     // back to the input includes all of the outputs' fences
     tracker->mergeFence(fence);
 
+    const bool blocking = output.maxQueueDepth == 0;
+    size_t holders = tracker->removeHolderLocked(blocking);
+    if (blocking && tracker->getHolderCountLocked(true) == 0) {
+        // Notify any waiting onFrameAvailable calls
+        --mOutstandingBuffers;
+        mReleaseCondition.signal();
+    }
+
     // Check to see if this is the last outstanding reference to this buffer
-    size_t releaseCount = tracker->incrementReleaseCountLocked();
-    ALOGV("buffer %#" PRIx64 " reference count %zu (of %zu)", buffer->getId(),
-            releaseCount, mOutputs.size());
-    if (releaseCount < mOutputs.size()) {
+    ALOGV("buffer %#" PRIx64 " still held by %zu outputs", buffer->getId(),
+            holders);
+    if (holders > 0) {
         return;
     }
 
+    releaseToInputLocked(tracker);
+}
+
+void StreamSplitter::releaseToInputLocked(const sp<BufferTracker>& tracker) {
+    const sp<GraphicBuffer>& buffer(tracker->getBuffer());
+    const uint64_t bufferId = buffer->getId();
+
     // If we've been abandoned, we can't return the buffer to the input, so just
     // stop tracking it and move on
     if (mIsAbandoned) {
-        mBuffers.removeItem(buffer->getId());
+        mBuffers.removeItem(bufferId);
         return;
     }
 
     // Attach and release the buffer back to the input
     int consumerSlot;
-    status = mInput->attachBuffer(&consumerSlot, tracker->getBuffer());
+    status_t status = mInput->attachBuffer(&consumerSlot, buffer);
     LOG_ALWAYS_FATAL_IF(status != NO_ERROR,
             "attaching buffer to input failed (%d)", status);
 
@@ -237,15 +328,11 @@ void StreamSplitter::onBufferReleasedByOutput(
     LOG_ALWAYS_FATAL_IF(status != NO_ERROR,
             "releasing buffer to input failed (%d)", status);
 
-    ALOGV("released buffer %#" PRIx64 " to input", buffer->getId());
+    ALOGV("released buffer %#" PRIx64 " to input", bufferId);
 
     // We no longer need to track the buffer once it has been returned to the
     // input
-    mBuffers.removeItem(buffer->getId());
-
-    // Notify any waiting onFrameAvailable calls
-    --mOutstandingBuffers;
-    mReleaseCondition.signal();
+    mBuffers.removeItem(bufferId);
 }
 
 void StreamSplitter::onAbandonedLocked() {
@@ -258,14 +345,13 @@ void StreamSplitter::onAbandonedLocked() {
 }
 
 StreamSplitter::OutputListener::OutputListener(
-        const sp<StreamSplitter>& splitter,
-        const sp<IGraphicBufferProducer>& output)
-      : mSplitter(splitter), mOutput(output) {}
+        const sp<StreamSplitter>& splitter, size_t outputIndex)
+      : mSplitter(splitter), mOutputIndex(outputIndex) {}
 
 StreamSplitter::OutputListener::~OutputListener() {}
 
 void StreamSplitter::OutputListener::onBufferReleased() {
-    mSplitter->onBufferReleasedByOutput(mOutput);
+    mSplitter->onBufferReleasedByOutput(mOutputIndex);
 }
 
 void StreamSplitter::OutputListener::binderDied(const wp<IBinder>& /* who */) {
@@ -273,13 +359,43 @@ void StreamSplitter::OutputListener::binderDied(const wp<IBinder>& /* who */) {
     mSplitter->onAbandonedLocked();
 }
 
+StreamSplitter::Output::Output(const sp<IGraphicBufferProducer>& _queue,
+        size_t _maxQueueDepth)
+      : queue(_queue), maxQueueDepth(_maxQueueDepth), held(0), queuedCount(0),
+        skippedCount(0), releasedCount(0), totalHoldTime(0), maxHoldTime(0) {}
+
 StreamSplitter::BufferTracker::BufferTracker(const sp<GraphicBuffer>& buffer)
-      : mBuffer(buffer), mMergedFence(Fence::NO_FENCE), mReleaseCount(0) {}
+      : mBuffer(buffer), mMergedFence(Fence::NO_FENCE),
+        mQueueTime(systemTime(SYSTEM_TIME_MONOTONIC)), mHolders(0),
+        mBlockingHolders(0) {}
 
 StreamSplitter::BufferTracker::~BufferTracker() {}
 
 void StreamSplitter::BufferTracker::mergeFence(const sp<Fence>& with) {
+    // Only merge (which creates a new sync file) when both fences are
+    // pending; outputs released without a fence are the common case.
+    if (with == NULL || !with->isValid()) {
+        return;
+    }
+    if (!mMergedFence->isValid()) {
+        mMergedFence = with;
+        return;
+    }
     mMergedFence = Fence::merge(String8("StreamSplitter"), mMergedFence, with);
 }
 
+void StreamSplitter::BufferTracker::addHolderLocked(bool blocking) {
+    ++mHolders;
+    if (blocking) {
+        ++mBlockingHolders;
+    }
+}
+
+size_t StreamSplitter::BufferTracker::removeHolderLocked(bool blocking) {
+    if (blocking) {
+        --mBlockingHolders;
+    }
+    return --mHolders;
+}
+
 } // namespace android
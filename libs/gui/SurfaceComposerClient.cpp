@@ -275,15 +275,32 @@ void Composer::setAnimationTransactionImpl() {
 layer_state_t* Composer::getLayerStateLocked(
         const sp<SurfaceComposerClient>& client, const sp<IBinder>& id) {
 
+    // This runs for every property set on a layer, so look the layer up
+    // without building a ComposerState (and its Region) first. The order is
+    // the one of compare_type() above.
+    const sp<ISurfaceComposerClient>& composerClient(client->mClient);
+    ComposerState* const states = mComposerStates.editArray();
+    size_t low = 0;
+    size_t high = mComposerStates.size();
+    while (low < high) {
+        const size_t mid = low + (high - low) / 2;
+        const ComposerState& s(states[mid]);
+        if (s.client == composerClient && s.state.surface == id) {
+            return &(states[mid].state);
+        }
+        if (s.client < composerClient ||
+                (s.client == composerClient && s.state.surface < id)) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    // we don't have it, add an initialized layer_state to our list
     ComposerState s;
-    s.client = client->mClient;
+    s.client = composerClient;
     s.state.surface = id;
-
-    ssize_t index = mComposerStates.indexOf(s);
-    if (index < 0) {
-        // we don't have it, add an initialized layer_state to our list
-        index = mComposerStates.add(s);
-    }
+    ssize_t index = mComposerStates.add(s);
 
     ComposerState* const out = mComposerStates.editArray();
     return &(out[index].state);
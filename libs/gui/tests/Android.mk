@@ -15,7 +15,9 @@ LOCAL_SRC_FILES := \
     FillBuffer.cpp \
     GLTest.cpp \
     IGraphicBufferProducer_test.cpp \
+    LayerState_test.cpp \
     MultiTextureConsumer_test.cpp \
+    PixelConverter_test.cpp \
     SRGB_test.cpp \
     StreamSplitter_test.cpp \
     SurfaceTextureClient_test.cpp \
@@ -42,6 +44,37 @@ LOCAL_SHARED_LIBRARIES := \
 # to integrate with auto-test framework.
 include $(BUILD_NATIVE_TEST)
 
+# Build the benchmarks.
+include $(CLEAR_VARS)
+LOCAL_ADDITIONAL_DEPENDENCIES := $(LOCAL_PATH)/Android.mk
+LOCAL_CLANG := true
+LOCAL_MODULE := BufferQueue_benchmark
+LOCAL_MODULE_TAGS := tests
+LOCAL_SRC_FILES := BufferQueue_benchmark.cpp
+LOCAL_SHARED_LIBRARIES := libbinder libcutils libgui libui libutils
+LOCAL_CFLAGS += -O3
+include $(BUILD_NATIVE_TEST)
+
+include $(CLEAR_VARS)
+LOCAL_ADDITIONAL_DEPENDENCIES := $(LOCAL_PATH)/Android.mk
+LOCAL_CLANG := true
+LOCAL_MODULE := LayerState_benchmark
+LOCAL_MODULE_TAGS := tests
+LOCAL_SRC_FILES := LayerState_benchmark.cpp
+LOCAL_SHARED_LIBRARIES := libbinder libcutils libgui libui libutils
+LOCAL_CFLAGS += -O3
+include $(BUILD_NATIVE_TEST)
+
+include $(CLEAR_VARS)
+LOCAL_ADDITIONAL_DEPENDENCIES := $(LOCAL_PATH)/Android.mk
+LOCAL_CLANG := true
+LOCAL_MODULE := PixelConverter_benchmark
+LOCAL_MODULE_TAGS := tests
+LOCAL_SRC_FILES := PixelConverter_benchmark.cpp
+LOCAL_SHARED_LIBRARIES := libgui libui libutils
+LOCAL_CFLAGS += -O3
+include $(BUILD_NATIVE_TEST)
+
 # Include subdirectory makefiles
 # ============================================================
 
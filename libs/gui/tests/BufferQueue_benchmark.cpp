@@ -0,0 +1,263 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Streams frames from the main thread to a consumer thread that polls for
+// them, as an in-process camera to encoder pipeline would, and reports the
+// time per frame and the time from queueBuffer to acquireBuffer, in the
+// default mode and in single producer/consumer mode. Then moves buffers
+// between the slot collections in random order on one thread and reports the
+// time per operation.
+//
+// Neither side waits forever: dequeueBuffer times out, and the consumer gives
+// up when no frame arrives for a while.
+
+#include "DummyConsumer.h"
+
+#include <gui/BufferItem.h>
+#include <gui/BufferQueue.h>
+#include <gui/IProducerListener.h>
+
+#include <ui/GraphicBuffer.h>
+
+#include <utils/Timers.h>
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <atomic>
+#include <random>
+#include <thread>
+#include <vector>
+
+using namespace android;
+
+// How long either side waits for the other before the run fails.
+static const nsecs_t kTimeout = seconds_to_nanoseconds(1);
+
+static bool runStreamingBenchmark(bool singleProducerConsumer, int frameCount,
+        nsecs_t* outFrameTime, nsecs_t* outLatency) {
+    sp<IGraphicBufferProducer> producer;
+    sp<IGraphicBufferConsumer> consumer;
+    BufferQueue::createBufferQueue(&producer, &consumer, NULL,
+            singleProducerConsumer);
+    IGraphicBufferProducer::QueueBufferOutput output;
+    if (consumer->consumerConnect(new DummyConsumer, false) != OK ||
+            producer->connect(new DummyProducerListener, NATIVE_WINDOW_API_CPU,
+                    false, &output) != OK ||
+            producer->setMaxDequeuedBufferCount(2) != OK ||
+            producer->setDequeueTimeout(kTimeout) != OK) {
+        fprintf(stderr, "failed to set up the BufferQueue\n");
+        return false;
+    }
+
+    std::atomic<bool> failed(false);
+    nsecs_t totalLatency = 0;
+    std::thread consumerThread([&]() {
+        uint64_t lastFrameNumber = 0;
+        int acquired = 0;
+        nsecs_t deadline = systemTime() + kTimeout;
+        while (acquired < frameCount && !failed) {
+            BufferItem item;
+            status_t result = consumer->acquireBuffer(&item, 0);
+            if (result == BufferQueue::NO_BUFFER_AVAILABLE) {
+                if (systemTime() > deadline) {
+                    fprintf(stderr, "no frame after frame %d\n", acquired);
+                    failed = true;
+                }
+                std::this_thread::yield();
+                continue;
+            }
+            if (result != OK || item.mFrameNumber != lastFrameNumber + 1) {
+                fprintf(stderr, "acquireBuffer failed (%d) or skipped a frame\n",
+                        result);
+                failed = true;
+                return;
+            }
+            totalLatency += systemTime() - item.mTimestamp;
+            lastFrameNumber = item.mFrameNumber;
+            consumer->releaseBuffer(item.mSlot, item.mFrameNumber,
+                    EGL_NO_DISPLAY, EGL_NO_SYNC_KHR, Fence::NO_FENCE);
+            ++acquired;
+            deadline = systemTime() + kTimeout;
+        }
+    });
+
+    const nsecs_t startTime = systemTime();
+    for (int i = 0; i < frameCount && !failed; ++i) {
+        int slot = BufferQueue::INVALID_BUFFER_SLOT;
+        sp<Fence> fence;
+        status_t result = producer->dequeueBuffer(&slot, &fence, 1, 1, 0,
+                GRALLOC_USAGE_SW_READ_OFTEN);
+        if (result == IGraphicBufferProducer::BUFFER_NEEDS_REALLOCATION) {
+            sp<GraphicBuffer> buffer;
+            result = producer->requestBuffer(slot, &buffer);
+        }
+        IGraphicBufferProducer::QueueBufferInput input(systemTime(), false,
+                HAL_DATASPACE_UNKNOWN, Rect(0, 0, 1, 1),
+                NATIVE_WINDOW_SCALING_MODE_FREEZE, 0, Fence::NO_FENCE);
+        if (result != OK || producer->queueBuffer(slot, input, &output) != OK) {
+            fprintf(stderr, "failed to produce frame %d: %d\n", i, result);
+            failed = true;
+        }
+    }
+    consumerThread.join();
+    if (failed) {
+        return false;
+    }
+
+    *outFrameTime = (systemTime() - startTime) / frameCount;
+    *outLatency = totalLatency / frameCount;
+    return true;
+}
+
+// Randomly dequeues, queues, cancels, acquires, releases and detaches and
+// reattaches buffers, as BufferQueue_test's SlotChurn does.
+static bool runSlotChurnBenchmark(int operationCount, nsecs_t* outOperationTime) {
+    sp<IGraphicBufferProducer> producer;
+    sp<IGraphicBufferConsumer> consumer;
+    BufferQueue::createBufferQueue(&producer, &consumer);
+    IGraphicBufferProducer::QueueBufferOutput output;
+    if (consumer->consumerConnect(new DummyConsumer, true) != OK ||
+            producer->connect(new DummyProducerListener, NATIVE_WINDOW_API_CPU,
+                    true, &output) != OK ||
+            consumer->setMaxAcquiredBufferCount(2) != OK ||
+            producer->setMaxDequeuedBufferCount(3) != OK) {
+        fprintf(stderr, "failed to set up the BufferQueue\n");
+        return false;
+    }
+
+    IGraphicBufferProducer::QueueBufferInput input(0ull, true,
+            HAL_DATASPACE_UNKNOWN, Rect::INVALID_RECT,
+            NATIVE_WINDOW_SCALING_MODE_FREEZE, 0, Fence::NO_FENCE);
+    std::minstd_rand random(42);
+    std::vector<int> dequeued;
+    std::vector<BufferItem> acquired;
+
+    const nsecs_t startTime = systemTime();
+    for (int i = 0; i < operationCount; ++i) {
+        int slot = BufferQueue::INVALID_BUFFER_SLOT;
+        sp<Fence> fence;
+        sp<GraphicBuffer> buffer;
+        status_t result = OK;
+        switch (random() % 7) {
+            case 0:
+            case 1:
+                if (dequeued.size() >= 3) break;
+                result = producer->dequeueBuffer(&slot, &fence, 0, 0, 0, 0);
+                if (result == WOULD_BLOCK) {
+                    result = OK;
+                    break;
+                }
+                if (result >= 0 && (result &
+                        IGraphicBufferProducer::BUFFER_NEEDS_REALLOCATION)) {
+                    result = producer->requestBuffer(slot, &buffer);
+                }
+                if (result >= 0) {
+                    result = OK;
+                    dequeued.push_back(slot);
+                }
+                break;
+            case 2:
+                if (dequeued.empty()) break;
+                result = producer->queueBuffer(dequeued.back(), input, &output);
+                dequeued.pop_back();
+                break;
+            case 3:
+                if (dequeued.empty()) break;
+                result = producer->cancelBuffer(dequeued.front(),
+                        Fence::NO_FENCE);
+                dequeued.erase(dequeued.begin());
+                break;
+            case 4: {
+                if (acquired.size() >= 2) break;
+                BufferItem item;
+                result = consumer->acquireBuffer(&item, 0);
+                if (result == BufferQueue::NO_BUFFER_AVAILABLE) {
+                    result = OK;
+                } else if (result == OK) {
+                    acquired.push_back(item);
+                }
+                break;
+            }
+            case 5:
+                if (acquired.empty()) break;
+                result = consumer->releaseBuffer(acquired.front().mSlot,
+                        acquired.front().mFrameNumber, EGL_NO_DISPLAY,
+                        EGL_NO_SYNC_KHR, Fence::NO_FENCE);
+                acquired.erase(acquired.begin());
+                break;
+            case 6:
+                if (dequeued.empty()) break;
+                slot = dequeued.back();
+                dequeued.pop_back();
+                result = producer->requestBuffer(slot, &buffer);
+                if (result == OK) {
+                    result = producer->detachBuffer(slot);
+                }
+                if (result == OK) {
+                    result = producer->attachBuffer(&slot, buffer);
+                }
+                if (result >= 0) {
+                    result = OK;
+                    dequeued.push_back(slot);
+                }
+                break;
+        }
+        if (result != OK) {
+            fprintf(stderr, "slot churn operation %d failed: %d\n", i, result);
+            return false;
+        }
+    }
+    *outOperationTime = (systemTime() - startTime) / operationCount;
+    return true;
+}
+
+int main(int argc, char** argv) {
+    int frameCount = 2000;
+    if (argc > 1) {
+        frameCount = atoi(argv[1]);
+    }
+    if (frameCount <= 0) {
+        fprintf(stderr, "usage: %s [frame count]\n", argv[0]);
+        return 1;
+    }
+
+    static const char* const kModes[] = {
+        "default mode:                 ",
+        "single producer/consumer mode:",
+    };
+    bool ok = true;
+    for (int spsc = 0; spsc < 2; ++spsc) {
+        nsecs_t frameTime = 0;
+        nsecs_t latency = 0;
+        if (!runStreamingBenchmark(spsc != 0, frameCount, &frameTime, &latency)) {
+            ok = false;
+            continue;
+        }
+        printf("%s %" PRId64 " ns/frame, %" PRId64 " ns queue-to-acquire\n",
+                kModes[spsc], frameTime, latency);
+    }
+
+    nsecs_t operationTime = 0;
+    if (runSlotChurnBenchmark(frameCount * 10, &operationTime)) {
+        printf("slot churn: %d operations, %" PRId64 " ns/operation\n",
+                frameCount * 10, operationTime);
+    } else {
+        ok = false;
+    }
+    return ok ? 0 : 1;
+}
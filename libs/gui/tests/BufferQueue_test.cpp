@@ -21,6 +21,8 @@
 
 #include <gui/BufferItem.h>
 #include <gui/BufferQueue.h>
+#include <gui/GraphicBufferAlloc.h>
+#include <gui/GraphicBufferPool.h>
 #include <gui/IProducerListener.h>
 
 #include <ui/GraphicBuffer.h>
@@ -34,7 +36,9 @@
 
 #include <gtest/gtest.h>
 
+#include <random>
 #include <thread>
+#include <vector>
 
 using namespace std::chrono_literals;
 
@@ -65,8 +69,9 @@ protected:
         ASSERT_GE(*bufferCount, 0);
     }
 
-    void createBufferQueue() {
-        BufferQueue::createBufferQueue(&mProducer, &mConsumer);
+    void createBufferQueue(bool singleProducerConsumer = false) {
+        BufferQueue::createBufferQueue(&mProducer, &mConsumer, NULL,
+                singleProducerConsumer);
     }
 
     void testBufferItem(const IGraphicBufferProducer::QueueBufferInput& input,
@@ -1067,4 +1072,431 @@ TEST_F(BufferQueueTest, TestDiscardFreeBuffers) {
     }
 }
 
+// Counts the buffers it allocates, so that a test can wait for a background
+// allocation.
+class CountingGraphicBufferAlloc : public GraphicBufferAlloc {
+public:
+    CountingGraphicBufferAlloc() : mCount(0) {}
+
+    virtual sp<GraphicBuffer> createGraphicBuffer(uint32_t width,
+            uint32_t height, PixelFormat format, uint32_t usage,
+            std::string requestorName, status_t* error) override {
+        sp<GraphicBuffer> buffer(GraphicBufferAlloc::createGraphicBuffer(width,
+                height, format, usage, requestorName, error));
+        Mutex::Autolock lock(mMutex);
+        ++mCount;
+        mCondition.broadcast();
+        return buffer;
+    }
+
+    size_t getCount() {
+        Mutex::Autolock lock(mMutex);
+        return mCount;
+    }
+
+    // Returns false if fewer than count buffers were allocated in time
+    bool waitForCount(size_t count, nsecs_t timeout) {
+        Mutex::Autolock lock(mMutex);
+        while (mCount < count) {
+            if (mCondition.waitRelative(mMutex, timeout) == TIMED_OUT) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+private:
+    Mutex mMutex;
+    Condition mCondition;
+    size_t mCount;
+};
+
+TEST_F(BufferQueueTest, PreallocatesAfterDefaultSizeChange) {
+    sp<CountingGraphicBufferAlloc> allocator(new CountingGraphicBufferAlloc);
+    BufferQueue::createBufferQueue(&mProducer, &mConsumer, allocator);
+    sp<DummyConsumer> dc(new DummyConsumer);
+    ASSERT_EQ(OK, mConsumer->consumerConnect(dc, false));
+    IGraphicBufferProducer::QueueBufferOutput output;
+    ASSERT_EQ(OK, mProducer->connect(new DummyProducerListener,
+            NATIVE_WINDOW_API_CPU, false, &output));
+
+    // Cycle one buffer so that the queue holds a free 1x1 buffer
+    int slot = BufferQueue::INVALID_BUFFER_SLOT;
+    sp<Fence> fence;
+    sp<GraphicBuffer> buffer;
+    ASSERT_EQ(IGraphicBufferProducer::BUFFER_NEEDS_REALLOCATION,
+            mProducer->dequeueBuffer(&slot, &fence, 0, 0, 0, 0));
+    ASSERT_EQ(OK, mProducer->requestBuffer(slot, &buffer));
+    IGraphicBufferProducer::QueueBufferInput input(0ull, true,
+            HAL_DATASPACE_UNKNOWN, Rect::INVALID_RECT,
+            NATIVE_WINDOW_SCALING_MODE_FREEZE, 0, Fence::NO_FENCE);
+    ASSERT_EQ(OK, mProducer->queueBuffer(slot, input, &output));
+    BufferItem item;
+    ASSERT_EQ(OK, mConsumer->acquireBuffer(&item, 0));
+    ASSERT_EQ(OK, mConsumer->releaseBuffer(item.mSlot, item.mFrameNumber,
+            EGL_NO_DISPLAY, EGL_NO_SYNC_KHR, Fence::NO_FENCE));
+
+    // Resizing replaces it in the background. The worker holds mIsAllocating
+    // until the new buffer is installed, so once it has been allocated the
+    // next dequeueBuffer gets it.
+    const size_t allocations = allocator->getCount();
+    ASSERT_EQ(OK, mConsumer->setDefaultBufferSize(2, 2));
+    ASSERT_TRUE(allocator->waitForCount(allocations + 1, s2ns(5)));
+
+    // The producer has to request the new buffer, but nothing is allocated
+    // while dequeueing it
+    ASSERT_EQ(IGraphicBufferProducer::BUFFER_NEEDS_REALLOCATION,
+            mProducer->dequeueBuffer(&slot, &fence, 0, 0, 0, 0));
+    ASSERT_EQ(OK, mProducer->requestBuffer(slot, &buffer));
+    ASSERT_EQ(2u, buffer->getWidth());
+    ASSERT_EQ(2u, buffer->getHeight());
+    ASSERT_EQ(allocations + 1, allocator->getCount());
+
+    String8 dump;
+    mConsumer->dumpState(dump, "");
+    ASSERT_NE(-1, dump.find("synchronous allocations=1, preallocated=1 "
+            "(dequeued 1)")) << dump.string();
+}
+
+TEST_F(BufferQueueTest, ReportsDequeueAndQueueTimes) {
+    createBufferQueue();
+    sp<DummyConsumer> dc(new DummyConsumer);
+    ASSERT_EQ(OK, mConsumer->consumerConnect(dc, false));
+    IGraphicBufferProducer::QueueBufferOutput output;
+    ASSERT_EQ(OK, mProducer->connect(new DummyProducerListener,
+            NATIVE_WINDOW_API_CPU, false, &output));
+
+    int slot = BufferQueue::INVALID_BUFFER_SLOT;
+    sp<Fence> fence;
+    sp<GraphicBuffer> buffer;
+    const nsecs_t beforeDequeue = systemTime();
+    ASSERT_EQ(IGraphicBufferProducer::BUFFER_NEEDS_REALLOCATION,
+            mProducer->dequeueBuffer(&slot, &fence, 0, 0, 0, 0));
+    ASSERT_EQ(OK, mProducer->requestBuffer(slot, &buffer));
+    std::this_thread::sleep_for(1ms);
+    const nsecs_t beforeQueue = systemTime();
+    IGraphicBufferProducer::QueueBufferInput input(0ull, true,
+            HAL_DATASPACE_UNKNOWN, Rect::INVALID_RECT,
+            NATIVE_WINDOW_SCALING_MODE_FREEZE, 0, Fence::NO_FENCE);
+    ASSERT_EQ(OK, mProducer->queueBuffer(slot, input, &output));
+
+    BufferItem item;
+    ASSERT_EQ(OK, mConsumer->acquireBuffer(&item, 0));
+    ASSERT_LE(beforeDequeue, item.mDequeueTime);
+    ASSERT_GT(beforeQueue, item.mDequeueTime);
+    ASSERT_LE(beforeQueue, item.mQueueTime);
+    ASSERT_GE(systemTime(), item.mQueueTime);
+
+    // Attached buffers were never dequeued
+    ASSERT_EQ(OK, mConsumer->detachBuffer(item.mSlot));
+    ASSERT_EQ(OK, mProducer->attachBuffer(&slot, item.mGraphicBuffer));
+    ASSERT_EQ(OK, mProducer->queueBuffer(slot, input, &output));
+    ASSERT_EQ(OK, mConsumer->acquireBuffer(&item, 0));
+    ASSERT_EQ(0, item.mDequeueTime);
+    ASSERT_LE(beforeQueue, item.mQueueTime);
+}
+
+TEST_F(BufferQueueTest, DumpsStallDiagnostics) {
+    createBufferQueue();
+    sp<DummyConsumer> dc(new DummyConsumer);
+    ASSERT_EQ(OK, mConsumer->consumerConnect(dc, false));
+    IGraphicBufferProducer::QueueBufferOutput output;
+    ASSERT_EQ(OK, mProducer->connect(new DummyProducerListener,
+            NATIVE_WINDOW_API_CPU, false, &output));
+    ASSERT_EQ(OK, mProducer->setDequeueTimeout(ms2ns(5)));
+
+    // The consumer holds one buffer and the other is queued, so the third
+    // dequeueBuffer times out
+    int slot = BufferQueue::INVALID_BUFFER_SLOT;
+    sp<Fence> fence;
+    sp<GraphicBuffer> buffer;
+    IGraphicBufferProducer::QueueBufferInput input(0ull, true,
+            HAL_DATASPACE_UNKNOWN, Rect::INVALID_RECT,
+            NATIVE_WINDOW_SCALING_MODE_FREEZE, 0, Fence::NO_FENCE);
+    for (int i = 0; i < 2; ++i) {
+        status_t result = mProducer->dequeueBuffer(&slot, &fence, 0, 0, 0, 0);
+        ASSERT_EQ(IGraphicBufferProducer::BUFFER_NEEDS_REALLOCATION, result);
+        ASSERT_EQ(OK, mProducer->requestBuffer(slot, &buffer));
+        ASSERT_EQ(OK, mProducer->queueBuffer(slot, input, &output));
+        if (i == 0) {
+            BufferItem item;
+            ASSERT_EQ(OK, mConsumer->acquireBuffer(&item, 0));
+        }
+    }
+    ASSERT_EQ(TIMED_OUT, mProducer->dequeueBuffer(&slot, &fence, 0, 0, 0, 0));
+
+    String8 dump;
+    mConsumer->dumpState(dump, "");
+    ASSERT_NE(-1, dump.find("-BufferQueue slots: 0 dequeued by pid ")) <<
+            dump.string();
+    ASSERT_NE(-1, dump.find("1 queued, 1 acquired by the consumer, "
+            "0 free buffers")) << dump.string();
+    ASSERT_NE(-1, dump.find("-BufferQueue dequeue wait: 3 samples")) <<
+            dump.string();
+    ASSERT_NE(-1, dump.find("-BufferQueue fence wait: 0 samples")) <<
+            dump.string();
+    ASSERT_NE(-1, dump.find("-BufferQueue allocation: ")) << dump.string();
+    ASSERT_NE(-1, dump.find("state=ACQUIRED")) << dump.string();
+    ASSERT_NE(-1, dump.find(" ms\n")) << dump.string();
+}
+
+TEST_F(BufferQueueTest, AdaptsQueueDepthToOccupancy) {
+    createBufferQueue();
+    sp<DummyConsumer> dc(new DummyConsumer);
+    ASSERT_EQ(OK, mConsumer->consumerConnect(dc, false));
+    IGraphicBufferProducer::QueueBufferOutput output;
+    ASSERT_EQ(OK, mProducer->connect(new DummyProducerListener,
+            NATIVE_WINDOW_API_CPU, false, &output));
+    ASSERT_EQ(OK, mProducer->setMaxDequeuedBufferCount(3));
+    ASSERT_EQ(OK, mConsumer->setAdaptiveQueueDepth(true));
+
+    int slot = BufferQueue::INVALID_BUFFER_SLOT;
+    sp<Fence> fence;
+    sp<GraphicBuffer> buffer;
+    IGraphicBufferProducer::QueueBufferInput input(0ull, true,
+            HAL_DATASPACE_UNKNOWN, Rect::INVALID_RECT,
+            NATIVE_WINDOW_SCALING_MODE_FREEZE, 0, Fence::NO_FENCE);
+    BufferItem item;
+    auto queueFrame = [&]() {
+        status_t result = mProducer->dequeueBuffer(&slot, &fence, 0, 0, 0, 0);
+        if (result == IGraphicBufferProducer::BUFFER_NEEDS_REALLOCATION) {
+            ASSERT_EQ(OK, mProducer->requestBuffer(slot, &buffer));
+        } else {
+            ASSERT_EQ(OK, result);
+        }
+        ASSERT_EQ(OK, mProducer->queueBuffer(slot, input, &output));
+    };
+
+    // Keep two frames waiting in the queue, so that the producer never needs
+    // more than one buffer at a time
+    for (int i = 0; i < 2; ++i) {
+        queueFrame();
+    }
+    for (int i = 0; i < 120; ++i) {
+        queueFrame();
+        ASSERT_EQ(OK, mConsumer->acquireBuffer(&item, 0));
+        ASSERT_EQ(OK, mConsumer->releaseBuffer(item.mSlot, item.mFrameNumber,
+                EGL_NO_DISPLAY, EGL_NO_SYNC_KHR, Fence::NO_FENCE));
+    }
+    String8 dump;
+    mConsumer->dumpState(dump, "");
+    ASSERT_NE(-1, dump.find("maxDequeued=2 (requested 3)")) << dump.string();
+    ASSERT_NE(-1, dump.find("lowered 3 -> 2 (0/60 frames stalled"))
+            << dump.string();
+
+    // Drain the queue; the producer can still dequeue all three buffers
+    for (int i = 0; i < 2; ++i) {
+        ASSERT_EQ(OK, mConsumer->acquireBuffer(&item, 0));
+        ASSERT_EQ(OK, mConsumer->releaseBuffer(item.mSlot, item.mFrameNumber,
+                EGL_NO_DISPLAY, EGL_NO_SYNC_KHR, Fence::NO_FENCE));
+    }
+    for (int i = 0; i < 3; ++i) {
+        status_t result = mProducer->dequeueBuffer(&slot, &fence, 0, 0, 0, 0);
+        ASSERT_TRUE(result == OK ||
+                result == IGraphicBufferProducer::BUFFER_NEEDS_REALLOCATION)
+                << result;
+    }
+    dump.clear();
+    mConsumer->dumpState(dump, "");
+    ASSERT_NE(-1, dump.find("restored 2 -> 3")) << dump.string();
+
+    // Disabling it drops the adaptive state from the dump
+    ASSERT_EQ(OK, mConsumer->setAdaptiveQueueDepth(false));
+    dump.clear();
+    mConsumer->dumpState(dump, "");
+    ASSERT_EQ(-1, dump.find("adaptive depth")) << dump.string();
+}
+
+TEST_F(BufferQueueTest, RecyclesBuffersAcrossQueues) {
+    GraphicBufferPool& pool(GraphicBufferPool::getInstance());
+    const size_t oldMaxBytes = pool.getMaxBytes();
+    pool.setMaxBytes(16 * 1024 * 1024);
+
+    IGraphicBufferProducer::QueueBufferOutput output;
+    IGraphicBufferProducer::QueueBufferInput input(0ull, true,
+            HAL_DATASPACE_UNKNOWN, Rect::INVALID_RECT,
+            NATIVE_WINDOW_SCALING_MODE_FREEZE, 0, Fence::NO_FENCE);
+    int slot = BufferQueue::INVALID_BUFFER_SLOT;
+    sp<Fence> fence;
+    sp<GraphicBuffer> buffer;
+
+    // Cycle one buffer through a queue, then tear the queue down
+    createBufferQueue();
+    ASSERT_EQ(OK, mConsumer->consumerConnect(new DummyConsumer, false));
+    ASSERT_EQ(OK, mProducer->connect(new DummyProducerListener,
+            NATIVE_WINDOW_API_CPU, false, &output));
+    ASSERT_EQ(IGraphicBufferProducer::BUFFER_NEEDS_REALLOCATION,
+            mProducer->dequeueBuffer(&slot, &fence, 64, 64, 0, 0));
+    ASSERT_EQ(OK, mProducer->requestBuffer(slot, &buffer));
+    const uint64_t recycledId = buffer->getId();
+    buffer.clear();
+    ASSERT_EQ(OK, mProducer->queueBuffer(slot, input, &output));
+    {
+        BufferItem item;
+        ASSERT_EQ(OK, mConsumer->acquireBuffer(&item, 0));
+        ASSERT_EQ(OK, mConsumer->releaseBuffer(item.mSlot, item.mFrameNumber,
+                EGL_NO_DISPLAY, EGL_NO_SYNC_KHR, Fence::NO_FENCE));
+    }
+    ASSERT_EQ(OK, mConsumer->consumerDisconnect());
+
+    // A new queue asking for the same attributes gets that buffer back
+    createBufferQueue();
+    ASSERT_EQ(OK, mConsumer->consumerConnect(new DummyConsumer, false));
+    ASSERT_EQ(OK, mProducer->connect(new DummyProducerListener,
+            NATIVE_WINDOW_API_CPU, false, &output));
+    ASSERT_EQ(IGraphicBufferProducer::BUFFER_NEEDS_REALLOCATION,
+            mProducer->dequeueBuffer(&slot, &fence, 64, 64, 0, 0));
+    ASSERT_EQ(OK, mProducer->requestBuffer(slot, &buffer));
+    ASSERT_EQ(recycledId, buffer->getId());
+
+    // but not one with a different size
+    ASSERT_EQ(OK, mProducer->cancelBuffer(slot, fence));
+    ASSERT_EQ(IGraphicBufferProducer::BUFFER_NEEDS_REALLOCATION,
+            mProducer->dequeueBuffer(&slot, &fence, 32, 32, 0, 0));
+    ASSERT_EQ(OK, mProducer->requestBuffer(slot, &buffer));
+    ASSERT_NE(recycledId, buffer->getId());
+
+    String8 dump;
+    pool.dump(dump, "");
+    pool.setMaxBytes(oldMaxBytes);
+    ASSERT_NE(-1, dump.find("hits=1 ")) << dump.string();
+}
+
+// Moves buffers through every slot collection (free slots, free buffers,
+// active buffers) in random order, then checks every slot is accounted for.
+TEST_F(BufferQueueTest, SlotChurn) {
+    createBufferQueue();
+    sp<DummyConsumer> dc(new DummyConsumer);
+    ASSERT_EQ(OK, mConsumer->consumerConnect(dc, true));
+    IGraphicBufferProducer::QueueBufferOutput output;
+    ASSERT_EQ(OK, mProducer->connect(new DummyProducerListener,
+            NATIVE_WINDOW_API_CPU, true, &output));
+    ASSERT_EQ(OK, mConsumer->setMaxAcquiredBufferCount(2));
+    ASSERT_EQ(OK, mProducer->setMaxDequeuedBufferCount(3));
+
+    const int OPERATION_COUNT = 20000;
+    IGraphicBufferProducer::QueueBufferInput input(0ull, true,
+            HAL_DATASPACE_UNKNOWN, Rect::INVALID_RECT,
+            NATIVE_WINDOW_SCALING_MODE_FREEZE, 0, Fence::NO_FENCE);
+    std::minstd_rand random(42);
+    std::vector<int> dequeued;
+    std::vector<BufferItem> acquired;
+
+    for (int i = 0; i < OPERATION_COUNT; ++i) {
+        int slot = BufferQueue::INVALID_BUFFER_SLOT;
+        sp<Fence> fence;
+        sp<GraphicBuffer> buffer;
+        switch (random() % 7) {
+            case 0:
+            case 1: {
+                if (dequeued.size() >= 3) break;
+                status_t result = mProducer->dequeueBuffer(&slot, &fence,
+                        0, 0, 0, 0);
+                if (result == WOULD_BLOCK) break;
+                ASSERT_GE(result, 0);
+                if (result & IGraphicBufferProducer::BUFFER_NEEDS_REALLOCATION) {
+                    ASSERT_EQ(OK, mProducer->requestBuffer(slot, &buffer));
+                }
+                dequeued.push_back(slot);
+                break;
+            }
+            case 2:
+                if (dequeued.empty()) break;
+                ASSERT_EQ(OK, mProducer->queueBuffer(dequeued.back(), input,
+                        &output));
+                dequeued.pop_back();
+                break;
+            case 3:
+                if (dequeued.empty()) break;
+                ASSERT_EQ(OK, mProducer->cancelBuffer(dequeued.front(),
+                        Fence::NO_FENCE));
+                dequeued.erase(dequeued.begin());
+                break;
+            case 4: {
+                if (acquired.size() >= 2) break;
+                BufferItem item;
+                status_t result = mConsumer->acquireBuffer(&item, 0);
+                if (result == BufferQueue::NO_BUFFER_AVAILABLE) break;
+                ASSERT_EQ(OK, result);
+                acquired.push_back(item);
+                break;
+            }
+            case 5:
+                if (acquired.empty()) break;
+                ASSERT_EQ(OK, mConsumer->releaseBuffer(acquired.front().mSlot,
+                        acquired.front().mFrameNumber, EGL_NO_DISPLAY,
+                        EGL_NO_SYNC_KHR, Fence::NO_FENCE));
+                acquired.erase(acquired.begin());
+                break;
+            case 6:
+                // Detach a dequeued buffer and attach it again, freeing a
+                // slot and taking one.
+                if (dequeued.empty()) break;
+                slot = dequeued.back();
+                ASSERT_EQ(OK, mProducer->requestBuffer(slot, &buffer));
+                ASSERT_EQ(OK, mProducer->detachBuffer(slot));
+                dequeued.pop_back();
+                ASSERT_GE(mProducer->attachBuffer(&slot, buffer), 0);
+                dequeued.push_back(slot);
+                break;
+        }
+    }
+
+    // Every slot must still be accounted for.
+    for (int s : dequeued) {
+        ASSERT_EQ(OK, mProducer->cancelBuffer(s, Fence::NO_FENCE));
+    }
+    for (const BufferItem& item : acquired) {
+        ASSERT_EQ(OK, mConsumer->releaseBuffer(item.mSlot, item.mFrameNumber,
+                EGL_NO_DISPLAY, EGL_NO_SYNC_KHR, Fence::NO_FENCE));
+    }
+    ASSERT_EQ(OK, mConsumer->discardFreeBuffers());
+    int slot = BufferQueue::INVALID_BUFFER_SLOT;
+    sp<Fence> fence;
+    ASSERT_EQ(OK, mProducer->dequeueBuffer(&slot, &fence, 0, 0, 0, 0) &
+            ~IGraphicBufferProducer::BUFFER_NEEDS_REALLOCATION);
+}
+
+TEST_F(BufferQueueTest, SingleProducerConsumerPollsEmptyQueue) {
+    createBufferQueue(true);
+    sp<DummyConsumer> dc(new DummyConsumer);
+    ASSERT_EQ(OK, mConsumer->consumerConnect(dc, false));
+    IGraphicBufferProducer::QueueBufferOutput output;
+    ASSERT_EQ(OK, mProducer->connect(new DummyProducerListener,
+            NATIVE_WINDOW_API_CPU, false, &output));
+
+    BufferItem item;
+    ASSERT_EQ(BufferQueue::NO_BUFFER_AVAILABLE,
+            mConsumer->acquireBuffer(&item, 0));
+
+    int slot = BufferQueue::INVALID_BUFFER_SLOT;
+    sp<Fence> fence;
+    sp<GraphicBuffer> buffer;
+    ASSERT_EQ(IGraphicBufferProducer::BUFFER_NEEDS_REALLOCATION,
+            mProducer->dequeueBuffer(&slot, &fence, 0, 0, 0, 0));
+    ASSERT_EQ(OK, mProducer->requestBuffer(slot, &buffer));
+    IGraphicBufferProducer::QueueBufferInput input(0ull, true,
+            HAL_DATASPACE_UNKNOWN, Rect::INVALID_RECT,
+            NATIVE_WINDOW_SCALING_MODE_FREEZE, 0, Fence::NO_FENCE);
+    ASSERT_EQ(OK, mProducer->queueBuffer(slot, input, &output));
+    ASSERT_EQ(OK, mConsumer->acquireBuffer(&item, 0));
+    ASSERT_EQ(slot, item.mSlot);
+    ASSERT_EQ(BufferQueue::NO_BUFFER_AVAILABLE,
+            mConsumer->acquireBuffer(&item, 0));
+    ASSERT_EQ(OK, mConsumer->releaseBuffer(item.mSlot, item.mFrameNumber,
+            EGL_NO_DISPLAY, EGL_NO_SYNC_KHR, Fence::NO_FENCE));
+
+    // The shared buffer can be acquired while the queue is empty, so polling
+    // has to go through the lock again.
+    ASSERT_EQ(OK, mProducer->setSharedBufferMode(true));
+    ASSERT_EQ(OK, mProducer->setAutoRefresh(true));
+    ASSERT_EQ(OK, mProducer->dequeueBuffer(&slot, &fence, 0, 0, 0, 0));
+    ASSERT_EQ(OK, mProducer->queueBuffer(slot, input, &output));
+    ASSERT_EQ(OK, mConsumer->acquireBuffer(&item, 0));
+    ASSERT_EQ(OK, mConsumer->releaseBuffer(item.mSlot, item.mFrameNumber,
+            EGL_NO_DISPLAY, EGL_NO_SYNC_KHR, Fence::NO_FENCE));
+    ASSERT_EQ(OK, mConsumer->acquireBuffer(&item, 0));
+    ASSERT_EQ(slot, item.mSlot);
+}
+
 } // namespace android
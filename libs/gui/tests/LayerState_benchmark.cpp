@@ -0,0 +1,143 @@
+/*
+ * Copyright 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Measures the cost of an animation frame that moves and fades a few dozen
+// layers: first encoding and decoding the layer states the way
+// ISurfaceComposer does, without the binder call, then whole transactions
+// through SurfaceFlinger.
+
+#include <binder/Binder.h>
+#include <binder/Parcel.h>
+#include <binder/ProcessState.h>
+#include <gui/SurfaceComposerClient.h>
+#include <gui/SurfaceControl.h>
+#include <private/gui/LayerState.h>
+#include <utils/String8.h>
+#include <utils/Timers.h>
+#include <utils/Vector.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace android;
+
+// Animations typically move and fade a few dozen layers per frame
+static const size_t kAnimatedLayerCount = 32;
+
+static layer_state_t makeAnimationState(const sp<IBinder>& surface,
+        size_t layer, int frame) {
+    layer_state_t state;
+    state.surface = surface;
+    state.what = layer_state_t::ePositionChanged |
+            layer_state_t::eAlphaChanged | layer_state_t::eMatrixChanged;
+    state.x = static_cast<float>(frame + static_cast<int>(layer));
+    state.y = static_cast<float>(frame);
+    state.alpha = 0.5f;
+    state.matrix.dsdx = 0.9f;
+    state.matrix.dtdy = 0.9f;
+    return state;
+}
+
+static bool runEncodingBenchmark(int frameCount) {
+    Vector<sp<IBinder> > surfaces;
+    for (size_t layer = 0; layer < kAnimatedLayerCount; ++layer) {
+        surfaces.push_back(new BBinder);
+    }
+
+    size_t parcelSize = 0;
+    const nsecs_t startTime = systemTime();
+    for (int frame = 0; frame < frameCount; ++frame) {
+        Parcel parcel;
+        parcel.writeUint32(static_cast<uint32_t>(kAnimatedLayerCount));
+        for (size_t layer = 0; layer < kAnimatedLayerCount; ++layer) {
+            makeAnimationState(surfaces[layer], layer, frame).write(parcel);
+        }
+        parcelSize = parcel.dataSize();
+
+        parcel.setDataPosition(0);
+        Vector<layer_state_t> states;
+        states.resize(parcel.readUint32());
+        for (size_t layer = 0; layer < states.size(); ++layer) {
+            if (states.editItemAt(layer).read(parcel) != NO_ERROR) {
+                fprintf(stderr, "failed to read layer %zu of frame %d\n",
+                        layer, frame);
+                return false;
+            }
+        }
+    }
+    const nsecs_t elapsed = systemTime() - startTime;
+    printf("encoding     %zu layers: %zu bytes per transaction, "
+            "%.0f transactions/s\n", kAnimatedLayerCount, parcelSize,
+            static_cast<double>(frameCount) * 1e9 /
+            static_cast<double>(elapsed));
+    return true;
+}
+
+static bool runTransactionBenchmark(int frameCount) {
+    sp<SurfaceComposerClient> client(new SurfaceComposerClient);
+    if (client->initCheck() != NO_ERROR) {
+        fprintf(stderr, "can't connect to SurfaceFlinger\n");
+        return false;
+    }
+
+    Vector<sp<SurfaceControl> > layers;
+    for (size_t layer = 0; layer < kAnimatedLayerCount; ++layer) {
+        sp<SurfaceControl> control(client->createSurface(
+                String8::format("LayerState_benchmark %zu", layer), 16, 16,
+                PIXEL_FORMAT_RGBA_8888, 0));
+        if (control == NULL || !control->isValid()) {
+            fprintf(stderr, "failed to create layer %zu\n", layer);
+            client->dispose();
+            return false;
+        }
+        layers.push_back(control);
+    }
+
+    const nsecs_t startTime = systemTime();
+    for (int frame = 0; frame < frameCount; ++frame) {
+        SurfaceComposerClient::openGlobalTransaction();
+        for (size_t layer = 0; layer < layers.size(); ++layer) {
+            const sp<SurfaceControl>& control(layers[layer]);
+            control->setPosition(static_cast<float>(frame % 64),
+                    static_cast<float>(layer));
+            control->setAlpha(static_cast<float>(frame % 10) / 10.0f);
+        }
+        SurfaceComposerClient::closeGlobalTransaction();
+    }
+    const nsecs_t elapsed = systemTime() - startTime;
+    printf("transactions %zu layers: %.0f transactions/s\n", layers.size(),
+            static_cast<double>(frameCount) * 1e9 /
+            static_cast<double>(elapsed));
+
+    client->dispose();
+    return true;
+}
+
+int main(int argc, char** argv) {
+    int frameCount = 1000;
+    if (argc > 1) {
+        frameCount = atoi(argv[1]);
+    }
+    if (frameCount <= 0) {
+        fprintf(stderr, "usage: %s [frame count]\n", argv[0]);
+        return 1;
+    }
+
+    ProcessState::self()->startThreadPool();
+    bool ok = runEncodingBenchmark(frameCount * 10);
+    ok = runTransactionBenchmark(frameCount) && ok;
+    return ok ? 0 : 1;
+}
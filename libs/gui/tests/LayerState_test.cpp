@@ -0,0 +1,133 @@
+/*
+ * Copyright 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "LayerState_test"
+
+#include <gtest/gtest.h>
+
+#include <binder/Binder.h>
+#include <binder/Parcel.h>
+#include <private/gui/LayerState.h>
+
+namespace android {
+
+TEST(LayerStateTest, OnlyChangedFieldsAreWritten) {
+    layer_state_t state;
+    state.what = layer_state_t::ePositionChanged;
+    state.x = 12.0f;
+    state.y = 34.0f;
+    state.z = 56;
+    Parcel parcel;
+    ASSERT_EQ(NO_ERROR, state.write(parcel));
+
+    Parcel expected;
+    expected.writeStrongBinder(NULL);
+    expected.writeUint32(layer_state_t::ePositionChanged);
+    expected.writeFloat(12.0f);
+    expected.writeFloat(34.0f);
+    ASSERT_EQ(expected.dataSize(), parcel.dataSize());
+
+    parcel.setDataPosition(0);
+    layer_state_t result;
+    ASSERT_EQ(NO_ERROR, result.read(parcel));
+    EXPECT_EQ(static_cast<uint32_t>(layer_state_t::ePositionChanged),
+            result.what);
+    EXPECT_EQ(12.0f, result.x);
+    EXPECT_EQ(34.0f, result.y);
+    EXPECT_EQ(0u, result.z);
+}
+
+TEST(LayerStateTest, EveryFieldRoundTrips) {
+    sp<IBinder> surface(new BBinder);
+    sp<IBinder> handle(new BBinder);
+    sp<IBinder> blurMaskSurface(new BBinder);
+
+    layer_state_t state;
+    state.surface = surface;
+    state.what = layer_state_t::ePositionChanged |
+            layer_state_t::eLayerChanged | layer_state_t::eSizeChanged |
+            layer_state_t::eAlphaChanged | layer_state_t::eMatrixChanged |
+            layer_state_t::eTransparentRegionChanged |
+            layer_state_t::eFlagsChanged | layer_state_t::eLayerStackChanged |
+            layer_state_t::eCropChanged | layer_state_t::eDeferTransaction |
+            layer_state_t::eFinalCropChanged |
+            layer_state_t::eOverrideScalingModeChanged |
+            layer_state_t::eGeometryAppliesWithResize |
+            layer_state_t::eColorChanged | layer_state_t::eBlurChanged |
+            layer_state_t::eBlurMaskSurfaceChanged |
+            layer_state_t::eBlurMaskSamplingChanged |
+            layer_state_t::eBlurMaskAlphaThresholdChanged;
+    state.x = 1.0f;
+    state.y = 2.0f;
+    state.z = 3;
+    state.w = 4;
+    state.h = 5;
+    state.alpha = 0.25f;
+    state.matrix.dsdx = 6.0f;
+    state.matrix.dtdx = 7.0f;
+    state.matrix.dsdy = 8.0f;
+    state.matrix.dtdy = 9.0f;
+    state.transparentRegion = Region(Rect(1, 2, 3, 4));
+    state.flags = layer_state_t::eLayerHidden;
+    state.mask = layer_state_t::eLayerHidden | layer_state_t::eLayerSecure;
+    state.layerStack = 10;
+    state.crop = Rect(11, 12, 13, 14);
+    state.handle = handle;
+    state.frameNumber = 15;
+    state.finalCrop = Rect(16, 17, 18, 19);
+    state.overrideScalingMode = 20;
+    state.color = 0x21222324;
+    state.blur = 0.5f;
+    state.blurMaskSurface = blurMaskSurface;
+    state.blurMaskSampling = 25;
+    state.blurMaskAlphaThreshold = 0.75f;
+
+    Parcel parcel;
+    ASSERT_EQ(NO_ERROR, state.write(parcel));
+    parcel.setDataPosition(0);
+    layer_state_t result;
+    ASSERT_EQ(NO_ERROR, result.read(parcel));
+    ASSERT_EQ(parcel.dataSize(), parcel.dataPosition());
+
+    EXPECT_EQ(surface, result.surface);
+    EXPECT_EQ(state.what, result.what);
+    EXPECT_EQ(state.x, result.x);
+    EXPECT_EQ(state.y, result.y);
+    EXPECT_EQ(state.z, result.z);
+    EXPECT_EQ(state.w, result.w);
+    EXPECT_EQ(state.h, result.h);
+    EXPECT_EQ(state.alpha, result.alpha);
+    EXPECT_EQ(state.matrix.dsdx, result.matrix.dsdx);
+    EXPECT_EQ(state.matrix.dtdx, result.matrix.dtdx);
+    EXPECT_EQ(state.matrix.dsdy, result.matrix.dsdy);
+    EXPECT_EQ(state.matrix.dtdy, result.matrix.dtdy);
+    EXPECT_EQ(Rect(1, 2, 3, 4), result.transparentRegion.getBounds());
+    EXPECT_EQ(state.flags, result.flags);
+    EXPECT_EQ(state.mask, result.mask);
+    EXPECT_EQ(state.layerStack, result.layerStack);
+    EXPECT_EQ(state.crop, result.crop);
+    EXPECT_EQ(handle, result.handle);
+    EXPECT_EQ(state.frameNumber, result.frameNumber);
+    EXPECT_EQ(state.finalCrop, result.finalCrop);
+    EXPECT_EQ(state.overrideScalingMode, result.overrideScalingMode);
+    EXPECT_EQ(state.color, result.color);
+    EXPECT_EQ(state.blur, result.blur);
+    EXPECT_EQ(blurMaskSurface, result.blurMaskSurface);
+    EXPECT_EQ(state.blurMaskSampling, result.blurMaskSampling);
+    EXPECT_EQ(state.blurMaskAlphaThreshold, result.blurMaskAlphaThreshold);
+}
+
+} // namespace android
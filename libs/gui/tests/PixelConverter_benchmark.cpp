@@ -0,0 +1,111 @@
+/*
+ * Copyright 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Converts a 1080p frame from each source format CpuConsumer commonly hands
+// out to BGRA, at full and at quarter scale, and prints the throughput in
+// source pixels.
+
+#include <gui/CpuConsumer.h>
+#include <gui/PixelConverter.h>
+#include <utils/Timers.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <vector>
+
+using namespace android;
+
+static const PixelFormat kSourceFormats[] = {
+    HAL_PIXEL_FORMAT_RGBA_8888,
+    HAL_PIXEL_FORMAT_RGBX_8888,
+    HAL_PIXEL_FORMAT_BGRA_8888,
+    HAL_PIXEL_FORMAT_RGB_565,
+    HAL_PIXEL_FORMAT_YV12,
+    HAL_PIXEL_FORMAT_YCrCb_420_SP,
+};
+
+static const uint32_t kWidth = 1920;
+static const uint32_t kHeight = 1080;
+
+// Fills a frame of the format with noise, and describes it the way
+// CpuConsumer::lockNextBuffer would.
+static void makeFrame(PixelFormat format, std::vector<uint8_t>* outMemory,
+        CpuConsumer::LockedBuffer* outBuffer) {
+    outBuffer->width = kWidth;
+    outBuffer->height = kHeight;
+    outBuffer->format = format;
+    outBuffer->flexFormat = format;
+    outBuffer->stride = kWidth;
+    switch (format) {
+        case HAL_PIXEL_FORMAT_RGB_565:
+            outMemory->resize(kWidth * kHeight * 2);
+            break;
+        case HAL_PIXEL_FORMAT_YV12:
+        case HAL_PIXEL_FORMAT_YCrCb_420_SP:
+            // Room for YV12's aligned chroma planes
+            outMemory->resize(kWidth * kHeight + ((kWidth / 2 + 15) & ~15u) *
+                    (kHeight / 2) * 2 + 16);
+            break;
+        default:
+            outMemory->resize(kWidth * kHeight * 4);
+            break;
+    }
+    for (size_t i = 0; i < outMemory->size(); ++i) {
+        (*outMemory)[i] = static_cast<uint8_t>(rand());
+    }
+    outBuffer->data = outMemory->data();
+}
+
+int main(int argc, char** argv) {
+    int iterations = 20;
+    if (argc > 1) {
+        iterations = atoi(argv[1]);
+    }
+    if (iterations <= 0) {
+        fprintf(stderr, "usage: %s [iterations]\n", argv[0]);
+        return 1;
+    }
+
+    std::vector<uint8_t> dst(kWidth * kHeight * 4);
+    bool ok = true;
+    for (PixelFormat srcFormat : kSourceFormats) {
+        std::vector<uint8_t> memory;
+        CpuConsumer::LockedBuffer src;
+        makeFrame(srcFormat, &memory, &src);
+        for (uint32_t scale = 1; scale <= 4; scale *= 4) {
+            const nsecs_t startTime = systemTime();
+            status_t result = NO_ERROR;
+            for (int i = 0; i < iterations && result == NO_ERROR; ++i) {
+                result = PixelConverter::convert(src, dst.data(),
+                        kWidth / scale, kHeight / scale, kWidth / scale,
+                        HAL_PIXEL_FORMAT_BGRA_8888);
+            }
+            const nsecs_t elapsed = systemTime() - startTime;
+            if (result != NO_ERROR) {
+                fprintf(stderr, "format %#x to BGRA, 1/%u scale failed: %d\n",
+                        srcFormat, scale, result);
+                ok = false;
+                continue;
+            }
+            printf("format %#x to BGRA, 1/%u scale: %.1f Mpixels/s "
+                    "(source pixels)\n", srcFormat, scale,
+                    static_cast<double>(kWidth) * kHeight * iterations * 1e3 /
+                    static_cast<double>(elapsed));
+        }
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,320 @@
+/*
+ * Copyright 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "PixelConverter_test"
+
+#include <gtest/gtest.h>
+
+#include <gui/BufferQueue.h>
+#include <gui/CpuConsumer.h>
+#include <gui/PixelConverter.h>
+#include <gui/Surface.h>
+#include <ui/GraphicBuffer.h>
+
+#include <utility>
+#include <vector>
+
+#include <stdlib.h>
+#include <string.h>
+
+namespace android {
+
+// An image in memory, described the way CpuConsumer::lockNextBuffer would.
+struct TestImage {
+    std::vector<uint8_t> memory;
+    CpuConsumer::LockedBuffer buffer;
+
+    TestImage(PixelFormat format, uint32_t width, uint32_t height,
+            uint32_t stride) {
+        buffer.width = width;
+        buffer.height = height;
+        buffer.format = format;
+        buffer.flexFormat = format;
+        buffer.stride = stride;
+        switch (format) {
+            case HAL_PIXEL_FORMAT_RGB_565:
+                memory.resize(stride * height * 2);
+                break;
+            case HAL_PIXEL_FORMAT_YV12:
+            case HAL_PIXEL_FORMAT_YCrCb_420_SP:
+                // Room for YV12's aligned chroma planes
+                memory.resize(stride * height + ((stride / 2 + 15) & ~15u) *
+                        (height / 2) * 2 + 16);
+                break;
+            default:
+                memory.resize(stride * height * 4);
+                break;
+        }
+        for (size_t i = 0; i < memory.size(); ++i) {
+            memory[i] = static_cast<uint8_t>(rand());
+        }
+        buffer.data = memory.data();
+    }
+};
+
+static uint8_t clamp(int value) {
+    return static_cast<uint8_t>(value < 0 ? 0 : (value > 255 ? 255 : value));
+}
+
+// Reference conversion of the source pixel at (x, y) to RGBA
+static void referencePixel(const CpuConsumer::LockedBuffer& src, uint32_t x,
+        uint32_t y, uint8_t* rgba) {
+    switch (src.format) {
+        case HAL_PIXEL_FORMAT_RGBA_8888:
+        case HAL_PIXEL_FORMAT_RGBX_8888:
+        case HAL_PIXEL_FORMAT_BGRA_8888: {
+            const uint8_t* pixel = src.data + (y * src.stride + x) * 4;
+            const bool bgra = src.format == HAL_PIXEL_FORMAT_BGRA_8888;
+            rgba[0] = pixel[bgra ? 2 : 0];
+            rgba[1] = pixel[1];
+            rgba[2] = pixel[bgra ? 0 : 2];
+            rgba[3] = src.format == HAL_PIXEL_FORMAT_RGBX_8888 ? 0xff : pixel[3];
+            break;
+        }
+        case HAL_PIXEL_FORMAT_RGB_565: {
+            uint16_t pixel;
+            memcpy(&pixel, src.data + (y * src.stride + x) * 2, 2);
+            const int red = pixel >> 11;
+            const int green = (pixel >> 5) & 0x3f;
+            const int blue = pixel & 0x1f;
+            rgba[0] = static_cast<uint8_t>((red << 3) | (red >> 2));
+            rgba[1] = static_cast<uint8_t>((green << 2) | (green >> 4));
+            rgba[2] = static_cast<uint8_t>((blue << 3) | (blue >> 2));
+            rgba[3] = 0xff;
+            break;
+        }
+        default: {
+            // BT.601 limited range, in the same 8.8 fixed point
+            const uint8_t* cb;
+            const uint8_t* cr;
+            size_t chromaOffset;
+            if (src.flexFormat == HAL_PIXEL_FORMAT_YCbCr_420_888) {
+                cb = src.dataCb;
+                cr = src.dataCr;
+                chromaOffset = (y / 2) * src.chromaStride +
+                        (x / 2) * src.chromaStep;
+            } else if (src.format == HAL_PIXEL_FORMAT_YV12) {
+                const uint32_t chromaStride = (src.stride / 2 + 15) & ~15u;
+                cr = src.data + src.stride * src.height;
+                cb = cr + chromaStride * (src.height / 2);
+                chromaOffset = (y / 2) * chromaStride + x / 2;
+            } else {
+                cr = src.data + src.stride * src.height;
+                cb = cr + 1;
+                chromaOffset = (y / 2) * src.stride + (x / 2) * 2;
+            }
+            const int c = src.data[y * src.stride + x] - 16;
+            const int d = cb[chromaOffset] - 128;
+            const int e = cr[chromaOffset] - 128;
+            rgba[0] = clamp((298 * c + 409 * e + 128) >> 8);
+            rgba[1] = clamp((298 * c - 100 * d - 208 * e + 128) >> 8);
+            rgba[2] = clamp((298 * c + 516 * d + 128) >> 8);
+            rgba[3] = 0xff;
+            break;
+        }
+    }
+}
+
+// Converts src with PixelConverter and compares every pixel to the reference
+static void checkConversion(const CpuConsumer::LockedBuffer& src,
+        uint32_t dstWidth, uint32_t dstHeight, PixelFormat dstFormat) {
+    const Rect crop(src.crop.isEmpty() ? Rect(src.width, src.height) :
+            src.crop);
+    const uint32_t srcWidth = static_cast<uint32_t>(crop.getWidth());
+    const uint32_t srcHeight = static_cast<uint32_t>(crop.getHeight());
+    const uint32_t dstStride = dstWidth + 3;
+    std::vector<uint8_t> dst(dstStride * dstHeight * 4);
+    ASSERT_EQ(NO_ERROR, PixelConverter::convert(src, dst.data(), dstWidth,
+            dstHeight, dstStride, dstFormat));
+
+    for (uint32_t y = 0; y < dstHeight; ++y) {
+        for (uint32_t x = 0; x < dstWidth; ++x) {
+            const uint32_t sx = static_cast<uint32_t>(crop.left) +
+                    (2 * x + 1) * srcWidth / (2 * dstWidth);
+            const uint32_t sy = static_cast<uint32_t>(crop.top) +
+                    (2 * y + 1) * srcHeight / (2 * dstHeight);
+            uint8_t expected[4];
+            referencePixel(src, sx, sy, expected);
+            if (dstFormat == HAL_PIXEL_FORMAT_BGRA_8888) {
+                std::swap(expected[0], expected[2]);
+            } else if (dstFormat == HAL_PIXEL_FORMAT_RGBX_8888) {
+                expected[3] = 0xff;
+            }
+            const uint8_t* actual = &dst[(y * dstStride + x) * 4];
+            ASSERT_EQ(0, memcmp(expected, actual, 4)) << "format " <<
+                    src.format << " to " << dstFormat << ", pixel " << x <<
+                    ", " << y << ": expected " << int(expected[0]) << " " <<
+                    int(expected[1]) << " " << int(expected[2]) << " " <<
+                    int(expected[3]) << ", got " << int(actual[0]) << " " <<
+                    int(actual[1]) << " " << int(actual[2]) << " " <<
+                    int(actual[3]);
+        }
+    }
+}
+
+static const PixelFormat SOURCE_FORMATS[] = {
+    HAL_PIXEL_FORMAT_RGBA_8888,
+    HAL_PIXEL_FORMAT_RGBX_8888,
+    HAL_PIXEL_FORMAT_BGRA_8888,
+    HAL_PIXEL_FORMAT_RGB_565,
+    HAL_PIXEL_FORMAT_YV12,
+    HAL_PIXEL_FORMAT_YCrCb_420_SP,
+};
+
+static const PixelFormat DESTINATION_FORMATS[] = {
+    HAL_PIXEL_FORMAT_RGBA_8888,
+    HAL_PIXEL_FORMAT_RGBX_8888,
+    HAL_PIXEL_FORMAT_BGRA_8888,
+};
+
+// Widths that exercise both the SIMD loops and the scalar remainder
+static const uint32_t WIDTHS[] = { 1, 2, 7, 16, 33, 64, 101 };
+
+TEST(PixelConverterTest, MatchesReference) {
+    for (PixelFormat srcFormat : SOURCE_FORMATS) {
+        for (uint32_t width : WIDTHS) {
+            TestImage image(srcFormat, width, 10, (width + 15) & ~15u);
+            for (PixelFormat dstFormat : DESTINATION_FORMATS) {
+                ASSERT_NO_FATAL_FAILURE(checkConversion(image.buffer, width,
+                        10, dstFormat));
+            }
+        }
+    }
+}
+
+TEST(PixelConverterTest, FlexibleYuvMatchesReference) {
+    for (uint32_t width : WIDTHS) {
+        // Planar, like YV12
+        TestImage planar(HAL_PIXEL_FORMAT_YV12, width, 10, (width + 15) & ~15u);
+        planar.buffer.flexFormat = HAL_PIXEL_FORMAT_YCbCr_420_888;
+        planar.buffer.chromaStride = (planar.buffer.stride / 2 + 15) & ~15u;
+        planar.buffer.chromaStep = 1;
+        planar.buffer.dataCr = planar.buffer.data +
+                planar.buffer.stride * planar.buffer.height;
+        planar.buffer.dataCb = planar.buffer.dataCr +
+                planar.buffer.chromaStride * (planar.buffer.height / 2);
+        ASSERT_NO_FATAL_FAILURE(checkConversion(planar.buffer, width, 10,
+                HAL_PIXEL_FORMAT_RGBA_8888));
+
+        // Semi-planar, like NV12
+        TestImage semiPlanar(HAL_PIXEL_FORMAT_YCrCb_420_SP, width, 10,
+                (width + 15) & ~15u);
+        semiPlanar.buffer.flexFormat = HAL_PIXEL_FORMAT_YCbCr_420_888;
+        semiPlanar.buffer.chromaStride = semiPlanar.buffer.stride;
+        semiPlanar.buffer.chromaStep = 2;
+        semiPlanar.buffer.dataCb = semiPlanar.buffer.data +
+                semiPlanar.buffer.stride * semiPlanar.buffer.height;
+        semiPlanar.buffer.dataCr = semiPlanar.buffer.dataCb + 1;
+        ASSERT_NO_FATAL_FAILURE(checkConversion(semiPlanar.buffer, width, 10,
+                HAL_PIXEL_FORMAT_BGRA_8888));
+    }
+}
+
+TEST(PixelConverterTest, CropMatchesReference) {
+    for (PixelFormat srcFormat : SOURCE_FORMATS) {
+        TestImage image(srcFormat, 100, 40, 112);
+        // Odd offsets, so YUV crops start halfway through a chroma sample
+        image.buffer.crop = Rect(3, 5, 90, 38);
+        ASSERT_NO_FATAL_FAILURE(checkConversion(image.buffer, 87, 33,
+                HAL_PIXEL_FORMAT_RGBA_8888));
+    }
+}
+
+TEST(PixelConverterTest, DownscaleMatchesReference) {
+    for (PixelFormat srcFormat : SOURCE_FORMATS) {
+        TestImage image(srcFormat, 100, 40, 112);
+        ASSERT_NO_FATAL_FAILURE(checkConversion(image.buffer, 50, 20,
+                HAL_PIXEL_FORMAT_RGBA_8888));
+        ASSERT_NO_FATAL_FAILURE(checkConversion(image.buffer, 33, 7,
+                HAL_PIXEL_FORMAT_BGRA_8888));
+        image.buffer.crop = Rect(1, 1, 99, 39);
+        ASSERT_NO_FATAL_FAILURE(checkConversion(image.buffer, 17, 13,
+                HAL_PIXEL_FORMAT_RGBA_8888));
+    }
+}
+
+TEST(PixelConverterTest, RejectsInvalidConversions) {
+    TestImage image(HAL_PIXEL_FORMAT_RGBA_8888, 16, 16, 16);
+    std::vector<uint8_t> dst(32 * 32 * 4);
+
+    // Upscaling
+    EXPECT_EQ(BAD_VALUE, PixelConverter::convert(image.buffer, dst.data(),
+            32, 16, 32, HAL_PIXEL_FORMAT_RGBA_8888));
+    // Stride smaller than the width
+    EXPECT_EQ(BAD_VALUE, PixelConverter::convert(image.buffer, dst.data(),
+            16, 16, 8, HAL_PIXEL_FORMAT_RGBA_8888));
+    // Unsupported destination
+    EXPECT_FALSE(PixelConverter::isSupportedDestination(
+            HAL_PIXEL_FORMAT_RGB_565));
+    EXPECT_EQ(BAD_VALUE, PixelConverter::convert(image.buffer, dst.data(),
+            16, 16, 16, HAL_PIXEL_FORMAT_RGB_565));
+    // Crop outside the buffer
+    image.buffer.crop = Rect(8, 8, 24, 24);
+    EXPECT_EQ(BAD_VALUE, PixelConverter::convert(image.buffer, dst.data(),
+            16, 16, 16, HAL_PIXEL_FORMAT_RGBA_8888));
+
+    image.buffer.format = HAL_PIXEL_FORMAT_RAW16;
+    image.buffer.flexFormat = HAL_PIXEL_FORMAT_RAW16;
+    EXPECT_FALSE(PixelConverter::isSupportedSource(image.buffer));
+}
+
+TEST(PixelConverterTest, ConvertsCpuConsumerBuffer) {
+    const uint32_t width = 64;
+    const uint32_t height = 32;
+    sp<IGraphicBufferProducer> producer;
+    sp<IGraphicBufferConsumer> consumer;
+    BufferQueue::createBufferQueue(&producer, &consumer);
+    sp<CpuConsumer> cpuConsumer(new CpuConsumer(consumer, 1));
+    sp<Surface> surface(new Surface(producer));
+    sp<ANativeWindow> window(surface);
+    ASSERT_EQ(NO_ERROR, native_window_api_connect(window.get(),
+            NATIVE_WINDOW_API_CPU));
+    ASSERT_EQ(NO_ERROR, native_window_set_buffers_dimensions(window.get(),
+            width, height));
+    ASSERT_EQ(NO_ERROR, native_window_set_buffers_format(window.get(),
+            HAL_PIXEL_FORMAT_RGB_565));
+    ASSERT_EQ(NO_ERROR, native_window_set_usage(window.get(),
+            GRALLOC_USAGE_SW_WRITE_OFTEN));
+
+    ANativeWindowBuffer* anb;
+    ASSERT_EQ(NO_ERROR, native_window_dequeue_buffer_and_wait(window.get(),
+            &anb));
+    sp<GraphicBuffer> buffer(new GraphicBuffer(anb, false));
+    uint8_t* pixels;
+    ASSERT_EQ(NO_ERROR, buffer->lock(GRALLOC_USAGE_SW_WRITE_OFTEN,
+            reinterpret_cast<void**>(&pixels)));
+    for (uint32_t y = 0; y < height; ++y) {
+        uint16_t* row = reinterpret_cast<uint16_t*>(pixels) +
+                y * buffer->getStride();
+        for (uint32_t x = 0; x < width; ++x) {
+            row[x] = static_cast<uint16_t>(x * 997 + y * 131);
+        }
+    }
+    ASSERT_EQ(NO_ERROR, buffer->unlock());
+    ASSERT_EQ(NO_ERROR, window->queueBuffer(window.get(),
+            buffer->getNativeBuffer(), -1));
+
+    CpuConsumer::LockedBuffer locked;
+    ASSERT_EQ(NO_ERROR, cpuConsumer->lockNextBuffer(&locked));
+    ASSERT_TRUE(PixelConverter::isSupportedSource(locked));
+    ASSERT_NO_FATAL_FAILURE(checkConversion(locked, width / 2, height / 2,
+            HAL_PIXEL_FORMAT_BGRA_8888));
+    ASSERT_EQ(NO_ERROR, cpuConsumer->unlockBuffer(locked));
+
+    native_window_api_disconnect(window.get(), NATIVE_WINDOW_API_CPU);
+}
+
+} // namespace android
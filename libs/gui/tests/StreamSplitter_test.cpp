@@ -233,4 +233,68 @@ TEST_F(StreamSplitterTest, OutputAbandonment) {
             GRALLOC_USAGE_SW_WRITE_OFTEN));
 }
 
+TEST_F(StreamSplitterTest, SlowOutputWithDepthLimitSkipsBuffers) {
+    sp<IGraphicBufferProducer> inputProducer;
+    sp<IGraphicBufferConsumer> inputConsumer;
+    BufferQueue::createBufferQueue(&inputProducer, &inputConsumer);
+
+    // A preview that keeps up, and an encoder that never releases anything
+    sp<IGraphicBufferProducer> previewProducer;
+    sp<IGraphicBufferConsumer> previewConsumer;
+    BufferQueue::createBufferQueue(&previewProducer, &previewConsumer);
+    ASSERT_EQ(OK, previewConsumer->consumerConnect(new DummyListener, false));
+    sp<IGraphicBufferProducer> encoderProducer;
+    sp<IGraphicBufferConsumer> encoderConsumer;
+    BufferQueue::createBufferQueue(&encoderProducer, &encoderConsumer);
+    ASSERT_EQ(OK, encoderConsumer->consumerConnect(new DummyListener, false));
+
+    sp<StreamSplitter> splitter;
+    status_t status = StreamSplitter::createSplitter(inputConsumer, &splitter);
+    ASSERT_EQ(OK, status);
+    ASSERT_EQ(OK, splitter->addOutput(previewProducer));
+    ASSERT_EQ(OK, splitter->addOutput(encoderProducer, 1));
+
+    IGraphicBufferProducer::QueueBufferOutput qbOutput;
+    ASSERT_EQ(OK, inputProducer->connect(new DummyProducerListener,
+            NATIVE_WINDOW_API_CPU, false, &qbOutput));
+
+    IGraphicBufferProducer::QueueBufferInput qbInput(0, false,
+            HAL_DATASPACE_UNKNOWN, Rect(0, 0, 1, 1),
+            NATIVE_WINDOW_SCALING_MODE_FREEZE, 0, Fence::NO_FENCE);
+
+    // Without the limit, the third frame would block until the encoder
+    // released something
+    const int FRAME_COUNT = 3;
+    for (int frame = 0; frame < FRAME_COUNT; ++frame) {
+        int slot;
+        sp<Fence> fence;
+        status = inputProducer->dequeueBuffer(&slot, &fence, 0, 0, 0,
+                GRALLOC_USAGE_SW_WRITE_OFTEN);
+        ASSERT_GE(status, 0);
+        if (status & IGraphicBufferProducer::BUFFER_NEEDS_REALLOCATION) {
+            sp<GraphicBuffer> buffer;
+            ASSERT_EQ(OK, inputProducer->requestBuffer(slot, &buffer));
+        }
+        ASSERT_EQ(OK, inputProducer->queueBuffer(slot, qbInput, &qbOutput));
+
+        BufferItem item;
+        ASSERT_EQ(OK, previewConsumer->acquireBuffer(&item, 0));
+        ASSERT_EQ(OK, previewConsumer->releaseBuffer(item.mSlot,
+                item.mFrameNumber, EGL_NO_DISPLAY, EGL_NO_SYNC_KHR,
+                Fence::NO_FENCE));
+    }
+
+    // The encoder only got the first frame
+    BufferItem item;
+    ASSERT_EQ(OK, encoderConsumer->acquireBuffer(&item, 0));
+    BufferItem nextItem;
+    ASSERT_EQ(IGraphicBufferConsumer::NO_BUFFER_AVAILABLE,
+            encoderConsumer->acquireBuffer(&nextItem, 0));
+
+    String8 dump;
+    splitter->dump(dump, "");
+    ASSERT_NE(-1, dump.find("queued 3, skipped 0")) << dump.string();
+    ASSERT_NE(-1, dump.find("queued 1, skipped 2, holding 1")) << dump.string();
+}
+
 } // namespace android
@@ -24,10 +24,15 @@
 #include <fcntl.h>
 #include <inttypes.h>
 #include <math.h>
+#include <string.h>
+#include <sys/mman.h>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <unistd.h>
 
+#include <atomic>
+
+#include <cutils/ashmem.h>
 #include <cutils/log.h>
 #include <cutils/properties.h>
 #include <input/InputTransport.h>
@@ -41,6 +46,10 @@ namespace android {
 // behind processing touches.
 static const size_t SOCKET_BUFFER_SIZE = 32 * 1024;
 
+// Size of each ring of a shared memory channel, one per direction.  Sized like the socket
+// buffers so that flow control behaves the same.  Must be a power of two.
+static const uint32_t RING_BUFFER_SIZE = SOCKET_BUFFER_SIZE;
+
 // Nanoseconds per milliseconds.
 static const nsecs_t NANOS_PER_MS = 1000000;
 
@@ -100,8 +109,126 @@ size_t InputMessage::size() const {
 
 // --- InputChannel ---
 
-InputChannel::InputChannel(const String8& name, int fd) :
-        mName(name), mFd(fd) {
+// Packets that a shared memory channel sends over its socket besides input messages.
+// Their types do not collide with InputMessage types and they are shorter than any
+// InputMessage, so a socket-only peer would reject them as invalid.
+struct ChannelControl {
+    enum {
+        // Sent when a ring goes from empty to non-empty.  The token is the ring index of
+        // the first message written, so a receiver that has already read past it can
+        // tell that the wakeup is stale.
+        TYPE_WAKEUP = 0x80000001,
+        // Carries the shared memory fd to the client.  The token is the ring the client
+        // sends on.
+        TYPE_ATTACH = 0x80000002,
+    };
+
+    uint32_t type;
+    uint32_t token;
+};
+
+// A single-producer single-consumer ring of variable sized records.  The indices count
+// bytes and wrap around at 2^32; their difference is the number of bytes in use.
+// A record that would straddle the end of the buffer is preceded by a record of size
+// 0 that pads out the rest of the buffer.
+//
+// The writer stores writeIndex and then loads readIndex, the reader stores readIndex
+// and then loads writeIndex, both sequentially consistent.  Either the reader sees a
+// new message or the writer sees that the reader had drained the ring and sends a wakeup.
+struct InputChannelRing {
+    alignas(64) std::atomic<uint32_t> writeIndex;
+    alignas(64) std::atomic<uint32_t> readIndex;
+    alignas(64) uint8_t data[RING_BUFFER_SIZE];
+};
+
+struct RingRecord {
+    uint32_t size;
+    uint32_t padding;
+};
+
+// Ring 0 carries messages from the server to the client, ring 1 the other way.
+struct InputChannelSharedRegion {
+    InputChannelRing rings[2];
+};
+
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t),
+        "ring indices must have the same layout in every process");
+static_assert(ATOMIC_INT_LOCK_FREE == 2, "ring indices must be lock free");
+static_assert((RING_BUFFER_SIZE & (RING_BUFFER_SIZE - 1)) == 0,
+        "ring size must be a power of two");
+static_assert(RING_BUFFER_SIZE % sizeof(RingRecord) == 0,
+        "a record header at an aligned index must never straddle the end of the ring");
+
+// Records are a multiple of sizeof(RingRecord) long, so both indices always are too
+// unless the peer has scribbled on them.
+static inline bool isRingIndexAligned(uint32_t index) {
+    return index % sizeof(RingRecord) == 0;
+}
+
+static inline uint32_t ringRecordSize(uint32_t msgLength) {
+    return (sizeof(RingRecord) + msgLength + 7) & ~7u;
+}
+
+class InputChannel::SharedMemory : public RefBase {
+public:
+    explicit SharedMemory(void* address) :
+            region(static_cast<InputChannelSharedRegion*>(address)) {
+    }
+
+    InputChannelSharedRegion* const region;
+
+protected:
+    virtual ~SharedMemory() {
+        munmap(region, sizeof(InputChannelSharedRegion));
+    }
+};
+
+static status_t sendControl(int fd, uint32_t type, uint32_t token, int passFd) {
+    ChannelControl control;
+    control.type = type;
+    control.token = token;
+
+    struct iovec iov;
+    iov.iov_base = &control;
+    iov.iov_len = sizeof(control);
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+
+    char cmsgBuffer[CMSG_SPACE(sizeof(int))];
+    if (passFd >= 0) {
+        msg.msg_control = cmsgBuffer;
+        msg.msg_controllen = sizeof(cmsgBuffer);
+        struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+        memcpy(CMSG_DATA(cmsg), &passFd, sizeof(int));
+    }
+
+    ssize_t nWrite;
+    do {
+        nWrite = ::sendmsg(fd, &msg, MSG_DONTWAIT | MSG_NOSIGNAL);
+    } while (nWrite == -1 && errno == EINTR);
+
+    if (nWrite < 0) {
+        int error = errno;
+        if (error == EAGAIN || error == EWOULDBLOCK) {
+            return WOULD_BLOCK;
+        }
+        if (error == EPIPE || error == ENOTCONN || error == ECONNREFUSED || error == ECONNRESET) {
+            return DEAD_OBJECT;
+        }
+        return -error;
+    }
+    return OK;
+}
+
+InputChannel::InputChannel(const String8& name, int fd, bool sharedMemoryClient) :
+        mName(name), mFd(fd), mAwaitingSharedMemory(sharedMemoryClient),
+        mSendRing(NULL), mReceiveRing(NULL) {
 #if DEBUG_CHANNEL_LIFECYCLE
     ALOGD("Input channel constructed: name='%s', fd=%d",
             mName.string(), fd);
@@ -149,7 +276,73 @@ status_t InputChannel::openInputChannelPair(const String8& name,
     return OK;
 }
 
+status_t InputChannel::openSharedMemoryInputChannelPair(const String8& name,
+        sp<InputChannel>& outServerChannel, sp<InputChannel>& outClientChannel) {
+    status_t result = openInputChannelPair(name, outServerChannel, outClientChannel);
+    if (result) {
+        return result;
+    }
+    outClientChannel->mAwaitingSharedMemory = true;
+
+    int fd = ashmem_create_region(name.string(), sizeof(InputChannelSharedRegion));
+    if (fd < 0) {
+        ALOGE("channel '%s' ~ Could not create shared memory region.  errno=%d",
+                name.string(), errno);
+        result = NO_MEMORY;
+    } else {
+        // The client attaches when it receives this, before any message it is sent.
+        result = sendControl(outServerChannel->getFd(), ChannelControl::TYPE_ATTACH, 1, fd);
+        if (result) {
+            ALOGE("channel '%s' ~ Could not send shared memory region.  status=%d",
+                    name.string(), result);
+        } else {
+            result = outServerChannel->attachSharedMemory(fd, 0);
+        }
+        ::close(fd);
+    }
+
+    if (result) {
+        outServerChannel.clear();
+        outClientChannel.clear();
+    }
+    return result;
+}
+
+status_t InputChannel::attachSharedMemory(int fd, uint32_t sendRingIndex) {
+    int size = ashmem_get_size_region(fd);
+    if (size < 0 || size_t(size) < sizeof(InputChannelSharedRegion)) {
+        ALOGE("channel '%s' ~ Shared memory region has invalid size %d",
+                mName.string(), size);
+        return BAD_VALUE;
+    }
+
+    void* address = mmap(NULL, sizeof(InputChannelSharedRegion), PROT_READ | PROT_WRITE,
+            MAP_SHARED, fd, 0);
+    if (address == MAP_FAILED) {
+        status_t result = -errno;
+        ALOGE("channel '%s' ~ Could not map shared memory region.  errno=%d",
+                mName.string(), errno);
+        return result;
+    }
+
+    mSharedMemory = new SharedMemory(address);
+    mSendRing = &mSharedMemory->region->rings[sendRingIndex];
+    mReceiveRing = &mSharedMemory->region->rings[sendRingIndex ^ 1];
+#if DEBUG_CHANNEL_LIFECYCLE
+    ALOGD("Input channel attached shared memory: name='%s'", mName.string());
+#endif
+    return OK;
+}
+
+bool InputChannel::isSharedMemory() const {
+    return mSharedMemory.get() != NULL;
+}
+
 status_t InputChannel::sendMessage(const InputMessage* msg) {
+    if (mSendRing) {
+        return sendRingMessage(msg);
+    }
+
     size_t msgLength = msg->size();
     ssize_t nWrite;
     do {
@@ -185,7 +378,170 @@ status_t InputChannel::sendMessage(const InputMessage* msg) {
     return OK;
 }
 
+status_t InputChannel::sendRingMessage(const InputMessage* msg) {
+    InputChannelRing* ring = mSendRing;
+    uint32_t msgLength = msg->size();
+    uint32_t recordSize = ringRecordSize(msgLength);
+
+    uint32_t writeIndex = ring->writeIndex.load(std::memory_order_relaxed);
+    if (!isRingIndexAligned(writeIndex)) {
+        ALOGE("channel '%s' ~ ring is corrupt", mName.string());
+        return BAD_VALUE;
+    }
+    uint32_t used = writeIndex - ring->readIndex.load(std::memory_order_acquire);
+    uint32_t offset = writeIndex & (RING_BUFFER_SIZE - 1);
+    uint32_t contiguous = RING_BUFFER_SIZE - offset;
+    uint32_t needed = recordSize <= contiguous ? recordSize : contiguous + recordSize;
+    if (used > RING_BUFFER_SIZE || needed > RING_BUFFER_SIZE - used) {
+#if DEBUG_CHANNEL_MESSAGES
+        ALOGD("channel '%s' ~ ring full sending message of type %d", mName.string(),
+                msg->header.type);
+#endif
+        return WOULD_BLOCK;
+    }
+
+    const uint32_t startIndex = writeIndex;
+    if (recordSize > contiguous) {
+        RingRecord pad = { 0, 0 };
+        memcpy(ring->data + offset, &pad, sizeof(pad));
+        writeIndex += contiguous;
+        offset = 0;
+    }
+    RingRecord record = { msgLength, 0 };
+    memcpy(ring->data + offset, &record, sizeof(record));
+    memcpy(ring->data + offset + sizeof(record), msg, msgLength);
+    ring->writeIndex.store(writeIndex + recordSize, std::memory_order_seq_cst);
+
+    if (ring->readIndex.load(std::memory_order_seq_cst) == startIndex) {
+        // The receiver had drained the ring and may be waiting on the fd.  If the socket
+        // is full of earlier wakeups the fd is readable anyway.
+        status_t status = sendControl(mFd, ChannelControl::TYPE_WAKEUP, startIndex, -1);
+        if (status != OK && status != WOULD_BLOCK) {
+#if DEBUG_CHANNEL_MESSAGES
+            ALOGD("channel '%s' ~ error sending wakeup, status=%d", mName.string(), status);
+#endif
+            return status;
+        }
+    }
+
+#if DEBUG_CHANNEL_MESSAGES
+    ALOGD("channel '%s' ~ sent message of type %d through ring", mName.string(),
+            msg->header.type);
+#endif
+    return OK;
+}
+
 status_t InputChannel::receiveMessage(InputMessage* msg) {
+    if (mReceiveRing) {
+        status_t status = receiveRingMessage(msg);
+        if (status != WOULD_BLOCK) {
+            return status;
+        }
+        return receiveAfterRingEmpty(msg);
+    }
+    if (mAwaitingSharedMemory) {
+        return receiveSharedMemory(msg);
+    }
+    return receiveSocketMessage(msg);
+}
+
+status_t InputChannel::receiveRingMessage(InputMessage* msg) {
+    // The ring is writable by the peer so every size read from it is checked before use.
+    InputChannelRing* ring = mReceiveRing;
+    uint32_t readIndex = ring->readIndex.load(std::memory_order_relaxed);
+    uint32_t available = ring->writeIndex.load(std::memory_order_seq_cst) - readIndex;
+    if (available == 0) {
+        return WOULD_BLOCK;
+    }
+    if (available > RING_BUFFER_SIZE || !isRingIndexAligned(readIndex)) {
+        ALOGE("channel '%s' ~ ring is corrupt", mName.string());
+        return BAD_VALUE;
+    }
+
+    uint32_t offset = readIndex & (RING_BUFFER_SIZE - 1);
+    RingRecord record;
+    memcpy(&record, ring->data + offset, sizeof(record));
+    if (record.size == 0) {
+        uint32_t contiguous = RING_BUFFER_SIZE - offset;
+        if (contiguous >= available) {
+            ALOGE("channel '%s' ~ ring is corrupt", mName.string());
+            return BAD_VALUE;
+        }
+        readIndex += contiguous;
+        available -= contiguous;
+        offset = 0;
+        memcpy(&record, ring->data, sizeof(record));
+    }
+
+    uint32_t msgLength = record.size;
+    if (msgLength == 0 || msgLength > sizeof(InputMessage)
+            || ringRecordSize(msgLength) > available
+            || offset + ringRecordSize(msgLength) > RING_BUFFER_SIZE) {
+        ALOGE("channel '%s' ~ ring is corrupt", mName.string());
+        return BAD_VALUE;
+    }
+    memcpy(msg, ring->data + offset + sizeof(record), msgLength);
+    ring->readIndex.store(readIndex + ringRecordSize(msgLength), std::memory_order_seq_cst);
+
+    if (!msg->isValid(msgLength)) {
+#if DEBUG_CHANNEL_MESSAGES
+        ALOGD("channel '%s' ~ received invalid message through ring", mName.string());
+#endif
+        return BAD_VALUE;
+    }
+
+#if DEBUG_CHANNEL_MESSAGES
+    ALOGD("channel '%s' ~ received message of type %d through ring", mName.string(),
+            msg->header.type);
+#endif
+    return OK;
+}
+
+status_t InputChannel::receiveAfterRingEmpty(InputMessage* msg) {
+    // Drop the wakeups for messages that have already been read so that the fd stops
+    // being readable.  A wakeup for a message that has not been read yet is left in the
+    // socket: its message was written after the ring was seen empty, so it is read below.
+    // Wakeups whose token lies outside of the unread part of the ring are bogus and are
+    // dropped too, otherwise the peer could keep the fd readable forever.
+    const uint32_t readIndex = mReceiveRing->readIndex.load(std::memory_order_relaxed);
+    for (;;) {
+        ChannelControl control;
+        ssize_t nRead;
+        do {
+            nRead = ::recv(mFd, &control, sizeof(control), MSG_DONTWAIT | MSG_PEEK);
+        } while (nRead == -1 && errno == EINTR);
+
+        if (nRead < 0) {
+            int error = errno;
+            if (error == EAGAIN || error == EWOULDBLOCK) {
+                break;
+            }
+            if (error == EPIPE || error == ENOTCONN || error == ECONNREFUSED) {
+                return DEAD_OBJECT;
+            }
+            return -error;
+        }
+        if (nRead == 0) { // check for EOF
+            return DEAD_OBJECT;
+        }
+
+        if (size_t(nRead) < sizeof(control) || control.type != ChannelControl::TYPE_WAKEUP) {
+            // A message sent through the socket.
+            return receiveSocketMessage(msg);
+        }
+        uint32_t unread = mReceiveRing->writeIndex.load(std::memory_order_seq_cst) - readIndex;
+        if (unread <= RING_BUFFER_SIZE && control.token - readIndex <= unread) {
+            break;
+        }
+        do {
+            nRead = ::recv(mFd, &control, sizeof(control), MSG_DONTWAIT);
+        } while (nRead == -1 && errno == EINTR);
+    }
+
+    return receiveRingMessage(msg);
+}
+
+status_t InputChannel::receiveSocketMessage(InputMessage* msg) {
     ssize_t nRead;
     do {
         nRead = ::recv(mFd, msg, sizeof(InputMessage), MSG_DONTWAIT);
@@ -225,9 +581,76 @@ status_t InputChannel::receiveMessage(InputMessage* msg) {
     return OK;
 }
 
+status_t InputChannel::receiveSharedMemory(InputMessage* msg) {
+    // Only the first packet received by the client end of a shared memory channel pair
+    // may carry an fd.  Every other receive uses recv(), which discards passed fds.
+    struct iovec iov;
+    iov.iov_base = msg;
+    iov.iov_len = sizeof(InputMessage);
+
+    char cmsgBuffer[CMSG_SPACE(sizeof(int))];
+    struct msghdr hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.msg_iov = &iov;
+    hdr.msg_iovlen = 1;
+    hdr.msg_control = cmsgBuffer;
+    hdr.msg_controllen = sizeof(cmsgBuffer);
+
+    ssize_t nRead;
+    do {
+        nRead = ::recvmsg(mFd, &hdr, MSG_DONTWAIT | MSG_CMSG_CLOEXEC);
+    } while (nRead == -1 && errno == EINTR);
+
+    if (nRead < 0) {
+        int error = errno;
+        if (error == EAGAIN || error == EWOULDBLOCK) {
+            return WOULD_BLOCK;
+        }
+        if (error == EPIPE || error == ENOTCONN || error == ECONNREFUSED) {
+            return DEAD_OBJECT;
+        }
+        return -error;
+    }
+    if (nRead == 0) { // check for EOF
+        return DEAD_OBJECT;
+    }
+    mAwaitingSharedMemory = false;
+
+    int passedFd = -1;
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&hdr);
+    if (cmsg && cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS
+            && cmsg->cmsg_len == CMSG_LEN(sizeof(int))) {
+        memcpy(&passedFd, CMSG_DATA(cmsg), sizeof(int));
+    }
+
+    ChannelControl control;
+    memcpy(&control, msg, sizeof(control));
+    if (size_t(nRead) != sizeof(control) || control.type != ChannelControl::TYPE_ATTACH
+            || passedFd < 0 || control.token > 1) {
+        if (passedFd >= 0) {
+            ::close(passedFd);
+        }
+        ALOGE("channel '%s' ~ expected shared memory region as first message",
+                mName.string());
+        return BAD_VALUE;
+    }
+
+    status_t status = attachSharedMemory(passedFd, control.token);
+    ::close(passedFd);
+    return status ? status : receiveMessage(msg);
+}
+
 sp<InputChannel> InputChannel::dup() const {
     int fd = ::dup(getFd());
-    return fd >= 0 ? new InputChannel(getName(), fd) : NULL;
+    if (fd < 0) {
+        return NULL;
+    }
+    sp<InputChannel> channel = new InputChannel(getName(), fd);
+    channel->mAwaitingSharedMemory = mAwaitingSharedMemory;
+    channel->mSharedMemory = mSharedMemory;
+    channel->mSendRing = mSendRing;
+    channel->mReceiveRing = mReceiveRing;
+    return channel;
 }
 
 
@@ -349,6 +772,12 @@ status_t InputPublisher::publishMotionEvent(
 }
 
 status_t InputPublisher::receiveFinishedSignal(uint32_t* outSeq, bool* outHandled) {
+    uint32_t firstSeq;
+    return receiveFinishedSignal(&firstSeq, outSeq, outHandled);
+}
+
+status_t InputPublisher::receiveFinishedSignal(uint32_t* outFirstSeq, uint32_t* outSeq,
+        bool* outHandled) {
 #if DEBUG_TRANSPORT_ACTIONS
     ALOGD("channel '%s' publisher ~ receiveFinishedSignal",
             mChannel->getName().string());
@@ -357,6 +786,7 @@ status_t InputPublisher::receiveFinishedSignal(uint32_t* outSeq, bool* outHandle
     InputMessage msg;
     status_t result = mChannel->receiveMessage(&msg);
     if (result) {
+        *outFirstSeq = 0;
         *outSeq = 0;
         *outHandled = false;
         return result;
@@ -367,6 +797,7 @@ status_t InputPublisher::receiveFinishedSignal(uint32_t* outSeq, bool* outHandle
         return UNKNOWN_ERROR;
     }
     *outSeq = msg.body.finished.seq;
+    *outFirstSeq = msg.body.finished.firstSeq ? msg.body.finished.firstSeq : *outSeq;
     *outHandled = msg.body.finished.handled;
     return OK;
 }
@@ -416,7 +847,13 @@ status_t InputConsumer::consume(InputEventFactoryInterface* factory,
         } else {
             // Receive a fresh message.
             status_t result = mChannel->receiveMessage(&mMsg);
-            if (result) {
+            if (!result) {
+                if (mMsg.header.type == InputMessage::TYPE_KEY) {
+                    mUnfinishedSeqs.push(mMsg.body.key.seq);
+                } else if (mMsg.header.type == InputMessage::TYPE_MOTION) {
+                    mUnfinishedSeqs.push(mMsg.body.motion.seq);
+                }
+            } else {
                 // Consume the next batched event unless batches are being held for later.
                 if (consumeBatches || result != WOULD_BLOCK) {
                     result = consumeBatch(factory, frameTime, outSeq, outEvent);
@@ -836,6 +1273,32 @@ status_t InputConsumer::sendFinishedSignal(uint32_t seq, bool handled) {
                  mSeqChains.removeAt(i);
              }
         }
+
+        // If nothing else was received in between the samples of the batch, finish them
+        // all with one cumulative signal.
+        if (chainIndex) {
+            uint32_t runSeqs[chainIndex + 1];
+            for (size_t i = 0; i < chainIndex; i++) {
+                runSeqs[i] = chainSeqs[chainIndex - 1 - i];
+            }
+            runSeqs[chainIndex] = seq;
+            if (isUnfinishedRun(runSeqs, chainIndex + 1)) {
+                status_t status = sendCumulativeFinishedSignal(runSeqs[0], seq,
+                        chainIndex + 1, handled);
+                if (status) {
+                    // Reconstruct the chain deepest link first, as it was consumed.
+                    for (size_t i = chainIndex; i > 0; ) {
+                        i--;
+                        SeqChain seqChain;
+                        seqChain.seq = i != 0 ? chainSeqs[i - 1] : seq;
+                        seqChain.chain = chainSeqs[i];
+                        mSeqChains.push(seqChain);
+                    }
+                }
+                return status;
+            }
+        }
+
         status_t status = OK;
         while (!status && chainIndex > 0) {
             chainIndex--;
@@ -865,7 +1328,56 @@ status_t InputConsumer::sendUnchainedFinishedSignal(uint32_t seq, bool handled)
     msg.header.type = InputMessage::TYPE_FINISHED;
     msg.body.finished.seq = seq;
     msg.body.finished.handled = handled;
-    return mChannel->sendMessage(&msg);
+    msg.body.finished.firstSeq = 0;
+    status_t status = mChannel->sendMessage(&msg);
+    if (!status) {
+        removeUnfinishedSeqs(seq, 1);
+    }
+    return status;
+}
+
+status_t InputConsumer::sendCumulativeFinishedSignal(uint32_t firstSeq, uint32_t seq,
+        size_t count, bool handled) {
+#if DEBUG_TRANSPORT_ACTIONS
+    ALOGD("channel '%s' consumer ~ sendCumulativeFinishedSignal: firstSeq=%u, seq=%u, "
+            "count=%zu", mChannel->getName().string(), firstSeq, seq, count);
+#endif
+    InputMessage msg;
+    msg.header.type = InputMessage::TYPE_FINISHED;
+    msg.body.finished.seq = seq;
+    msg.body.finished.handled = handled;
+    msg.body.finished.firstSeq = firstSeq;
+    status_t status = mChannel->sendMessage(&msg);
+    if (!status) {
+        removeUnfinishedSeqs(firstSeq, count);
+    }
+    return status;
+}
+
+bool InputConsumer::isUnfinishedRun(const uint32_t* seqs, size_t count) const {
+    for (size_t i = 0; i < mUnfinishedSeqs.size(); i++) {
+        if (mUnfinishedSeqs.itemAt(i) == seqs[0]) {
+            if (i + count > mUnfinishedSeqs.size()) {
+                return false;
+            }
+            for (size_t j = 1; j < count; j++) {
+                if (mUnfinishedSeqs.itemAt(i + j) != seqs[j]) {
+                    return false;
+                }
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+void InputConsumer::removeUnfinishedSeqs(uint32_t firstSeq, size_t count) {
+    for (size_t i = 0; i < mUnfinishedSeqs.size(); i++) {
+        if (mUnfinishedSeqs.itemAt(i) == firstSeq) {
+            mUnfinishedSeqs.removeItemsAt(i, count);
+            return;
+        }
+    }
 }
 
 bool InputConsumer::hasDeferredEvent() const {
@@ -16,8 +16,10 @@
 
 #include "TestHelpers.h"
 
+#include <poll.h>
 #include <unistd.h>
 #include <sys/mman.h>
+#include <sys/socket.h>
 #include <time.h>
 
 #include <cutils/ashmem.h>
@@ -36,8 +38,16 @@ protected:
     PreallocatedInputEventFactory mEventFactory;
 
     virtual void SetUp() {
-        status_t result = InputChannel::openInputChannelPair(String8("channel name"),
-                serverChannel, clientChannel);
+        openChannels(false);
+    }
+
+    void openChannels(bool sharedMemory) {
+        status_t result = sharedMemory
+                ? InputChannel::openSharedMemoryInputChannelPair(String8("channel name"),
+                        serverChannel, clientChannel)
+                : InputChannel::openInputChannelPair(String8("channel name"),
+                        serverChannel, clientChannel);
+        ASSERT_EQ(OK, result);
 
         mPublisher = new InputPublisher(serverChannel);
         mConsumer = new InputConsumer(clientChannel);
@@ -286,4 +296,471 @@ TEST_F(InputPublisherAndConsumerTest, PublishMultipleEvents_EndToEnd) {
     ASSERT_NO_FATAL_FAILURE(PublishAndConsumeKeyEvent());
 }
 
+static status_t publishMove(InputPublisher* publisher, uint32_t seq) {
+    PointerProperties properties;
+    properties.clear();
+    properties.toolType = AMOTION_EVENT_TOOL_TYPE_FINGER;
+    PointerCoords coords;
+    coords.clear();
+    coords.setAxisValue(AMOTION_EVENT_AXIS_X, seq);
+    coords.setAxisValue(AMOTION_EVENT_AXIS_Y, seq);
+    return publisher->publishMotionEvent(seq, 1, AINPUT_SOURCE_TOUCHSCREEN,
+            AMOTION_EVENT_ACTION_MOVE, 0, 0, 0, 0, 0, 0, 0, 1, 1, 0, seq,
+            1, &properties, &coords);
+}
+
+TEST_F(InputPublisherAndConsumerTest, FinishBatch_SendsOneCumulativeSignal) {
+    ASSERT_EQ(OK, publishMove(mPublisher, 1));
+    ASSERT_EQ(OK, publishMove(mPublisher, 2));
+    ASSERT_EQ(OK, publishMove(mPublisher, 3));
+
+    uint32_t seq;
+    InputEvent* event;
+    ASSERT_EQ(OK, mConsumer->consume(&mEventFactory, true, -1, &seq, &event));
+    ASSERT_EQ(3U, seq);
+    EXPECT_EQ(2U, static_cast<MotionEvent*>(event)->getHistorySize());
+    ASSERT_EQ(OK, mConsumer->sendFinishedSignal(seq, true));
+
+    uint32_t firstSeq;
+    bool handled;
+    ASSERT_EQ(OK, mPublisher->receiveFinishedSignal(&firstSeq, &seq, &handled));
+    EXPECT_EQ(1U, firstSeq);
+    EXPECT_EQ(3U, seq);
+    EXPECT_TRUE(handled);
+    EXPECT_EQ(WOULD_BLOCK, mPublisher->receiveFinishedSignal(&firstSeq, &seq, &handled))
+            << "the batch should have been finished by a single signal";
+}
+
+TEST_F(InputPublisherAndConsumerTest, FinishBatch_WhenChannelIsFull_FinishesEverySeqOnRetry) {
+    ASSERT_EQ(OK, publishMove(mPublisher, 1));
+    ASSERT_EQ(OK, publishMove(mPublisher, 2));
+    ASSERT_EQ(OK, publishMove(mPublisher, 3));
+
+    uint32_t seq;
+    InputEvent* event;
+    ASSERT_EQ(OK, mConsumer->consume(&mEventFactory, true, -1, &seq, &event));
+    ASSERT_EQ(3U, seq);
+
+    // Fill the channel back to the publisher with unrelated signals.
+    InputMessage filler;
+    memset(&filler, 0, sizeof(filler));
+    filler.header.type = InputMessage::TYPE_FINISHED;
+    filler.body.finished.seq = 1000;
+    size_t fillerCount = 0;
+    while (clientChannel->sendMessage(&filler) == OK) {
+        fillerCount += 1;
+    }
+    ASSERT_GT(fillerCount, 0U);
+    ASSERT_EQ(WOULD_BLOCK, mConsumer->sendFinishedSignal(3, true));
+
+    uint32_t firstSeq;
+    bool handled;
+    for (size_t i = 0; i < fillerCount; i++) {
+        ASSERT_EQ(OK, mPublisher->receiveFinishedSignal(&firstSeq, &seq, &handled));
+        ASSERT_EQ(1000U, seq);
+    }
+    ASSERT_EQ(OK, mConsumer->sendFinishedSignal(3, true));
+
+    bool finished[4] = { false, false, false, false };
+    while (mPublisher->receiveFinishedSignal(&firstSeq, &seq, &handled) == OK) {
+        ASSERT_LE(firstSeq, seq);
+        ASSERT_LE(seq, 3U);
+        for (uint32_t s = firstSeq; s <= seq; s++) {
+            EXPECT_FALSE(finished[s]) << "seq " << s << " finished twice";
+            finished[s] = true;
+        }
+    }
+    EXPECT_TRUE(finished[1]);
+    EXPECT_TRUE(finished[2]);
+    EXPECT_TRUE(finished[3]);
+}
+
+TEST_F(InputPublisherAndConsumerTest, FinishBatch_WhenInterleavedWithUnfinishedEvent_SendsEachSignal) {
+    ASSERT_EQ(OK, publishMove(mPublisher, 1));
+    ASSERT_EQ(OK, mPublisher->publishKeyEvent(2, 0, AINPUT_SOURCE_KEYBOARD,
+            AKEY_EVENT_ACTION_DOWN, 0, AKEYCODE_ENTER, 0, 0, 0, 0, 0));
+    ASSERT_EQ(OK, publishMove(mPublisher, 3));
+
+    uint32_t seq;
+    InputEvent* event;
+    ASSERT_EQ(OK, mConsumer->consume(&mEventFactory, true, -1, &seq, &event));
+    ASSERT_EQ(2U, seq);
+    ASSERT_EQ(OK, mConsumer->consume(&mEventFactory, true, -1, &seq, &event));
+    ASSERT_EQ(3U, seq);
+
+    // The key event is still unfinished so it must not be covered by the batch.
+    ASSERT_EQ(OK, mConsumer->sendFinishedSignal(3, true));
+    uint32_t firstSeq;
+    bool handled;
+    ASSERT_EQ(OK, mPublisher->receiveFinishedSignal(&firstSeq, &seq, &handled));
+    EXPECT_EQ(1U, firstSeq);
+    EXPECT_EQ(1U, seq);
+    ASSERT_EQ(OK, mPublisher->receiveFinishedSignal(&firstSeq, &seq, &handled));
+    EXPECT_EQ(3U, firstSeq);
+    EXPECT_EQ(3U, seq);
+
+    ASSERT_EQ(OK, mConsumer->sendFinishedSignal(2, false));
+    ASSERT_EQ(OK, mPublisher->receiveFinishedSignal(&firstSeq, &seq, &handled));
+    EXPECT_EQ(2U, firstSeq);
+    EXPECT_EQ(2U, seq);
+    EXPECT_FALSE(handled);
+}
+
+class SharedMemoryInputPublisherAndConsumerTest : public InputPublisherAndConsumerTest {
+protected:
+    virtual void SetUp() {
+        openChannels(true);
+    }
+};
+
+TEST_F(SharedMemoryInputPublisherAndConsumerTest, PublishMultipleEvents_EndToEnd) {
+    EXPECT_TRUE(serverChannel->isSharedMemory());
+    EXPECT_FALSE(clientChannel->isSharedMemory())
+            << "client should not attach before receiving its first message";
+
+    ASSERT_NO_FATAL_FAILURE(PublishAndConsumeMotionEvent());
+    EXPECT_TRUE(clientChannel->isSharedMemory());
+    ASSERT_NO_FATAL_FAILURE(PublishAndConsumeKeyEvent());
+    ASSERT_NO_FATAL_FAILURE(PublishAndConsumeMotionEvent());
+    ASSERT_NO_FATAL_FAILURE(PublishAndConsumeMotionEvent());
+    ASSERT_NO_FATAL_FAILURE(PublishAndConsumeKeyEvent());
+}
+
+TEST_F(SharedMemoryInputPublisherAndConsumerTest, FdIsReadableOnlyWhileMessagesArePending) {
+    ASSERT_NO_FATAL_FAILURE(PublishAndConsumeKeyEvent());
+
+    uint32_t seq;
+    InputEvent* event;
+    ASSERT_EQ(WOULD_BLOCK, mConsumer->consume(&mEventFactory, true, -1, &seq, &event));
+
+    struct pollfd pfd;
+    pfd.fd = clientChannel->getFd();
+    pfd.events = POLLIN;
+    EXPECT_EQ(0, poll(&pfd, 1, 0))
+            << "client fd should not be readable once the ring is drained";
+
+    ASSERT_EQ(OK, mPublisher->publishKeyEvent(1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0));
+    ASSERT_EQ(OK, mPublisher->publishKeyEvent(2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0));
+    EXPECT_EQ(1, poll(&pfd, 1, 0))
+            << "client fd should be readable while messages are pending";
+
+    ASSERT_EQ(OK, mConsumer->consume(&mEventFactory, true, -1, &seq, &event));
+    EXPECT_EQ(1U, seq);
+    EXPECT_EQ(1, poll(&pfd, 1, 0))
+            << "client fd should stay readable until the last message is consumed";
+    ASSERT_EQ(OK, mConsumer->consume(&mEventFactory, true, -1, &seq, &event));
+    EXPECT_EQ(2U, seq);
+    ASSERT_EQ(WOULD_BLOCK, mConsumer->consume(&mEventFactory, true, -1, &seq, &event));
+    EXPECT_EQ(0, poll(&pfd, 1, 0));
+}
+
+// --- Misbehaving peers ---
+
+// These mirror the control packets and the shared region layout of InputTransport.cpp
+// so that the tests can act as a misbehaving peer.
+static const uint32_t CONTROL_WAKEUP = 0x80000001;
+static const uint32_t CONTROL_ATTACH = 0x80000002;
+static const size_t RING_BUFFER_SIZE = 32 * 1024;
+static const size_t RING_READ_INDEX_OFFSET = 64;
+static const size_t RING_DATA_OFFSET = 128;
+static const size_t RING_SIZE = RING_DATA_OFFSET + RING_BUFFER_SIZE;
+static const size_t REGION_SIZE = 2 * RING_SIZE;
+
+static status_t sendControl(int fd, uint32_t type, uint32_t token, int passFd) {
+    uint32_t control[2] = { type, token };
+    struct iovec iov;
+    iov.iov_base = control;
+    iov.iov_len = sizeof(control);
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+
+    char cmsgBuffer[CMSG_SPACE(sizeof(int))];
+    if (passFd >= 0) {
+        msg.msg_control = cmsgBuffer;
+        msg.msg_controllen = sizeof(cmsgBuffer);
+        struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+        memcpy(CMSG_DATA(cmsg), &passFd, sizeof(int));
+    }
+    return sendmsg(fd, &msg, MSG_DONTWAIT | MSG_NOSIGNAL) == sizeof(control) ? OK : -errno;
+}
+
+// Plays the server end of a shared memory channel pair with a region it controls.
+class FakeSharedMemoryServer {
+public:
+    sp<InputChannel> clientChannel;
+    uint8_t* region;
+
+    FakeSharedMemoryServer() : region(NULL), mFd(-1), mRegionFd(-1) {
+        int sockets[2];
+        if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, sockets)) {
+            return;
+        }
+        mFd = sockets[0];
+        clientChannel = new InputChannel(String8("fake client"), sockets[1],
+                true /*sharedMemoryClient*/);
+        mRegionFd = ashmem_create_region("fake region", REGION_SIZE);
+        void* address = mmap(NULL, REGION_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED,
+                mRegionFd, 0);
+        if (address != MAP_FAILED) {
+            region = static_cast<uint8_t*>(address);
+        }
+    }
+
+    ~FakeSharedMemoryServer() {
+        if (region) {
+            munmap(region, REGION_SIZE);
+        }
+        close(mRegionFd);
+        close(mFd);
+    }
+
+    status_t attach() {
+        // The client sends on ring 1 and receives on ring 0.
+        return sendControl(mFd, CONTROL_ATTACH, 1, mRegionFd);
+    }
+
+    void setIndices(uint32_t readIndex, uint32_t writeIndex) {
+        memcpy(region + RING_READ_INDEX_OFFSET, &readIndex, sizeof(readIndex));
+        memcpy(region, &writeIndex, sizeof(writeIndex));
+    }
+
+    void setSendIndices(uint32_t readIndex, uint32_t writeIndex) {
+        memcpy(region + RING_SIZE + RING_READ_INDEX_OFFSET, &readIndex, sizeof(readIndex));
+        memcpy(region + RING_SIZE, &writeIndex, sizeof(writeIndex));
+    }
+
+    void setRecord(uint32_t offset, uint32_t size) {
+        uint32_t record[2] = { size, 0 };
+        memcpy(region + RING_DATA_OFFSET + offset, record, sizeof(record));
+    }
+
+    int getFd() const { return mFd; }
+
+private:
+    int mFd;
+    int mRegionFd;
+};
+
+TEST_F(InputPublisherAndConsumerTest, ReceiveMessage_WhenPeerSendsSharedMemory_ReturnsError) {
+    int regionFd = ashmem_create_region("bogus region", REGION_SIZE);
+    ASSERT_GE(regionFd, 0);
+    ASSERT_EQ(OK, sendControl(clientChannel->getFd(), CONTROL_ATTACH, 0, regionFd));
+    close(regionFd);
+
+    uint32_t seq;
+    bool handled;
+    EXPECT_EQ(BAD_VALUE, mPublisher->receiveFinishedSignal(&seq, &handled));
+    EXPECT_FALSE(serverChannel->isSharedMemory())
+            << "a plain channel should never attach shared memory sent by its peer";
+}
+
+TEST_F(SharedMemoryInputPublisherAndConsumerTest, ReceiveMessage_WhenSharedMemoryIsSentAgain_ReturnsError) {
+    ASSERT_NO_FATAL_FAILURE(PublishAndConsumeKeyEvent());
+    int regionFd = ashmem_create_region("bogus region", REGION_SIZE);
+    ASSERT_GE(regionFd, 0);
+
+    ASSERT_EQ(OK, sendControl(serverChannel->getFd(), CONTROL_ATTACH, 1, regionFd));
+    InputMessage msg;
+    EXPECT_EQ(BAD_VALUE, clientChannel->receiveMessage(&msg))
+            << "the client should only accept shared memory as its first message";
+
+    ASSERT_EQ(OK, sendControl(clientChannel->getFd(), CONTROL_ATTACH, 0, regionFd));
+    uint32_t seq;
+    bool handled;
+    EXPECT_EQ(BAD_VALUE, mPublisher->receiveFinishedSignal(&seq, &handled))
+            << "the server should never accept shared memory from the client";
+    close(regionFd);
+}
+
+TEST_F(InputPublisherAndConsumerTest, ReceiveMessage_WhenFirstMessageIsNotSharedMemory_ReturnsError) {
+    FakeSharedMemoryServer server;
+    ASSERT_TRUE(server.region != NULL);
+
+    InputMessage msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.header.type = InputMessage::TYPE_KEY;
+    ASSERT_EQ(ssize_t(msg.size()), send(server.getFd(), &msg, msg.size(), MSG_DONTWAIT));
+    EXPECT_EQ(BAD_VALUE, server.clientChannel->receiveMessage(&msg));
+
+    ASSERT_EQ(OK, server.attach());
+    EXPECT_EQ(BAD_VALUE, server.clientChannel->receiveMessage(&msg))
+            << "shared memory should not be accepted after the first message";
+    EXPECT_FALSE(server.clientChannel->isSharedMemory());
+}
+
+TEST_F(SharedMemoryInputPublisherAndConsumerTest, ReceiveMessage_WhenWakeupIsBogus_DropsIt) {
+    ASSERT_NO_FATAL_FAILURE(PublishAndConsumeKeyEvent());
+    uint32_t seq;
+    InputEvent* event;
+    ASSERT_EQ(WOULD_BLOCK, mConsumer->consume(&mEventFactory, true, -1, &seq, &event));
+
+    // A wakeup for a message far in the future would keep the fd readable forever.
+    ASSERT_EQ(OK, sendControl(serverChannel->getFd(), CONTROL_WAKEUP, 0x40000000, -1));
+    struct pollfd pfd;
+    pfd.fd = clientChannel->getFd();
+    pfd.events = POLLIN;
+    ASSERT_EQ(1, poll(&pfd, 1, 0));
+    ASSERT_EQ(WOULD_BLOCK, mConsumer->consume(&mEventFactory, true, -1, &seq, &event));
+    EXPECT_EQ(0, poll(&pfd, 1, 0))
+            << "the bogus wakeup should have been dropped";
+}
+
+TEST_F(InputPublisherAndConsumerTest, ReceiveMessage_WhenRingIndicesAreCorrupt_ReturnsError) {
+    FakeSharedMemoryServer server;
+    ASSERT_TRUE(server.region != NULL);
+    ASSERT_EQ(OK, server.attach());
+
+    // More data than the ring can hold.
+    server.setIndices(0, 2 * RING_BUFFER_SIZE);
+    InputMessage msg;
+    EXPECT_EQ(BAD_VALUE, server.clientChannel->receiveMessage(&msg));
+    EXPECT_TRUE(server.clientChannel->isSharedMemory());
+
+    // A read index off the record boundaries, whose record header would straddle the
+    // end of the ring.
+    server.setIndices(RING_BUFFER_SIZE - 4, RING_BUFFER_SIZE + 16);
+    server.setRecord(0, 8);
+    EXPECT_EQ(BAD_VALUE, server.clientChannel->receiveMessage(&msg));
+}
+
+TEST_F(InputPublisherAndConsumerTest, SendMessage_WhenRingWriteIndexIsCorrupt_ReturnsError) {
+    FakeSharedMemoryServer server;
+    ASSERT_TRUE(server.region != NULL);
+    ASSERT_EQ(OK, server.attach());
+    InputMessage msg;
+    ASSERT_EQ(WOULD_BLOCK, server.clientChannel->receiveMessage(&msg));
+    ASSERT_TRUE(server.clientChannel->isSharedMemory());
+
+    // The peer moved the client's write index off the record boundaries, so that the
+    // padding record in front of the message would straddle the end of the ring.
+    server.setSendIndices(RING_BUFFER_SIZE - 4, RING_BUFFER_SIZE - 4);
+    memset(&msg, 0, sizeof(msg));
+    msg.header.type = InputMessage::TYPE_FINISHED;
+    msg.body.finished.seq = 1;
+    EXPECT_EQ(BAD_VALUE, server.clientChannel->sendMessage(&msg));
+}
+
+TEST_F(InputPublisherAndConsumerTest, ReceiveMessage_WhenRingRecordSizeIsCorrupt_ReturnsError) {
+    FakeSharedMemoryServer server;
+    ASSERT_TRUE(server.region != NULL);
+    ASSERT_EQ(OK, server.attach());
+    InputMessage msg;
+
+    // Larger than any message.
+    server.setIndices(0, 4096);
+    server.setRecord(0, sizeof(InputMessage) + 8);
+    EXPECT_EQ(BAD_VALUE, server.clientChannel->receiveMessage(&msg));
+
+    // Larger than the data written.
+    server.setIndices(0, 16);
+    server.setRecord(0, 64);
+    EXPECT_EQ(BAD_VALUE, server.clientChannel->receiveMessage(&msg));
+
+    // A padding record that covers everything written.
+    server.setIndices(RING_BUFFER_SIZE - 16, RING_BUFFER_SIZE);
+    server.setRecord(RING_BUFFER_SIZE - 16, 0);
+    EXPECT_EQ(BAD_VALUE, server.clientChannel->receiveMessage(&msg));
+
+    // Within bounds but not a valid message.
+    server.setIndices(0, 16);
+    server.setRecord(0, 8);
+    EXPECT_EQ(BAD_VALUE, server.clientChannel->receiveMessage(&msg));
+}
+
+// --- Transport comparison ---
+
+struct TransportTiming {
+    nsecs_t roundTripLatency;
+    double eventsPerSecond;
+};
+
+static status_t publishTouch(InputPublisher* publisher, uint32_t seq) {
+    PointerProperties properties;
+    properties.clear();
+    properties.toolType = AMOTION_EVENT_TOOL_TYPE_FINGER;
+    PointerCoords coords;
+    coords.clear();
+    coords.setAxisValue(AMOTION_EVENT_AXIS_X, seq % 1000);
+    coords.setAxisValue(AMOTION_EVENT_AXIS_Y, seq % 2000);
+    // Use DOWN so that the consumer does not batch samples and every message is an event.
+    return publisher->publishMotionEvent(seq, 1, AINPUT_SOURCE_TOUCHSCREEN,
+            AMOTION_EVENT_ACTION_DOWN, 0, 0, 0, 0, 0, 0, 0, 1, 1, seq, seq,
+            1, &properties, &coords);
+}
+
+static size_t drainFinishedSignals(InputPublisher* publisher) {
+    size_t count = 0;
+    uint32_t seq;
+    bool handled;
+    while (publisher->receiveFinishedSignal(&seq, &handled) == OK) {
+        count += 1;
+    }
+    return count;
+}
+
+static void measureTransport(bool sharedMemory, size_t numEvents, TransportTiming* outTiming) {
+    sp<InputChannel> serverChannel, clientChannel;
+    status_t result = sharedMemory
+            ? InputChannel::openSharedMemoryInputChannelPair(String8("comparison"),
+                    serverChannel, clientChannel)
+            : InputChannel::openInputChannelPair(String8("comparison"),
+                    serverChannel, clientChannel);
+    ASSERT_EQ(OK, result);
+    InputPublisher publisher(serverChannel);
+    InputConsumer consumer(clientChannel);
+    PreallocatedInputEventFactory factory;
+    uint32_t seq;
+    InputEvent* event;
+
+    // Latency: one event at a time, through to its finished signal.
+    nsecs_t start = systemTime(SYSTEM_TIME_MONOTONIC);
+    for (size_t i = 1; i <= numEvents; i++) {
+        ASSERT_EQ(OK, publishTouch(&publisher, i));
+        ASSERT_EQ(OK, consumer.consume(&factory, true, -1, &seq, &event));
+        ASSERT_EQ(OK, consumer.sendFinishedSignal(seq, true));
+        ASSERT_EQ(1U, drainFinishedSignals(&publisher));
+    }
+    outTiming->roundTripLatency = (systemTime(SYSTEM_TIME_MONOTONIC) - start) / numEvents;
+
+    // Throughput: fill the channel, then drain it, until every event is finished.
+    size_t published = 0;
+    size_t finished = 0;
+    start = systemTime(SYSTEM_TIME_MONOTONIC);
+    while (finished < numEvents) {
+        while (published < numEvents
+                && publishTouch(&publisher, published + 1) == OK) {
+            published += 1;
+        }
+        while ((result = consumer.consume(&factory, true, -1, &seq, &event)) == OK) {
+            while ((result = consumer.sendFinishedSignal(seq, true)) == WOULD_BLOCK) {
+                finished += drainFinishedSignals(&publisher);
+            }
+            ASSERT_EQ(OK, result);
+        }
+        ASSERT_EQ(WOULD_BLOCK, result);
+        finished += drainFinishedSignals(&publisher);
+    }
+    nsecs_t elapsed = systemTime(SYSTEM_TIME_MONOTONIC) - start;
+    ASSERT_EQ(numEvents, finished);
+    outTiming->eventsPerSecond = numEvents * 1e9 / (elapsed > 0 ? elapsed : 1);
+}
+
+TEST(InputTransportComparisonTest, SocketVersusSharedMemory) {
+    const size_t numEvents = 20000;
+    TransportTiming socketTiming, sharedMemoryTiming;
+    ASSERT_NO_FATAL_FAILURE(measureTransport(false, numEvents, &socketTiming));
+    ASSERT_NO_FATAL_FAILURE(measureTransport(true, numEvents, &sharedMemoryTiming));
+
+    printf("socket:        round trip %6.2f us, %10.0f events/s\n",
+            socketTiming.roundTripLatency / 1000.0, socketTiming.eventsPerSecond);
+    printf("shared memory: round trip %6.2f us, %10.0f events/s\n",
+            sharedMemoryTiming.roundTripLatency / 1000.0, sharedMemoryTiming.eventsPerSecond);
+}
+
 } // namespace android
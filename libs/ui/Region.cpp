@@ -19,6 +19,9 @@
 #include <inttypes.h>
 #include <limits.h>
 
+#include <new>
+#include <type_traits>
+
 #include <utils/Log.h>
 #include <utils/String8.h>
 #include <utils/CallStack.h>
@@ -29,6 +32,14 @@
 
 #include <private/ui/RegionHelper.h>
 
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define REGION_USE_NEON 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define REGION_USE_SSE2 1
+#endif
+
 // ----------------------------------------------------------------------------
 #define VALIDATE_REGIONS        (false)
 #define VALIDATE_WITH_CORECG    (false)
@@ -413,20 +424,156 @@ const Region Region::operation(const Region& rhs, int dx, int dy, int op) const
 
 // ----------------------------------------------------------------------------
 
+// Returns true if every rect of the span [p, p+count) has the same left and
+// right edges as the corresponding rect of [q, q+count), in which case the two
+// spans can be coalesced vertically. top and bottom are ignored.
+static inline bool spansHaveSameEdges(Rect const* p, Rect const* q, size_t count)
+{
+#if defined(REGION_USE_NEON)
+    // lanes are { left, top, right, bottom }, only compare left and right
+    static const uint32_t kEdgeMask[4] = { 0xFFFFFFFFu, 0, 0xFFFFFFFFu, 0 };
+    uint32x4_t diff = vdupq_n_u32(0);
+    for (size_t i = 0; i < count; i++) {
+        const uint32x4_t a = vld1q_u32(reinterpret_cast<const uint32_t*>(&p[i].left));
+        const uint32x4_t b = vld1q_u32(reinterpret_cast<const uint32_t*>(&q[i].left));
+        diff = vorrq_u32(diff, veorq_u32(a, b));
+    }
+    diff = vandq_u32(diff, vld1q_u32(kEdgeMask));
+    const uint32x2_t folded = vorr_u32(vget_low_u32(diff), vget_high_u32(diff));
+    return (vget_lane_u32(folded, 0) | vget_lane_u32(folded, 1)) == 0;
+#elif defined(REGION_USE_SSE2)
+    // lanes are { left, top, right, bottom }, only compare left and right
+    const __m128i edgeMask = _mm_set_epi32(0, -1, 0, -1);
+    __m128i diff = _mm_setzero_si128();
+    for (size_t i = 0; i < count; i++) {
+        const __m128i a = _mm_loadu_si128(
+                static_cast<const __m128i*>(static_cast<const void*>(p + i)));
+        const __m128i b = _mm_loadu_si128(
+                static_cast<const __m128i*>(static_cast<const void*>(q + i)));
+        diff = _mm_or_si128(diff, _mm_xor_si128(a, b));
+    }
+    diff = _mm_and_si128(diff, edgeMask);
+    return _mm_movemask_epi8(_mm_cmpeq_epi32(diff, _mm_setzero_si128())) == 0xFFFF;
+#else
+    int32_t diff = 0;
+    for (size_t i = 0; i < count; i++) {
+        diff |= (p[i].left ^ q[i].left) | (p[i].right ^ q[i].right);
+    }
+    return diff == 0;
+#endif
+}
+
+// Offsets all rects in [rects, rects+count) by (dx, dy).
+static inline void offsetRects(Rect* rects, size_t count, int dx, int dy)
+{
+#if defined(REGION_USE_NEON)
+    const int32_t delta[4] = { dx, dy, dx, dy };
+    const int32x4_t d = vld1q_s32(delta);
+    for (size_t i = 0; i < count; i++) {
+        int32_t* r = &rects[i].left;
+        vst1q_s32(r, vaddq_s32(vld1q_s32(r), d));
+    }
+#elif defined(REGION_USE_SSE2)
+    const __m128i d = _mm_set_epi32(dy, dx, dy, dx);
+    for (size_t i = 0; i < count; i++) {
+        __m128i* r = static_cast<__m128i*>(static_cast<void*>(rects + i));
+        _mm_storeu_si128(r, _mm_add_epi32(_mm_loadu_si128(r), d));
+    }
+#else
+    for (size_t i = 0; i < count; i++) {
+        rects[i].offsetBy(dx, dy);
+    }
+#endif
+}
+
+// ----------------------------------------------------------------------------
+
 // This is our region rasterizer, which merges rects and spans together
 // to obtain an optimal region.
 class Region::rasterizer : public region_operator<Rect>::region_rasterizer
 {
+    // Scratch storage for rects, kept inline and only moved to the heap once
+    // there are more than InlineCapacity of them. The inline rects are left
+    // uninitialized until they are added.
+    template<size_t InlineCapacity>
+    class rect_storage
+    {
+        Rect* mRects;
+        size_t mSize;
+        size_t mCapacity;
+        typename std::aligned_storage<sizeof(Rect) * InlineCapacity,
+                alignof(Rect)>::type mInline;
+
+        Rect* inlineRects() { return reinterpret_cast<Rect*>(&mInline); }
+
+        rect_storage(const rect_storage&) = delete;
+        rect_storage& operator = (const rect_storage&) = delete;
+
+        void reserve(size_t size) {
+            if (size <= mCapacity) {
+                return;
+            }
+            size_t capacity = mCapacity * 2;
+            while (capacity < size) {
+                capacity *= 2;
+            }
+            Rect* rects = new Rect[capacity];
+            for (size_t i = 0; i < mSize; i++) {
+                rects[i] = mRects[i];
+            }
+            if (mRects != inlineRects()) {
+                delete [] mRects;
+            }
+            mRects = rects;
+            mCapacity = capacity;
+        }
+
+    public:
+        rect_storage() : mRects(inlineRects()), mSize(0), mCapacity(InlineCapacity) { }
+        ~rect_storage() {
+            if (mRects != inlineRects()) {
+                delete [] mRects;
+            }
+        }
+
+        inline size_t size() const { return mSize; }
+        inline Rect const* array() const { return mRects; }
+        inline Rect* editArray() { return mRects; }
+        inline Rect const& itemAt(size_t index) const { return mRects[index]; }
+        inline Rect const& top() const { return mRects[mSize - 1]; }
+        inline void clear() { mSize = 0; }
+
+        // returns the newly added rect, which stays valid until the next
+        // add() or append()
+        Rect* add(const Rect& rect) {
+            reserve(mSize + 1);
+            new (mRects + mSize) Rect(rect);
+            return mRects + mSize++;
+        }
+
+        void append(Rect const* rects, size_t count) {
+            reserve(mSize + count);
+            for (size_t i = 0; i < count; i++) {
+                new (mRects + mSize + i) Rect(rects[i]);
+            }
+            mSize += count;
+        }
+    };
+
+    // Spans of typical window shapes have only a handful of rects, and whole
+    // regions a few dozen (a rounded corner adds one per pixel row), so the
+    // result is built on the stack. The region's storage is then allocated
+    // once, at its final size, by the destructor.
     Rect bounds;
     Vector<Rect>& storage;
+    rect_storage<128> rects;
     Rect* head;
     Rect* tail;
-    Vector<Rect> span;
+    rect_storage<16> span;
     Rect* cur;
 public:
     rasterizer(Region& reg)
         : bounds(INT_MAX, 0, INT_MIN, 0), storage(reg.mStorage), head(), tail(), cur() {
-        storage.clear();
     }
 
     virtual ~rasterizer();
@@ -447,16 +594,22 @@ Region::rasterizer::~rasterizer()
     if (span.size()) {
         flushSpan();
     }
-    if (storage.size()) {
-        bounds.top = storage.itemAt(0).top;
-        bounds.bottom = storage.top().bottom;
-        if (storage.size() == 1) {
-            storage.clear();
-        }
+    // drop the (possibly shared) previous content without copying it
+    storage = Vector<Rect>();
+    if (rects.size()) {
+        bounds.top = rects.itemAt(0).top;
+        bounds.bottom = rects.top().bottom;
     } else {
         bounds.left  = 0;
         bounds.right = 0;
     }
+    // a single rect is its own bounds, otherwise the bounds go last
+    if (rects.size() > 1) {
+        storage.setCapacity(rects.size() + 1);
+        storage.appendArray(rects.array(), rects.size());
+    } else {
+        storage.setCapacity(1);
+    }
     storage.add(bounds);
 }
 
@@ -472,29 +625,21 @@ void Region::rasterizer::operator()(const Rect& rect)
             return;
         }
     }
-    span.add(rect);
-    cur = span.editArray() + (span.size() - 1);
+    cur = span.add(rect);
 }
 
 void Region::rasterizer::flushSpan()
 {
     bool merge = false;
     if (tail-head == ssize_t(span.size())) {
-        Rect const* p = span.editArray();
+        Rect const* p = span.array();
         Rect const* q = head;
         if (p->top == q->bottom) {
-            merge = true;
-            while (q != tail) {
-                if ((p->left != q->left) || (p->right != q->right)) {
-                    merge = false;
-                    break;
-                }
-                p++, q++;
-            }
+            merge = spansHaveSameEdges(p, q, span.size());
         }
     }
     if (merge) {
-        const int bottom = span[0].bottom;
+        const int bottom = span.itemAt(0).bottom;
         Rect* r = head;
         while (r != tail) {
             r->bottom = bottom;
@@ -503,8 +648,8 @@ void Region::rasterizer::flushSpan()
     } else {
         bounds.left = min(span.itemAt(0).left, bounds.left);
         bounds.right = max(span.top().right, bounds.right);
-        storage.appendVector(span);
-        tail = storage.editArray() + storage.size();
+        rects.append(span.array(), span.size());
+        tail = rects.editArray() + rects.size();
         head = tail - span.size();
     }
     span.clear();
@@ -739,13 +884,7 @@ void Region::translate(Region& reg, int dx, int dy)
 #if VALIDATE_REGIONS
         validate(reg, "translate (before)");
 #endif
-        size_t count = reg.mStorage.size();
-        Rect* rects = reg.mStorage.editArray();
-        while (count) {
-            rects->offsetBy(dx, dy);
-            rects++;
-            count--;
-        }
+        offsetRects(reg.mStorage.editArray(), reg.mStorage.size(), dx, dy);
 #if VALIDATE_REGIONS
         validate(reg, "translate (after)");
 #endif
@@ -23,6 +23,16 @@ LOCAL_SRC_FILES := Region_test.cpp
 LOCAL_MODULE := Region_test
 include $(BUILD_NATIVE_TEST)
 
+include $(CLEAR_VARS)
+LOCAL_ADDITIONAL_DEPENDENCIES := $(LOCAL_PATH)/Android.mk
+LOCAL_SHARED_LIBRARIES := libui libutils
+LOCAL_SRC_FILES := Region_benchmark.cpp
+LOCAL_MODULE := Region_benchmark
+LOCAL_CFLAGS += -O3
+# lets the benchmark's malloc count the allocations made by libui
+LOCAL_LDFLAGS += -Wl,--export-dynamic
+include $(BUILD_NATIVE_TEST)
+
 include $(CLEAR_VARS)
 LOCAL_ADDITIONAL_DEPENDENCIES := $(LOCAL_PATH)/Android.mk
 LOCAL_SRC_FILES := vec_test.cpp
@@ -0,0 +1,184 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Measures Region boolean operation throughput on window shapes similar to
+// what SurfaceFlinger sees when computing visible regions: full screen
+// windows, system bars, a picture-in-picture window and dialogs with rounded
+// (stair-cased) corners. Also counts the heap allocations each operation
+// makes.
+
+#include <dlfcn.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <ui/Rect.h>
+#include <ui/Region.h>
+#include <utils/Timers.h>
+
+#include <vector>
+
+using namespace android;
+
+static const int kWidth = 1080;
+static const int kHeight = 1920;
+
+// Heap allocations are counted while gCountAllocations is set. The benchmark
+// is linked with --export-dynamic, so that libui and libutils call these
+// instead of libc's malloc and realloc (operator new calls malloc).
+typedef void* (*MallocFunction)(size_t);
+typedef void* (*ReallocFunction)(void*, size_t);
+static MallocFunction gMalloc = NULL;
+static ReallocFunction gRealloc = NULL;
+static bool gCountAllocations = false;
+static size_t gAllocations = 0;
+
+extern "C" void* malloc(size_t size) {
+    if (gMalloc == NULL) {
+        gMalloc = reinterpret_cast<MallocFunction>(dlsym(RTLD_NEXT, "malloc"));
+    }
+    if (gCountAllocations) {
+        gAllocations++;
+    }
+    return gMalloc(size);
+}
+
+extern "C" void* realloc(void* ptr, size_t size) {
+    if (gRealloc == NULL) {
+        gRealloc = reinterpret_cast<ReallocFunction>(dlsym(RTLD_NEXT, "realloc"));
+    }
+    if (gCountAllocations) {
+        gAllocations++;
+    }
+    return gRealloc(ptr, size);
+}
+
+// A rect with its four corners rounded by 'radius', approximated by one
+// rect per pixel row of the corner.
+static Region roundedRect(const Rect& r, int radius) {
+    Region region(Rect(r.left, r.top + radius, r.right, r.bottom - radius));
+    for (int y = 0; y < radius; y++) {
+        const int dy = radius - y;
+        int inset = 0;
+        while ((radius - inset) * (radius - inset) + dy * dy > radius * radius) {
+            inset++;
+        }
+        region.orSelf(Rect(r.left + inset, r.top + y, r.right - inset, r.top + y + 1));
+        region.orSelf(Rect(r.left + inset, r.bottom - y - 1, r.right - inset, r.bottom - y));
+    }
+    return region;
+}
+
+static std::vector<Region> makeWindowShapes() {
+    std::vector<Region> shapes;
+    // wallpaper, app, status bar, navigation bar
+    shapes.push_back(Region(Rect(0, 0, kWidth, kHeight)));
+    shapes.push_back(Region(Rect(0, 72, kWidth, kHeight - 144)));
+    shapes.push_back(Region(Rect(0, 0, kWidth, 72)));
+    shapes.push_back(Region(Rect(0, kHeight - 144, kWidth, kHeight)));
+    // picture-in-picture window
+    shapes.push_back(roundedRect(Rect(600, 1300, 1040, 1548), 8));
+    // dialog and toast
+    shapes.push_back(roundedRect(Rect(60, 600, 1020, 1200), 24));
+    shapes.push_back(roundedRect(Rect(240, 1500, 840, 1620), 48));
+    // L-shaped region, e.g. what remains of a window under the PiP window
+    Region l(Rect(0, 72, kWidth, kHeight - 144));
+    l.subtractSelf(Rect(600, 1300, 1040, 1548));
+    shapes.push_back(l);
+    return shapes;
+}
+
+typedef const Region (Region::*Operation)(const Region&) const;
+
+static void runBenchmark(const char* name, Operation op,
+        const std::vector<Region>& shapes, int iterations) {
+    size_t rects = 0;
+    const nsecs_t start = systemTime(SYSTEM_TIME_MONOTONIC);
+    for (int i = 0; i < iterations; i++) {
+        for (size_t a = 0; a < shapes.size(); a++) {
+            for (size_t b = 0; b < shapes.size(); b++) {
+                const Region result((shapes[a].*op)(shapes[b]));
+                size_t count;
+                result.getArray(&count);
+                rects += count;
+            }
+        }
+    }
+    const nsecs_t elapsed = systemTime(SYSTEM_TIME_MONOTONIC) - start;
+    const double ops = double(iterations) * double(shapes.size() * shapes.size());
+    printf("%-10s %10.0f ops/s  %8.1f ns/op  (%zu rects produced)\n",
+            name, ops * 1e9 / double(elapsed), double(elapsed) / ops, rects);
+}
+
+static void countAllocations(const char* name, Operation op,
+        const std::vector<Region>& shapes) {
+    gAllocations = 0;
+    gCountAllocations = true;
+    for (size_t a = 0; a < shapes.size(); a++) {
+        for (size_t b = 0; b < shapes.size(); b++) {
+            const Region result((shapes[a].*op)(shapes[b]));
+        }
+    }
+    gCountAllocations = false;
+    printf("%-10s %8.2f allocations/op\n", name,
+            double(gAllocations) / double(shapes.size() * shapes.size()));
+}
+
+static void runAccumulateBenchmark(const std::vector<Region>& shapes,
+        int iterations) {
+    // mimics SurfaceFlinger::computeVisibleRegions(): walk the windows front
+    // to back, accumulating covered and opaque regions.
+    const nsecs_t start = systemTime(SYSTEM_TIME_MONOTONIC);
+    for (int i = 0; i < iterations; i++) {
+        Region aboveOpaque;
+        Region aboveCovered;
+        for (size_t s = shapes.size(); s-- > 0; ) {
+            Region visible(shapes[s]);
+            const Region covered(aboveCovered.intersect(visible));
+            aboveCovered.orSelf(visible);
+            visible.subtractSelf(aboveOpaque);
+            aboveOpaque.orSelf(shapes[s]);
+            (void)covered;
+        }
+    }
+    const nsecs_t elapsed = systemTime(SYSTEM_TIME_MONOTONIC) - start;
+    printf("%-10s %10.0f passes/s  %8.1f us/pass\n", "visibility",
+            double(iterations) * 1e9 / double(elapsed),
+            double(elapsed) / 1e3 / double(iterations));
+}
+
+int main(int argc, char** argv) {
+    int iterations = 2000;
+    if (argc > 1) {
+        iterations = atoi(argv[1]);
+    }
+
+    const std::vector<Region> shapes(makeWindowShapes());
+    for (size_t i = 0; i < shapes.size(); i++) {
+        size_t count;
+        shapes[i].getArray(&count);
+        printf("shape %zu: %zu rects\n", i, count);
+    }
+
+    runBenchmark("merge", &Region::merge, shapes, iterations);
+    runBenchmark("subtract", &Region::subtract, shapes, iterations);
+    runBenchmark("intersect", &Region::intersect, shapes, iterations);
+    runAccumulateBenchmark(shapes, iterations);
+
+    countAllocations("merge", &Region::merge, shapes);
+    countAllocations("subtract", &Region::subtract, shapes);
+    countAllocations("intersect", &Region::intersect, shapes);
+    return 0;
+}
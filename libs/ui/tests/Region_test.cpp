@@ -152,5 +152,50 @@ TEST_F(RegionTest, Random_TJunction) {
     }
 }
 
+TEST_F(RegionTest, MergeCoalescesMatchingSpans) {
+    Region r;
+     // |x x|    |x x|
+     // |x x| => |x x|
+    r.orSelf(Rect(0, 0, 1, 1));
+    r.orSelf(Rect(2, 0, 3, 1));
+    r.orSelf(Rect(0, 1, 1, 2));
+    r.orSelf(Rect(2, 1, 3, 2));
+    EXPECT_EQ(2, r.end() - r.begin());
+    EXPECT_EQ(Rect(0, 0, 1, 2), r.begin()[0]);
+    EXPECT_EQ(Rect(2, 0, 3, 2), r.begin()[1]);
+
+     // a wider span doesn't coalesce
+    r.orSelf(Rect(0, 2, 3, 3));
+    EXPECT_EQ(3, r.end() - r.begin());
+    EXPECT_EQ(Rect(0, 0, 3, 3), r.getBounds());
+}
+
+TEST_F(RegionTest, WideSpans) {
+    // spans with more rects than the rasterizer keeps inline
+    Region r;
+    for (int x = 0; x < 64; x++) {
+        r.orSelf(Rect(x * 2, 0, x * 2 + 1, 4));
+    }
+    EXPECT_EQ(64, r.end() - r.begin());
+    Region s(r.subtract(Rect(0, 1, 128, 2)));
+    EXPECT_EQ(128, s.end() - s.begin());
+    EXPECT_TRUE((s.merge(Rect(0, 1, 128, 2)) ^ r.merge(Rect(0, 1, 128, 2))).isEmpty());
+}
+
+TEST_F(RegionTest, Translate) {
+    Region r(Rect(0, 0, 10, 10));
+    r.orSelf(Rect(20, 5, 30, 15));
+    const Region t(r.translate(3, -2));
+    ASSERT_EQ(r.end() - r.begin(), t.end() - t.begin());
+    for (const Rect *a = r.begin(), *b = t.begin(); a != r.end(); a++, b++) {
+        Rect expected(*a);
+        expected.offsetBy(3, -2);
+        EXPECT_EQ(expected, *b);
+    }
+    Rect bounds(r.getBounds());
+    bounds.offsetBy(3, -2);
+    EXPECT_EQ(bounds, t.getBounds());
+}
+
 }; // namespace android
 
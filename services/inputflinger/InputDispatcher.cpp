@@ -53,8 +53,11 @@
 #include <stddef.h>
 #include <unistd.h>
 #include <errno.h>
+#include <inttypes.h>
 #include <limits.h>
 #include <time.h>
+#include <algorithm>
+#include <vector>
 #include <ui/DisplayInfo.h>
 #include <gui/SurfaceComposerClient.h>
 #include <gui/ISurfaceComposer.h>
@@ -217,6 +220,12 @@ InputDispatcher::InputDispatcher(const sp<InputDispatcherPolicyInterface>& polic
 
     mKeyRepeatState.lastKeyEntry = NULL;
 
+    mWindowUpdateStats.fullUpdates = 0;
+    mWindowUpdateStats.incrementalUpdates = 0;
+    mWindowUpdateStats.totalLockHeldTime = 0;
+    mWindowUpdateStats.maxLockHeldTime = 0;
+    mWindowUpdateStats.lastLockHeldTime = 0;
+
     policy->getDispatcherConfiguration(&mConfig);
 }
 
@@ -482,10 +491,12 @@ void InputDispatcher::addRecentEventLocked(EventEntry* entry) {
 
 sp<InputWindowHandle> InputDispatcher::findTouchedWindowAtLocked(int32_t displayId,
         int32_t x, int32_t y) {
-    // Traverse windows from front to back to find touched window.
-    size_t numWindows = mWindowHandles.size();
-    for (size_t i = 0; i < numWindows; i++) {
-        sp<InputWindowHandle> windowHandle = mWindowHandles.itemAt(i);
+    // Traverse the windows that may contain the point from front to back to find
+    // touched window.
+    const Vector<WindowHitGrid::Candidate>& candidates = mWindowHitGrid.getCandidates(x, y);
+    size_t numCandidates = candidates.size();
+    for (size_t i = 0; i < numCandidates; i++) {
+        sp<InputWindowHandle> windowHandle = candidates.itemAt(i).windowHandle;
         const InputWindowInfo* windowInfo = windowHandle->getInfo();
         if (windowHandle->getName().find("SingleMode_windowbg") != -1) {
             bool leftSingleHandScreen = (windowHandle->getName().find("left") != -1);
@@ -1191,7 +1202,6 @@ int32_t InputDispatcher::findTouchedWindowTargetsLocked(nsecs_t currentTime,
             || maskedAction == AMOTION_EVENT_ACTION_SCROLL
             || isHoverAction);
     bool wrongDevice = false;
-    size_t numWindows = mWindowHandles.size();
     bool hasVirtualDevice = false;
     bool isOriginCoordinate = true;
     int32_t pointerIndex = getMotionEventActionPointerIndex(action);
@@ -1219,8 +1229,10 @@ int32_t InputDispatcher::findTouchedWindowTargetsLocked(nsecs_t currentTime,
         isSplit = false;
     }
 
-    for (size_t i = 0; i < numWindows; i++) {
-        sp<InputWindowHandle> windowHandle = mWindowHandles.itemAt(i);
+    const Vector<WindowHitGrid::Candidate>& singleHandWindows =
+            mWindowHitGrid.getSingleHandWindows();
+    for (size_t i = 0; i < singleHandWindows.size(); i++) {
+        sp<InputWindowHandle> windowHandle = singleHandWindows.itemAt(i).windowHandle;
         const InputWindowInfo* windowInfo = windowHandle->getInfo();
         int32_t flags = windowInfo->layoutParamsFlags;
         if (windowInfo->visible && windowHandle->getName().find("SingleMode_windowbg_hint") != -1) {
@@ -1228,8 +1240,8 @@ int32_t InputDispatcher::findTouchedWindowTargetsLocked(nsecs_t currentTime,
             break;
         }
     }
-    for (size_t i = 0; (!hint && i < numWindows); i++) {
-        sp<InputWindowHandle> windowHandle = mWindowHandles.itemAt(i);
+    for (size_t i = 0; (!hint && i < singleHandWindows.size()); i++) {
+        sp<InputWindowHandle> windowHandle = singleHandWindows.itemAt(i).windowHandle;
         const InputWindowInfo* windowInfo = windowHandle->getInfo();
         int32_t flags = windowInfo->layoutParamsFlags;
         if (windowInfo->visible && windowHandle->getName().find("SingleMode_windowbg") != -1) {
@@ -1263,10 +1275,12 @@ int32_t InputDispatcher::findTouchedWindowTargetsLocked(nsecs_t currentTime,
         sp<InputWindowHandle> newTouchedWindowHandle;
         bool isTouchModal = false;
 
-        // Traverse windows from front to back to find touched window and outside targets.
-        //size_t numWindows = mWindowHandles.size();
-        for (size_t i = 0; i < numWindows; i++) {
-            sp<InputWindowHandle> windowHandle = mWindowHandles.itemAt(i);
+        // Traverse the windows that may contain the point from front to back to find
+        // touched window and outside targets.
+        const Vector<WindowHitGrid::Candidate>& candidates = mWindowHitGrid.getCandidates(x, y);
+        size_t numCandidates = candidates.size();
+        for (size_t i = 0; i < numCandidates; i++) {
+            sp<InputWindowHandle> windowHandle = candidates.itemAt(i).windowHandle;
             const InputWindowInfo* windowInfo = windowHandle->getInfo();
             if (windowInfo->displayId != displayId) {
                 continue; // wrong display
@@ -1689,12 +1703,15 @@ bool InputDispatcher::isWindowObscuredAtPointLocked(
         const sp<InputWindowHandle>& windowHandle, int32_t x, int32_t y) const {
     int32_t displayId = windowHandle->getInfo()->displayId;
     const InputWindowInfo* windowInfo = windowHandle->getInfo();
-    size_t numWindows = mWindowHandles.size();
-    for (size_t i = 0; i < numWindows; i++) {
-        sp<InputWindowHandle> otherHandle = mWindowHandles.itemAt(i);
-        if (otherHandle == windowHandle) {
+    // Only the windows in front of this one that may contain the point can obscure it.
+    int64_t windowOrder = mWindowHitGrid.getOrder(windowHandle);
+    const Vector<WindowHitGrid::Candidate>& candidates = mWindowHitGrid.getCandidates(x, y);
+    size_t numCandidates = candidates.size();
+    for (size_t i = 0; i < numCandidates; i++) {
+        if (candidates.itemAt(i).order <= windowOrder) {
             break;
         }
+        sp<InputWindowHandle> otherHandle = candidates.itemAt(i).windowHandle;
 
         const InputWindowInfo* otherInfo = otherHandle->getInfo();
         if (otherHandle->getName().find("SingleMode_windowbg") != -1) {
@@ -2157,10 +2174,10 @@ void InputDispatcher::startDispatchCycleLocked(nsecs_t currentTime,
 }
 
 void InputDispatcher::finishDispatchCycleLocked(nsecs_t currentTime,
-        const sp<Connection>& connection, uint32_t seq, bool handled) {
+        const sp<Connection>& connection, uint32_t firstSeq, uint32_t seq, bool handled) {
 #if DEBUG_DISPATCH_CYCLE
-    ALOGD("channel '%s' ~ finishDispatchCycle - seq=%u, handled=%s",
-            connection->getInputChannelName(), seq, toString(handled));
+    ALOGD("channel '%s' ~ finishDispatchCycle - firstSeq=%u, seq=%u, handled=%s",
+            connection->getInputChannelName(), firstSeq, seq, toString(handled));
 #endif
 
     connection->inputPublisherBlocked = false;
@@ -2171,7 +2188,7 @@ void InputDispatcher::finishDispatchCycleLocked(nsecs_t currentTime,
     }
 
     // Notify other system components and prepare to start the next dispatch cycle.
-    onDispatchCycleFinishedLocked(currentTime, connection, seq, handled);
+    onDispatchCycleFinishedLocked(currentTime, connection, firstSeq, seq, handled);
 }
 
 void InputDispatcher::abortBrokenDispatchCycleLocked(nsecs_t currentTime,
@@ -2238,17 +2255,40 @@ int InputDispatcher::handleReceiveCallback(int fd, int events, void* data) {
             nsecs_t currentTime = now();
             bool gotOne = false;
             status_t status;
+            // Signals that finish adjacent wait queue entries with the same result are
+            // merged so that a burst of them is handled by a single command.
+            uint32_t pendingFirstSeq = 0;
+            uint32_t pendingSeq = 0;
+            bool pendingHandled = false;
             for (;;) {
+                uint32_t firstSeq;
                 uint32_t seq;
                 bool handled;
-                status = connection->inputPublisher.receiveFinishedSignal(&seq, &handled);
+                status = connection->inputPublisher.receiveFinishedSignal(
+                        &firstSeq, &seq, &handled);
                 if (status) {
                     break;
                 }
-                d->finishDispatchCycleLocked(currentTime, connection, seq, handled);
+                if (gotOne && handled == pendingHandled) {
+                    DispatchEntry* pendingEntry = connection->findWaitQueueEntry(pendingSeq);
+                    if (pendingEntry && pendingEntry->next
+                            && pendingEntry->next->seq == firstSeq) {
+                        pendingSeq = seq;
+                        continue;
+                    }
+                }
+                if (gotOne) {
+                    d->finishDispatchCycleLocked(currentTime, connection,
+                            pendingFirstSeq, pendingSeq, pendingHandled);
+                }
+                pendingFirstSeq = firstSeq;
+                pendingSeq = seq;
+                pendingHandled = handled;
                 gotOne = true;
             }
             if (gotOne) {
+                d->finishDispatchCycleLocked(currentTime, connection,
+                        pendingFirstSeq, pendingSeq, pendingHandled);
                 d->runCommandsLockedInterruptible();
                 if (status == WOULD_BLOCK) {
                     return 1;
@@ -2921,13 +2961,7 @@ sp<InputWindowHandle> InputDispatcher::getWindowHandleLocked(
 
 bool InputDispatcher::hasWindowHandleLocked(
         const sp<InputWindowHandle>& windowHandle) const {
-    size_t numWindows = mWindowHandles.size();
-    for (size_t i = 0; i < numWindows; i++) {
-        if (mWindowHandles.itemAt(i) == windowHandle) {
-            return true;
-        }
-    }
-    return false;
+    return mWindowHitGrid.contains(windowHandle);
 }
 
 void InputDispatcher::setInputWindows(const Vector<sp<InputWindowHandle> >& inputWindowHandles) {
@@ -2936,12 +2970,12 @@ void InputDispatcher::setInputWindows(const Vector<sp<InputWindowHandle> >& inpu
 #endif
     { // acquire lock
         AutoMutex _l(mLock);
+        nsecs_t startTime = now();
 
         Vector<sp<InputWindowHandle> > oldWindowHandles = mWindowHandles;
         mWindowHandles = inputWindowHandles;
 
         sp<InputWindowHandle> newFocusedWindowHandle;
-        bool foundHoveredWindow = false;
         for (size_t i = 0; i < mWindowHandles.size(); i++) {
             const sp<InputWindowHandle>& windowHandle = mWindowHandles.itemAt(i);
             if (!windowHandle->updateInfo() || windowHandle->getInputChannel() == NULL) {
@@ -2951,77 +2985,184 @@ void InputDispatcher::setInputWindows(const Vector<sp<InputWindowHandle> >& inpu
             if (windowHandle->getInfo()->hasFocus) {
                 newFocusedWindowHandle = windowHandle;
             }
-            if (windowHandle == mLastHoverWindowHandle) {
-                foundHoveredWindow = true;
-            }
         }
 
-        if (!foundHoveredWindow) {
-            mLastHoverWindowHandle = NULL;
-        }
+        mWindowHitGrid.rebuild(mWindowHandles);
+        onWindowHandlesChangedLocked(newFocusedWindowHandle, oldWindowHandles);
+        recordWindowUpdateLocked(false, now() - startTime);
+    } // release lock
 
-        if (mFocusedWindowHandle != newFocusedWindowHandle) {
-            if (mFocusedWindowHandle != NULL) {
+    // Wake up poll loop since it may need to make new input dispatching choices.
+    mLooper->wake();
+}
+
+void InputDispatcher::updateInputWindows(
+        const Vector<sp<InputWindowHandle> >& changedWindowHandles,
+        const Vector<sp<InputWindowHandle> >& removedWindowHandles) {
 #if DEBUG_FOCUS
-                ALOGD("Focus left window: %s",
-                        mFocusedWindowHandle->getName().string());
+    ALOGD("updateInputWindows: %zu changed, %zu removed",
+            changedWindowHandles.size(), removedWindowHandles.size());
 #endif
-                sp<InputChannel> focusedInputChannel = mFocusedWindowHandle->getInputChannel();
-                if (focusedInputChannel != NULL) {
-                    CancelationOptions options(CancelationOptions::CANCEL_NON_POINTER_EVENTS,
-                            "focus left window");
-                    synthesizeCancelationEventsForInputChannelLocked(
-                            focusedInputChannel, options);
+    { // acquire lock
+        AutoMutex _l(mLock);
+        nsecs_t startTime = now();
+
+        // Windows are added, moved and removed one at a time, in mWindowHandles and in
+        // the hit grid, so that an update costs in proportion to the changed windows.
+        Vector<sp<InputWindowHandle> > goneWindowHandles;
+        for (size_t i = 0; i < removedWindowHandles.size(); i++) {
+            const sp<InputWindowHandle>& windowHandle = removedWindowHandles.itemAt(i);
+            if (mWindowHitGrid.contains(windowHandle)) {
+                removeWindowHandleLocked(windowHandle);
+                goneWindowHandles.add(windowHandle);
+            }
+        }
+
+        sp<InputWindowHandle> newFocusedWindowHandle = mFocusedWindowHandle;
+        for (size_t i = 0; i < changedWindowHandles.size(); i++) {
+            const sp<InputWindowHandle>& windowHandle = changedWindowHandles.itemAt(i);
+            if (goneWindowHandles.indexOf(windowHandle) >= 0) {
+                continue; // removed
+            }
+            // A window listed twice is already known the second time, and unchanged.
+            bool known = mWindowHitGrid.contains(windowHandle);
+            int32_t oldLayer = known ? windowHandle->getInfo()->layer : 0;
+            if (!windowHandle->updateInfo() || windowHandle->getInputChannel() == NULL) {
+                if (known) {
+                    removeWindowHandleLocked(windowHandle);
+                    goneWindowHandles.add(windowHandle);
                 }
+                continue;
+            }
+            if (!known) {
+                addWindowHandleLocked(windowHandle);
+            } else if (windowHandle->getInfo()->layer != oldLayer) {
+                // Moved in the z-order, take it out and insert it again.
+                removeWindowHandleLocked(windowHandle);
+                addWindowHandleLocked(windowHandle);
+            } else {
+                // Its frame may have changed.
+                mWindowHitGrid.update(mWindowHandles, windowHandle);
             }
-            if (newFocusedWindowHandle != NULL) {
+
+            if (windowHandle->getInfo()->hasFocus) {
+                newFocusedWindowHandle = windowHandle;
+            } else if (windowHandle == newFocusedWindowHandle) {
+                newFocusedWindowHandle = NULL;
+            }
+        }
+
+        if (newFocusedWindowHandle != NULL && !hasWindowHandleLocked(newFocusedWindowHandle)) {
+            newFocusedWindowHandle = NULL;
+        }
+        onWindowHandlesChangedLocked(newFocusedWindowHandle, goneWindowHandles);
+        recordWindowUpdateLocked(true, now() - startTime);
+    } // release lock
+
+    // Wake up poll loop since it may need to make new input dispatching choices.
+    mLooper->wake();
+}
+
+void InputDispatcher::addWindowHandleLocked(const sp<InputWindowHandle>& windowHandle) {
+    // Windows are ordered front to back, so insert in front of the first lower window.
+    int32_t layer = windowHandle->getInfo()->layer;
+    size_t index = 0;
+    while (index < mWindowHandles.size()
+            && mWindowHandles.itemAt(index)->getInfo()->layer >= layer) {
+        index++;
+    }
+    mWindowHandles.insertAt(windowHandle, index);
+    mWindowHitGrid.add(mWindowHandles, index);
+}
+
+void InputDispatcher::removeWindowHandleLocked(const sp<InputWindowHandle>& windowHandle) {
+    mWindowHitGrid.remove(windowHandle);
+    for (size_t i = 0; i < mWindowHandles.size(); i++) {
+        if (mWindowHandles.itemAt(i) == windowHandle) {
+            mWindowHandles.removeAt(i);
+            return;
+        }
+    }
+}
+
+void InputDispatcher::onWindowHandlesChangedLocked(
+        const sp<InputWindowHandle>& newFocusedWindowHandle,
+        const Vector<sp<InputWindowHandle> >& oldWindowHandles) {
+    if (mLastHoverWindowHandle != NULL && !hasWindowHandleLocked(mLastHoverWindowHandle)) {
+        mLastHoverWindowHandle = NULL;
+    }
+
+    if (mFocusedWindowHandle != newFocusedWindowHandle) {
+        if (mFocusedWindowHandle != NULL) {
 #if DEBUG_FOCUS
-                ALOGD("Focus entered window: %s",
-                        newFocusedWindowHandle->getName().string());
+            ALOGD("Focus left window: %s",
+                    mFocusedWindowHandle->getName().string());
 #endif
+            sp<InputChannel> focusedInputChannel = mFocusedWindowHandle->getInputChannel();
+            if (focusedInputChannel != NULL) {
+                CancelationOptions options(CancelationOptions::CANCEL_NON_POINTER_EVENTS,
+                        "focus left window");
+                synthesizeCancelationEventsForInputChannelLocked(
+                        focusedInputChannel, options);
             }
-            mFocusedWindowHandle = newFocusedWindowHandle;
         }
+        if (newFocusedWindowHandle != NULL) {
+#if DEBUG_FOCUS
+            ALOGD("Focus entered window: %s",
+                    newFocusedWindowHandle->getName().string());
+#endif
+        }
+        mFocusedWindowHandle = newFocusedWindowHandle;
+    }
 
-        for (size_t d = 0; d < mTouchStatesByDisplay.size(); d++) {
-            TouchState& state = mTouchStatesByDisplay.editValueAt(d);
-            for (size_t i = 0; i < state.windows.size(); i++) {
-                TouchedWindow& touchedWindow = state.windows.editItemAt(i);
-                if (!hasWindowHandleLocked(touchedWindow.windowHandle)) {
+    for (size_t d = 0; d < mTouchStatesByDisplay.size(); d++) {
+        TouchState& state = mTouchStatesByDisplay.editValueAt(d);
+        for (size_t i = 0; i < state.windows.size(); i++) {
+            TouchedWindow& touchedWindow = state.windows.editItemAt(i);
+            if (!hasWindowHandleLocked(touchedWindow.windowHandle)) {
 #if DEBUG_FOCUS
-                    ALOGD("Touched window was removed: %s",
-                            touchedWindow.windowHandle->getName().string());
+                ALOGD("Touched window was removed: %s",
+                        touchedWindow.windowHandle->getName().string());
 #endif
-                    sp<InputChannel> touchedInputChannel =
-                            touchedWindow.windowHandle->getInputChannel();
-                    if (touchedInputChannel != NULL) {
-                        CancelationOptions options(CancelationOptions::CANCEL_POINTER_EVENTS,
-                                "touched window was removed");
-                        synthesizeCancelationEventsForInputChannelLocked(
-                                touchedInputChannel, options);
-                    }
-                    state.windows.removeAt(i--);
+                sp<InputChannel> touchedInputChannel =
+                        touchedWindow.windowHandle->getInputChannel();
+                if (touchedInputChannel != NULL) {
+                    CancelationOptions options(CancelationOptions::CANCEL_POINTER_EVENTS,
+                            "touched window was removed");
+                    synthesizeCancelationEventsForInputChannelLocked(
+                            touchedInputChannel, options);
                 }
+                state.windows.removeAt(i--);
             }
         }
+    }
 
-        // Release information for windows that are no longer present.
-        // This ensures that unused input channels are released promptly.
-        // Otherwise, they might stick around until the window handle is destroyed
-        // which might not happen until the next GC.
-        for (size_t i = 0; i < oldWindowHandles.size(); i++) {
-            const sp<InputWindowHandle>& oldWindowHandle = oldWindowHandles.itemAt(i);
-            if (!hasWindowHandleLocked(oldWindowHandle)) {
+    // Release information for windows that are no longer present.
+    // This ensures that unused input channels are released promptly.
+    // Otherwise, they might stick around until the window handle is destroyed
+    // which might not happen until the next GC.
+    for (size_t i = 0; i < oldWindowHandles.size(); i++) {
+        const sp<InputWindowHandle>& oldWindowHandle = oldWindowHandles.itemAt(i);
+        if (!hasWindowHandleLocked(oldWindowHandle)) {
 #if DEBUG_FOCUS
-                ALOGD("Window went away: %s", oldWindowHandle->getName().string());
+            ALOGD("Window went away: %s", oldWindowHandle->getName().string());
 #endif
-                oldWindowHandle->releaseInfo();
-            }
+            oldWindowHandle->releaseInfo();
         }
-    } // release lock
+    }
+}
 
-    // Wake up poll loop since it may need to make new input dispatching choices.
-    mLooper->wake();
+void InputDispatcher::recordWindowUpdateLocked(bool incremental, nsecs_t lockHeldTime) {
+    if (incremental) {
+        mWindowUpdateStats.incrementalUpdates += 1;
+    } else {
+        mWindowUpdateStats.fullUpdates += 1;
+    }
+    mWindowUpdateStats.totalLockHeldTime += lockHeldTime;
+    mWindowUpdateStats.lastLockHeldTime = lockHeldTime;
+    if (lockHeldTime > mWindowUpdateStats.maxLockHeldTime) {
+        mWindowUpdateStats.maxLockHeldTime = lockHeldTime;
+    }
 }
 
 void InputDispatcher::setFocusedApplication(
@@ -3294,10 +3435,22 @@ void InputDispatcher::dumpDispatchStateLocked(String8& dump) {
                     windowInfo->ownerPid, windowInfo->ownerUid,
                     windowInfo->dispatchingTimeout / 1000000.0);
         }
+        mWindowHitGrid.dump(dump);
     } else {
         dump.append(INDENT "Windows: <none>\n");
     }
 
+    uint32_t windowUpdates = mWindowUpdateStats.fullUpdates
+            + mWindowUpdateStats.incrementalUpdates;
+    dump.appendFormat(INDENT "WindowUpdates: full=%u, incremental=%u, "
+            "lockHeld: total=%0.3fms, avg=%0.3fms, max=%0.3fms, last=%0.3fms\n",
+            mWindowUpdateStats.fullUpdates, mWindowUpdateStats.incrementalUpdates,
+            mWindowUpdateStats.totalLockHeldTime / 1000000.0,
+            windowUpdates ? mWindowUpdateStats.totalLockHeldTime / 1000000.0 / windowUpdates
+                    : 0.0,
+            mWindowUpdateStats.maxLockHeldTime / 1000000.0,
+            mWindowUpdateStats.lastLockHeldTime / 1000000.0);
+
     if (!mMonitoringChannels.isEmpty()) {
         dump.append(INDENT "MonitoringChannels:\n");
         for (size_t i = 0; i < mMonitoringChannels.size(); i++) {
@@ -3519,11 +3672,13 @@ ssize_t InputDispatcher::getConnectionIndexLocked(const sp<InputChannel>& inputC
 }
 
 void InputDispatcher::onDispatchCycleFinishedLocked(
-        nsecs_t currentTime, const sp<Connection>& connection, uint32_t seq, bool handled) {
+        nsecs_t currentTime, const sp<Connection>& connection,
+        uint32_t firstSeq, uint32_t seq, bool handled) {
     CommandEntry* commandEntry = postCommandLocked(
             & InputDispatcher::doDispatchCycleFinishedLockedInterruptible);
     commandEntry->connection = connection;
     commandEntry->eventTime = currentTime;
+    commandEntry->firstSeq = firstSeq;
     commandEntry->seq = seq;
     commandEntry->handled = handled;
 }
@@ -3638,9 +3793,49 @@ void InputDispatcher::doDispatchCycleFinishedLockedInterruptible(
         CommandEntry* commandEntry) {
     sp<Connection> connection = commandEntry->connection;
     nsecs_t finishTime = commandEntry->eventTime;
+    uint32_t firstSeq = commandEntry->firstSeq;
     uint32_t seq = commandEntry->seq;
     bool handled = commandEntry->handled;
 
+    if (firstSeq == seq) {
+        if (finishWaitQueueEntryLockedInterruptible(connection, seq, finishTime, handled)) {
+            // Start the next dispatch cycle for this connection.
+            startDispatchCycleLocked(now(), connection);
+        }
+        return;
+    }
+
+    // The signal finishes the wait queue entries from firstSeq through seq.  Collect
+    // them up front since the lock may be released while each one is handled.  If the
+    // range is no longer intact, only its two ends are known to be finished.
+    Vector<uint32_t> seqs;
+    DispatchEntry* entry = connection->findWaitQueueEntry(firstSeq);
+    for (; entry != NULL; entry = entry->next) {
+        seqs.push(entry->seq);
+        if (entry->seq == seq) {
+            break;
+        }
+    }
+    if (entry == NULL) {
+        seqs.clear();
+        seqs.push(firstSeq);
+        seqs.push(seq);
+    }
+
+    bool finishedAny = false;
+    for (size_t i = 0; i < seqs.size(); i++) {
+        if (finishWaitQueueEntryLockedInterruptible(connection, seqs[i], finishTime, handled)) {
+            finishedAny = true;
+        }
+    }
+    if (finishedAny) {
+        // Start the next dispatch cycle for this connection.
+        startDispatchCycleLocked(now(), connection);
+    }
+}
+
+bool InputDispatcher::finishWaitQueueEntryLockedInterruptible(
+        const sp<Connection>& connection, uint32_t seq, nsecs_t finishTime, bool handled) {
     // Handle post-event policy actions.
     DispatchEntry* dispatchEntry = connection->findWaitQueueEntry(seq);
     if (dispatchEntry) {
@@ -3680,10 +3875,9 @@ void InputDispatcher::doDispatchCycleFinishedLockedInterruptible(
                 releaseDispatchEntryLocked(dispatchEntry);
             }
         }
-
-        // Start the next dispatch cycle for this connection.
-        startDispatchCycleLocked(now(), connection);
+        return true;
     }
+    return false;
 }
 
 bool InputDispatcher::afterKeyEventLockedInterruptible(const sp<Connection>& connection,
@@ -3910,6 +4104,12 @@ void InputDispatcher::dump(String8& dump) {
     dump.append("Input Dispatcher State:\n");
     dumpDispatchStateLocked(dump);
 
+    dump.append(INDENT "EntryPools:\n");
+    sKeyEntryPool.dump(dump);
+    sMotionEntryPool.dump(dump);
+    sDispatchEntryPool.dump(dump);
+    sCommandEntryPool.dump(dump);
+
     if (!mLastANRState.isEmpty()) {
         dump.append("\nInput Dispatcher State at time of last ANR:\n");
         dump.append(mLastANRState);
@@ -3925,6 +4125,69 @@ void InputDispatcher::monitor() {
 }
 
 
+// --- InputDispatcher::EntryPool ---
+
+InputDispatcher::EntryPool InputDispatcher::sKeyEntryPool("KeyEntry", sizeof(KeyEntry));
+InputDispatcher::EntryPool InputDispatcher::sMotionEntryPool("MotionEntry", sizeof(MotionEntry));
+InputDispatcher::EntryPool InputDispatcher::sDispatchEntryPool("DispatchEntry",
+        sizeof(DispatchEntry));
+InputDispatcher::EntryPool InputDispatcher::sCommandEntryPool("CommandEntry",
+        sizeof(CommandEntry));
+
+InputDispatcher::EntryPool::EntryPool(const char* name, size_t blockSize) :
+        mName(name),
+        // Keep every block in a slab aligned like malloc() would.
+        mBlockSize((std::max(blockSize, sizeof(FreeBlock)) + 15) & ~size_t(15)),
+        mFreeList(NULL), mSlabs(0), mLiveBlocks(0), mPeakLiveBlocks(0), mAllocations(0) {
+}
+
+void* InputDispatcher::EntryPool::allocate(size_t size) {
+    LOG_ALWAYS_FATAL_IF(size > mBlockSize, "%s pool: cannot allocate %zu bytes from "
+            "%zu byte blocks", mName, size, mBlockSize);
+
+    AutoMutex _l(mLock);
+    if (!mFreeList) {
+        char* slab = static_cast<char*>(malloc(mBlockSize * SLAB_BLOCKS));
+        LOG_ALWAYS_FATAL_IF(!slab, "%s pool: out of memory", mName);
+        for (size_t i = SLAB_BLOCKS; i > 0; i--) {
+            FreeBlock* block = reinterpret_cast<FreeBlock*>(slab + (i - 1) * mBlockSize);
+            block->next = mFreeList;
+            mFreeList = block;
+        }
+        mSlabs += 1;
+    }
+
+    FreeBlock* block = mFreeList;
+    mFreeList = block->next;
+    mAllocations += 1;
+    mLiveBlocks += 1;
+    if (mLiveBlocks > mPeakLiveBlocks) {
+        mPeakLiveBlocks = mLiveBlocks;
+    }
+    return block;
+}
+
+void InputDispatcher::EntryPool::free(void* ptr) {
+    if (!ptr) {
+        return;
+    }
+
+    AutoMutex _l(mLock);
+    FreeBlock* block = static_cast<FreeBlock*>(ptr);
+    block->next = mFreeList;
+    mFreeList = block;
+    mLiveBlocks -= 1;
+}
+
+void InputDispatcher::EntryPool::dump(String8& dump) const {
+    AutoMutex _l(mLock);
+    dump.appendFormat(INDENT2 "%s: blockSize=%zu, live=%zu, peak=%zu, slabs=%zu (%zuKB), "
+            "allocations=%" PRIu64 "\n",
+            mName, mBlockSize, mLiveBlocks, mPeakLiveBlocks, mSlabs,
+            mSlabs * SLAB_BLOCKS * mBlockSize / 1024, mAllocations);
+}
+
+
 // --- InputDispatcher::InjectionState ---
 
 InputDispatcher::InjectionState::InjectionState(int32_t injectorPid, int32_t injectorUid) :
@@ -4023,6 +4286,14 @@ InputDispatcher::KeyEntry::KeyEntry(nsecs_t eventTime,
 InputDispatcher::KeyEntry::~KeyEntry() {
 }
 
+void* InputDispatcher::KeyEntry::operator new(size_t size) {
+    return sKeyEntryPool.allocate(size);
+}
+
+void InputDispatcher::KeyEntry::operator delete(void* ptr) {
+    sKeyEntryPool.free(ptr);
+}
+
 void InputDispatcher::KeyEntry::appendDescription(String8& msg) const {
     msg.appendFormat("KeyEvent(deviceId=%d, source=0x%08x, action=%d, "
             "flags=0x%08x, keyCode=%d, scanCode=%d, metaState=0x%08x, "
@@ -4068,6 +4339,14 @@ InputDispatcher::MotionEntry::MotionEntry(nsecs_t eventTime, int32_t deviceId,
 InputDispatcher::MotionEntry::~MotionEntry() {
 }
 
+void* InputDispatcher::MotionEntry::operator new(size_t size) {
+    return sMotionEntryPool.allocate(size);
+}
+
+void InputDispatcher::MotionEntry::operator delete(void* ptr) {
+    sMotionEntryPool.free(ptr);
+}
+
 void InputDispatcher::MotionEntry::appendDescription(String8& msg) const {
     msg.appendFormat("MotionEvent(deviceId=%d, source=0x%08x, action=%d, actionButton=0x%08x, "
             "flags=0x%08x, metaState=0x%08x, buttonState=0x%08x, "
@@ -4102,6 +4381,14 @@ InputDispatcher::DispatchEntry::~DispatchEntry() {
     eventEntry->release();
 }
 
+void* InputDispatcher::DispatchEntry::operator new(size_t size) {
+    return sDispatchEntryPool.allocate(size);
+}
+
+void InputDispatcher::DispatchEntry::operator delete(void* ptr) {
+    sDispatchEntryPool.free(ptr);
+}
+
 uint32_t InputDispatcher::DispatchEntry::nextSeq() {
     // Sequence number 0 is reserved and will never be returned.
     uint32_t seq;
@@ -4518,12 +4805,20 @@ InputDispatcher::DispatchEntry* InputDispatcher::Connection::findWaitQueueEntry(
 
 InputDispatcher::CommandEntry::CommandEntry(Command command) :
     command(command), eventTime(0), keyEntry(NULL), userActivityEventType(0),
-    seq(0), handled(false) {
+    firstSeq(0), seq(0), handled(false) {
 }
 
 InputDispatcher::CommandEntry::~CommandEntry() {
 }
 
+void* InputDispatcher::CommandEntry::operator new(size_t size) {
+    return sCommandEntryPool.allocate(size);
+}
+
+void InputDispatcher::CommandEntry::operator delete(void* ptr) {
+    sCommandEntryPool.free(ptr);
+}
+
 
 // --- InputDispatcher::TouchState ---
 
@@ -4629,6 +4924,285 @@ bool InputDispatcher::TouchState::isSlippery() const {
 }
 
 
+// --- InputDispatcher::WindowHitGrid ---
+
+// Gets the area of a window that hit tests can match, or returns false if the window
+// can be hit anywhere.  Invisible windows never match so their bounds are empty.
+static bool getWindowHitBounds(const InputWindowInfo* windowInfo, Rect* outBounds) {
+    *outBounds = Rect::EMPTY_RECT;
+    if (!windowInfo->visible) {
+        return true;
+    }
+
+    int32_t flags = windowInfo->layoutParamsFlags;
+    bool isTouchModal = !(flags & InputWindowInfo::FLAG_NOT_TOUCHABLE)
+            && (flags & (InputWindowInfo::FLAG_NOT_FOCUSABLE
+                    | InputWindowInfo::FLAG_NOT_TOUCH_MODAL)) == 0;
+    if (isTouchModal || (flags & InputWindowInfo::FLAG_WATCH_OUTSIDE_TOUCH)) {
+        return false;
+    }
+
+    // Touches match the touchable region, obscured checks match the frame.
+    Rect bounds(windowInfo->frameLeft, windowInfo->frameTop,
+            windowInfo->frameRight, windowInfo->frameBottom);
+    Rect touchableBounds(windowInfo->touchableRegion.getBounds());
+    if (bounds.isEmpty()) {
+        bounds = touchableBounds;
+    } else if (!touchableBounds.isEmpty()) {
+        bounds.left = std::min(bounds.left, touchableBounds.left);
+        bounds.top = std::min(bounds.top, touchableBounds.top);
+        bounds.right = std::max(bounds.right, touchableBounds.right);
+        bounds.bottom = std::max(bounds.bottom, touchableBounds.bottom);
+    }
+    if (!bounds.isEmpty()) {
+        *outBounds = bounds;
+    }
+    return true;
+}
+
+InputDispatcher::WindowHitGrid::WindowHitGrid() :
+    mBounds(Rect::EMPTY_RECT), mCellWidth(1), mCellHeight(1) {
+}
+
+void InputDispatcher::WindowHitGrid::rebuild(
+        const Vector<sp<InputWindowHandle> >& windowHandles) {
+    for (size_t i = 0; i < GRID_SIZE * GRID_SIZE; i++) {
+        mCells[i].clear();
+    }
+    mUnboundedWindows.clear();
+    mSingleHandWindows.clear();
+    mEntries.clear();
+
+    // Size the grid to cover every window that has bounds.
+    size_t numWindows = windowHandles.size();
+    mBounds = Rect::EMPTY_RECT;
+    for (size_t i = 0; i < numWindows; i++) {
+        Rect bounds;
+        if (!getWindowHitBounds(windowHandles.itemAt(i)->getInfo(), &bounds)
+                || bounds.isEmpty()) {
+            continue;
+        }
+        if (mBounds.isEmpty()) {
+            mBounds = bounds;
+        } else {
+            mBounds.left = std::min(mBounds.left, bounds.left);
+            mBounds.top = std::min(mBounds.top, bounds.top);
+            mBounds.right = std::max(mBounds.right, bounds.right);
+            mBounds.bottom = std::max(mBounds.bottom, bounds.bottom);
+        }
+    }
+    int64_t width = int64_t(mBounds.right) - mBounds.left;
+    int64_t height = int64_t(mBounds.bottom) - mBounds.top;
+    mCellWidth = std::max(int32_t((width + GRID_SIZE - 1) / GRID_SIZE), 1);
+    mCellHeight = std::max(int32_t((height + GRID_SIZE - 1) / GRID_SIZE), 1);
+
+    // Windows are added front to back, so each one is appended to its cells.
+    mEntries.setCapacity(numWindows);
+    for (size_t i = 0; i < numWindows; i++) {
+        const sp<InputWindowHandle>& windowHandle = windowHandles.itemAt(i);
+        if (!contains(windowHandle)) {
+            insert(windowHandle.get(),
+                    makeEntry(windowHandle, int64_t(numWindows - i) * ORDER_SPACING));
+        }
+    }
+}
+
+void InputDispatcher::WindowHitGrid::add(
+        const Vector<sp<InputWindowHandle> >& windowHandles, size_t index) {
+    const sp<InputWindowHandle>& windowHandle = windowHandles.itemAt(index);
+    if (contains(windowHandle)) {
+        return;
+    }
+
+    // Take an order between the ones of the windows around it.
+    bool hasFront = index > 0;
+    bool hasBack = index + 1 < windowHandles.size();
+    int64_t front = hasFront ? getOrder(windowHandles.itemAt(index - 1)) : 0;
+    int64_t back = hasBack ? getOrder(windowHandles.itemAt(index + 1)) : 0;
+    int64_t order;
+    if (hasFront && hasBack) {
+        if (front - back < 2) {
+            rebuild(windowHandles); // no room left between them
+            return;
+        }
+        order = back + (front - back) / 2;
+    } else if (hasFront) {
+        order = front - ORDER_SPACING;
+    } else if (hasBack) {
+        order = back + ORDER_SPACING;
+    } else {
+        order = 0;
+    }
+
+    Entry entry = makeEntry(windowHandle, order);
+    if (!fits(entry)) {
+        rebuild(windowHandles);
+        return;
+    }
+    insert(windowHandle.get(), entry);
+}
+
+void InputDispatcher::WindowHitGrid::remove(const sp<InputWindowHandle>& windowHandle) {
+    ssize_t index = mEntries.indexOfKey(windowHandle.get());
+    if (index >= 0) {
+        Entry entry = mEntries.valueAt(index);
+        erase(windowHandle.get(), entry);
+    }
+}
+
+void InputDispatcher::WindowHitGrid::update(
+        const Vector<sp<InputWindowHandle> >& windowHandles,
+        const sp<InputWindowHandle>& windowHandle) {
+    ssize_t index = mEntries.indexOfKey(windowHandle.get());
+    if (index < 0) {
+        return;
+    }
+    Entry oldEntry = mEntries.valueAt(index);
+    Entry entry = makeEntry(windowHandle, oldEntry.order);
+    if (entry.unbounded == oldEntry.unbounded && entry.singleHand == oldEntry.singleHand
+            && entry.bounds == oldEntry.bounds) {
+        return;
+    }
+    if (!fits(entry)) {
+        rebuild(windowHandles);
+        return;
+    }
+    erase(windowHandle.get(), oldEntry);
+    insert(windowHandle.get(), entry);
+}
+
+const Vector<InputDispatcher::WindowHitGrid::Candidate>&
+InputDispatcher::WindowHitGrid::getCandidates(int32_t x, int32_t y) const {
+    if (x < mBounds.left || x >= mBounds.right || y < mBounds.top || y >= mBounds.bottom) {
+        // Only the windows that can be hit anywhere lie outside the grid.
+        return mUnboundedWindows;
+    }
+    int32_t column = int32_t((int64_t(x) - mBounds.left) / mCellWidth);
+    int32_t row = int32_t((int64_t(y) - mBounds.top) / mCellHeight);
+    return mCells[row * GRID_SIZE + column];
+}
+
+int64_t InputDispatcher::WindowHitGrid::getOrder(
+        const sp<InputWindowHandle>& windowHandle) const {
+    ssize_t index = mEntries.indexOfKey(windowHandle.get());
+    return index >= 0 ? mEntries.valueAt(index).order : INT64_MIN;
+}
+
+InputDispatcher::WindowHitGrid::Entry InputDispatcher::WindowHitGrid::makeEntry(
+        const sp<InputWindowHandle>& windowHandle, int64_t order) const {
+    Entry entry;
+    entry.order = order;
+    entry.unbounded = !getWindowHitBounds(windowHandle->getInfo(), &entry.bounds);
+    entry.singleHand = windowHandle->getName().find("SingleMode_windowbg") != -1;
+    return entry;
+}
+
+bool InputDispatcher::WindowHitGrid::fits(const Entry& entry) const {
+    const Rect& bounds = entry.bounds;
+    return entry.unbounded || bounds.isEmpty()
+            || (bounds.left >= mBounds.left && bounds.top >= mBounds.top
+                    && bounds.right <= mBounds.right && bounds.bottom <= mBounds.bottom);
+}
+
+void InputDispatcher::WindowHitGrid::getCells(const Rect& bounds,
+        int32_t* outFirstColumn, int32_t* outLastColumn,
+        int32_t* outFirstRow, int32_t* outLastRow) const {
+    *outFirstColumn = int32_t((int64_t(bounds.left) - mBounds.left) / mCellWidth);
+    *outLastColumn = int32_t((int64_t(bounds.right) - 1 - mBounds.left) / mCellWidth);
+    *outFirstRow = int32_t((int64_t(bounds.top) - mBounds.top) / mCellHeight);
+    *outLastRow = int32_t((int64_t(bounds.bottom) - 1 - mBounds.top) / mCellHeight);
+}
+
+void InputDispatcher::WindowHitGrid::insert(InputWindowHandle* windowHandle,
+        const Entry& entry) {
+    mEntries.add(windowHandle, entry);
+    Candidate candidate;
+    candidate.order = entry.order;
+    candidate.windowHandle = windowHandle;
+    if (entry.singleHand) {
+        insertCandidate(mSingleHandWindows, candidate);
+    }
+
+    if (entry.unbounded) {
+        insertCandidate(mUnboundedWindows, candidate);
+        for (size_t c = 0; c < GRID_SIZE * GRID_SIZE; c++) {
+            insertCandidate(mCells[c], candidate);
+        }
+        return;
+    }
+    if (entry.bounds.isEmpty()) {
+        return;
+    }
+    int32_t firstColumn, lastColumn, firstRow, lastRow;
+    getCells(entry.bounds, &firstColumn, &lastColumn, &firstRow, &lastRow);
+    for (int32_t row = firstRow; row <= lastRow; row++) {
+        for (int32_t column = firstColumn; column <= lastColumn; column++) {
+            insertCandidate(mCells[row * GRID_SIZE + column], candidate);
+        }
+    }
+}
+
+void InputDispatcher::WindowHitGrid::erase(InputWindowHandle* windowHandle,
+        const Entry& entry) {
+    mEntries.removeItem(windowHandle);
+    if (entry.singleHand) {
+        eraseCandidate(mSingleHandWindows, windowHandle);
+    }
+
+    if (entry.unbounded) {
+        eraseCandidate(mUnboundedWindows, windowHandle);
+        for (size_t c = 0; c < GRID_SIZE * GRID_SIZE; c++) {
+            eraseCandidate(mCells[c], windowHandle);
+        }
+        return;
+    }
+    if (entry.bounds.isEmpty()) {
+        return;
+    }
+    int32_t firstColumn, lastColumn, firstRow, lastRow;
+    getCells(entry.bounds, &firstColumn, &lastColumn, &firstRow, &lastRow);
+    for (int32_t row = firstRow; row <= lastRow; row++) {
+        for (int32_t column = firstColumn; column <= lastColumn; column++) {
+            eraseCandidate(mCells[row * GRID_SIZE + column], windowHandle);
+        }
+    }
+}
+
+void InputDispatcher::WindowHitGrid::insertCandidate(Vector<Candidate>& candidates,
+        const Candidate& candidate) {
+    // Search from the back: rebuild adds windows front to back.
+    size_t index = candidates.size();
+    while (index > 0 && candidates.itemAt(index - 1).order < candidate.order) {
+        index--;
+    }
+    candidates.insertAt(candidate, index);
+}
+
+void InputDispatcher::WindowHitGrid::eraseCandidate(Vector<Candidate>& candidates,
+        const InputWindowHandle* windowHandle) {
+    for (size_t i = 0; i < candidates.size(); i++) {
+        if (candidates.itemAt(i).windowHandle == windowHandle) {
+            candidates.removeAt(i);
+            return;
+        }
+    }
+}
+
+void InputDispatcher::WindowHitGrid::dump(String8& dump) const {
+    size_t maxCandidates = 0;
+    size_t totalCandidates = 0;
+    for (size_t i = 0; i < GRID_SIZE * GRID_SIZE; i++) {
+        maxCandidates = std::max(maxCandidates, mCells[i].size());
+        totalCandidates += mCells[i].size();
+    }
+    dump.appendFormat(INDENT "WindowHitGrid: bounds=[%d,%d][%d,%d], cell=%dx%d, "
+            "windows=%zu, unbounded=%zu, candidatesPerCell: avg=%0.1f, max=%zu\n",
+            mBounds.left, mBounds.top, mBounds.right, mBounds.bottom,
+            mCellWidth, mCellHeight, mEntries.size(), mUnboundedWindows.size(),
+            double(totalCandidates) / (GRID_SIZE * GRID_SIZE), maxCandidates);
+}
+
+
 // --- InputDispatcherThread ---
 
 InputDispatcherThread::InputDispatcherThread(const sp<InputDispatcherInterface>& dispatcher) :
@@ -4663,10 +5237,11 @@ bool InputDispatcher::singlehandRegionContainsPointLocked(int32_t x, int32_t y,
 void InputDispatcher::singleHandModePreProcessLocked(MotionEntry* entry) {
     bool hasVirtualDevice = false;
     bool leftSingleHandScreen  = false;
-    size_t numWindows = mWindowHandles.size();
+    const Vector<WindowHitGrid::Candidate>& singleHandWindows =
+            mWindowHitGrid.getSingleHandWindows();
 
-    for (size_t i = 0; i < numWindows; i++) {
-        sp<InputWindowHandle> windowHandle = mWindowHandles.itemAt(i);
+    for (size_t i = 0; i < singleHandWindows.size(); i++) {
+        sp<InputWindowHandle> windowHandle = singleHandWindows.itemAt(i).windowHandle;
         const InputWindowInfo* windowInfo = windowHandle->getInfo();
         int32_t flags = windowInfo->layoutParamsFlags;
         if (windowInfo->visible && windowHandle->getName().find("SingleMode_windowbg") != -1) {
@@ -311,6 +311,16 @@ public:
      */
     virtual void setInputWindows(const Vector<sp<InputWindowHandle> >& inputWindowHandles) = 0;
 
+    /* Updates the list of input windows with only the windows that changed since the
+     * last update.  Changed windows that are not in the list yet are added, and windows
+     * are kept ordered front to back by layer.  A window that is both changed and
+     * removed is removed.  Only the changed windows are asked to update their info.
+     *
+     * This method may be called on any thread (usually by the input manager).
+     */
+    virtual void updateInputWindows(const Vector<sp<InputWindowHandle> >& changedWindowHandles,
+            const Vector<sp<InputWindowHandle> >& removedWindowHandles) = 0;
+
     /* Sets the focused application.
      *
      * This method may be called on any thread (usually by the input manager).
@@ -390,6 +400,8 @@ public:
             uint32_t policyFlags);
 
     virtual void setInputWindows(const Vector<sp<InputWindowHandle> >& inputWindowHandles);
+    virtual void updateInputWindows(const Vector<sp<InputWindowHandle> >& changedWindowHandles,
+            const Vector<sp<InputWindowHandle> >& removedWindowHandles);
     virtual void setFocusedApplication(const sp<InputApplicationHandle>& inputApplicationHandle);
     virtual void setInputDispatchMode(bool enabled, bool frozen);
     virtual void setInputFilterEnabled(bool enabled);
@@ -411,6 +423,39 @@ private:
         inline Link() : next(NULL), prev(NULL) { }
     };
 
+    // A pool of fixed size blocks for the entries allocated for every event and target,
+    // so that high rate input doesn't go to the heap for every sample.  Blocks are carved
+    // out of slabs of SLAB_BLOCKS blocks and freed blocks are kept on a free list for
+    // reuse; slabs are never returned to the heap, so a pool stays as large as its peak.
+    // Entries are allocated on the reader and binder threads as well as the dispatcher
+    // thread, so the pool has its own lock.
+    class EntryPool {
+    public:
+        EntryPool(const char* name, size_t blockSize);
+
+        void* allocate(size_t size);
+        void free(void* block);
+
+        void dump(String8& dump) const;
+
+    private:
+        enum { SLAB_BLOCKS = 32 };
+
+        struct FreeBlock {
+            FreeBlock* next;
+        };
+
+        const char* const mName;
+        const size_t mBlockSize;
+
+        mutable Mutex mLock;
+        FreeBlock* mFreeList;
+        size_t mSlabs;
+        size_t mLiveBlocks;
+        size_t mPeakLiveBlocks;
+        uint64_t mAllocations;
+    };
+
     struct InjectionState {
         mutable int32_t refCount;
 
@@ -502,6 +547,9 @@ private:
         virtual void appendDescription(String8& msg) const;
         void recycle();
 
+        static void* operator new(size_t size);
+        static void operator delete(void* ptr);
+
     protected:
         virtual ~KeyEntry();
     };
@@ -534,6 +582,9 @@ private:
                 float xOffset, float yOffset);
         virtual void appendDescription(String8& msg) const;
 
+        static void* operator new(size_t size);
+        static void operator delete(void* ptr);
+
     protected:
         virtual ~MotionEntry();
     };
@@ -557,6 +608,9 @@ private:
                 int32_t targetFlags, float xOffset, float yOffset, float scaleFactor);
         ~DispatchEntry();
 
+        static void* operator new(size_t size);
+        static void operator delete(void* ptr);
+
         inline bool hasForegroundTarget() const {
             return targetFlags & InputTarget::FLAG_FOREGROUND;
         }
@@ -595,6 +649,9 @@ private:
         CommandEntry(Command command);
         ~CommandEntry();
 
+        static void* operator new(size_t size);
+        static void operator delete(void* ptr);
+
         Command command;
 
         // parameters for the command (usage varies by command)
@@ -605,10 +662,16 @@ private:
         sp<InputWindowHandle> inputWindowHandle;
         String8 reason;
         int32_t userActivityEventType;
+        uint32_t firstSeq;
         uint32_t seq;
         bool handled;
     };
 
+    static EntryPool sKeyEntryPool;
+    static EntryPool sMotionEntryPool;
+    static EntryPool sDispatchEntryPool;
+    static EntryPool sCommandEntryPool;
+
     // Generic queue implementation.
     template <typename T>
     struct Queue {
@@ -959,6 +1022,111 @@ private:
     sp<InputWindowHandle> getWindowHandleLocked(const sp<InputChannel>& inputChannel) const;
     bool hasWindowHandleLocked(const sp<InputWindowHandle>& windowHandle) const;
 
+    // Spatial index over mWindowHandles, rebuilt by setInputWindows and updated one window
+    // at a time by updateInputWindows, so that hit tests don't have to walk every window.
+    // The bounds of each visible window (its frame and touchable region) are bucketed into
+    // a fixed grid spanning all the windows; each cell lists, front to back, the windows
+    // that may contain a point in that cell.  Windows that can be hit anywhere (touch modal
+    // windows and windows watching outside touches) are listed in every cell.  Callers
+    // still apply the exact per-window checks to the candidates: the grid only prunes
+    // windows that cannot match.
+    class WindowHitGrid {
+    public:
+        struct Candidate {
+            // Orders the windows front to back: a window is in front of every window
+            // with a lower order.  Unlike list indices, orders stay valid when other
+            // windows are added or removed.
+            int64_t order;
+            // Kept alive by mWindowHandles.
+            InputWindowHandle* windowHandle;
+        };
+
+        WindowHitGrid();
+
+        void rebuild(const Vector<sp<InputWindowHandle> >& windowHandles);
+
+        // Indexes the window that was just inserted at the given index of windowHandles.
+        // The whole grid is rebuilt if the window lies outside its bounds.
+        void add(const Vector<sp<InputWindowHandle> >& windowHandles, size_t index);
+
+        // Stops indexing the window, which is about to be removed from the window handles.
+        void remove(const sp<InputWindowHandle>& windowHandle);
+
+        // Moves the window to the cells matching its current info, if its bounds changed.
+        void update(const Vector<sp<InputWindowHandle> >& windowHandles,
+                const sp<InputWindowHandle>& windowHandle);
+
+        // Returns the windows, in z-order, that may contain the point.
+        const Vector<Candidate>& getCandidates(int32_t x, int32_t y) const;
+
+        // Returns true if the window is indexed.
+        inline bool contains(const sp<InputWindowHandle>& windowHandle) const {
+            return mEntries.indexOfKey(windowHandle.get()) >= 0;
+        }
+
+        // Returns the order of the window, or INT64_MIN if it isn't indexed.
+        int64_t getOrder(const sp<InputWindowHandle>& windowHandle) const;
+
+        // Returns the single hand mode background windows, in z-order.
+        inline const Vector<Candidate>& getSingleHandWindows() const {
+            return mSingleHandWindows;
+        }
+
+        void dump(String8& dump) const;
+
+    private:
+        enum { GRID_SIZE = 16 };
+
+        // Spacing of the orders assigned by rebuild, leaving room for windows added later.
+        static const int64_t ORDER_SPACING = 1 << 20;
+
+        struct Entry {
+            int64_t order;
+            bool unbounded;
+            bool singleHand;
+            Rect bounds;
+        };
+
+        Entry makeEntry(const sp<InputWindowHandle>& windowHandle, int64_t order) const;
+        bool fits(const Entry& entry) const;
+        void getCells(const Rect& bounds, int32_t* outFirstColumn, int32_t* outLastColumn,
+                int32_t* outFirstRow, int32_t* outLastRow) const;
+        void insert(InputWindowHandle* windowHandle, const Entry& entry);
+        void erase(InputWindowHandle* windowHandle, const Entry& entry);
+
+        static void insertCandidate(Vector<Candidate>& candidates, const Candidate& candidate);
+        static void eraseCandidate(Vector<Candidate>& candidates,
+                const InputWindowHandle* windowHandle);
+
+        Rect mBounds;
+        int32_t mCellWidth;
+        int32_t mCellHeight;
+        Vector<Candidate> mCells[GRID_SIZE * GRID_SIZE];
+        Vector<Candidate> mUnboundedWindows;
+        Vector<Candidate> mSingleHandWindows;
+        KeyedVector<const InputWindowHandle*, Entry> mEntries;
+    };
+    WindowHitGrid mWindowHitGrid;
+
+    // Applies the focus, hover and touch consequences of a change to mWindowHandles and
+    // releases the windows of oldWindowHandles that are no longer present.
+    void onWindowHandlesChangedLocked(const sp<InputWindowHandle>& newFocusedWindowHandle,
+            const Vector<sp<InputWindowHandle> >& oldWindowHandles);
+    // Insert into or remove from mWindowHandles and the hit grid.
+    void addWindowHandleLocked(const sp<InputWindowHandle>& windowHandle);
+    void removeWindowHandleLocked(const sp<InputWindowHandle>& windowHandle);
+
+    // Window update statistics, to keep an eye on how long window updates hold mLock.
+    struct WindowUpdateStats {
+        uint32_t fullUpdates;
+        uint32_t incrementalUpdates;
+        nsecs_t totalLockHeldTime;
+        nsecs_t maxLockHeldTime;
+        nsecs_t lastLockHeldTime;
+    } mWindowUpdateStats;
+
+    void recordWindowUpdateLocked(bool incremental, nsecs_t lockHeldTime);
+
     // Focus tracking for keys, trackball, etc.
     sp<InputWindowHandle> mFocusedWindowHandle;
 
@@ -1077,7 +1245,7 @@ private:
             EventEntry* eventEntry, const InputTarget* inputTarget, int32_t dispatchMode);
     void startDispatchCycleLocked(nsecs_t currentTime, const sp<Connection>& connection);
     void finishDispatchCycleLocked(nsecs_t currentTime, const sp<Connection>& connection,
-            uint32_t seq, bool handled);
+            uint32_t firstSeq, uint32_t seq, bool handled);
     void abortBrokenDispatchCycleLocked(nsecs_t currentTime, const sp<Connection>& connection,
             bool notify);
     void drainDispatchQueueLocked(Queue<DispatchEntry>* queue);
@@ -1112,7 +1280,8 @@ private:
 
     // Interesting events that we might like to log or tell the framework about.
     void onDispatchCycleFinishedLocked(
-            nsecs_t currentTime, const sp<Connection>& connection, uint32_t seq, bool handled);
+            nsecs_t currentTime, const sp<Connection>& connection,
+            uint32_t firstSeq, uint32_t seq, bool handled);
     void onDispatchCycleBrokenLocked(
             nsecs_t currentTime, const sp<Connection>& connection);
     void onANRLocked(
@@ -1126,6 +1295,8 @@ private:
     void doNotifyANRLockedInterruptible(CommandEntry* commandEntry);
     void doInterceptKeyBeforeDispatchingLockedInterruptible(CommandEntry* commandEntry);
     void doDispatchCycleFinishedLockedInterruptible(CommandEntry* commandEntry);
+    bool finishWaitQueueEntryLockedInterruptible(const sp<Connection>& connection,
+            uint32_t seq, nsecs_t finishTime, bool handled);
     bool afterKeyEventLockedInterruptible(const sp<Connection>& connection,
             DispatchEntry* dispatchEntry, KeyEntry* keyEntry, bool handled);
     bool afterMotionEventLockedInterruptible(const sp<Connection>& connection,
@@ -36,5 +36,15 @@ $(foreach file,$(test_src_files), \
     $(eval include $(BUILD_NATIVE_TEST)) \
 )
 
+# Build the benchmark.
+include $(CLEAR_VARS)
+LOCAL_SHARED_LIBRARIES := $(shared_libraries)
+LOCAL_C_INCLUDES := $(c_includes)
+LOCAL_CFLAGS += -Wno-unused-parameter -O3
+LOCAL_SRC_FILES := InputDispatcher_benchmark.cpp
+LOCAL_MODULE := InputDispatcher_benchmark
+LOCAL_MODULE_TAGS := $(module_tags)
+include $(BUILD_NATIVE_TEST)
+
 # Build the manual test programs.
 include $(call all-makefiles-under, $(LOCAL_PATH))
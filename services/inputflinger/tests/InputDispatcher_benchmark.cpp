@@ -0,0 +1,534 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Measures the latency of dispatching ACTION_DOWN to a window with 50 to 200
+// windows on screen: from injecting the event until it can be read from the
+// touched window's input channel.  The windows are a full screen touch modal
+// application window at the back, a grid of small non touch modal windows in
+// front of it (like widgets or popups) and a status bar and a navigation bar
+// at the front.  Touches cycle through the grid so that the windows further
+// back are hit as often as the ones in front.
+//
+// It also compares how long it takes to push a window update to the
+// dispatcher with setInputWindows, which updates every window, and with
+// updateInputWindows, which only updates the window that changed.
+//
+// Finally it stresses the dispatcher with a long stylus stroke fed through
+// notifyMotion as fast as the dispatcher takes it, as the input reader would
+// at a very high sampling rate, and prints the entry pool statistics.
+
+#include "../InputDispatcher.h"
+
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+using namespace android;
+
+static const int32_t kWidth = 1080;
+static const int32_t kHeight = 1920;
+static const int32_t kStatusBarHeight = 72;
+static const int32_t kNavigationBarHeight = 144;
+static const int32_t kColumns = 8;
+
+static const int32_t DEVICE_ID = 1;
+static const int32_t DISPLAY_ID = 0;
+static const int32_t INJECTOR_PID = 999;
+static const int32_t INJECTOR_UID = 1001;
+
+static const int kReceiveTimeoutMillis = 1000;
+
+
+// --- FakeInputDispatcherPolicy ---
+
+class FakeInputDispatcherPolicy : public InputDispatcherPolicyInterface {
+    InputDispatcherConfiguration mConfig;
+
+protected:
+    virtual ~FakeInputDispatcherPolicy() {
+    }
+
+public:
+    FakeInputDispatcherPolicy() {
+    }
+
+private:
+    virtual void notifyConfigurationChanged(nsecs_t) {
+    }
+
+    virtual nsecs_t notifyANR(const sp<InputApplicationHandle>&,
+            const sp<InputWindowHandle>&,
+            const String8&) {
+        return 0;
+    }
+
+    virtual void notifyInputChannelBroken(const sp<InputWindowHandle>&) {
+    }
+
+    virtual void getDispatcherConfiguration(InputDispatcherConfiguration* outConfig) {
+        *outConfig = mConfig;
+    }
+
+    virtual bool filterInputEvent(const InputEvent*, uint32_t) {
+        return true;
+    }
+
+    virtual void interceptKeyBeforeQueueing(const KeyEvent*, uint32_t&) {
+    }
+
+    virtual void interceptMotionBeforeQueueing(nsecs_t, uint32_t& policyFlags) {
+        policyFlags |= POLICY_FLAG_PASS_TO_USER;
+    }
+
+    virtual nsecs_t interceptKeyBeforeDispatching(const sp<InputWindowHandle>&,
+            const KeyEvent*, uint32_t) {
+        return 0;
+    }
+
+    virtual bool dispatchUnhandledKey(const sp<InputWindowHandle>&,
+            const KeyEvent*, uint32_t, KeyEvent*) {
+        return false;
+    }
+
+    virtual void notifySwitch(nsecs_t, uint32_t, uint32_t, uint32_t) {
+    }
+
+    virtual void pokeUserActivity(nsecs_t, int32_t) {
+    }
+
+    virtual bool checkInjectEventsPermissionNonReentrant(int32_t, int32_t) {
+        return false;
+    }
+};
+
+
+// --- FakeApplicationHandle ---
+
+class FakeApplicationHandle : public InputApplicationHandle {
+public:
+    FakeApplicationHandle() {
+    }
+
+    virtual bool updateInfo() {
+        if (!mInfo) {
+            mInfo = new InputApplicationInfo();
+        }
+        mInfo->name = "FakeApplication";
+        mInfo->dispatchingTimeout = seconds_to_nanoseconds(5);
+        return true;
+    }
+};
+
+
+// --- FakeWindowHandle ---
+
+class FakeWindowHandle : public InputWindowHandle {
+public:
+    FakeWindowHandle(const sp<InputApplicationHandle>& inputApplicationHandle,
+            const String8& name, const Rect& frame, int32_t flags, int32_t layer) :
+            InputWindowHandle(inputApplicationHandle),
+            mName(name), mFrame(frame), mFlags(flags), mLayer(layer) {
+        InputChannel::openInputChannelPair(name, mServerChannel, mClientChannel);
+    }
+
+    virtual bool updateInfo() {
+        if (!mInfo) {
+            mInfo = new InputWindowInfo();
+        }
+        mInfo->inputChannel = mServerChannel;
+        mInfo->name = mName;
+        mInfo->layoutParamsFlags = mFlags;
+        mInfo->layoutParamsType = InputWindowInfo::TYPE_APPLICATION;
+        mInfo->dispatchingTimeout = seconds_to_nanoseconds(5);
+        mInfo->frameLeft = mFrame.left;
+        mInfo->frameTop = mFrame.top;
+        mInfo->frameRight = mFrame.right;
+        mInfo->frameBottom = mFrame.bottom;
+        mInfo->scaleFactor = 1.0f;
+        mInfo->touchableRegion = Region(mFrame);
+        mInfo->visible = true;
+        mInfo->canReceiveKeys = true;
+        mInfo->hasFocus = false;
+        mInfo->hasWallpaper = false;
+        mInfo->paused = false;
+        mInfo->layer = mLayer;
+        mInfo->ownerPid = INJECTOR_PID;
+        mInfo->ownerUid = INJECTOR_UID;
+        mInfo->inputFeatures = 0;
+        mInfo->displayId = DISPLAY_ID;
+        return true;
+    }
+
+    const sp<InputChannel>& getServerChannel() const { return mServerChannel; }
+    const sp<InputChannel>& getClientChannel() const { return mClientChannel; }
+    const Rect& getFrame() const { return mFrame; }
+
+private:
+    String8 mName;
+    Rect mFrame;
+    int32_t mFlags;
+    int32_t mLayer;
+    sp<InputChannel> mServerChannel;
+    sp<InputChannel> mClientChannel;
+};
+
+
+// Creates the windows front to back, with numWindows - 3 windows in the grid.
+static Vector<sp<InputWindowHandle> > makeWindows(
+        const sp<InputApplicationHandle>& application, size_t numWindows,
+        std::vector<sp<FakeWindowHandle> >* outGridWindows) {
+    const int32_t notTouchModal = InputWindowInfo::FLAG_NOT_FOCUSABLE
+            | InputWindowInfo::FLAG_NOT_TOUCH_MODAL;
+    Vector<sp<InputWindowHandle> > windows;
+    int32_t layer = int32_t(numWindows);
+    windows.add(new FakeWindowHandle(application, String8("StatusBar"),
+            Rect(0, 0, kWidth, kStatusBarHeight), notTouchModal, layer--));
+    windows.add(new FakeWindowHandle(application, String8("NavigationBar"),
+            Rect(0, kHeight - kNavigationBarHeight, kWidth, kHeight),
+            notTouchModal, layer--));
+
+    const int32_t numGridWindows = int32_t(numWindows) - 3;
+    const int32_t rows = (numGridWindows + kColumns - 1) / kColumns;
+    const int32_t cellWidth = kWidth / kColumns;
+    const int32_t cellHeight =
+            (kHeight - kStatusBarHeight - kNavigationBarHeight) / rows;
+    for (int32_t i = 0; i < numGridWindows; i++) {
+        const int32_t left = (i % kColumns) * cellWidth;
+        const int32_t top = kStatusBarHeight + (i / kColumns) * cellHeight;
+        sp<FakeWindowHandle> window = new FakeWindowHandle(application,
+                String8::format("Grid%d", i),
+                Rect(left, top, left + cellWidth, top + cellHeight),
+                notTouchModal, layer--);
+        windows.add(window);
+        outGridWindows->push_back(window);
+    }
+
+    windows.add(new FakeWindowHandle(application, String8("Application"),
+            Rect(0, 0, kWidth, kHeight), 0, layer--));
+    return windows;
+}
+
+static bool injectMotion(const sp<InputDispatcher>& dispatcher, int32_t action,
+        nsecs_t downTime, int32_t x, int32_t y) {
+    PointerProperties pointerProperties;
+    pointerProperties.clear();
+    pointerProperties.id = 0;
+    pointerProperties.toolType = AMOTION_EVENT_TOOL_TYPE_FINGER;
+    PointerCoords pointerCoords;
+    pointerCoords.clear();
+    pointerCoords.setAxisValue(AMOTION_EVENT_AXIS_X, float(x));
+    pointerCoords.setAxisValue(AMOTION_EVENT_AXIS_Y, float(y));
+
+    MotionEvent event;
+    event.initialize(DEVICE_ID, AINPUT_SOURCE_TOUCHSCREEN,
+            action, 0, 0, 0, AMETA_NONE, 0, 0, 0, 0, 0,
+            downTime, systemTime(SYSTEM_TIME_MONOTONIC),
+            /*pointerCount*/ 1, &pointerProperties, &pointerCoords);
+    return dispatcher->injectInputEvent(&event, DISPLAY_ID,
+            INJECTOR_PID, INJECTOR_UID, INPUT_EVENT_INJECTION_SYNC_NONE, 0, 0)
+            == INPUT_EVENT_INJECTION_SUCCEEDED;
+}
+
+// Waits for a motion event on the channel and tells the dispatcher it was handled.
+static bool receiveMotion(const sp<InputChannel>& channel, int32_t expectedAction) {
+    struct pollfd pfd;
+    pfd.fd = channel->getFd();
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    if (poll(&pfd, 1, kReceiveTimeoutMillis) != 1) {
+        return false;
+    }
+
+    InputMessage message;
+    if (channel->receiveMessage(&message) != OK
+            || message.header.type != InputMessage::TYPE_MOTION
+            || message.body.motion.action != expectedAction) {
+        return false;
+    }
+
+    InputMessage finished;
+    finished.header.type = InputMessage::TYPE_FINISHED;
+    finished.header.padding = 0;
+    finished.body.finished.seq = message.body.motion.seq;
+    finished.body.finished.handled = true;
+    finished.body.finished.firstSeq = 0;
+    return channel->sendMessage(&finished) == OK;
+}
+
+static bool runBenchmark(size_t numWindows, int iterations) {
+    sp<FakeInputDispatcherPolicy> policy = new FakeInputDispatcherPolicy();
+    sp<InputDispatcher> dispatcher = new InputDispatcher(policy);
+    sp<InputDispatcherThread> thread = new InputDispatcherThread(dispatcher);
+
+    sp<InputApplicationHandle> application = new FakeApplicationHandle();
+    std::vector<sp<FakeWindowHandle> > gridWindows;
+    Vector<sp<InputWindowHandle> > windows = makeWindows(application, numWindows,
+            &gridWindows);
+    for (size_t i = 0; i < windows.size(); i++) {
+        const FakeWindowHandle* window =
+                static_cast<const FakeWindowHandle*>(windows.itemAt(i).get());
+        dispatcher->registerInputChannel(window->getServerChannel(), windows.itemAt(i),
+                false);
+    }
+    dispatcher->setInputWindows(windows);
+    dispatcher->setInputDispatchMode(true, false);
+    thread->run("InputDispatcher", PRIORITY_URGENT_DISPLAY);
+
+    std::vector<nsecs_t> latencies;
+    latencies.reserve(size_t(iterations));
+    bool ok = true;
+    for (int i = 0; ok && i < iterations; i++) {
+        const sp<FakeWindowHandle>& window = gridWindows[size_t(i) % gridWindows.size()];
+        const Rect& frame = window->getFrame();
+        const int32_t x = (frame.left + frame.right) / 2;
+        const int32_t y = (frame.top + frame.bottom) / 2;
+
+        const nsecs_t downTime = systemTime(SYSTEM_TIME_MONOTONIC);
+        ok = injectMotion(dispatcher, AMOTION_EVENT_ACTION_DOWN, downTime, x, y)
+                && receiveMotion(window->getClientChannel(), AMOTION_EVENT_ACTION_DOWN);
+        latencies.push_back(systemTime(SYSTEM_TIME_MONOTONIC) - downTime);
+
+        ok = ok && injectMotion(dispatcher, AMOTION_EVENT_ACTION_UP, downTime, x, y)
+                && receiveMotion(window->getClientChannel(), AMOTION_EVENT_ACTION_UP);
+        if (!ok) {
+            fprintf(stderr, "%zu windows: ACTION_DOWN at (%d, %d) did not reach %s\n",
+                    numWindows, x, y, window->getName().string());
+        }
+    }
+
+    thread->requestExit();
+    dispatcher->setInputDispatchMode(false, false);
+    thread->join();
+    for (size_t i = 0; i < windows.size(); i++) {
+        const FakeWindowHandle* window =
+                static_cast<const FakeWindowHandle*>(windows.itemAt(i).get());
+        dispatcher->unregisterInputChannel(window->getServerChannel());
+    }
+
+    if (!ok) {
+        return false;
+    }
+    std::sort(latencies.begin(), latencies.end());
+    nsecs_t total = 0;
+    for (size_t i = 0; i < latencies.size(); i++) {
+        total += latencies[i];
+    }
+    printf("%4zu windows  avg %7.1f us  p50 %7.1f us  p99 %7.1f us  max %7.1f us\n",
+            numWindows, double(total) / 1e3 / double(latencies.size()),
+            double(latencies[latencies.size() / 2]) / 1e3,
+            double(latencies[latencies.size() * 99 / 100]) / 1e3,
+            double(latencies.back()) / 1e3);
+    return true;
+}
+
+static void runWindowUpdateBenchmark(size_t numWindows, int iterations) {
+    sp<FakeInputDispatcherPolicy> policy = new FakeInputDispatcherPolicy();
+    sp<InputDispatcher> dispatcher = new InputDispatcher(policy);
+
+    sp<InputApplicationHandle> application = new FakeApplicationHandle();
+    std::vector<sp<FakeWindowHandle> > gridWindows;
+    Vector<sp<InputWindowHandle> > windows = makeWindows(application, numWindows,
+            &gridWindows);
+    for (size_t i = 0; i < windows.size(); i++) {
+        const FakeWindowHandle* window =
+                static_cast<const FakeWindowHandle*>(windows.itemAt(i).get());
+        dispatcher->registerInputChannel(window->getServerChannel(), windows.itemAt(i),
+                false);
+    }
+    dispatcher->setInputWindows(windows);
+
+    nsecs_t start = systemTime(SYSTEM_TIME_MONOTONIC);
+    for (int i = 0; i < iterations; i++) {
+        dispatcher->setInputWindows(windows);
+    }
+    const nsecs_t fullTime = systemTime(SYSTEM_TIME_MONOTONIC) - start;
+
+    // One window changes per update, e.g. a window being animated.
+    Vector<sp<InputWindowHandle> > changed;
+    const Vector<sp<InputWindowHandle> > removed;
+    start = systemTime(SYSTEM_TIME_MONOTONIC);
+    for (int i = 0; i < iterations; i++) {
+        changed.clear();
+        changed.add(gridWindows[size_t(i) % gridWindows.size()]);
+        dispatcher->updateInputWindows(changed, removed);
+    }
+    const nsecs_t incrementalTime = systemTime(SYSTEM_TIME_MONOTONIC) - start;
+
+    for (size_t i = 0; i < windows.size(); i++) {
+        const FakeWindowHandle* window =
+                static_cast<const FakeWindowHandle*>(windows.itemAt(i).get());
+        dispatcher->unregisterInputChannel(window->getServerChannel());
+    }
+
+    printf("%4zu windows  setInputWindows %7.1f us  updateInputWindows %7.1f us\n",
+            numWindows, double(fullTime) / 1e3 / iterations,
+            double(incrementalTime) / 1e3 / iterations);
+}
+
+// --- ConsumerThread ---
+
+// Reads the events sent to a window and finishes them, like an application
+// that keeps up with its input.
+class ConsumerThread : public Thread {
+public:
+    explicit ConsumerThread(const sp<InputChannel>& channel) :
+            Thread(/*canCallJava*/ false), mChannel(channel), mReceived(0) {
+    }
+
+    int32_t getReceived() const { return android_atomic_acquire_load(&mReceived); }
+
+private:
+    virtual bool threadLoop() {
+        struct pollfd pfd;
+        pfd.fd = mChannel->getFd();
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        if (poll(&pfd, 1, 100) != 1) {
+            return true;
+        }
+
+        InputMessage message;
+        while (mChannel->receiveMessage(&message) == OK) {
+            if (message.header.type != InputMessage::TYPE_MOTION) {
+                continue;
+            }
+            InputMessage finished;
+            finished.header.type = InputMessage::TYPE_FINISHED;
+            finished.header.padding = 0;
+            finished.body.finished.seq = message.body.motion.seq;
+            finished.body.finished.handled = true;
+            finished.body.finished.firstSeq = 0;
+            mChannel->sendMessage(&finished);
+            android_atomic_inc(&mReceived);
+        }
+        return true;
+    }
+
+    sp<InputChannel> mChannel;
+    volatile int32_t mReceived;
+};
+
+static void notifyStylus(const sp<InputDispatcher>& dispatcher, int32_t action,
+        nsecs_t downTime, float x, float y) {
+    PointerProperties pointerProperties;
+    pointerProperties.clear();
+    pointerProperties.id = 0;
+    pointerProperties.toolType = AMOTION_EVENT_TOOL_TYPE_STYLUS;
+    PointerCoords pointerCoords;
+    pointerCoords.clear();
+    pointerCoords.setAxisValue(AMOTION_EVENT_AXIS_X, x);
+    pointerCoords.setAxisValue(AMOTION_EVENT_AXIS_Y, y);
+    pointerCoords.setAxisValue(AMOTION_EVENT_AXIS_PRESSURE, 0.5f);
+
+    NotifyMotionArgs args(systemTime(SYSTEM_TIME_MONOTONIC), DEVICE_ID,
+            AINPUT_SOURCE_STYLUS, 0, action, 0, 0, AMETA_NONE, 0, 0, DISPLAY_ID,
+            1, &pointerProperties, &pointerCoords, 0, 0, downTime);
+    dispatcher->notifyMotion(&args);
+}
+
+static bool runNotifyMotionStress(int numSamples) {
+    sp<FakeInputDispatcherPolicy> policy = new FakeInputDispatcherPolicy();
+    sp<InputDispatcher> dispatcher = new InputDispatcher(policy);
+    sp<InputDispatcherThread> thread = new InputDispatcherThread(dispatcher);
+
+    sp<InputApplicationHandle> application = new FakeApplicationHandle();
+    std::vector<sp<FakeWindowHandle> > gridWindows;
+    Vector<sp<InputWindowHandle> > windows = makeWindows(application, 50, &gridWindows);
+    for (size_t i = 0; i < windows.size(); i++) {
+        const FakeWindowHandle* window =
+                static_cast<const FakeWindowHandle*>(windows.itemAt(i).get());
+        dispatcher->registerInputChannel(window->getServerChannel(), windows.itemAt(i),
+                false);
+    }
+    dispatcher->setInputWindows(windows);
+    dispatcher->setInputDispatchMode(true, false);
+    thread->run("InputDispatcher", PRIORITY_URGENT_DISPLAY);
+
+    // The stroke starts in the status bar, which gets the whole gesture.
+    const FakeWindowHandle* target =
+            static_cast<const FakeWindowHandle*>(windows.itemAt(0).get());
+    sp<ConsumerThread> consumer = new ConsumerThread(target->getClientChannel());
+    consumer->run("InputConsumer", PRIORITY_DISPLAY);
+
+    const int32_t expected = numSamples + 2;
+    const nsecs_t start = systemTime(SYSTEM_TIME_MONOTONIC);
+    notifyStylus(dispatcher, AMOTION_EVENT_ACTION_DOWN, start, 0, 0);
+    for (int i = 0; i < numSamples; i++) {
+        notifyStylus(dispatcher, AMOTION_EVENT_ACTION_MOVE, start,
+                float(i % kWidth), float(i / kWidth % kHeight));
+    }
+    notifyStylus(dispatcher, AMOTION_EVENT_ACTION_UP, start, 0, 0);
+    const nsecs_t notified = systemTime(SYSTEM_TIME_MONOTONIC);
+
+    const nsecs_t deadline = notified + seconds_to_nanoseconds(10);
+    while (consumer->getReceived() < expected
+            && systemTime(SYSTEM_TIME_MONOTONIC) < deadline) {
+        usleep(1000);
+    }
+    const nsecs_t received = systemTime(SYSTEM_TIME_MONOTONIC);
+    const int32_t count = consumer->getReceived();
+
+    String8 dump;
+    dispatcher->dump(dump);
+
+    consumer->requestExit();
+    consumer->join();
+    thread->requestExit();
+    dispatcher->setInputDispatchMode(false, false);
+    thread->join();
+    for (size_t i = 0; i < windows.size(); i++) {
+        const FakeWindowHandle* window =
+                static_cast<const FakeWindowHandle*>(windows.itemAt(i).get());
+        dispatcher->unregisterInputChannel(window->getServerChannel());
+    }
+
+    printf("notifyMotion  %d samples  notify %7.0f samples/s  delivered %7.0f samples/s\n",
+            numSamples, double(expected) * 1e9 / double(notified - start),
+            double(count) * 1e9 / double(received - start));
+    const char* pools = strstr(dump.string(), "EntryPools:");
+    if (pools) {
+        const char* end = strstr(pools, "\nInput Dispatcher State at time of last ANR");
+        printf("%.*s", end ? int(end - pools) + 1 : int(strlen(pools)), pools);
+    }
+    if (count != expected) {
+        fprintf(stderr, "notifyMotion: only %d of %d events were delivered\n",
+                count, expected);
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    int iterations = 1000;
+    if (argc > 1) {
+        iterations = atoi(argv[1]);
+    }
+
+    static const size_t kWindowCounts[] = { 50, 100, 150, 200 };
+    bool ok = true;
+    for (size_t i = 0; i < sizeof(kWindowCounts) / sizeof(kWindowCounts[0]); i++) {
+        ok = runBenchmark(kWindowCounts[i], iterations) && ok;
+    }
+    for (size_t i = 0; i < sizeof(kWindowCounts) / sizeof(kWindowCounts[0]); i++) {
+        runWindowUpdateBenchmark(kWindowCounts[i], iterations);
+    }
+    ok = runNotifyMotionStress(iterations * 100) && ok;
+    return ok ? 0 : 1;
+}
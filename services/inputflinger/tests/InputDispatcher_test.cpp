@@ -18,6 +18,7 @@
 
 #include <gtest/gtest.h>
 #include <linux/input.h>
+#include <poll.h>
 
 namespace android {
 
@@ -34,6 +35,9 @@ static const int32_t DISPLAY_ID = 0;
 static const int32_t INJECTOR_PID = 999;
 static const int32_t INJECTOR_UID = 1001;
 
+// How long to wait for an event that should be dispatched.
+static const int RECEIVE_TIMEOUT_MILLIS = 1000;
+
 
 // --- FakeInputDispatcherPolicy ---
 
@@ -72,7 +76,8 @@ private:
     virtual void interceptKeyBeforeQueueing(const KeyEvent*, uint32_t&) {
     }
 
-    virtual void interceptMotionBeforeQueueing(nsecs_t, uint32_t&) {
+    virtual void interceptMotionBeforeQueueing(nsecs_t, uint32_t& policyFlags) {
+        policyFlags |= POLICY_FLAG_PASS_TO_USER;
     }
 
     virtual nsecs_t interceptKeyBeforeDispatching(const sp<InputWindowHandle>&,
@@ -253,4 +258,318 @@ TEST_F(InputDispatcherTest, InjectInputEvent_ValidatesMotionEvents) {
             << "Should reject motion events with duplicate pointer ids.";
 }
 
+
+// --- FakeApplicationHandle ---
+
+class FakeApplicationHandle : public InputApplicationHandle {
+public:
+    FakeApplicationHandle() {
+    }
+
+    virtual bool updateInfo() {
+        if (!mInfo) {
+            mInfo = new InputApplicationInfo();
+        }
+        mInfo->name = "FakeApplication";
+        mInfo->dispatchingTimeout = seconds_to_nanoseconds(5);
+        return true;
+    }
+};
+
+
+// --- FakeWindowHandle ---
+
+// A touchable, not touch modal window.  Its info only changes when updateInfo is called,
+// like the info of a real window only changes when the window manager is asked for it.
+class FakeWindowHandle : public InputWindowHandle {
+public:
+    FakeWindowHandle(const sp<InputApplicationHandle>& inputApplicationHandle,
+            const String8& name, const Rect& frame, int32_t layer) :
+            InputWindowHandle(inputApplicationHandle),
+            mName(name), mFrame(frame), mLayer(layer), mHasFocus(false) {
+        InputChannel::openInputChannelPair(name, mServerChannel, mClientChannel);
+    }
+
+    virtual bool updateInfo() {
+        if (!mInfo) {
+            mInfo = new InputWindowInfo();
+        }
+        mInfo->inputChannel = mServerChannel;
+        mInfo->name = mName;
+        mInfo->layoutParamsFlags = InputWindowInfo::FLAG_NOT_FOCUSABLE
+                | InputWindowInfo::FLAG_NOT_TOUCH_MODAL;
+        mInfo->layoutParamsType = InputWindowInfo::TYPE_APPLICATION;
+        mInfo->dispatchingTimeout = seconds_to_nanoseconds(5);
+        mInfo->frameLeft = mFrame.left;
+        mInfo->frameTop = mFrame.top;
+        mInfo->frameRight = mFrame.right;
+        mInfo->frameBottom = mFrame.bottom;
+        mInfo->scaleFactor = 1.0f;
+        mInfo->touchableRegion = Region(mFrame);
+        mInfo->visible = true;
+        mInfo->canReceiveKeys = true;
+        mInfo->hasFocus = mHasFocus;
+        mInfo->hasWallpaper = false;
+        mInfo->paused = false;
+        mInfo->layer = mLayer;
+        mInfo->ownerPid = INJECTOR_PID;
+        mInfo->ownerUid = INJECTOR_UID;
+        mInfo->inputFeatures = 0;
+        mInfo->displayId = DISPLAY_ID;
+        return true;
+    }
+
+    void setFrame(const Rect& frame) { mFrame = frame; }
+    void setLayer(int32_t layer) { mLayer = layer; }
+    void setHasFocus(bool hasFocus) { mHasFocus = hasFocus; }
+
+    const sp<InputChannel>& getServerChannel() const { return mServerChannel; }
+    const sp<InputChannel>& getClientChannel() const { return mClientChannel; }
+
+private:
+    String8 mName;
+    Rect mFrame;
+    int32_t mLayer;
+    bool mHasFocus;
+    sp<InputChannel> mServerChannel;
+    sp<InputChannel> mClientChannel;
+};
+
+
+// --- InputDispatcherWindowsTest ---
+
+class InputDispatcherWindowsTest : public InputDispatcherTest {
+protected:
+    sp<InputApplicationHandle> mApplication;
+    Vector<sp<FakeWindowHandle> > mWindows;
+    sp<InputDispatcherThread> mThread;
+
+    virtual void SetUp() {
+        InputDispatcherTest::SetUp();
+        mApplication = new FakeApplicationHandle();
+    }
+
+    virtual void TearDown() {
+        if (mThread != NULL) {
+            mThread->requestExit();
+            mDispatcher->setInputDispatchMode(false, false);
+            mThread->join();
+            mThread.clear();
+        }
+        for (size_t i = 0; i < mWindows.size(); i++) {
+            mDispatcher->unregisterInputChannel(mWindows[i]->getServerChannel());
+        }
+        mWindows.clear();
+        mApplication.clear();
+        InputDispatcherTest::TearDown();
+    }
+
+    sp<FakeWindowHandle> createWindow(const char* name, const Rect& frame, int32_t layer) {
+        sp<FakeWindowHandle> window = new FakeWindowHandle(mApplication, String8(name),
+                frame, layer);
+        mDispatcher->registerInputChannel(window->getServerChannel(), window, false);
+        mWindows.add(window);
+        return window;
+    }
+
+    String8 dump() {
+        String8 dump;
+        mDispatcher->dump(dump);
+        return dump;
+    }
+
+    // Checks that the window is listed at the given position, front to back.
+    static bool hasWindowAt(const String8& dump, size_t index, const char* name) {
+        return dump.find(String8::format("%zu: name='%s', displayId=", index, name)) >= 0;
+    }
+
+    void startDispatching() {
+        mDispatcher->setInputDispatchMode(true, false);
+        mThread = new InputDispatcherThread(mDispatcher);
+        mThread->run("InputDispatcher", PRIORITY_URGENT_DISPLAY);
+    }
+
+    bool injectMotion(int32_t action, int32_t x, int32_t y) {
+        PointerProperties pointerProperties;
+        pointerProperties.clear();
+        pointerProperties.id = 0;
+        pointerProperties.toolType = AMOTION_EVENT_TOOL_TYPE_FINGER;
+        PointerCoords pointerCoords;
+        pointerCoords.clear();
+        pointerCoords.setAxisValue(AMOTION_EVENT_AXIS_X, float(x));
+        pointerCoords.setAxisValue(AMOTION_EVENT_AXIS_Y, float(y));
+
+        nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+        MotionEvent event;
+        event.initialize(DEVICE_ID, AINPUT_SOURCE_TOUCHSCREEN,
+                action, 0, 0, 0, AMETA_NONE, 0, 0, 0, 0, 0, now, now,
+                /*pointerCount*/ 1, &pointerProperties, &pointerCoords);
+        return mDispatcher->injectInputEvent(&event, DISPLAY_ID,
+                INJECTOR_PID, INJECTOR_UID, INPUT_EVENT_INJECTION_SYNC_NONE, 0, 0)
+                == INPUT_EVENT_INJECTION_SUCCEEDED;
+    }
+
+    // Waits for a motion event on the window and tells the dispatcher it was handled.
+    static bool receiveMotion(const sp<FakeWindowHandle>& window, int32_t expectedAction) {
+        const sp<InputChannel>& channel = window->getClientChannel();
+        struct pollfd pfd;
+        pfd.fd = channel->getFd();
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        if (poll(&pfd, 1, RECEIVE_TIMEOUT_MILLIS) != 1) {
+            return false;
+        }
+
+        InputMessage message;
+        if (channel->receiveMessage(&message) != OK
+                || message.header.type != InputMessage::TYPE_MOTION
+                || message.body.motion.action != expectedAction) {
+            return false;
+        }
+
+        InputMessage finished;
+        finished.header.type = InputMessage::TYPE_FINISHED;
+        finished.header.padding = 0;
+        finished.body.finished.seq = message.body.motion.seq;
+        finished.body.finished.handled = true;
+        finished.body.finished.firstSeq = 0;
+        return channel->sendMessage(&finished) == OK;
+    }
+
+    // Taps the point and checks that the window, and no other window, got the touch.
+    bool tapReaches(int32_t x, int32_t y, const sp<FakeWindowHandle>& window) {
+        if (!injectMotion(AMOTION_EVENT_ACTION_DOWN, x, y)
+                || !receiveMotion(window, AMOTION_EVENT_ACTION_DOWN)
+                || !injectMotion(AMOTION_EVENT_ACTION_UP, x, y)
+                || !receiveMotion(window, AMOTION_EVENT_ACTION_UP)) {
+            return false;
+        }
+        InputMessage message;
+        for (size_t i = 0; i < mWindows.size(); i++) {
+            if (mWindows[i]->getClientChannel()->receiveMessage(&message) != WOULD_BLOCK) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+TEST_F(InputDispatcherWindowsTest, UpdateInputWindows_AddsWindowsByLayer) {
+    sp<FakeWindowHandle> middle = createWindow("Middle", Rect(0, 0, 100, 100), 2);
+    sp<FakeWindowHandle> back = createWindow("Back", Rect(0, 0, 100, 100), 1);
+    sp<FakeWindowHandle> front = createWindow("Front", Rect(0, 0, 100, 100), 3);
+    Vector<sp<InputWindowHandle> > changed;
+    changed.add(middle);
+    mDispatcher->updateInputWindows(changed, Vector<sp<InputWindowHandle> >());
+
+    changed.clear();
+    changed.add(back);
+    changed.add(front);
+    mDispatcher->updateInputWindows(changed, Vector<sp<InputWindowHandle> >());
+
+    String8 state = dump();
+    ASSERT_TRUE(hasWindowAt(state, 0, "Front")) << state.string();
+    ASSERT_TRUE(hasWindowAt(state, 1, "Middle")) << state.string();
+    ASSERT_TRUE(hasWindowAt(state, 2, "Back")) << state.string();
+    ASSERT_NE(-1, state.find("windows=3,")) << state.string();
+}
+
+TEST_F(InputDispatcherWindowsTest, UpdateInputWindows_RemovesWindows) {
+    sp<FakeWindowHandle> front = createWindow("Front", Rect(0, 0, 100, 100), 2);
+    sp<FakeWindowHandle> back = createWindow("Back", Rect(0, 0, 100, 100), 1);
+    Vector<sp<InputWindowHandle> > windows;
+    windows.add(front);
+    windows.add(back);
+    mDispatcher->setInputWindows(windows);
+
+    Vector<sp<InputWindowHandle> > removed;
+    removed.add(front);
+    removed.add(front);
+    mDispatcher->updateInputWindows(Vector<sp<InputWindowHandle> >(), removed);
+
+    String8 state = dump();
+    ASSERT_TRUE(hasWindowAt(state, 0, "Back")) << state.string();
+    ASSERT_EQ(-1, state.find("name='Front'")) << state.string();
+    ASSERT_NE(-1, state.find("windows=1,")) << state.string();
+
+    startDispatching();
+    ASSERT_TRUE(tapReaches(50, 50, back));
+}
+
+TEST_F(InputDispatcherWindowsTest, UpdateInputWindows_MovesWindowWhenLayerChanges) {
+    sp<FakeWindowHandle> first = createWindow("First", Rect(0, 0, 100, 100), 2);
+    sp<FakeWindowHandle> second = createWindow("Second", Rect(0, 0, 100, 100), 1);
+    Vector<sp<InputWindowHandle> > windows;
+    windows.add(first);
+    windows.add(second);
+    mDispatcher->setInputWindows(windows);
+    startDispatching();
+    ASSERT_TRUE(tapReaches(50, 50, first));
+
+    // Raise the second window above the first one, and move it.
+    second->setLayer(3);
+    second->setFrame(Rect(50, 50, 150, 150));
+    Vector<sp<InputWindowHandle> > changed;
+    changed.add(second);
+    mDispatcher->updateInputWindows(changed, Vector<sp<InputWindowHandle> >());
+
+    String8 state = dump();
+    ASSERT_TRUE(hasWindowAt(state, 0, "Second")) << state.string();
+    ASSERT_TRUE(hasWindowAt(state, 1, "First")) << state.string();
+    ASSERT_TRUE(tapReaches(75, 75, second));
+    ASSERT_TRUE(tapReaches(25, 25, first));
+    ASSERT_TRUE(tapReaches(125, 125, second));
+}
+
+TEST_F(InputDispatcherWindowsTest, UpdateInputWindows_MovesFocus) {
+    sp<FakeWindowHandle> first = createWindow("First", Rect(0, 0, 100, 100), 2);
+    sp<FakeWindowHandle> second = createWindow("Second", Rect(0, 100, 100, 200), 1);
+    first->setHasFocus(true);
+    Vector<sp<InputWindowHandle> > changed;
+    changed.add(first);
+    changed.add(second);
+    mDispatcher->updateInputWindows(changed, Vector<sp<InputWindowHandle> >());
+    String8 state = dump();
+    ASSERT_NE(-1, state.find("FocusedWindow: name='First'")) << state.string();
+
+    first->setHasFocus(false);
+    second->setHasFocus(true);
+    changed.clear();
+    changed.add(first);
+    changed.add(second);
+    mDispatcher->updateInputWindows(changed, Vector<sp<InputWindowHandle> >());
+    state = dump();
+    ASSERT_NE(-1, state.find("FocusedWindow: name='Second'")) << state.string();
+
+    // Removing the focused window leaves no window focused.
+    Vector<sp<InputWindowHandle> > removed;
+    removed.add(second);
+    mDispatcher->updateInputWindows(Vector<sp<InputWindowHandle> >(), removed);
+    state = dump();
+    ASSERT_NE(-1, state.find("FocusedWindow: name='<null>'")) << state.string();
+}
+
+TEST_F(InputDispatcherWindowsTest, UpdateInputWindows_AddsWindowListedTwiceOnce) {
+    sp<FakeWindowHandle> window = createWindow("Window", Rect(0, 0, 100, 100), 1);
+    Vector<sp<InputWindowHandle> > changed;
+    changed.add(window);
+    changed.add(window);
+    mDispatcher->updateInputWindows(changed, Vector<sp<InputWindowHandle> >());
+
+    String8 state = dump();
+    ASSERT_TRUE(hasWindowAt(state, 0, "Window")) << state.string();
+    ASSERT_FALSE(hasWindowAt(state, 1, "Window")) << state.string();
+    ASSERT_NE(-1, state.find("windows=1,")) << state.string();
+
+    // Removing it once removes it from hit tests too.
+    Vector<sp<InputWindowHandle> > removed;
+    removed.add(window);
+    mDispatcher->updateInputWindows(Vector<sp<InputWindowHandle> >(), removed);
+    state = dump();
+    ASSERT_NE(-1, state.find("Windows: <none>")) << state.string();
+    startDispatching();
+    ASSERT_TRUE(injectMotion(AMOTION_EVENT_ACTION_DOWN, 50, 50));
+    ASSERT_FALSE(receiveMotion(window, AMOTION_EVENT_ACTION_DOWN));
+}
+
 } // namespace android
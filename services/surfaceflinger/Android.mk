@@ -11,6 +11,7 @@ LOCAL_SRC_FILES := \
     EventControlThread.cpp \
     EventThread.cpp \
     FenceTracker.cpp \
+    FrameTimeline.cpp \
     FrameTracker.cpp \
     GpuService.cpp \
     Layer.cpp \
@@ -20,6 +21,8 @@ LOCAL_SRC_FILES := \
     MonitoredProducer.cpp \
     SurfaceFlingerConsumer.cpp \
     Transform.cpp \
+    VisibleRegionCache.cpp \
+    WorkerPool.cpp \
     DisplayHardware/FramebufferSurface.cpp \
     DisplayHardware/HWC2.cpp \
     DisplayHardware/HWC2On1Adapter.cpp \
@@ -98,6 +98,7 @@ DisplayDevice::DisplayDevice(
       mFlags(),
       mPageFlipCount(),
       mIsSecure(isSecure),
+      mStageTimings(),
       mLayerStack(NO_LAYER_STACK),
       mOrientation(),
       mPowerMode(HWC_POWER_MODE_OFF),
@@ -622,6 +623,18 @@ uint32_t DisplayDevice::getPrimaryDisplayOrientationTransform() {
     return sPrimaryDisplayOrientation;
 }
 
+// ----------------------------------------------------------------------------
+
+void DisplayDevice::recordStageTime(CompositionStage stage, nsecs_t duration) {
+    StageTiming& timing(mStageTimings[stage]);
+    timing.last = duration;
+    if (duration > timing.max) {
+        timing.max = duration;
+    }
+    timing.total += duration;
+    timing.count++;
+}
+
 void DisplayDevice::dump(String8& result) const {
     const Transform& tr(mGlobalTransform);
     result.appendFormat(
@@ -641,6 +654,20 @@ void DisplayDevice::dump(String8& result) const {
         tr[0][0], tr[1][0], tr[2][0],
         tr[0][1], tr[1][1], tr[2][1],
         tr[0][2], tr[1][2], tr[2][2]);
+    mVisibleRegionCache.dump(result);
+
+    static const char* const stageNames[NUM_COMPOSITION_STAGES] = {
+        "rebuild", "hwc setup", "composition"
+    };
+    result.append("   timings (last/avg/max us):");
+    for (size_t i = 0; i < NUM_COMPOSITION_STAGES; i++) {
+        const StageTiming& timing(mStageTimings[i]);
+        const nsecs_t average = timing.count ?
+                timing.total / static_cast<nsecs_t>(timing.count) : 0;
+        result.appendFormat(" %s=%.1f/%.1f/%.1f", stageNames[i],
+                timing.last / 1000.0, average / 1000.0, timing.max / 1000.0);
+    }
+    result.append("\n");
 
     String8 surfaceDump;
     mDisplaySurface->dumpAsString(surfaceDump);
@@ -18,6 +18,7 @@
 #define ANDROID_DISPLAY_DEVICE_H
 
 #include "Transform.h"
+#include "VisibleRegionCache.h"
 
 #include <stdlib.h>
 
@@ -121,6 +122,7 @@ public:
 
     void                    setVisibleLayersSortedByZ(const Vector< sp<Layer> >& layers);
     const Vector< sp<Layer> >& getVisibleLayersSortedByZ() const;
+    VisibleRegionCache&     getVisibleRegionCache() { return mVisibleRegionCache; }
     Region                  getDirtyRegion(bool repaintEverything) const;
 
     void                    setLayerStack(uint32_t stack);
@@ -200,6 +202,18 @@ public:
     // release HWC resources (if any) for removable displays
     void disconnect(HWComposer& hwc);
 
+    /* ------------------------------------------------------------------------
+     * Composition timing
+     */
+    enum CompositionStage {
+        STAGE_REBUILD_LAYER_STACK,
+        STAGE_SET_UP_HWC,
+        STAGE_COMPOSITION,
+        NUM_COMPOSITION_STAGES
+    };
+    // records how long a stage of the last refresh took for this display
+    void recordStageTime(CompositionStage stage, nsecs_t duration);
+
     /* ------------------------------------------------------------------------
      * Debugging
      */
@@ -240,6 +254,18 @@ private:
     // list of visible layers on that display
     Vector< sp<Layer> > mVisibleLayersSortedByZ;
 
+    // results of the last visible region pass on that display
+    VisibleRegionCache mVisibleRegionCache;
+
+    // time spent in each composition stage, for dumpsys
+    struct StageTiming {
+        nsecs_t last;
+        nsecs_t max;
+        nsecs_t total;
+        uint64_t count;
+    };
+    StageTiming mStageTimings[NUM_COMPOSITION_STAGES];
+
     /*
      * Transaction state
      */
@@ -0,0 +1,187 @@
+/*
+ * Copyright 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// This is needed for stdint.h to define INT64_MAX in C++
+#define __STDC_LIMIT_MACROS
+
+#include <inttypes.h>
+
+#include <gui/BufferItem.h>
+
+#include <ui/Fence.h>
+
+#include <utils/String8.h>
+
+#include "FrameTimeline.h"
+
+namespace android {
+
+FrameTimeline::FrameTimeline() :
+        mOffset(0),
+        mNumFrames(0),
+        mLastLatched(-1),
+        mNumFences(0) {
+}
+
+FrameTimeline::FrameRecord& FrameTimeline::addFrameLocked(
+        const BufferItem& item, nsecs_t latchTime) {
+    FrameRecord& record(mFrameRecords[mOffset]);
+    if (record.readyFence != NULL) {
+        // We're clobbering an unsignaled fence
+        mNumFences--;
+    }
+    if (record.presentFence != NULL) {
+        mNumFences--;
+    }
+    if (mLastLatched == static_cast<ssize_t>(mOffset)) {
+        mLastLatched = -1;
+    }
+    record = FrameRecord();
+    record.frameNumber = item.mFrameNumber;
+    record.dequeueTime = item.mDequeueTime;
+    record.queueTime = item.mQueueTime;
+    record.latchTime = latchTime;
+    if (item.mFence != NULL && item.mFence->isValid()) {
+        record.readyTime = INT64_MAX;
+        record.readyFence = item.mFence;
+        mNumFences++;
+    } else {
+        // Without a fence the buffer was ready when it was queued
+        record.readyTime = item.mQueueTime;
+    }
+
+    mOffset = (mOffset + 1) % NUM_FRAME_RECORDS;
+    if (mNumFrames < NUM_FRAME_RECORDS) {
+        mNumFrames++;
+    }
+
+    // Keep the number of open fence FDs in this process reasonable
+    processFencesLocked();
+    return record;
+}
+
+void FrameTimeline::addLatchedFrame(const BufferItem& item,
+        nsecs_t latchTime) {
+    Mutex::Autolock lock(mMutex);
+    addFrameLocked(item, latchTime);
+    mLastLatched = static_cast<ssize_t>(
+            (mOffset + NUM_FRAME_RECORDS - 1) % NUM_FRAME_RECORDS);
+}
+
+void FrameTimeline::addDroppedFrame(const BufferItem& item,
+        nsecs_t latchTime) {
+    Mutex::Autolock lock(mMutex);
+    FrameRecord& record(addFrameLocked(item, latchTime));
+    record.flags |= FLAG_DROPPED;
+}
+
+void FrameTimeline::setPresented(nsecs_t compositionTime,
+        const sp<Fence>& presentFence, nsecs_t presentTime) {
+    Mutex::Autolock lock(mMutex);
+    if (mLastLatched < 0) {
+        return;
+    }
+    FrameRecord& record(mFrameRecords[static_cast<size_t>(mLastLatched)]);
+    record.compositionTime = compositionTime;
+    if (presentFence != NULL && presentFence->isValid()) {
+        record.presentTime = INT64_MAX;
+        record.presentFence = presentFence;
+        mNumFences++;
+    } else {
+        record.presentTime = presentTime;
+    }
+    mLastLatched = -1;
+}
+
+void FrameTimeline::clear() {
+    Mutex::Autolock lock(mMutex);
+    for (size_t i = 0; i < NUM_FRAME_RECORDS; i++) {
+        mFrameRecords[i] = FrameRecord();
+    }
+    mOffset = 0;
+    mNumFrames = 0;
+    mLastLatched = -1;
+    mNumFences = 0;
+}
+
+void FrameTimeline::processFencesLocked() const {
+    for (size_t i = 1; i <= mNumFrames && mNumFences > 0; i++) {
+        FrameRecord& record(mFrameRecords[
+                (mOffset + NUM_FRAME_RECORDS - i) % NUM_FRAME_RECORDS]);
+        if (record.readyFence != NULL) {
+            record.readyTime = record.readyFence->getSignalTime();
+            if (record.readyTime < INT64_MAX) {
+                record.readyFence = NULL;
+                mNumFences--;
+            }
+        }
+        if (record.presentFence != NULL) {
+            record.presentTime = record.presentFence->getSignalTime();
+            if (record.presentTime < INT64_MAX) {
+                record.presentFence = NULL;
+                mNumFences--;
+            }
+        }
+    }
+}
+
+void FrameTimeline::dump(String8& result) const {
+    Mutex::Autolock lock(mMutex);
+    processFencesLocked();
+
+    result.append("frame\tdequeue\tqueue\tready\tlatch\tcomposition\t"
+            "present\n");
+    for (size_t i = mNumFrames; i > 0; i--) {
+        const FrameRecord& record(mFrameRecords[
+                (mOffset + NUM_FRAME_RECORDS - i) % NUM_FRAME_RECORDS]);
+        result.appendFormat("%" PRIu64 "\t%" PRId64 "\t%" PRId64 "\t%" PRId64
+                "\t%" PRId64 "\t%" PRId64 "\t%" PRId64 "%s\n",
+                record.frameNumber, record.dequeueTime, record.queueTime,
+                record.readyTime, record.latchTime, record.compositionTime,
+                record.presentTime,
+                (record.flags & FLAG_DROPPED) ? "\tdropped" : "");
+    }
+    result.append("\n");
+}
+
+void FrameTimeline::dumpBinary(String8& result, const String8& name) const {
+    Mutex::Autolock lock(mMutex);
+    processFencesLocked();
+
+    const uint32_t header[] = { BINARY_MAGIC, BINARY_VERSION,
+            static_cast<uint32_t>(name.length()) };
+    result.append(reinterpret_cast<const char*>(header), sizeof(header));
+    result.append(name.string(), name.length());
+    const uint32_t count = static_cast<uint32_t>(mNumFrames);
+    result.append(reinterpret_cast<const char*>(&count), sizeof(count));
+    for (size_t i = mNumFrames; i > 0; i--) {
+        const FrameRecord& record(mFrameRecords[
+                (mOffset + NUM_FRAME_RECORDS - i) % NUM_FRAME_RECORDS]);
+        BinaryRecord binary;
+        binary.frameNumber = record.frameNumber;
+        binary.dequeueTime = record.dequeueTime;
+        binary.queueTime = record.queueTime;
+        binary.readyTime = record.readyTime;
+        binary.latchTime = record.latchTime;
+        binary.compositionTime = record.compositionTime;
+        binary.presentTime = record.presentTime;
+        binary.flags = record.flags;
+        binary.reserved = 0;
+        result.append(reinterpret_cast<const char*>(&binary), sizeof(binary));
+    }
+}
+
+} // namespace android
@@ -0,0 +1,156 @@
+/*
+ * Copyright 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_FRAMETIMELINE_H
+#define ANDROID_FRAMETIMELINE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <utils/Mutex.h>
+#include <utils/RefBase.h>
+#include <utils/Timers.h>
+
+namespace android {
+
+class BufferItem;
+class Fence;
+class String8;
+
+// FrameTimeline records, for the most recent frames of a layer, when each
+// frame went through every stage of the pipeline: dequeued and queued by the
+// producer, ready (its acquire fence signaled), latched by SurfaceFlinger,
+// composited and presented. Comparing the stages of a janky frame shows
+// whether the app, the GPU or SurfaceFlinger was late.
+//
+// Frames that were queued but replaced by a newer frame before they could be
+// latched are recorded as dropped. Times are systemTime(SYSTEM_TIME_MONOTONIC);
+// a time that isn't known is 0, and a fence that hasn't signaled yet is
+// reported as INT64_MAX.
+//
+// FrameTimeline is thread-safe.
+class FrameTimeline {
+public:
+    // NUM_FRAME_RECORDS is the size of the circular buffer of frame records.
+    enum { NUM_FRAME_RECORDS = 128 };
+
+    // Binary format written by dumpBinary. Each layer is one section, and
+    // all values are in host byte order:
+    //   uint32_t magic (BINARY_MAGIC)
+    //   uint32_t version (BINARY_VERSION)
+    //   uint32_t name length, followed by the layer name (not terminated)
+    //   uint32_t record count, followed by that many BinaryRecords, oldest
+    //   first
+    enum {
+        BINARY_MAGIC = 0x4c544653, // "SFTL"
+        BINARY_VERSION = 1,
+    };
+
+    enum {
+        // The frame was replaced by a newer one before it was latched
+        FLAG_DROPPED = 1 << 0,
+    };
+
+    struct BinaryRecord {
+        uint64_t frameNumber;
+        int64_t dequeueTime;
+        int64_t queueTime;
+        int64_t readyTime;
+        int64_t latchTime;
+        int64_t compositionTime;
+        int64_t presentTime;
+        uint32_t flags;
+        uint32_t reserved;
+    };
+
+    FrameTimeline();
+
+    // addLatchedFrame records a frame that has just been latched.
+    void addLatchedFrame(const BufferItem& item, nsecs_t latchTime);
+
+    // addDroppedFrame records a frame that was dropped while latching a
+    // newer frame.
+    void addDroppedFrame(const BufferItem& item, nsecs_t latchTime);
+
+    // setPresented sets when SurfaceFlinger started compositing the most
+    // recently latched frame and the fence that signals when it's presented.
+    // If the display has no present fence, presentTime is used instead.
+    void setPresented(nsecs_t compositionTime, const sp<Fence>& presentFence,
+            nsecs_t presentTime);
+
+    // clear drops all the frame records.
+    void clear();
+
+    // dump appends the frame records to result as text, oldest first.
+    void dump(String8& result) const;
+
+    // dumpBinary appends the frame records to result in the binary format
+    // described above.
+    void dumpBinary(String8& result, const String8& name) const;
+
+private:
+    struct FrameRecord {
+        FrameRecord() :
+            frameNumber(0),
+            dequeueTime(0),
+            queueTime(0),
+            readyTime(0),
+            latchTime(0),
+            compositionTime(0),
+            presentTime(0),
+            flags(0) {}
+        uint64_t frameNumber;
+        nsecs_t dequeueTime;
+        nsecs_t queueTime;
+        nsecs_t readyTime;
+        nsecs_t latchTime;
+        nsecs_t compositionTime;
+        nsecs_t presentTime;
+        uint32_t flags;
+        sp<Fence> readyFence;
+        sp<Fence> presentFence;
+    };
+
+    // addFrameLocked adds a record for item and returns it.
+    FrameRecord& addFrameLocked(const BufferItem& item, nsecs_t latchTime);
+
+    // processFencesLocked replaces the fences that have signaled with their
+    // signal times. Like FrameTracker::processFencesLocked it's const because
+    // the information the records represent doesn't change.
+    void processFencesLocked() const;
+
+    // mFrameRecords is the circular buffer of frame records, and mOffset is
+    // the index the next frame will be recorded at.
+    mutable FrameRecord mFrameRecords[NUM_FRAME_RECORDS];
+    size_t mOffset;
+
+    // mNumFrames is the number of valid records, up to NUM_FRAME_RECORDS.
+    size_t mNumFrames;
+
+    // mLastLatched is the index of the record of the last latched frame, or
+    // -1 if it has been composited already.
+    ssize_t mLastLatched;
+
+    // mNumFences is the number of unsignaled fences in the frame records, so
+    // that processFencesLocked has nothing to do most of the time.
+    mutable int mNumFences;
+
+    mutable Mutex mMutex;
+};
+
+} // namespace android
+
+#endif // ANDROID_FRAMETIMELINE_H
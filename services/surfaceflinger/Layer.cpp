@@ -175,6 +175,9 @@ void Layer::onFirstRef() {
 #else
     mProducer->setMaxDequeuedBufferCount(2);
 #endif
+    if (mFlinger->mAdaptiveQueueDepth) {
+        mSurfaceFlingerConsumer->setAdaptiveQueueDepth(true);
+    }
 
     const sp<const DisplayDevice> hw(mFlinger->getDefaultDisplayDevice());
     updateTransformHint(hw);
@@ -1847,7 +1850,7 @@ bool Layer::onPreComposition() {
     return mQueuedFrames > 0 || mSidebandStreamChanged || mAutoRefresh;
 }
 
-bool Layer::onPostComposition() {
+bool Layer::onPostComposition(nsecs_t refreshStartTime) {
     bool frameLatencyNeeded = mFrameLatencyNeeded;
     if (mFrameLatencyNeeded) {
         nsecs_t desiredPresentTime = mSurfaceFlingerConsumer->getTimestamp();
@@ -1870,11 +1873,13 @@ bool Layer::onPostComposition() {
 #endif
         if (presentFence->isValid()) {
             mFrameTracker.setActualPresentFence(presentFence);
+            mFrameTimeline.setPresented(refreshStartTime, presentFence, 0);
         } else {
             // The HWC doesn't support present fences, so use the refresh
             // timestamp instead.
             nsecs_t presentTime = hwc.getRefreshTimestamp(HWC_DISPLAY_PRIMARY);
             mFrameTracker.setActualPresentTime(presentTime);
+            mFrameTimeline.setPresented(refreshStartTime, NULL, presentTime);
         }
 
         mFrameTracker.advanceFrame();
@@ -2147,12 +2152,14 @@ Region Layer::latchBuffer(bool& recomputeVisibleRegions)
         if (queuedBuffer) {
             // Autolock scope
             auto currentFrameNumber = mSurfaceFlingerConsumer->getFrameNumber();
+            const nsecs_t latchTime = systemTime();
 
             Mutex::Autolock lock(mQueueItemLock);
 
             // Remove any stale buffers that have been dropped during
             // updateTexImage
             while ((mQueuedFrames > 0) && (mQueueItems[0].mFrameNumber != currentFrameNumber)) {
+                mFrameTimeline.addDroppedFrame(mQueueItems[0], latchTime);
                 mQueueItems.removeAt(0);
                 android_atomic_dec(&mQueuedFrames);
             }
@@ -2162,6 +2169,7 @@ Region Layer::latchBuffer(bool& recomputeVisibleRegions)
                 return outDirtyRegion;
             }
 
+            mFrameTimeline.addLatchedFrame(mQueueItems[0], latchTime);
             mQueueItems.removeAt(0);
         }
 
@@ -2408,6 +2416,18 @@ void Layer::getFrameStats(FrameStats* outStats) const {
     mFrameTracker.getStats(outStats);
 }
 
+void Layer::dumpFrameTimeline(String8& result) const {
+    mFrameTimeline.dump(result);
+}
+
+void Layer::dumpFrameTimelineBinary(String8& result) const {
+    mFrameTimeline.dumpBinary(result, mName);
+}
+
+void Layer::clearFrameTimeline() {
+    mFrameTimeline.clear();
+}
+
 void Layer::getFenceData(String8* outName, uint64_t* outFrameNumber,
         bool* outIsGlesComposition, nsecs_t* outPostedTime,
         sp<Fence>* outAcquireFence, sp<Fence>* outPrevReleaseFence) const {
@@ -38,6 +38,7 @@
 
 #include <list>
 
+#include "FrameTimeline.h"
 #include "FrameTracker.h"
 #include "Client.h"
 #include "MonitoredProducer.h"
@@ -299,7 +300,7 @@ public:
      * called after composition.
      * returns true if the layer latched a new buffer this frame.
      */
-    bool onPostComposition();
+    bool onPostComposition(nsecs_t refreshStartTime);
 
 #ifdef USE_HWC2
     // If a buffer was replaced this frame, release the former buffer
@@ -450,6 +451,9 @@ public:
     void clearFrameStats();
     void logFrameStats();
     void getFrameStats(FrameStats* outStats) const;
+    void dumpFrameTimeline(String8& result) const;
+    void dumpFrameTimelineBinary(String8& result) const;
+    void clearFrameTimeline();
 
     void getFenceData(String8* outName, uint64_t* outFrameNumber,
             bool* outIsGlesComposition, nsecs_t* outPostedTime,
@@ -598,6 +602,7 @@ private:
     volatile int32_t mQueuedFrames;
     volatile int32_t mSidebandStreamChanged; // used like an atomic boolean
     FrameTracker mFrameTracker;
+    FrameTimeline mFrameTimeline;
 
     // main thread
     sp<GraphicBuffer> mActiveBuffer;
@@ -45,6 +45,7 @@
 #include <gui/IDisplayEventConnection.h>
 #include <gui/Surface.h>
 #include <gui/GraphicBufferAlloc.h>
+#include <gui/GraphicBufferPool.h>
 
 #include <ui/GraphicBufferAllocator.h>
 #include <ui/PixelFormat.h>
@@ -198,6 +199,28 @@ SurfaceFlinger::SurfaceFlinger()
     property_get("debug.sf.disable_hwc_vds", value, "0");
     mUseHwcVirtualDisplays = !atoi(value);
     ALOGI_IF(!mUseHwcVirtualDisplays, "Disabling HWC virtual displays");
+
+    property_get("debug.sf.adaptive_queue_depth", value, "0");
+    mAdaptiveQueueDepth = atoi(value) != 0;
+    ALOGI_IF(mAdaptiveQueueDepth, "Enabling adaptive queue depth");
+
+    // recycle the buffers of torn down layers, off unless the device sets
+    // a pool size
+    property_get("ro.sf.buffer_pool_size_kb", value, "0");
+    int bufferPoolSizeKb = atoi(value);
+    GraphicBufferPool::getInstance().setMaxBytes(bufferPoolSizeKb > 0 ?
+            static_cast<size_t>(bufferPoolSizeKb) * 1024 : 0);
+
+    // number of extra threads used to rebuild the layer stacks of
+    // independent displays concurrently, 0 disables it
+    property_get("debug.sf.parallel_displays", value, "0");
+    int displayWorkers = atoi(value);
+    if (displayWorkers > 0) {
+        mDisplayWorkerPool.reset(new WorkerPool("SFDisplayWorker",
+                static_cast<size_t>(displayWorkers)));
+        ALOGI("Rebuilding layer stacks on %zu display worker threads",
+                mDisplayWorkerPool->getThreadCount());
+    }
 }
 
 void SurfaceFlinger::onFirstRef()
@@ -1196,7 +1219,7 @@ void SurfaceFlinger::postComposition(nsecs_t refreshStartTime)
     const LayerVector& layers(mDrawingState.layersSortedByZ);
     const size_t count = layers.size();
     for (size_t i=0 ; i<count ; i++) {
-        bool frameLatched = layers[i]->onPostComposition();
+        bool frameLatched = layers[i]->onPostComposition(refreshStartTime);
         if (frameLatched) {
             recordBufferingStats(layers[i]->getName().string(),
                     layers[i]->getOccupancyHistory(false));
@@ -1269,45 +1292,89 @@ void SurfaceFlinger::rebuildLayerStacks() {
         mVisibleRegionsDirty = false;
         invalidateHwcGeometry();
 
-        const LayerVector& layers(mDrawingState.layersSortedByZ);
+        // layers which are no longer visible on a given display
+        std::vector<Vector<sp<Layer>>> hiddenLayers(mDisplays.size());
+
+        if (mDisplayWorkerPool != nullptr) {
+            // Displays showing different layer stacks work on disjoint sets of
+            // layers and are rebuilt concurrently. Displays sharing a layer
+            // stack are rebuilt one after the other within the same task.
+            std::vector<std::vector<size_t>> groups;
+            std::map<uint32_t, size_t> groupForLayerStack;
+            for (size_t dpy=0 ; dpy<mDisplays.size() ; dpy++) {
+                const uint32_t layerStack = mDisplays[dpy]->getLayerStack();
+                auto group = groupForLayerStack.find(layerStack);
+                if (group == groupForLayerStack.end()) {
+                    group = groupForLayerStack.emplace(layerStack,
+                            groups.size()).first;
+                    groups.emplace_back();
+                }
+                groups[group->second].push_back(dpy);
+            }
+            mDisplayWorkerPool->run(groups.size(), [&](size_t group) {
+                for (size_t dpy : groups[group]) {
+                    rebuildLayerStack(dpy, hiddenLayers[dpy]);
+                }
+            });
+        } else {
+            for (size_t dpy=0 ; dpy<mDisplays.size() ; dpy++) {
+                rebuildLayerStack(dpy, hiddenLayers[dpy]);
+            }
+        }
+
+        // Clear out the HWC layer of layers which were previously visible,
+        // but no longer are. This talks to the HWC and is kept on this thread.
         for (size_t dpy=0 ; dpy<mDisplays.size() ; dpy++) {
-            Region opaqueRegion;
-            Region dirtyRegion;
-            Vector<sp<Layer>> layersSortedByZ;
-            const sp<DisplayDevice>& displayDevice(mDisplays[dpy]);
-            const Transform& tr(displayDevice->getTransform());
-            const Rect bounds(displayDevice->getBounds());
-            if (displayDevice->isDisplayOn()) {
-                SurfaceFlinger::computeVisibleRegions(dpy, layers,
-                        displayDevice->getLayerStack(), dirtyRegion,
-                        opaqueRegion);
-
-                const size_t count = layers.size();
-                for (size_t i=0 ; i<count ; i++) {
-                    const sp<Layer>& layer(layers[i]);
-                    const Layer::State& s(layer->getDrawingState());
-                    if (s.layerStack == displayDevice->getLayerStack()) {
-                        Region drawRegion(tr.transform(
-                                layer->visibleNonTransparentRegion));
-                        drawRegion.andSelf(bounds);
-                        if (!drawRegion.isEmpty()) {
-                            layersSortedByZ.add(layer);
-                        } else {
-                            // Clear out the HWC layer if this layer was
-                            // previously visible, but no longer is
-                            layer->setHwcLayer(displayDevice->getHwcDisplayId(),
-                                    nullptr);
-                        }
-                    }
+            const auto hwcId = mDisplays[dpy]->getHwcDisplayId();
+            for (const auto& layer : hiddenLayers[dpy]) {
+                layer->setHwcLayer(hwcId, nullptr);
+            }
+        }
+    }
+}
+
+void SurfaceFlinger::rebuildLayerStack(size_t dpy,
+        Vector<sp<Layer>>& outHiddenLayers) {
+    ATRACE_CALL();
+    const nsecs_t startTime = systemTime(SYSTEM_TIME_MONOTONIC);
+
+    const LayerVector& layers(mDrawingState.layersSortedByZ);
+    Region opaqueRegion;
+    Region dirtyRegion;
+    Vector<sp<Layer>> layersSortedByZ;
+    const sp<DisplayDevice>& displayDevice(mDisplays[dpy]);
+    const Transform& tr(displayDevice->getTransform());
+    const Rect bounds(displayDevice->getBounds());
+    if (displayDevice->isDisplayOn()) {
+        SurfaceFlinger::computeVisibleRegions(dpy, layers,
+                displayDevice->getLayerStack(),
+                displayDevice->getVisibleRegionCache(), dirtyRegion,
+                opaqueRegion);
+
+        const size_t count = layers.size();
+        for (size_t i=0 ; i<count ; i++) {
+            const sp<Layer>& layer(layers[i]);
+            const Layer::State& s(layer->getDrawingState());
+            if (s.layerStack == displayDevice->getLayerStack()) {
+                Region drawRegion(tr.transform(
+                        layer->visibleNonTransparentRegion));
+                drawRegion.andSelf(bounds);
+                if (!drawRegion.isEmpty()) {
+                    layersSortedByZ.add(layer);
+                } else {
+                    outHiddenLayers.add(layer);
                 }
             }
-            displayDevice->setVisibleLayersSortedByZ(layersSortedByZ);
-            displayDevice->undefinedRegion.set(bounds);
-            displayDevice->undefinedRegion.subtractSelf(
-                    tr.transform(opaqueRegion));
-            displayDevice->dirtyRegion.orSelf(dirtyRegion);
         }
     }
+    displayDevice->setVisibleLayersSortedByZ(layersSortedByZ);
+    displayDevice->undefinedRegion.set(bounds);
+    displayDevice->undefinedRegion.subtractSelf(
+            tr.transform(opaqueRegion));
+    displayDevice->dirtyRegion.orSelf(dirtyRegion);
+
+    displayDevice->recordStageTime(DisplayDevice::STAGE_REBUILD_LAYER_STACK,
+            systemTime(SYSTEM_TIME_MONOTONIC) - startTime);
 }
 
 void SurfaceFlinger::setUpHWComposer() {
@@ -1378,12 +1445,14 @@ void SurfaceFlinger::setUpHWComposer() {
     mat4 colorMatrix = mColorMatrix * mDaltonizer();
 
     // Set the per-frame data
+    std::vector<nsecs_t> setUpTimes(mDisplays.size(), 0);
     for (size_t displayId = 0; displayId < mDisplays.size(); ++displayId) {
         auto& displayDevice = mDisplays[displayId];
         const auto hwcId = displayDevice->getHwcDisplayId();
         if (hwcId < 0) {
             continue;
         }
+        const nsecs_t startTime = systemTime(SYSTEM_TIME_MONOTONIC);
         if (colorMatrix != mPreviousColorMatrix) {
             status_t result = mHwc->setColorTransform(hwcId, colorMatrix);
             ALOGE_IF(result != NO_ERROR, "Failed to set color transform on "
@@ -1392,6 +1461,7 @@ void SurfaceFlinger::setUpHWComposer() {
         for (auto& layer : displayDevice->getVisibleLayersSortedByZ()) {
             layer->setPerFrameData(displayDevice);
         }
+        setUpTimes[displayId] += systemTime(SYSTEM_TIME_MONOTONIC) - startTime;
     }
 
     mPreviousColorMatrix = colorMatrix;
@@ -1402,9 +1472,13 @@ void SurfaceFlinger::setUpHWComposer() {
             continue;
         }
 
+        const nsecs_t startTime = systemTime(SYSTEM_TIME_MONOTONIC);
         status_t result = displayDevice->prepareFrame(*mHwc);
         ALOGE_IF(result != NO_ERROR, "prepareFrame for display %zd failed:"
                 " %d (%s)", displayId, result, strerror(-result));
+        setUpTimes[displayId] += systemTime(SYSTEM_TIME_MONOTONIC) - startTime;
+        displayDevice->recordStageTime(DisplayDevice::STAGE_SET_UP_HWC,
+                setUpTimes[displayId]);
     }
 }
 
@@ -1416,6 +1490,8 @@ void SurfaceFlinger::doComposition() {
     for (size_t dpy=0 ; dpy<mDisplays.size() ; dpy++) {
         const sp<DisplayDevice>& hw(mDisplays[dpy]);
         if (hw->isDisplayOn()) {
+            const nsecs_t startTime = systemTime(SYSTEM_TIME_MONOTONIC);
+
             // transform the dirty region into this screen's coordinate space
             const Region dirtyRegion(hw->getDirtyRegion(repaintEverything));
 
@@ -1427,6 +1503,9 @@ void SurfaceFlinger::doComposition() {
             hw->dirtyRegion.clear();
             hw->flip(hw->swapRegion);
             hw->swapRegion.clear();
+
+            hw->recordStageTime(DisplayDevice::STAGE_COMPOSITION,
+                    systemTime(SYSTEM_TIME_MONOTONIC) - startTime);
         }
     }
     postFramebuffer();
@@ -1840,7 +1919,7 @@ void SurfaceFlinger::commitTransaction()
 
 void SurfaceFlinger::computeVisibleRegions(size_t /*dpy*/,
         const LayerVector& currentLayers, uint32_t layerStack,
-        Region& outDirtyRegion, Region& outOpaqueRegion)
+        VisibleRegionCache& cache, Region& outDirtyRegion, Region& outOpaqueRegion)
 {
     ATRACE_CALL();
     ALOGV("computeVisibleRegions");
@@ -1851,6 +1930,12 @@ void SurfaceFlinger::computeVisibleRegions(size_t /*dpy*/,
 
     outDirtyRegion.clear();
 
+    // layers are considered front to back; the cached results can be used
+    // until the first layer whose footprint changed.
+    bool reuseCachedRegions = true;
+    size_t layerCount = 0;
+    size_t reusedCount = 0;
+
     size_t i = currentLayers.size();
     while (i--) {
         const sp<Layer>& layer = currentLayers[i];
@@ -1892,11 +1977,56 @@ void SurfaceFlinger::computeVisibleRegions(size_t /*dpy*/,
         Region transparentRegion;
 
 
+        /*
+         * footprint: everything this layer feeds into the computation below.
+         * If it hasn't changed, and neither has any layer above it, the
+         * results of the previous pass are still valid.
+         */
+        VisibleRegionCache::Footprint footprint;
+        footprint.layerSequence = layer->sequence;
+        footprint.stateSequence = s.sequence;
+        footprint.visible = layer->isVisible();
+
         // handle hidden surfaces by setting the visible region to empty
-        if (CC_LIKELY(layer->isVisible())) {
+        if (CC_LIKELY(footprint.visible)) {
             const bool translucent = !layer->isOpaque(s);
-            Rect bounds(s.active.transform.transform(layer->computeBounds()));
-            visibleRegion.set(bounds);
+            const int32_t layerOrientation = s.active.transform.getOrientation();
+            footprint.translucent = translucent;
+            footprint.opaque = s.alpha == 1.0f && !translucent &&
+                    ((layerOrientation & Transform::ROT_INVALID) == false);
+            footprint.bounds = s.active.transform.transform(layer->computeBounds());
+            footprint.activeTransparentRegion = s.activeTransparentRegion;
+        }
+
+        const size_t cacheIndex = layerCount++;
+        if (reuseCachedRegions) {
+            const VisibleRegionCache::Entry* cached = cache.getCleanEntry(
+                    cacheIndex, footprint, layer->visibleRegion,
+                    layer->coveredRegion);
+            if (cached) {
+                // nothing above us nor this layer changed, so neither did
+                // the visible/covered regions nor what lies below.
+                if (layer->contentDirty) {
+                    // the old and new visible regions are the same
+                    outDirtyRegion.orSelf(cached->visibleRegion);
+                    layer->contentDirty = false;
+                } else {
+                    outDirtyRegion.orSelf(cached->getSteadyDirtyRegion());
+                }
+                aboveOpaqueLayers = cached->aboveOpaqueLayers;
+                aboveCoveredLayers = cached->aboveCoveredLayers;
+                layer->setVisibleNonTransparentRegion(
+                        cached->visibleNonTransparentRegion);
+                reusedCount++;
+                continue;
+            }
+            // from here on, recompute everything
+            reuseCachedRegions = false;
+        }
+
+        if (CC_LIKELY(footprint.visible)) {
+            const bool translucent = footprint.translucent;
+            visibleRegion.set(footprint.bounds);
             if (!visibleRegion.isEmpty()) {
                 // Remove the transparent area from the visible region
                 if (translucent) {
@@ -1912,9 +2042,7 @@ void SurfaceFlinger::computeVisibleRegions(size_t /*dpy*/,
                 }
 
                 // compute the opaque region
-                const int32_t layerOrientation = s.active.transform.getOrientation();
-                if (s.alpha == 1.0f && !translucent &&
-                        ((layerOrientation & Transform::ROT_INVALID) == false)) {
+                if (footprint.opaque) {
                     // the opaque region is the layer's footprint
                     opaqueRegion = visibleRegion;
                 }
@@ -1965,12 +2093,21 @@ void SurfaceFlinger::computeVisibleRegions(size_t /*dpy*/,
         aboveOpaqueLayers.orSelf(opaqueRegion);
 
         // Store the visible region in screen space
+        const Region visibleNonTransparentRegion(
+                visibleRegion.subtract(transparentRegion));
         layer->setVisibleRegion(visibleRegion);
         layer->setCoveredRegion(coveredRegion);
-        layer->setVisibleNonTransparentRegion(
-                visibleRegion.subtract(transparentRegion));
+        layer->setVisibleNonTransparentRegion(visibleNonTransparentRegion);
+
+        cache.update(cacheIndex, footprint, visibleRegion, coveredRegion,
+                visibleNonTransparentRegion, aboveOpaqueLayers,
+                aboveCoveredLayers);
     }
 
+    cache.endPass(layerCount, reusedCount);
+    ATRACE_INT("VisibleRegionsRecomputed",
+            static_cast<int32_t>(layerCount - reusedCount));
+
     outOpaqueRegion = aboveOpaqueLayers;
 }
 
@@ -2854,6 +2991,27 @@ status_t SurfaceFlinger::dump(int fd, const Vector<String16>& args)
                 mFenceTracker.dump(&result);
                 dumpAll = false;
             }
+
+            if ((index < numArgs) &&
+                    (args[index] == String16("--frame-timeline"))) {
+                index++;
+                dumpFrameTimelineLocked(args, index, result, false);
+                dumpAll = false;
+            }
+
+            if ((index < numArgs) &&
+                    (args[index] == String16("--frame-timeline-binary"))) {
+                index++;
+                dumpFrameTimelineLocked(args, index, result, true);
+                dumpAll = false;
+            }
+
+            if ((index < numArgs) &&
+                    (args[index] == String16("--frame-timeline-clear"))) {
+                index++;
+                clearFrameTimelineLocked(args, index);
+                dumpAll = false;
+            }
         }
 
         if (dumpAll) {
@@ -2927,6 +3085,53 @@ void SurfaceFlinger::clearStatsLocked(const Vector<String16>& args, size_t& inde
     mAnimFrameTracker.clearStats();
 }
 
+// Dumps the frame timeline of the layers called name, or of every layer if
+// no name is given. The text format has one section per layer, headed by its
+// name; the binary format is described in FrameTimeline.h.
+void SurfaceFlinger::dumpFrameTimelineLocked(const Vector<String16>& args,
+        size_t& index, String8& result, bool binary) const
+{
+    String8 name;
+    if (index < args.size()) {
+        name = String8(args[index]);
+        index++;
+    }
+
+    const LayerVector& currentLayers = mCurrentState.layersSortedByZ;
+    const size_t count = currentLayers.size();
+    for (size_t i=0 ; i<count ; i++) {
+        const sp<Layer>& layer(currentLayers[i]);
+        if (!name.isEmpty() && name != layer->getName()) {
+            continue;
+        }
+        if (binary) {
+            layer->dumpFrameTimelineBinary(result);
+        } else {
+            result.appendFormat("%s\n", layer->getName().string());
+            layer->dumpFrameTimeline(result);
+        }
+    }
+}
+
+void SurfaceFlinger::clearFrameTimelineLocked(const Vector<String16>& args,
+        size_t& index)
+{
+    String8 name;
+    if (index < args.size()) {
+        name = String8(args[index]);
+        index++;
+    }
+
+    const LayerVector& currentLayers = mCurrentState.layersSortedByZ;
+    const size_t count = currentLayers.size();
+    for (size_t i=0 ; i<count ; i++) {
+        const sp<Layer>& layer(currentLayers[i]);
+        if (name.isEmpty() || (name == layer->getName())) {
+            layer->clearFrameTimeline();
+        }
+    }
+}
+
 // This should only be called from the main thread.  Otherwise it would need
 // the lock and should use mCurrentState rather than mDrawingState.
 void SurfaceFlinger::logFrameStats() {
@@ -3082,6 +3287,9 @@ void SurfaceFlinger::dumpAllLocked(const Vector<String16>& args, size_t& index,
 
     dumpBufferingStats(result);
 
+    ProcessState::self()->dumpThreadPool(result);
+    result.append("\n");
+
     /*
      * Dump the visible layer list
      */
@@ -3106,6 +3314,10 @@ void SurfaceFlinger::dumpAllLocked(const Vector<String16>& args, size_t& index,
         const sp<const DisplayDevice>& hw(mDisplays[dpy]);
         hw->dump(result);
     }
+    result.appendFormat("  parallel layer stack rebuild: %s (%zu worker threads)\n",
+            mDisplayWorkerPool != nullptr ? "enabled" : "disabled",
+            mDisplayWorkerPool != nullptr ?
+                    mDisplayWorkerPool->getThreadCount() : 0);
 
     /*
      * Dump SurfaceFlinger global state
@@ -3194,6 +3406,7 @@ void SurfaceFlinger::dumpAllLocked(const Vector<String16>& args, size_t& index,
      */
     const GraphicBufferAllocator& alloc(GraphicBufferAllocator::get());
     alloc.dump(result);
+    GraphicBufferPool::getInstance().dump(result, "");
 }
 
 const Vector< sp<Layer> >&
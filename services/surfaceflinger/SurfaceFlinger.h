@@ -56,6 +56,7 @@
 #include "FenceTracker.h"
 #include "FrameTracker.h"
 #include "MessageQueue.h"
+#include "WorkerPool.h"
 
 #include "DisplayHardware/HWComposer.h"
 #include "Effects/Daltonizer.h"
@@ -63,6 +64,7 @@
 #include "FrameRateHelper.h"
 
 #include <map>
+#include <memory>
 #include <string>
 
 namespace android {
@@ -462,11 +464,17 @@ private:
     void invalidateHwcGeometry();
     void computeVisibleRegions(size_t dpy,
             const LayerVector& currentLayers, uint32_t layerStack,
+            VisibleRegionCache& cache,
             Region& dirtyRegion, Region& opaqueRegion);
 
     void preComposition();
     void postComposition(nsecs_t refreshStartTime);
     void rebuildLayerStacks();
+#ifdef USE_HWC2
+    // rebuilds the visible layer list of a single display; may run on a
+    // display worker thread
+    void rebuildLayerStack(size_t dpy, Vector<sp<Layer>>& outHiddenLayers);
+#endif
     void setUpHWComposer();
     void doComposition();
     void doDebugFlashRegions();
@@ -499,6 +507,9 @@ private:
     void listLayersLocked(const Vector<String16>& args, size_t& index, String8& result) const;
     void dumpStatsLocked(const Vector<String16>& args, size_t& index, String8& result) const;
     void clearStatsLocked(const Vector<String16>& args, size_t& index, String8& result);
+    void dumpFrameTimelineLocked(const Vector<String16>& args, size_t& index,
+            String8& result, bool binary) const;
+    void clearFrameTimelineLocked(const Vector<String16>& args, size_t& index);
     void dumpAllLocked(const Vector<String16>& args, size_t& index, String8& result) const;
     bool startDdmConnection();
     static void appendSfConfigString(String8& result);
@@ -584,8 +595,12 @@ private:
     FenceTracker mFenceTracker;
 #ifdef USE_HWC2
     bool mPropagateBackpressure = true;
+    // runs per-display work concurrently, null unless enabled
+    std::unique_ptr<WorkerPool> mDisplayWorkerPool;
 #endif
     bool mUseHwcVirtualDisplays = true;
+    // let layer BufferQueues adjust their depth to occupancy
+    bool mAdaptiveQueueDepth = false;
 
     // these are thread safe
     mutable MessageQueue mEventQueue;
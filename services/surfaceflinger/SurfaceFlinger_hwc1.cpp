@@ -48,6 +48,7 @@
 #include <gui/IDisplayEventConnection.h>
 #include <gui/Surface.h>
 #include <gui/GraphicBufferAlloc.h>
+#include <gui/GraphicBufferPool.h>
 
 #include <ui/GraphicBufferAllocator.h>
 #include <ui/HdrCapabilities.h>
@@ -199,6 +200,17 @@ SurfaceFlinger::SurfaceFlinger()
     property_get("debug.sf.disable_hwc_vds", value, "0");
     mUseHwcVirtualDisplays = !atoi(value);
     ALOGI_IF(!mUseHwcVirtualDisplays, "Disabling HWC virtual displays");
+
+    property_get("debug.sf.adaptive_queue_depth", value, "0");
+    mAdaptiveQueueDepth = atoi(value) != 0;
+    ALOGI_IF(mAdaptiveQueueDepth, "Enabling adaptive queue depth");
+
+    // recycle the buffers of torn down layers, off unless the device sets
+    // a pool size
+    property_get("ro.sf.buffer_pool_size_kb", value, "0");
+    int bufferPoolSizeKb = atoi(value);
+    GraphicBufferPool::getInstance().setMaxBytes(bufferPoolSizeKb > 0 ?
+            static_cast<size_t>(bufferPoolSizeKb) * 1024 : 0);
 }
 
 void SurfaceFlinger::onFirstRef()
@@ -1155,7 +1167,7 @@ void SurfaceFlinger::postComposition(nsecs_t refreshStartTime)
     const LayerVector& layers(mDrawingState.layersSortedByZ);
     const size_t count = layers.size();
     for (size_t i=0 ; i<count ; i++) {
-        bool frameLatched = layers[i]->onPostComposition();
+        bool frameLatched = layers[i]->onPostComposition(refreshStartTime);
         if (frameLatched) {
             recordBufferingStats(layers[i]->getName().string(),
                     layers[i]->getOccupancyHistory(false));
@@ -1234,11 +1246,13 @@ void SurfaceFlinger::rebuildLayerStacks() {
             Region dirtyRegion;
             Vector< sp<Layer> > layersSortedByZ;
             const sp<DisplayDevice>& hw(mDisplays[dpy]);
+            const nsecs_t startTime = systemTime(SYSTEM_TIME_MONOTONIC);
             const Transform& tr(hw->getTransform());
             const Rect bounds(hw->getBounds());
             if (hw->isDisplayOn()) {
                 computeVisibleRegions(hw->getHwcDisplayId(), layers,
-                        hw->getLayerStack(), dirtyRegion, opaqueRegion);
+                        hw->getLayerStack(), hw->getVisibleRegionCache(),
+                        dirtyRegion, opaqueRegion);
 
                 const size_t count = layers.size();
                 for (size_t i=0 ; i<count ; i++) {
@@ -1257,6 +1271,8 @@ void SurfaceFlinger::rebuildLayerStacks() {
             hw->undefinedRegion.set(bounds);
             hw->undefinedRegion.subtractSelf(tr.transform(opaqueRegion));
             hw->dirtyRegion.orSelf(dirtyRegion);
+            hw->recordStageTime(DisplayDevice::STAGE_REBUILD_LAYER_STACK,
+                    systemTime(SYSTEM_TIME_MONOTONIC) - startTime);
         }
     }
 }
@@ -1324,6 +1340,7 @@ void SurfaceFlinger::setUpHWComposer() {
             sp<const DisplayDevice> hw(mDisplays[dpy]);
             const int32_t id = hw->getHwcDisplayId();
             if (id >= 0) {
+                const nsecs_t startTime = systemTime(SYSTEM_TIME_MONOTONIC);
                 bool freezeSurfacePresent = false;
                 isfreezeSurfacePresent(freezeSurfacePresent, hw, id);
                 const Vector< sp<Layer> >& currentLayers(
@@ -1340,6 +1357,8 @@ void SurfaceFlinger::setUpHWComposer() {
                     layer->setPerFrameData(hw, *cur);
                     setOrientationEventControl(freezeSurfacePresent,id);
                 }
+                mDisplays[dpy]->recordStageTime(DisplayDevice::STAGE_SET_UP_HWC,
+                        systemTime(SYSTEM_TIME_MONOTONIC) - startTime);
             }
         }
 
@@ -1381,6 +1400,8 @@ void SurfaceFlinger::doComposition() {
     for (size_t dpy=0 ; dpy<mDisplays.size() ; dpy++) {
         const sp<DisplayDevice>& hw(mDisplays[dpy]);
         if (hw->isDisplayOn()) {
+            const nsecs_t startTime = systemTime(SYSTEM_TIME_MONOTONIC);
+
             // transform the dirty region into this screen's coordinate space
             const Region dirtyRegion(hw->getDirtyRegion(repaintEverything));
 
@@ -1392,6 +1413,9 @@ void SurfaceFlinger::doComposition() {
             hw->dirtyRegion.clear();
             hw->flip(hw->swapRegion);
             hw->swapRegion.clear();
+
+            hw->recordStageTime(DisplayDevice::STAGE_COMPOSITION,
+                    systemTime(SYSTEM_TIME_MONOTONIC) - startTime);
         }
         // inform the h/w that we're done compositing
         hw->compositionComplete();
@@ -1830,7 +1854,7 @@ void SurfaceFlinger::commitTransaction()
 
 void SurfaceFlinger::computeVisibleRegions(size_t dpy,
         const LayerVector& currentLayers, uint32_t layerStack,
-        Region& outDirtyRegion, Region& outOpaqueRegion)
+        VisibleRegionCache& cache, Region& outDirtyRegion, Region& outOpaqueRegion)
 {
     ATRACE_CALL();
 
@@ -1839,6 +1863,13 @@ void SurfaceFlinger::computeVisibleRegions(size_t dpy,
     Region dirty;
 
     outDirtyRegion.clear();
+
+    // layers are considered front to back; the cached results can be used
+    // until the first layer whose footprint changed.
+    bool reuseCachedRegions = true;
+    size_t layerCount = 0;
+    size_t reusedCount = 0;
+
     bool bIgnoreLayers = false;
     int indexLOI = -1;
     getIndexLOI(dpy, currentLayers, bIgnoreLayers, indexLOI);
@@ -1885,11 +1916,56 @@ void SurfaceFlinger::computeVisibleRegions(size_t dpy,
         Region transparentRegion;
 
 
+        /*
+         * footprint: everything this layer feeds into the computation below.
+         * If it hasn't changed, and neither has any layer above it, the
+         * results of the previous pass are still valid.
+         */
+        VisibleRegionCache::Footprint footprint;
+        footprint.layerSequence = layer->sequence;
+        footprint.stateSequence = s.sequence;
+        footprint.visible = layer->isVisible();
+
         // handle hidden surfaces by setting the visible region to empty
-        if (CC_LIKELY(layer->isVisible())) {
+        if (CC_LIKELY(footprint.visible)) {
             const bool translucent = !layer->isOpaque(s);
-            Rect bounds(s.active.transform.transform(layer->computeBounds()));
-            visibleRegion.set(bounds);
+            const int32_t layerOrientation = s.active.transform.getOrientation();
+            footprint.translucent = translucent;
+            footprint.opaque = s.alpha==255 && !translucent &&
+                    ((layerOrientation & Transform::ROT_INVALID) == false);
+            footprint.bounds = s.active.transform.transform(layer->computeBounds());
+            footprint.activeTransparentRegion = s.activeTransparentRegion;
+        }
+
+        const size_t cacheIndex = layerCount++;
+        if (reuseCachedRegions) {
+            const VisibleRegionCache::Entry* cached = cache.getCleanEntry(
+                    cacheIndex, footprint, layer->visibleRegion,
+                    layer->coveredRegion);
+            if (cached) {
+                // nothing above us nor this layer changed, so neither did
+                // the visible/covered regions nor what lies below.
+                if (layer->contentDirty) {
+                    // the old and new visible regions are the same
+                    outDirtyRegion.orSelf(cached->visibleRegion);
+                    layer->contentDirty = false;
+                } else {
+                    outDirtyRegion.orSelf(cached->getSteadyDirtyRegion());
+                }
+                aboveOpaqueLayers = cached->aboveOpaqueLayers;
+                aboveCoveredLayers = cached->aboveCoveredLayers;
+                layer->setVisibleNonTransparentRegion(
+                        cached->visibleNonTransparentRegion);
+                reusedCount++;
+                continue;
+            }
+            // from here on, recompute everything
+            reuseCachedRegions = false;
+        }
+
+        if (CC_LIKELY(footprint.visible)) {
+            const bool translucent = footprint.translucent;
+            visibleRegion.set(footprint.bounds);
             if (!visibleRegion.isEmpty()) {
                 // Remove the transparent area from the visible region
                 if (translucent) {
@@ -1905,9 +1981,7 @@ void SurfaceFlinger::computeVisibleRegions(size_t dpy,
                 }
 
                 // compute the opaque region
-                const int32_t layerOrientation = s.active.transform.getOrientation();
-                if (s.alpha==255 && !translucent &&
-                        ((layerOrientation & Transform::ROT_INVALID) == false)) {
+                if (footprint.opaque) {
                     // the opaque region is the layer's footprint
                     opaqueRegion = visibleRegion;
                 }
@@ -1958,12 +2032,21 @@ void SurfaceFlinger::computeVisibleRegions(size_t dpy,
         aboveOpaqueLayers.orSelf(opaqueRegion);
 
         // Store the visible region in screen space
+        const Region visibleNonTransparentRegion(
+                visibleRegion.subtract(transparentRegion));
         layer->setVisibleRegion(visibleRegion);
         layer->setCoveredRegion(coveredRegion);
-        layer->setVisibleNonTransparentRegion(
-                visibleRegion.subtract(transparentRegion));
+        layer->setVisibleNonTransparentRegion(visibleNonTransparentRegion);
+
+        cache.update(cacheIndex, footprint, visibleRegion, coveredRegion,
+                visibleNonTransparentRegion, aboveOpaqueLayers,
+                aboveCoveredLayers);
     }
 
+    cache.endPass(layerCount, reusedCount);
+    ATRACE_INT("VisibleRegionsRecomputed",
+            static_cast<int32_t>(layerCount - reusedCount));
+
     outOpaqueRegion = aboveOpaqueLayers;
 }
 
@@ -2852,6 +2935,27 @@ status_t SurfaceFlinger::dump(int fd, const Vector<String16>& args)
                 mFenceTracker.dump(&result);
                 dumpAll = false;
             }
+
+            if ((index < numArgs) &&
+                    (args[index] == String16("--frame-timeline"))) {
+                index++;
+                dumpFrameTimelineLocked(args, index, result, false);
+                dumpAll = false;
+            }
+
+            if ((index < numArgs) &&
+                    (args[index] == String16("--frame-timeline-binary"))) {
+                index++;
+                dumpFrameTimelineLocked(args, index, result, true);
+                dumpAll = false;
+            }
+
+            if ((index < numArgs) &&
+                    (args[index] == String16("--frame-timeline-clear"))) {
+                index++;
+                clearFrameTimelineLocked(args, index);
+                dumpAll = false;
+            }
         }
 
         if (dumpAll) {
@@ -2925,6 +3029,53 @@ void SurfaceFlinger::clearStatsLocked(const Vector<String16>& args, size_t& inde
     mAnimFrameTracker.clearStats();
 }
 
+// Dumps the frame timeline of the layers called name, or of every layer if
+// no name is given. The text format has one section per layer, headed by its
+// name; the binary format is described in FrameTimeline.h.
+void SurfaceFlinger::dumpFrameTimelineLocked(const Vector<String16>& args,
+        size_t& index, String8& result, bool binary) const
+{
+    String8 name;
+    if (index < args.size()) {
+        name = String8(args[index]);
+        index++;
+    }
+
+    const LayerVector& currentLayers = mCurrentState.layersSortedByZ;
+    const size_t count = currentLayers.size();
+    for (size_t i=0 ; i<count ; i++) {
+        const sp<Layer>& layer(currentLayers[i]);
+        if (!name.isEmpty() && name != layer->getName()) {
+            continue;
+        }
+        if (binary) {
+            layer->dumpFrameTimelineBinary(result);
+        } else {
+            result.appendFormat("%s\n", layer->getName().string());
+            layer->dumpFrameTimeline(result);
+        }
+    }
+}
+
+void SurfaceFlinger::clearFrameTimelineLocked(const Vector<String16>& args,
+        size_t& index)
+{
+    String8 name;
+    if (index < args.size()) {
+        name = String8(args[index]);
+        index++;
+    }
+
+    const LayerVector& currentLayers = mCurrentState.layersSortedByZ;
+    const size_t count = currentLayers.size();
+    for (size_t i=0 ; i<count ; i++) {
+        const sp<Layer>& layer(currentLayers[i]);
+        if (name.isEmpty() || (name == layer->getName())) {
+            layer->clearFrameTimeline();
+        }
+    }
+}
+
 // This should only be called from the main thread.  Otherwise it would need
 // the lock and should use mCurrentState rather than mDrawingState.
 void SurfaceFlinger::logFrameStats() {
@@ -3077,6 +3228,9 @@ void SurfaceFlinger::dumpAllLocked(const Vector<String16>& args, size_t& index,
 
     dumpBufferingStats(result);
 
+    ProcessState::self()->dumpThreadPool(result);
+    result.append("\n");
+
     /*
      * Dump the visible layer list
      */
@@ -3171,6 +3325,7 @@ void SurfaceFlinger::dumpAllLocked(const Vector<String16>& args, size_t& index,
      */
     const GraphicBufferAllocator& alloc(GraphicBufferAllocator::get());
     alloc.dump(result);
+    GraphicBufferPool::getInstance().dump(result, "");
 }
 
 const Vector< sp<Layer> >&
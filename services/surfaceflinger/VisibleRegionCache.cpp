@@ -0,0 +1,135 @@
+/*
+ * Copyright 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <inttypes.h>
+
+#include "VisibleRegionCache.h"
+
+namespace android {
+
+// ---------------------------------------------------------------------------
+
+VisibleRegionCache::Footprint::Footprint() :
+        layerSequence(0),
+        stateSequence(0),
+        visible(false),
+        translucent(false),
+        opaque(false),
+        bounds(Rect::EMPTY_RECT),
+        activeTransparentRegion() {
+}
+
+bool VisibleRegionCache::Footprint::operator == (const Footprint& rhs) const {
+    if (layerSequence != rhs.layerSequence ||
+            stateSequence != rhs.stateSequence ||
+            visible != rhs.visible ||
+            translucent != rhs.translucent ||
+            opaque != rhs.opaque ||
+            bounds != rhs.bounds) {
+        return false;
+    }
+    // the transparent region hint only matters for translucent layers
+    return !translucent ||
+            activeTransparentRegion.isTriviallyEqual(rhs.activeTransparentRegion);
+}
+
+const Region& VisibleRegionCache::Entry::getSteadyDirtyRegion() const {
+    if (!mHasSteadyDirtyRegion) {
+        mSteadyDirtyRegion = visibleRegion.intersect(coveredRegion);
+        mHasSteadyDirtyRegion = true;
+    }
+    return mSteadyDirtyRegion;
+}
+
+// ---------------------------------------------------------------------------
+
+VisibleRegionCache::VisibleRegionCache() :
+        mEntries(),
+        mPassCount(0),
+        mTotalRecomputed(0),
+        mTotalReused(0),
+        mLastRecomputed(0),
+        mLastReused(0),
+        mMaxRecomputed(0) {
+}
+
+const VisibleRegionCache::Entry* VisibleRegionCache::getCleanEntry(
+        size_t index, const Footprint& footprint,
+        const Region& layerVisibleRegion,
+        const Region& layerCoveredRegion) const {
+    if (index >= mEntries.size()) {
+        return NULL;
+    }
+    const Entry& entry(mEntries[index]);
+    if (entry.footprint != footprint) {
+        return NULL;
+    }
+    // The layer's regions may have been overwritten by another display
+    // showing the same layer stack; only reuse what we stored ourselves.
+    if (!entry.visibleRegion.isTriviallyEqual(layerVisibleRegion) ||
+            !entry.coveredRegion.isTriviallyEqual(layerCoveredRegion)) {
+        return NULL;
+    }
+    return &entry;
+}
+
+void VisibleRegionCache::update(size_t index, const Footprint& footprint,
+        const Region& visibleRegion, const Region& coveredRegion,
+        const Region& visibleNonTransparentRegion,
+        const Region& aboveOpaqueLayers,
+        const Region& aboveCoveredLayers) {
+    if (index >= mEntries.size()) {
+        mEntries.resize(index + 1);
+    }
+    Entry& entry(mEntries[index]);
+    entry.footprint = footprint;
+    entry.visibleRegion = visibleRegion;
+    entry.coveredRegion = coveredRegion;
+    entry.visibleNonTransparentRegion = visibleNonTransparentRegion;
+    entry.aboveOpaqueLayers = aboveOpaqueLayers;
+    entry.aboveCoveredLayers = aboveCoveredLayers;
+    entry.mSteadyDirtyRegion.clear();
+    entry.mHasSteadyDirtyRegion = false;
+}
+
+void VisibleRegionCache::endPass(size_t layerCount, size_t reusedCount) {
+    if (mEntries.size() > layerCount) {
+        mEntries.resize(layerCount);
+    }
+
+    const size_t recomputed = layerCount - reusedCount;
+    mPassCount++;
+    mTotalRecomputed += recomputed;
+    mTotalReused += reusedCount;
+    mLastRecomputed = recomputed;
+    mLastReused = reusedCount;
+    if (recomputed > mMaxRecomputed) {
+        mMaxRecomputed = recomputed;
+    }
+}
+
+void VisibleRegionCache::dump(String8& result) const {
+    result.appendFormat(
+        "   visible regions: passes=%" PRIu64 ", last pass recomputed=%zu "
+        "reused=%zu, max recomputed=%zu, total recomputed=%" PRIu64
+        " reused=%" PRIu64 "\n",
+        mPassCount, mLastRecomputed, mLastReused, mMaxRecomputed,
+        mTotalRecomputed, mTotalReused);
+}
+
+// ---------------------------------------------------------------------------
+
+}; // namespace android
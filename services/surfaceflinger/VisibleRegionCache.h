@@ -0,0 +1,128 @@
+/*
+ * Copyright 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_VISIBLE_REGION_CACHE_H
+#define ANDROID_VISIBLE_REGION_CACHE_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <ui/Rect.h>
+#include <ui/Region.h>
+#include <utils/String8.h>
+
+#include <vector>
+
+namespace android {
+
+// ---------------------------------------------------------------------------
+
+/*
+ * Remembers, for one display, the result of the last visible region pass of
+ * SurfaceFlinger::computeVisibleRegions().
+ *
+ * The pass walks the layer stack front-to-back, accumulating the opaque and
+ * covered regions of the layers above the current one. As long as every
+ * layer walked so far has the same footprint as in the previous pass, the
+ * accumulated regions (and thus the visible/covered regions of each of
+ * these layers) are the same as well, so they can be taken from the cache.
+ * Only the layers from the first changed one downwards need to be
+ * recomputed.
+ */
+class VisibleRegionCache {
+public:
+    /*
+     * Everything a layer contributes to the visible region computation.
+     * Two footprints comparing equal yield the same visible, covered and
+     * opaque regions given the same layers above them.
+     */
+    struct Footprint {
+        int32_t layerSequence;  // Layer::sequence, identifies the layer
+        int32_t stateSequence;  // Layer::State::sequence
+        bool visible;
+        bool translucent;
+        bool opaque;
+        Rect bounds;            // in layer-stack space
+        // untransformed transparent region hint, compared by identity
+        Region activeTransparentRegion;
+
+        Footprint();
+        bool operator == (const Footprint& rhs) const;
+        inline bool operator != (const Footprint& rhs) const {
+            return !operator == (rhs);
+        }
+    };
+
+    struct Entry {
+        Entry() : mHasSteadyDirtyRegion(false) { }
+
+        Footprint footprint;
+        Region visibleRegion;
+        Region coveredRegion;
+        Region visibleNonTransparentRegion;
+        // accumulated regions of this layer and all layers above it
+        Region aboveOpaqueLayers;
+        Region aboveCoveredLayers;
+
+        // Dirty region contributed by this layer when nothing changed,
+        // i.e. (visibleRegion & coveredRegion). Computed on first use.
+        const Region& getSteadyDirtyRegion() const;
+
+    private:
+        mutable Region mSteadyDirtyRegion;
+        mutable bool mHasSteadyDirtyRegion;
+        friend class VisibleRegionCache;
+    };
+
+    VisibleRegionCache();
+
+    // Returns the cached entry for the index-th considered layer (front to
+    // back) if it was computed from the same footprint and the layer still
+    // holds the visible and covered regions stored in it, NULL otherwise.
+    const Entry* getCleanEntry(size_t index, const Footprint& footprint,
+            const Region& layerVisibleRegion,
+            const Region& layerCoveredRegion) const;
+
+    // Stores the freshly computed state of the index-th considered layer.
+    void update(size_t index, const Footprint& footprint,
+            const Region& visibleRegion, const Region& coveredRegion,
+            const Region& visibleNonTransparentRegion,
+            const Region& aboveOpaqueLayers,
+            const Region& aboveCoveredLayers);
+
+    // Ends a pass over 'layerCount' layers, of which 'reusedCount' were
+    // taken from the cache.
+    void endPass(size_t layerCount, size_t reusedCount);
+
+    void dump(String8& result) const;
+
+private:
+    std::vector<Entry> mEntries;
+
+    // statistics
+    uint64_t mPassCount;
+    uint64_t mTotalRecomputed;
+    uint64_t mTotalReused;
+    size_t mLastRecomputed;
+    size_t mLastReused;
+    size_t mMaxRecomputed;
+};
+
+// ---------------------------------------------------------------------------
+
+}; // namespace android
+
+#endif // ANDROID_VISIBLE_REGION_CACHE_H
@@ -0,0 +1,117 @@
+/*
+ * Copyright 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define ATRACE_TAG ATRACE_TAG_GRAPHICS
+
+#include <string.h>
+
+#include <cutils/log.h>
+
+#include <utils/String8.h>
+#include <utils/Trace.h>
+
+#include "WorkerPool.h"
+
+namespace android {
+
+// ---------------------------------------------------------------------------
+
+WorkerPool::WorkerPool(const char* name, size_t threadCount) :
+        mTask(NULL),
+        mTaskCount(0),
+        mNextTask(0),
+        mRemainingTasks(0),
+        mExiting(false) {
+    for (size_t i = 0; i < threadCount; i++) {
+        sp<Worker> worker(new Worker(*this));
+        status_t err = worker->run(String8::format("%s%zu", name, i).string(),
+                PRIORITY_URGENT_DISPLAY);
+        if (err != NO_ERROR) {
+            ALOGE("WorkerPool: unable to start thread %zu (%s)", i,
+                    strerror(-err));
+            break;
+        }
+        mWorkers.add(worker);
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        Mutex::Autolock _l(mLock);
+        mExiting = true;
+        mWorkCondition.broadcast();
+    }
+    for (size_t i = 0; i < mWorkers.size(); i++) {
+        mWorkers[i]->requestExitAndWait();
+    }
+}
+
+void WorkerPool::run(size_t count, const Task& task) {
+    ATRACE_CALL();
+    if (mWorkers.isEmpty() || count <= 1) {
+        for (size_t i = 0; i < count; i++) {
+            task(i);
+        }
+        return;
+    }
+
+    Mutex::Autolock _l(mLock);
+    mTask = &task;
+    mTaskCount = count;
+    mNextTask = 0;
+    mRemainingTasks = count;
+    mWorkCondition.broadcast();
+
+    // lend a hand, then wait for the tasks still running on the workers
+    processTasksLocked();
+    while (mRemainingTasks) {
+        mDoneCondition.wait(mLock);
+    }
+    mTask = NULL;
+}
+
+bool WorkerPool::hasPendingTasksLocked() const {
+    return mTask != NULL && mNextTask < mTaskCount;
+}
+
+void WorkerPool::processTasksLocked() {
+    while (hasPendingTasksLocked()) {
+        const Task& task(*mTask);
+        const size_t index = mNextTask++;
+        mLock.unlock();
+        task(index);
+        mLock.lock();
+        if (--mRemainingTasks == 0) {
+            mDoneCondition.signal();
+        }
+    }
+}
+
+bool WorkerPool::Worker::threadLoop() {
+    Mutex::Autolock _l(mPool.mLock);
+    while (!mPool.mExiting && !mPool.hasPendingTasksLocked()) {
+        mPool.mWorkCondition.wait(mPool.mLock);
+    }
+    if (mPool.mExiting) {
+        return false;
+    }
+    mPool.processTasksLocked();
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+
+}; // namespace android
@@ -0,0 +1,80 @@
+/*
+ * Copyright 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_SF_WORKER_POOL_H
+#define ANDROID_SF_WORKER_POOL_H
+
+#include <stddef.h>
+
+#include <utils/Condition.h>
+#include <utils/Mutex.h>
+#include <utils/RefBase.h>
+#include <utils/Thread.h>
+#include <utils/Vector.h>
+
+#include <functional>
+
+namespace android {
+
+/*
+ * A small fixed-size pool of threads used by SurfaceFlinger to run
+ * independent per-display work concurrently. The calling thread takes part
+ * in the work, and run() only returns once every task has completed, so it
+ * acts as a barrier.
+ */
+class WorkerPool {
+public:
+    typedef std::function<void(size_t)> Task;
+
+    WorkerPool(const char* name, size_t threadCount);
+    ~WorkerPool();
+
+    size_t getThreadCount() const { return mWorkers.size(); }
+
+    // Runs task(0) .. task(count - 1) and waits for all of them to complete.
+    // Must not be called concurrently from several threads.
+    void run(size_t count, const Task& task);
+
+private:
+    class Worker : public Thread {
+    public:
+        explicit Worker(WorkerPool& pool) : Thread(false), mPool(pool) { }
+        virtual bool threadLoop();
+    private:
+        WorkerPool& mPool;
+    };
+
+    // Runs tasks of the current batch until none is left to start.
+    // Must be called with mLock held.
+    void processTasksLocked();
+    bool hasPendingTasksLocked() const;
+
+    Mutex mLock;
+    Condition mWorkCondition;
+    Condition mDoneCondition;
+    Vector< sp<Worker> > mWorkers;
+
+    // protected by mLock
+    const Task* mTask;
+    size_t mTaskCount;
+    size_t mNextTask;
+    size_t mRemainingTasks;
+    bool mExiting;
+};
+
+}; // namespace android
+
+#endif // ANDROID_SF_WORKER_POOL_H
@@ -17,7 +17,9 @@
 #include <sys/resource.h>
 
 #include <sched.h>
+#include <stdlib.h>
 
+#include <cutils/properties.h>
 #include <cutils/sched_policy.h>
 #include <binder/IServiceManager.h>
 #include <binder/IPCThreadState.h>
@@ -32,8 +34,15 @@ using namespace android;
 int main(int, char**) {
     signal(SIGPIPE, SIG_IGN);
     // When SF is launched in its own process, limit the number of
-    // binder threads to 4.
-    ProcessState::self()->setThreadPoolMaxThreadCount(4);
+    // binder threads to 4. Devices can let the pool shrink to 2 threads
+    // while clients leave it idle instead.
+    char value[PROPERTY_VALUE_MAX];
+    property_get("ro.sf.binder_adaptive_pool", value, "0");
+    if (atoi(value)) {
+        ProcessState::self()->setThreadPoolAdaptive(2, 4);
+    } else {
+        ProcessState::self()->setThreadPoolMaxThreadCount(4);
+    }
 
     // start the thread pool
     sp<ProcessState> ps(ProcessState::self());